@@ -0,0 +1,205 @@
+
+
+#include "AdaptivePoller.h"
+
+#include <string.h>
+
+
+
+namespace
+{
+    // this is kHIDPage_KeyboardOrKeypad
+    const uint16_t USAGE_PAGE_KEYBOARD_OR_KEYPAD = 0x07;
+
+    /// the eight modifiers, kHIDUsage_KeyboardLeftControl (0xE0) through kHIDUsage_KeyboardRightGUI (0xE7)
+    const unsigned int MODIFIER_WORD = 0xE0 >> 5;
+    const uint32_t MODIFIER_BITS = 0x000000FFu;
+
+    const size_t WORD_COUNT = GitHubSample::KeyStateBitmap::kWordCount;
+
+
+    bool IsEmpty( const uint32_t* words )
+    {
+        uint32_t any = 0;
+        for ( size_t w = 0; w < WORD_COUNT; w++ )
+        {
+            any |= words[ w ];
+        }
+        return any == 0;
+    }
+}
+
+
+
+GitHubSample::AdaptivePoller::AdaptivePoller
+(
+ SnapshotFunctor snapshotFunctor,
+ const uint64_t minimumInterval,
+ const uint64_t maximumInterval,
+ const uint64_t activeHold,
+ EventClock& clock
+)
+    : m_snapshotFunctor( snapshotFunctor ),
+      m_clock( clock ),
+      m_minimumInterval( minimumInterval ),
+      m_maximumInterval( maximumInterval < minimumInterval ? minimumInterval : maximumInterval ),
+      m_activeHold( activeHold ),
+      m_interval( minimumInterval ),
+      m_nextPollTime( 0 ),
+      m_lastActivityTime( m_clock.NowNanoseconds() ),
+      m_snapshotTicks( 0 ),
+      m_deviceIndex( 0 ),
+      m_pollCount( 0 ),
+      m_edgeCount( 0 ),
+      m_failedSnapshotCount( 0 )
+{
+    Reset();
+}
+
+
+void GitHubSample::AdaptivePoller::Reset()
+{
+    memset( m_current.words, 0, sizeof(m_current.words) );
+    memset( m_reported.words, 0, sizeof(m_reported.words) );
+    m_interval = m_minimumInterval;
+    m_nextPollTime = 0;
+}
+
+
+size_t GitHubSample::AdaptivePoller::Poll( KeyEvent* events, const size_t capacity )
+{
+    const uint64_t ticks = m_clock.Now();
+    const uint64_t now = m_clock.ToNanoseconds( ticks );
+
+    uint32_t changed[ WORD_COUNT ];
+    for ( size_t w = 0; w < WORD_COUNT; w++ )
+    {
+        changed[ w ] = m_current.words[ w ] ^ m_reported.words[ w ];
+    }
+
+    // only take a new snapshot once everything from the last one was handed out
+    if ( IsEmpty( changed ) )
+    {
+        KeyStateBitmap snapshot;
+        m_pollCount++;
+
+        if ( ! m_snapshotFunctor || ! m_snapshotFunctor( snapshot ) )
+        {
+            m_failedSnapshotCount++;
+            Schedule( now, false );
+            return 0; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+        }
+
+        m_current = snapshot;
+        m_snapshotTicks = ticks;
+
+        for ( size_t w = 0; w < WORD_COUNT; w++ )
+        {
+            changed[ w ] = m_current.words[ w ] ^ m_reported.words[ w ];
+        }
+    }
+
+    uint32_t modifierPresses[ WORD_COUNT ];
+    uint32_t keys[ WORD_COUNT ];
+    uint32_t modifierReleases[ WORD_COUNT ];
+    for ( size_t w = 0; w < WORD_COUNT; w++ )
+    {
+        const uint32_t modifiers = ( w == MODIFIER_WORD ) ? MODIFIER_BITS : 0;
+        modifierPresses[ w ] = changed[ w ] & m_current.words[ w ] & modifiers;
+        keys[ w ] = changed[ w ] & ~modifiers;
+        modifierReleases[ w ] = changed[ w ] & ~m_current.words[ w ] & modifiers;
+    }
+
+    size_t count = EmitEdges( modifierPresses, events, capacity );
+    count += EmitEdges( keys, events + count, capacity - count );
+    count += EmitEdges( modifierReleases, events + count, capacity - count );
+    m_edgeCount += count;
+
+    Schedule( now, count != 0 || ! IsEmpty( m_current.words ) );
+
+    if ( count == capacity && memcmp( m_current.words, m_reported.words, sizeof(m_current.words) ) != 0 )
+    {
+        // the caller ran out of room. the rest is due right away.
+        m_nextPollTime = now;
+    }
+
+    return count;
+}
+
+
+size_t GitHubSample::AdaptivePoller::WaitAndPoll( KeyEvent* events, const size_t capacity )
+{
+    m_clock.SleepUntil( m_nextPollTime );
+
+    return Poll( events, capacity );
+}
+
+
+uint64_t GitHubSample::AdaptivePoller::NanosecondsUntilNextPoll() const
+{
+    const uint64_t now = m_clock.NowNanoseconds();
+    return ( m_nextPollTime > now ) ? m_nextPollTime - now : 0;
+}
+
+
+size_t GitHubSample::AdaptivePoller::EmitEdges( const uint32_t* mask, KeyEvent* events, const size_t capacity )
+{
+    size_t count = 0;
+
+    for ( size_t w = 0; w < WORD_COUNT; w++ )
+    {
+        uint32_t bits = mask[ w ];
+
+        while ( bits != 0 && count < capacity )
+        {
+            const unsigned int bit = __builtin_ctz( bits );
+            const uint32_t bitMask = 1u << bit;
+            bits &= bits - 1;
+
+            KeyEvent& event = events[ count++ ];
+            event.timestamp = m_snapshotTicks;
+            event.usagePage = USAGE_PAGE_KEYBOARD_OR_KEYPAD;
+            event.usage = static_cast<uint16_t>( ( w << 5 ) | bit );
+            event.value = ( m_current.words[ w ] & bitMask ) ? 1 : 0;
+            event.deviceIndex = m_deviceIndex;
+            event.flags = 0;
+
+            m_reported.words[ w ] ^= bitMask;
+        }
+    }
+
+    return count;
+}
+
+
+/**
+   While active (an edge, or a key still down) or within m_activeHold of the
+   last activity, poll at the minimum interval.  Otherwise back off: double
+   the interval up to the maximum.
+*/
+void GitHubSample::AdaptivePoller::Schedule( const uint64_t now, const bool active )
+{
+    if ( active )
+    {
+        m_lastActivityTime = now;
+    }
+
+    if ( now - m_lastActivityTime < m_activeHold )
+    {
+        m_interval = m_minimumInterval;
+    }
+    else
+    {
+        m_interval = ( m_interval > m_maximumInterval / 2 ) ? m_maximumInterval : m_interval * 2;
+    }
+
+    m_nextPollTime = now + m_interval;
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::AdaptivePoller::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) );
+    return report;
+}
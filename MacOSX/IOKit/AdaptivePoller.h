@@ -0,0 +1,132 @@
+
+#ifndef GITHUBSAMPLE_ADAPTIVE_POLLER_H
+#define GITHUBSAMPLE_ADAPTIVE_POLLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <boost/function.hpp>
+
+#include "EventClock.h"
+#include "KeyEvent.h"
+#include "MemoryUsage.h"
+
+
+namespace GitHubSample
+{
+
+    /**
+       Managed polling, for readers that were created WITHOUT the queue.
+
+       Calling CountOfCurrentlyDepressedKeys from a hot loop (or a fixed
+       1 kHz timer) burns a core to find out, almost every time, that nothing
+       changed.  This polls fast only while it matters: at the minimum
+       interval while any key is down, and for 'activeHold' after the last
+       edge (the next keystroke of a burst of typing is likely to follow
+       soon).  After that, every idle poll doubles the interval, up to the
+       maximum.  So the worst case detection latency is the minimum interval
+       while typing and the maximum interval for the first key after a pause.
+
+       Each poll is ONE snapshot of every key (see
+       HelperForKeyboardReaderIOKit::SnapshotPressedKeys), diffed against the
+       state that was last reported, so the output is the same KeyEvent edges
+       that ReadEventsFromQueue produces:
+
+           GitHubSample::AdaptivePoller poller(
+               boost::bind( &GitHubSample::HelperForKeyboardReaderIOKit::SnapshotPressedKeys, &reader, _1 ) );
+
+           while ( running )
+           {
+               const size_t count = poller.WaitAndPoll( events, capacity );
+               ...
+           }
+
+       Edges that happen between two polls all get the timestamp of the
+       second poll (raw ticks of the clock; EventClock::System ticks like
+       queue events).  Their order within one poll is unknown, so they come
+       out as: modifier presses, then the other keys by usage id, then
+       modifier releases, which makes shift+letter typed "at once" come out
+       as a shifted letter.  A key that goes down and back up between two
+       polls is never seen, so the minimum interval must stay well below the
+       shortest keystroke (about 30 ms for fast typists).
+     */
+    class AdaptivePoller
+    {
+    public:
+
+        typedef boost::function< bool ( KeyStateBitmap& pressed ) > SnapshotFunctor;
+
+        /// the intervals are in nanoseconds.  'clock' (e.g. a VirtualClock for replay) must outlive the poller.
+        explicit AdaptivePoller
+        (
+         SnapshotFunctor snapshotFunctor,
+         uint64_t minimumInterval = 1000000,
+         uint64_t maximumInterval = 16000000,
+         uint64_t activeHold = 250000000,
+         EventClock& clock = EventClock::System()
+        );
+
+        /**
+           Takes a snapshot now and writes up to 'capacity' edges.  Returns
+           how many.  When there are more edges than room, the rest come out
+           of the next call, which is then due immediately.  A snapshot that
+           fails changes nothing (no spurious releases) and is counted in
+           FailedSnapshotCount.
+         */
+        size_t Poll( KeyEvent* events, size_t capacity );
+
+        /// Sleeps (on the clock) until the next poll is due, then polls.
+        size_t WaitAndPoll( KeyEvent* events, size_t capacity );
+
+        /// for callers with their own timer. zero when a poll is due (or overdue).
+        uint64_t NanosecondsUntilNextPoll() const;
+
+        uint64_t CurrentInterval() const { return m_interval; }
+
+        /// stamped on every KeyEvent (zero by default). see HelperForKeyboardReaderIOKit::SetDeviceIndex.
+        void SetDeviceIndex( uint16_t deviceIndex ) { m_deviceIndex = deviceIndex; }
+
+        /// the key state as of the edges handed out so far
+        const KeyStateBitmap& ReportedState() const { return m_reported; }
+
+        /// Forgets the key state (e.g. after the keyboard was reopened).  The
+        /// keys that are down at the next poll come out as presses.
+        void Reset();
+
+        uint64_t PollCount() const { return m_pollCount; }
+        uint64_t EdgeCount() const { return m_edgeCount; }
+        uint64_t FailedSnapshotCount() const { return m_failedSnapshotCount; }
+
+        MemoryUsageReport MemoryUsage() const;
+
+    private:
+
+        SnapshotFunctor m_snapshotFunctor;
+        EventClock& m_clock;
+        uint64_t m_minimumInterval;
+        uint64_t m_maximumInterval;
+        uint64_t m_activeHold;
+        uint64_t m_interval;
+        /// nanoseconds, in the clock's time
+        uint64_t m_nextPollTime;
+        uint64_t m_lastActivityTime;
+        /// raw ticks of the last snapshot, for the events still to be handed out
+        uint64_t m_snapshotTicks;
+        KeyStateBitmap m_current;
+        KeyStateBitmap m_reported;
+        uint16_t m_deviceIndex;
+        uint64_t m_pollCount;
+        uint64_t m_edgeCount;
+        uint64_t m_failedSnapshotCount;
+
+        size_t EmitEdges( const uint32_t* mask, KeyEvent* events, size_t capacity );
+        void Schedule( uint64_t now, bool active );
+
+        /// declared private so as to make this class non-copyable
+        AdaptivePoller(const AdaptivePoller&);
+        /// declared private so as to make this class non-copyable
+        AdaptivePoller& operator=(const AdaptivePoller&);
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_ADAPTIVE_POLLER_H
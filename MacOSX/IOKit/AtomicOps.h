@@ -0,0 +1,53 @@
+
+#ifndef GITHUBSAMPLE_ATOMIC_OPS_H
+#define GITHUBSAMPLE_ATOMIC_OPS_H
+
+#include <stdint.h>
+
+#ifdef __DARWIN__
+#include <libkern/OSAtomic.h>
+#endif
+
+
+namespace GitHubSample
+{
+
+    /**
+       The few atomic operations the lock-free parts need, for a compiler
+       that predates <atomic>: OSAtomic on the mac (g++-4.0 also predates
+       the __sync builtins), the GCC __sync builtins elsewhere.
+
+       Loads and stores of aligned words are atomic on every target we
+       build for; the barriers are what give them acquire and release
+       ordering.
+     */
+
+    inline void FullMemoryBarrier()
+    {
+#ifdef __DARWIN__
+        OSMemoryBarrier();
+#else
+        __sync_synchronize();
+#endif
+    }
+
+    /// nothing that follows can be reordered before the load
+    template< class T >
+    inline T LoadAcquire( const volatile T* location )
+    {
+        const T value = *location;
+        FullMemoryBarrier();
+        return value;
+    }
+
+    /// nothing that comes before can be reordered after the store
+    template< class T >
+    inline void StoreRelease( volatile T* location, const T value )
+    {
+        FullMemoryBarrier();
+        *location = value;
+    }
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_ATOMIC_OPS_H
@@ -0,0 +1,228 @@
+
+
+#include "AxisPipeline.h"
+#include "RealtimeThreadConfig.h"
+#include "UsageRegistry.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+
+namespace
+{
+    // these are the kHIDPage_* and kHIDUsage_* values
+    const uint16_t USAGE_PAGE_GENERIC_DESKTOP = 0x01;
+    const uint16_t USAGE_PAGE_BUTTON          = 0x09;
+    const uint16_t USAGE_GD_X                 = 0x30;
+
+    /// the scalar form of one step of AxisPipeline::Update
+    inline void UpdateOneAxis
+    (
+     const float raw,
+     const float center,
+     const float inverseHalfRange,
+     const float deadzone,
+     const float inverseLiveRange,
+     const float curve,
+     const float physicalCenter,
+     const float physicalHalfRange,
+     float& value,
+     float& physical
+    )
+    {
+        float scaled = ( raw - center ) * inverseHalfRange;
+        scaled = ( scaled > 1.0f ) ? 1.0f : ( ( scaled < -1.0f ) ? -1.0f : scaled );
+
+        physical = physicalCenter + scaled * physicalHalfRange;
+
+        const float magnitude = ( scaled < 0.0f ) ? -scaled : scaled;
+        const float live = ( magnitude > deadzone ) ? ( magnitude - deadzone ) * inverseLiveRange : 0.0f;
+        const float curved = live + curve * ( live * live * live - live );
+
+        value = ( scaled < 0.0f ) ? -curved : curved;
+    }
+}
+
+
+
+GitHubSample::AxisPipeline::AxisPipeline( const size_t padCount )
+    : m_padCount( padCount ),
+      m_raw( padCount * kAxesPerPad, 0 ),
+      m_center( padCount * kAxesPerPad, 0.0f ),
+      m_inverseHalfRange( padCount * kAxesPerPad, 0.0f ),
+      m_deadzone( padCount * kAxesPerPad, 0.0f ),
+      m_inverseLiveRange( padCount * kAxesPerPad, 1.0f ),
+      m_curve( padCount * kAxesPerPad, 0.0f ),
+      m_physicalCenter( padCount * kAxesPerPad, 0.0f ),
+      m_physicalHalfRange( padCount * kAxesPerPad, 0.0f ),
+      // one spare, so that Values() can be called with no pads at all
+      m_values( padCount * kAxesPerPad + 1, 0.0f ),
+      m_physical( padCount * kAxesPerPad + 1, 0.0f ),
+      m_buttons( padCount, 0 )
+{
+}
+
+
+void GitHubSample::AxisPipeline::ConfigureAxis( const size_t pad, const unsigned int axis, const AxisSettings& settings )
+{
+    if ( pad >= m_padCount || axis >= kAxesPerPad )
+    {
+        return; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    const size_t slot = pad * kAxesPerPad + axis;
+
+    const float center = 0.5f * ( static_cast<float>( settings.logicalMin ) + static_cast<float>( settings.logicalMax ) );
+    const float halfRange = 0.5f * ( static_cast<float>( settings.logicalMax ) - static_cast<float>( settings.logicalMin ) );
+    const float deadzone = ( settings.deadzone < 0.0f ) ? 0.0f : ( ( settings.deadzone > 0.99f ) ? 0.99f : settings.deadzone );
+    const float curve = ( settings.curve < 0.0f ) ? 0.0f : ( ( settings.curve > 1.0f ) ? 1.0f : settings.curve );
+
+    m_center[ slot ] = center;
+    m_inverseHalfRange[ slot ] = ( halfRange > 0.0f ) ? 1.0f / halfRange : 0.0f;
+    m_deadzone[ slot ] = deadzone;
+    m_inverseLiveRange[ slot ] = 1.0f / ( 1.0f - deadzone );
+    m_curve[ slot ] = curve;
+
+    if ( settings.physicalMin != settings.physicalMax )
+    {
+        m_physicalCenter[ slot ] = 0.5f * ( settings.physicalMin + settings.physicalMax );
+        m_physicalHalfRange[ slot ] = 0.5f * ( settings.physicalMax - settings.physicalMin );
+    }
+    else
+    {
+        m_physicalCenter[ slot ] = center;
+        m_physicalHalfRange[ slot ] = halfRange;
+    }
+}
+
+
+void GitHubSample::AxisPipeline::ConfigurePad
+(
+ const size_t pad,
+ const UsageRegistry& elements,
+ const float deadzone,
+ const float curve
+)
+{
+    for ( unsigned int axis = 0; axis < kAxesPerPad; axis++ )
+    {
+        const unsigned int index = elements.IndexOf( USAGE_PAGE_GENERIC_DESKTOP, static_cast<uint16_t>( USAGE_GD_X + axis ) );
+        if ( index == UsageRegistry::kNoIndex )
+        {
+            continue;
+        }
+
+        const UsageRegistry::Range& range = elements.ElementRange( index );
+
+        AxisSettings settings;
+        settings.logicalMin = range.logicalMin;
+        settings.logicalMax = range.logicalMax;
+        settings.physicalMin = static_cast<float>( range.physicalMin );
+        settings.physicalMax = static_cast<float>( range.physicalMax );
+        settings.deadzone = deadzone;
+        settings.curve = curve;
+
+        ConfigureAxis( pad, axis, settings );
+    }
+}
+
+
+void GitHubSample::AxisPipeline::Offer( const KeyEvent* events, const size_t count )
+{
+    for ( size_t i = 0; i < count; i++ )
+    {
+        const KeyEvent& event = events[ i ];
+        if ( event.deviceIndex >= m_padCount )
+        {
+            continue;
+        }
+
+        if ( event.usagePage == USAGE_PAGE_GENERIC_DESKTOP )
+        {
+            const unsigned int axis = event.usage - USAGE_GD_X; // wraps around (and is rejected) below X
+            if ( axis < kAxesPerPad )
+            {
+                m_raw[ event.deviceIndex * kAxesPerPad + axis ] = event.value;
+            }
+        }
+        else if ( event.usagePage == USAGE_PAGE_BUTTON && event.usage >= 1 && event.usage <= 32 )
+        {
+            const uint32_t bit = 1u << ( event.usage - 1 );
+            uint32_t& buttons = m_buttons[ event.deviceIndex ];
+            buttons = ( event.value != 0 ) ? ( buttons | bit ) : ( buttons & ~bit );
+        }
+    }
+}
+
+
+void GitHubSample::AxisPipeline::Update()
+{
+    const size_t count = m_padCount * kAxesPerPad;
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128 one = _mm_set1_ps( 1.0f );
+    const __m128 minusOne = _mm_set1_ps( -1.0f );
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 signBit = _mm_set1_ps( -0.0f );
+
+    for ( ; i + 4 <= count; i += 4 )
+    {
+        const __m128 raw = _mm_cvtepi32_ps( _mm_loadu_si128( reinterpret_cast<const __m128i*>( &m_raw[ i ] ) ) );
+
+        __m128 scaled = _mm_mul_ps( _mm_sub_ps( raw, _mm_loadu_ps( &m_center[ i ] ) ), _mm_loadu_ps( &m_inverseHalfRange[ i ] ) );
+        scaled = _mm_max_ps( minusOne, _mm_min_ps( one, scaled ) );
+
+        _mm_storeu_ps( &m_physical[ i ], _mm_add_ps( _mm_loadu_ps( &m_physicalCenter[ i ] ),
+                                                     _mm_mul_ps( scaled, _mm_loadu_ps( &m_physicalHalfRange[ i ] ) ) ) );
+
+        const __m128 sign = _mm_and_ps( scaled, signBit );
+        const __m128 magnitude = _mm_andnot_ps( signBit, scaled );
+
+        const __m128 live = _mm_mul_ps( _mm_max_ps( zero, _mm_sub_ps( magnitude, _mm_loadu_ps( &m_deadzone[ i ] ) ) ),
+                                        _mm_loadu_ps( &m_inverseLiveRange[ i ] ) );
+        const __m128 cubed = _mm_mul_ps( live, _mm_mul_ps( live, live ) );
+        const __m128 curved = _mm_add_ps( live, _mm_mul_ps( _mm_loadu_ps( &m_curve[ i ] ), _mm_sub_ps( cubed, live ) ) );
+
+        _mm_storeu_ps( &m_values[ i ], _mm_or_ps( curved, sign ) );
+    }
+#endif // __SSE2__
+
+    for ( ; i < count; i++ )
+    {
+        UpdateOneAxis( static_cast<float>( m_raw[ i ] ), m_center[ i ], m_inverseHalfRange[ i ], m_deadzone[ i ],
+                       m_inverseLiveRange[ i ], m_curve[ i ], m_physicalCenter[ i ], m_physicalHalfRange[ i ],
+                       m_values[ i ], m_physical[ i ] );
+    }
+}
+
+
+void GitHubSample::AxisPipeline::LockBuffers( RealtimeThreadConfig& realtime )
+{
+    realtime.LockVector( m_raw );
+    realtime.LockVector( m_center );
+    realtime.LockVector( m_inverseHalfRange );
+    realtime.LockVector( m_deadzone );
+    realtime.LockVector( m_inverseLiveRange );
+    realtime.LockVector( m_curve );
+    realtime.LockVector( m_physicalCenter );
+    realtime.LockVector( m_physicalHalfRange );
+    realtime.LockVector( m_values );
+    realtime.LockVector( m_physical );
+    realtime.LockVector( m_buttons );
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::AxisPipeline::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) );
+    report.AddHeap( MemoryUsageReport::kDeviceState,
+                    CapacityBytes( m_raw ) + CapacityBytes( m_center ) + CapacityBytes( m_inverseHalfRange )
+                    + CapacityBytes( m_deadzone ) + CapacityBytes( m_inverseLiveRange ) + CapacityBytes( m_curve )
+                    + CapacityBytes( m_physicalCenter ) + CapacityBytes( m_physicalHalfRange )
+                    + CapacityBytes( m_values ) + CapacityBytes( m_physical ) + CapacityBytes( m_buttons ) );
+    return report;
+}
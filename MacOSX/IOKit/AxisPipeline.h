@@ -0,0 +1,127 @@
+
+#ifndef GITHUBSAMPLE_AXIS_PIPELINE_H
+#define GITHUBSAMPLE_AXIS_PIPELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "KeyEvent.h"
+#include "MemoryUsage.h"
+
+
+namespace GitHubSample
+{
+
+    class RealtimeThreadConfig;
+    class UsageRegistry;
+
+    /**
+       The analog state of many gamepads and joysticks, turned from raw HID
+       values into something a game can use, once per tick.
+
+       Every axis goes through the same three steps:
+
+         1. scaling: the logical range (e.g. 0 .. 255) becomes -1 .. 1, and
+            the physical range (the ScaledMin / ScaledMax of the element,
+            e.g. degrees) is filled in alongside.
+         2. a deadzone around the centre: |v| below 'deadzone' reads as
+            zero, and the rest is stretched back to 0 .. 1 so that there is
+            no jump at the edge of the deadzone.
+         3. a response curve: (1 - curve) * v + curve * v^3, so 0 is linear
+            and 1 is cubic (fine control near the centre).
+
+       The state is kept as a STRUCTURE OF ARRAYS: one array per quantity
+       (raw value, centre, scale, deadzone, ...) with kAxesPerPad entries
+       per pad, pad after pad.  Update runs the steps as one loop over
+       all the axes of all the pads, four at a time with SSE2 (the scalar
+       loop finishes the rest, and does it all where there is no SSE2).
+       There are no per-pad branches, so a thousand pads cost a thousand
+       times one pad, and an unused axis costs the same as a used one.
+
+       The pad is the KeyEvent's deviceIndex: give each reader its own
+       (HelperForKeyboardReaderIOKit::SetDeviceIndex).
+
+       Not thread-safe.  Offer and Update from the thread that drains the
+       readers; read the values between Updates.
+     */
+    class AxisPipeline
+    {
+    public:
+
+        enum
+        {
+            /// kHIDUsage_GD_X .. kHIDUsage_GD_Dial (X, Y, Z, Rx, Ry, Rz, Slider, Dial)
+            kAxesPerPad = 8
+        };
+
+        struct AxisSettings
+        {
+            int32_t logicalMin;
+            int32_t logicalMax;
+            /// equal (e.g. both zero) when the device did not say: the physical value is then the logical one
+            float physicalMin;
+            float physicalMax;
+            /// 0 .. 1, a fraction of the way from the centre to the end
+            float deadzone;
+            /// 0 (linear) .. 1 (cubic)
+            float curve;
+        };
+
+        explicit AxisPipeline( size_t padCount );
+
+        size_t PadCount() const { return m_padCount; }
+
+        /// An axis that was never configured always reads zero.
+        void ConfigureAxis( size_t pad, unsigned int axis, const AxisSettings& settings );
+
+        /// Configures each axis that 'elements' (HelperForKeyboardReaderIOKit::Elements) has
+        /// with its ranges, and the same deadzone and curve for all of them.
+        void ConfigurePad( size_t pad, const UsageRegistry& elements, float deadzone, float curve );
+
+        /// Takes a batch from ReadEventsFromQueue: axes keep their latest raw
+        /// value, buttons (kHIDPage_Button 1 .. 32) set or clear a bit.  Events
+        /// of other usages, or for pads beyond PadCount, are ignored.
+        void Offer( const KeyEvent* events, size_t count );
+
+        /// Scales, deadzones and curves every axis of every pad.
+        void Update();
+
+        /// -1 .. 1, as of the last Update
+        float Value( size_t pad, unsigned int axis ) const { return m_values[ pad * kAxesPerPad + axis ]; }
+
+        /// in the physical units of the element, before the deadzone and curve
+        float PhysicalValue( size_t pad, unsigned int axis ) const { return m_physical[ pad * kAxesPerPad + axis ]; }
+
+        /// bit 0 is button 1.  live (not as of the last Update).
+        uint32_t Buttons( size_t pad ) const { return m_buttons[ pad ]; }
+
+        /// all the values, pad after pad, kAxesPerPad per pad
+        const float* Values() const { return &m_values[ 0 ]; }
+
+        /// Hands every state array to 'realtime' to be prefaulted and mlocked.  This object must outlive it.
+        void LockBuffers( RealtimeThreadConfig& realtime );
+
+        MemoryUsageReport MemoryUsage() const;
+
+    private:
+
+        size_t m_padCount;
+
+        std::vector< int32_t > m_raw;
+        std::vector< float > m_center;
+        std::vector< float > m_inverseHalfRange;
+        std::vector< float > m_deadzone;
+        std::vector< float > m_inverseLiveRange;
+        std::vector< float > m_curve;
+        std::vector< float > m_physicalCenter;
+        std::vector< float > m_physicalHalfRange;
+
+        std::vector< float > m_values;
+        std::vector< float > m_physical;
+        std::vector< uint32_t > m_buttons;
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_AXIS_PIPELINE_H
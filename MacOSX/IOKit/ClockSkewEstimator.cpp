@@ -0,0 +1,207 @@
+
+
+#include "ClockSkewEstimator.h"
+
+#include <math.h>
+
+
+
+namespace
+{
+    /// rejections in a row that are taken for a step in one of the clocks
+    const size_t RESEED_AFTER_REJECTIONS = 8;
+
+    /// device time after which the origin moves up to the newest sample
+    const int64_t REANCHOR_AFTER_NANOSECONDS = 10000000000LL;
+}
+
+
+
+GitHubSample::ClockSkewEstimator::ClockSkewEstimator( const double outlierSigmas, const size_t warmupSamples, const double forgetting )
+    : m_outlierSigmas( outlierSigmas ),
+      m_warmupSamples( warmupSamples < 2 ? 2 : warmupSamples ),
+      m_forgetting( forgetting )
+{
+    Reset();
+}
+
+
+void GitHubSample::ClockSkewEstimator::Reset()
+{
+    m_originDevice = 0;
+    m_originArrival = 0;
+    m_sumWeight = 0.0;
+    m_sumX = 0.0;
+    m_sumY = 0.0;
+    m_sumXX = 0.0;
+    m_sumXY = 0.0;
+    m_sumSquaredResiduals = 0.0;
+    m_slope = 1.0;
+    m_intercept = 0.0;
+    m_sampleCount = 0;
+    m_rejectedCount = 0;
+    m_consecutiveRejections = 0;
+    m_reseedCount = 0;
+}
+
+
+double GitHubSample::ClockSkewEstimator::JitterNanoseconds() const
+{
+    return ( m_sumWeight > 0.0 ) ? sqrt( m_sumSquaredResiduals / m_sumWeight ) : 0.0;
+}
+
+
+void GitHubSample::ClockSkewEstimator::Refit()
+{
+    const double denominator = ( m_sumWeight * m_sumXX ) - ( m_sumX * m_sumX );
+
+    // all samples at the same device time (so far): keep the rate, fit the offset
+    if ( denominator <= 1e-9 * m_sumWeight * m_sumXX )
+    {
+        m_intercept = ( m_sumY - m_slope * m_sumX ) / m_sumWeight;
+        return; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    m_slope = ( ( m_sumWeight * m_sumXY ) - ( m_sumX * m_sumY ) ) / denominator;
+    m_intercept = ( m_sumY - m_slope * m_sumX ) / m_sumWeight;
+}
+
+
+/**
+   Moves the origin to 'deviceTimestamp' and the arrival the fit gives for
+   it, and rewrites the sums for x - dx and y - dy.  The fit is the same
+   line afterwards; only the numbers in the sums get small again.
+ */
+void GitHubSample::ClockSkewEstimator::Reanchor( const uint64_t deviceTimestamp )
+{
+    const int64_t deviceShift = static_cast<int64_t>( deviceTimestamp - m_originDevice );
+    const int64_t arrivalShift = static_cast<int64_t>( m_intercept + m_slope * static_cast<double>( deviceShift ) );
+    const double dx = static_cast<double>( deviceShift );
+    const double dy = static_cast<double>( arrivalShift );
+
+    m_sumXX = m_sumXX - ( 2.0 * dx * m_sumX ) + ( m_sumWeight * dx * dx );
+    m_sumXY = m_sumXY - ( dx * m_sumY ) - ( dy * m_sumX ) + ( m_sumWeight * dx * dy );
+    m_sumX  = m_sumX - ( m_sumWeight * dx );
+    m_sumY  = m_sumY - ( m_sumWeight * dy );
+    m_intercept = m_intercept + ( m_slope * dx ) - dy;
+
+    m_originDevice += deviceShift;
+    m_originArrival += arrivalShift;
+}
+
+
+bool GitHubSample::ClockSkewEstimator::AddSample( const uint64_t deviceTimestamp, const uint64_t arrivalTime )
+{
+    if ( m_sampleCount == 0 )
+    {
+        m_originDevice = deviceTimestamp;
+        m_originArrival = arrivalTime;
+    }
+    else if ( static_cast<int64_t>( deviceTimestamp - m_originDevice ) > REANCHOR_AFTER_NANOSECONDS )
+    {
+        Reanchor( deviceTimestamp );
+    }
+
+    const double x = static_cast<double>( static_cast<int64_t>( deviceTimestamp - m_originDevice ) );
+    const double y = static_cast<double>( static_cast<int64_t>( arrivalTime - m_originArrival ) );
+    const double residual = y - ( m_intercept + m_slope * x );
+
+    if ( m_sampleCount >= m_warmupSamples )
+    {
+        const double limit = m_outlierSigmas * JitterNanoseconds();
+        if ( fabs( residual ) > limit && limit > 0.0 )
+        {
+            if ( ++m_consecutiveRejections < RESEED_AFTER_REJECTIONS )
+            {
+                m_rejectedCount++;
+                return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+            }
+
+            // that many in a row is a step, and the old fit would reject everything from now on: start over here
+            const size_t rejectedCount = m_rejectedCount;
+            const size_t reseedCount = m_reseedCount;
+            Reset();
+            m_rejectedCount = rejectedCount;
+            m_reseedCount = reseedCount + 1;
+            return AddSample( deviceTimestamp, arrivalTime ); // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+        }
+    }
+
+    m_consecutiveRejections = 0;
+
+    m_sumWeight = ( m_sumWeight * m_forgetting ) + 1.0;
+    m_sumX      = ( m_sumX * m_forgetting ) + x;
+    m_sumY      = ( m_sumY * m_forgetting ) + y;
+    m_sumXX     = ( m_sumXX * m_forgetting ) + ( x * x );
+    m_sumXY     = ( m_sumXY * m_forgetting ) + ( x * y );
+    m_sumSquaredResiduals = ( m_sumSquaredResiduals * m_forgetting ) + ( residual * residual );
+    m_sampleCount++;
+
+    Refit();
+    return true;
+}
+
+
+uint64_t GitHubSample::ClockSkewEstimator::Correct( const uint64_t deviceTimestamp ) const
+{
+    if ( m_sampleCount == 0 )
+    {
+        return deviceTimestamp;
+    }
+
+    const double x = static_cast<double>( static_cast<int64_t>( deviceTimestamp - m_originDevice ) );
+    return m_originArrival + static_cast<int64_t>( m_intercept + m_slope * x );
+}
+
+
+
+GitHubSample::DeviceClockCorrector::DeviceClockCorrector( const double outlierSigmas, const size_t warmupSamples, const double forgetting )
+    : m_outlierSigmas( outlierSigmas ),
+      m_warmupSamples( warmupSamples ),
+      m_forgetting( forgetting )
+{
+}
+
+
+void GitHubSample::DeviceClockCorrector::Correct( KeyEvent* events, const size_t eventCount, const uint64_t arrivalTime )
+{
+    m_newestInBatch.assign( m_estimators.size(), -1 );
+
+    for ( size_t i = 0; i < eventCount; i++ )
+    {
+        const uint16_t device = events[i].deviceIndex;
+        if ( device >= m_estimators.size() )
+        {
+            m_estimators.resize( device + 1, ClockSkewEstimator( m_outlierSigmas, m_warmupSamples, m_forgetting ) );
+            m_newestInBatch.resize( device + 1, -1 );
+        }
+
+        const long newest = m_newestInBatch[ device ];
+        if ( newest < 0 || events[i].timestamp >= events[ newest ].timestamp )
+        {
+            m_newestInBatch[ device ] = static_cast<long>( i );
+        }
+    }
+
+    for ( size_t device = 0; device < m_newestInBatch.size(); device++ )
+    {
+        if ( m_newestInBatch[ device ] >= 0 )
+        {
+            m_estimators[ device ].AddSample( events[ m_newestInBatch[ device ] ].timestamp, arrivalTime );
+        }
+    }
+
+    for ( size_t i = 0; i < eventCount; i++ )
+    {
+        events[i].timestamp = m_estimators[ events[i].deviceIndex ].Correct( events[i].timestamp );
+    }
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::DeviceClockCorrector::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) );
+    report.AddHeap( MemoryUsageReport::kDeviceState, CapacityBytes( m_estimators ) + CapacityBytes( m_newestInBatch ) );
+    return report;
+}
@@ -0,0 +1,136 @@
+
+#ifndef GITHUBSAMPLE_CLOCK_SKEW_ESTIMATOR_H
+#define GITHUBSAMPLE_CLOCK_SKEW_ESTIMATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "KeyEvent.h"
+#include "MemoryUsage.h"
+
+
+namespace GitHubSample
+{
+
+    /**
+       Maps ONE device's timestamps onto host time.
+
+       Every device clock runs at its own rate (a USB keyboard and a
+       Bluetooth one can disagree by tens of ppm, see kIOHIDTransportKey) and
+       from its own origin.  Each (device timestamp, host arrival time) pair
+       is a sample of
+
+           arrival = offset + slope * deviceTimestamp + delivery delay
+
+       and a running least squares fit over the samples gives 'offset' and
+       'slope' (skew is slope - 1).  The sums decay by 'forgetting' per sample,
+       so the fit follows a clock whose rate wanders with temperature.
+
+       Delivery delay is noise for the fit.  Samples whose residual is more
+       than 'outlierSigmas' standard deviations from the fit (a reader that
+       was descheduled, a Bluetooth retransmit) are rejected once the fit has
+       seen 'warmupSamples' samples.  The mean delay ends up in the offset,
+       which is the same for all events of the device, so cross-device order
+       and intervals are right even so.
+
+       A run of rejections in a row is not noise but a step (the host clock
+       was set, the device reset its counter): the fit then starts over from
+       the newest sample, as after Reset.  And the origin of x and y moves up
+       to the newest sample every few seconds of device time, so the sums of
+       squares stay small enough for the doubles to keep their precision
+       after days of uptime.
+
+       Both times are in nanoseconds.
+     */
+    class ClockSkewEstimator
+    {
+    public:
+
+        explicit ClockSkewEstimator( double outlierSigmas = 4.0, size_t warmupSamples = 16, double forgetting = 0.999 );
+
+        /// Returns false when the sample was rejected as an outlier.
+        bool AddSample( uint64_t deviceTimestamp, uint64_t arrivalTime );
+
+        void Reset();
+
+        /// host time (nanoseconds) for a device timestamp.  Before any sample the timestamp comes back unchanged.
+        uint64_t Correct( uint64_t deviceTimestamp ) const;
+
+        /// how much faster the device clock runs than the host's
+        double SkewPartsPerMillion() const { return ( m_slope > 0.0 ) ? ( 1.0 / m_slope - 1.0 ) * 1e6 : 0.0; }
+        /// the residual standard deviation, i.e. the delivery jitter, in nanoseconds
+        double JitterNanoseconds() const;
+
+        size_t SampleCount() const { return m_sampleCount; }
+        size_t RejectedCount() const { return m_rejectedCount; }
+        /// how many times a run of rejections made the fit start over
+        size_t ReseedCount() const { return m_reseedCount; }
+
+    private:
+
+        double m_outlierSigmas;
+        size_t m_warmupSamples;
+        double m_forgetting;
+
+        /// the first sample, or the one Reanchor moved to; everything else is relative to it, to keep the doubles precise
+        uint64_t m_originDevice;
+        uint64_t m_originArrival;
+
+        /// decayed sums of weight, x, y, x*x, x*y.  x is device time, y arrival time (relative, nanoseconds)
+        double m_sumWeight;
+        double m_sumX;
+        double m_sumY;
+        double m_sumXX;
+        double m_sumXY;
+        double m_sumSquaredResiduals;
+
+        double m_slope;
+        double m_intercept;
+        size_t m_sampleCount;
+        size_t m_rejectedCount;
+        size_t m_consecutiveRejections;
+        size_t m_reseedCount;
+
+        void Refit();
+        void Reanchor( uint64_t deviceTimestamp );
+    };
+
+
+    /**
+       One ClockSkewEstimator per device, applied to KeyEvents as they are
+       drained from the readers.  Call Correct with each drained batch and
+       the host time of the drain: the newest event of each device in the
+       batch becomes a sample (it is the one that waited the least), and
+       then every event's timestamp is rewritten to host nanoseconds.
+     */
+    class DeviceClockCorrector
+    {
+    public:
+
+        explicit DeviceClockCorrector( double outlierSigmas = 4.0, size_t warmupSamples = 16, double forgetting = 0.999 );
+
+        /// 'events' timestamps must be device nanoseconds (see HighResolutionClock::TimestampsToNanoseconds)
+        void Correct( KeyEvent* events, size_t eventCount, uint64_t arrivalTime );
+
+        /// NULL when no event of that device was seen yet
+        const ClockSkewEstimator* Estimator( uint16_t deviceIndex ) const
+        {
+            return ( deviceIndex < m_estimators.size() ) ? &m_estimators[ deviceIndex ] : 0;
+        }
+
+        MemoryUsageReport MemoryUsage() const;
+
+    private:
+
+        double m_outlierSigmas;
+        size_t m_warmupSamples;
+        double m_forgetting;
+        std::vector< ClockSkewEstimator > m_estimators;
+        /// scratch for Correct: per device, the index of its newest event in the batch (or -1)
+        std::vector< long > m_newestInBatch;
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_CLOCK_SKEW_ESTIMATOR_H
@@ -0,0 +1,509 @@
+
+
+#include "ComposeTable.h"
+#include "ErrorLogging.h"
+#include "KeyboardLayout.h"
+
+#include <boost/format.hpp>
+
+#include <map>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+
+namespace
+{
+    const size_t SYMBOL_KEY_BLOCK_COUNT = ( 1 << 22 ) >> 8;
+
+    /// the spacing form of the accent, flagged as dead.  that is what KeyboardLayout puts in its tables.
+    struct NamedKeysym
+    {
+        const char* name;
+        uint32_t symbol;
+    };
+
+    const NamedKeysym NAMED_KEYSYMS[] =
+    {
+        { "Multi_key",        GitHubSample::KeyboardLayout::kMultiKey },
+        { "dead_grave",       GitHubSample::KeyboardLayout::kDeadKeyFlag | 0x0060 },
+        { "dead_acute",       GitHubSample::KeyboardLayout::kDeadKeyFlag | 0x00B4 },
+        { "dead_circumflex",  GitHubSample::KeyboardLayout::kDeadKeyFlag | 0x005E },
+        { "dead_tilde",       GitHubSample::KeyboardLayout::kDeadKeyFlag | 0x007E },
+        { "dead_macron",      GitHubSample::KeyboardLayout::kDeadKeyFlag | 0x00AF },
+        { "dead_breve",       GitHubSample::KeyboardLayout::kDeadKeyFlag | 0x02D8 },
+        { "dead_abovedot",    GitHubSample::KeyboardLayout::kDeadKeyFlag | 0x02D9 },
+        { "dead_diaeresis",   GitHubSample::KeyboardLayout::kDeadKeyFlag | 0x00A8 },
+        { "dead_abovering",   GitHubSample::KeyboardLayout::kDeadKeyFlag | 0x02DA },
+        { "dead_doubleacute", GitHubSample::KeyboardLayout::kDeadKeyFlag | 0x02DD },
+        { "dead_caron",       GitHubSample::KeyboardLayout::kDeadKeyFlag | 0x02C7 },
+        { "dead_cedilla",     GitHubSample::KeyboardLayout::kDeadKeyFlag | 0x00B8 },
+        { "dead_ogonek",      GitHubSample::KeyboardLayout::kDeadKeyFlag | 0x02DB },
+        { "space",        ' '  }, { "exclam",       '!'  }, { "quotedbl",     '"'  },
+        { "numbersign",   '#'  }, { "dollar",       '$'  }, { "percent",      '%'  },
+        { "ampersand",    '&'  }, { "apostrophe",   '\'' }, { "parenleft",    '('  },
+        { "parenright",   ')'  }, { "asterisk",     '*'  }, { "plus",         '+'  },
+        { "comma",        ','  }, { "minus",        '-'  }, { "period",       '.'  },
+        { "slash",        '/'  }, { "colon",        ':'  }, { "semicolon",    ';'  },
+        { "less",         '<'  }, { "equal",        '='  }, { "greater",      '>'  },
+        { "question",     '?'  }, { "at",           '@'  }, { "bracketleft",  '['  },
+        { "backslash",    '\\' }, { "bracketright", ']'  }, { "asciicircum",  '^'  },
+        { "underscore",   '_'  }, { "grave",        '`'  }, { "braceleft",    '{'  },
+        { "bar",          '|'  }, { "braceright",   '}'  }, { "asciitilde",   '~'  }
+    };
+
+    /// returns zero when the name is not one we support
+    uint32_t KeysymNameToSymbol( const std::string& name )
+    {
+        if ( name.size() == 1 && isalnum( static_cast<unsigned char>( name[0] ) ) )
+        {
+            return static_cast<unsigned char>( name[0] );
+        }
+
+        if ( name.size() >= 5 && name[0] == 'U' )
+        {
+            char* end = 0;
+            const unsigned long codePoint = strtoul( name.c_str() + 1, &end, 16 );
+            return ( *end == '\0' && codePoint > 0 && codePoint <= 0x10FFFF ) ? static_cast<uint32_t>( codePoint ) : 0;
+        }
+
+        for ( size_t i = 0; i < sizeof(NAMED_KEYSYMS) / sizeof(NAMED_KEYSYMS[0]); i++ )
+        {
+            if ( name == NAMED_KEYSYMS[i].name )
+            {
+                return NAMED_KEYSYMS[i].symbol;
+            }
+        }
+
+        return 0;
+    }
+
+    /// the first code point of a UTF-8 string, or zero
+    uint32_t DecodeFirstUtf8CodePoint( const std::string& text )
+    {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>( text.c_str() );
+
+        if ( p[0] < 0x80 )
+        {
+            return p[0];
+        }
+
+        size_t length = ( p[0] >= 0xF0 ) ? 4 : ( p[0] >= 0xE0 ) ? 3 : ( p[0] >= 0xC0 ) ? 2 : 0;
+        if ( length == 0 || text.size() < length )
+        {
+            return 0;
+        }
+
+        uint32_t codePoint = p[0] & ( 0x7F >> length );
+        for ( size_t i = 1; i < length; i++ )
+        {
+            if ( ( p[i] & 0xC0 ) != 0x80 )
+            {
+                return 0;
+            }
+            codePoint = ( codePoint << 6 ) | ( p[i] & 0x3F );
+        }
+
+        return codePoint;
+    }
+
+    /// parses one line of a Compose file. returns false when the line must be skipped.
+    bool ParseComposeLine( const std::string& line, GitHubSample::ComposeTable::Sequence& sequence )
+    {
+        sequence.symbols.clear();
+        sequence.result = 0;
+
+        size_t position = 0;
+        while ( true )
+        {
+            position = line.find_first_not_of( " \t", position );
+            if ( position == std::string::npos || line[position] != '<' )
+            {
+                break;
+            }
+
+            const size_t close = line.find( '>', position );
+            if ( close == std::string::npos )
+            {
+                return false;
+            }
+
+            const uint32_t symbol = KeysymNameToSymbol( line.substr( position + 1, close - position - 1 ) );
+            if ( symbol == 0 )
+            {
+                return false;
+            }
+
+            sequence.symbols.push_back( symbol );
+            position = close + 1;
+        }
+
+        if ( position == std::string::npos || line[position] != ':' || sequence.symbols.empty() )
+        {
+            return false;
+        }
+
+        const size_t openQuote = line.find( '"', position );
+        if ( openQuote == std::string::npos )
+        {
+            return false;
+        }
+
+        std::string result;
+        for ( size_t i = openQuote + 1; i < line.size() && line[i] != '"'; i++ )
+        {
+            if ( line[i] == '\\' && i + 1 < line.size() )
+            {
+                i++;
+            }
+            result += line[i];
+        }
+
+        sequence.result = DecodeFirstUtf8CodePoint( result );
+        return sequence.result != 0;
+    }
+}
+
+
+
+GitHubSample::ComposeTable::ComposeTable()
+    : m_alphabetSize( 0 )
+{
+    Clear();
+}
+
+
+void GitHubSample::ComposeTable::Clear()
+{
+    m_alphabetSize = 1; // index zero means "not in the alphabet"
+    m_alphabetBlockIndex.assign( SYMBOL_KEY_BLOCK_COUNT, 0 );
+    m_alphabetBlocks.assign( 256, 0 );
+    m_nodeResult.clear();
+    m_nodeChildRow.clear();
+    m_children.clear();
+}
+
+
+size_t GitHubSample::ComposeTable::MemoryFootprint() const
+{
+    return ( m_alphabetBlockIndex.capacity() * sizeof(uint16_t) )
+        + ( m_alphabetBlocks.capacity() * sizeof(uint16_t) )
+        + ( m_nodeResult.capacity() * sizeof(uint32_t) )
+        + ( m_nodeChildRow.capacity() * sizeof(uint16_t) )
+        + ( m_children.capacity() * sizeof(uint16_t) );
+}
+
+
+unsigned int GitHubSample::ComposeTable::AddToAlphabet( const uint32_t symbol )
+{
+    const uint32_t key = SymbolKey( symbol );
+
+    uint16_t& block = m_alphabetBlockIndex[ key >> 8 ];
+    if ( block == 0 )
+    {
+        block = static_cast<uint16_t>( m_alphabetBlocks.size() >> 8 );
+        m_alphabetBlocks.resize( m_alphabetBlocks.size() + 256, 0 );
+    }
+
+    uint16_t& index = m_alphabetBlocks[ ( block << 8 ) | ( key & 0xFF ) ];
+    if ( index == 0 && m_alphabetSize < kNoNode )
+    {
+        index = static_cast<uint16_t>( m_alphabetSize++ );
+    }
+
+    return index;
+}
+
+
+bool GitHubSample::ComposeTable::Compile
+(
+ const std::vector< Sequence >& sequences,
+ boost::function< void ( const std::string msg ) > errorLoggerFunctor
+)
+{
+    Clear();
+
+    // First build the trie with ordinary maps for the children, then flatten
+    // it.  Compiling happens once; only the flattened form has to be fast.
+    std::vector< std::map< unsigned int, unsigned int > > childMaps( 1 );
+    std::vector< uint32_t > results( 1, 0 );
+    size_t skipped = 0;
+
+    std::vector< Sequence >::const_iterator iter = sequences.begin();
+    for ( ; iter != sequences.end(); iter++ )
+    {
+        const size_t length = iter->symbols.size();
+        if ( length == 0 || length > kMaxSequenceLength || iter->result == 0 )
+        {
+            skipped++;
+            continue;
+        }
+
+        unsigned int node = 0;
+        bool conflict = false;
+
+        for ( size_t i = 0; i < length && ! conflict; i++ )
+        {
+            const unsigned int alphabetIndex = AddToAlphabet( iter->symbols[i] );
+            const bool isLast = ( i + 1 == length );
+
+            std::map< unsigned int, unsigned int >::const_iterator found = childMaps[ node ].find( alphabetIndex );
+            if ( alphabetIndex == 0 || results[ node ] != 0 )
+            {
+                conflict = true; // alphabet overflow, or the prefix is already a complete sequence
+            }
+            else if ( found != childMaps[ node ].end() )
+            {
+                // an existing node: fine as a prefix, but not as the end of a second sequence
+                node = found->second;
+                conflict = isLast;
+            }
+            else if ( childMaps.size() >= kNoNode )
+            {
+                conflict = true;
+            }
+            else
+            {
+                const unsigned int child = static_cast<unsigned int>( childMaps.size() );
+                childMaps[ node ][ alphabetIndex ] = child;
+                childMaps.push_back( std::map< unsigned int, unsigned int >() );
+                results.push_back( isLast ? iter->result : 0 );
+                node = child;
+            }
+        }
+
+        if ( conflict )
+        {
+            skipped++; // first definition wins, just like in X11
+        }
+    }
+
+    if ( skipped > 0 )
+    {
+        std::string msg = boost::str( boost::format("Skipped %1% of %2% compose sequences (too long, duplicate, or a prefix of another).")
+                                      % skipped % sequences.size() );
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, msg );
+    }
+
+    if ( childMaps.size() == 1 )
+    {
+        Clear();
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, "No usable compose sequences." );
+        return false;
+    }
+
+    // flatten: interior nodes get a dense row of children, leaves get nothing
+    m_nodeResult = results;
+    m_nodeChildRow.assign( childMaps.size(), kNoNode );
+
+    size_t rowCount = 0;
+    for ( size_t node = 0; node < childMaps.size(); node++ )
+    {
+        if ( ! childMaps[ node ].empty() )
+        {
+            m_nodeChildRow[ node ] = static_cast<uint16_t>( rowCount++ );
+        }
+    }
+
+    m_children.assign( rowCount * m_alphabetSize, kNoNode );
+    for ( size_t node = 0; node < childMaps.size(); node++ )
+    {
+        std::map< unsigned int, unsigned int >::const_iterator child = childMaps[ node ].begin();
+        for ( ; child != childMaps[ node ].end(); child++ )
+        {
+            m_children[ m_nodeChildRow[ node ] * m_alphabetSize + child->first ] = static_cast<uint16_t>( child->second );
+        }
+    }
+
+    return true;
+}
+
+
+bool GitHubSample::ComposeTable::LoadFromFile
+(
+ const std::string& path,
+ boost::function< void ( const std::string msg ) > errorLoggerFunctor
+)
+{
+    Clear();
+
+    FILE* file = fopen( path.c_str(), "r" );
+    if ( ! file )
+    {
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, "Failed to open compose file: " + path );
+        return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    std::vector< Sequence > sequences;
+    Sequence sequence;
+    size_t unsupportedLines = 0;
+    std::string line;
+    char chunk[512];
+
+    while ( fgets( chunk, sizeof(chunk), file ) )
+    {
+        line += chunk;
+        if ( line.empty() || line[ line.size() - 1 ] != '\n' )
+        {
+            if ( ! feof( file ) )
+            {
+                continue; // a long line. keep reading.
+            }
+        }
+
+        const size_t first = line.find_first_not_of( " \t\r\n" );
+        const bool isBlankOrComment = ( first == std::string::npos || line[first] == '#' );
+
+        if ( ! isBlankOrComment )
+        {
+            if ( ParseComposeLine( line, sequence ) )
+            {
+                sequences.push_back( sequence );
+            }
+            else
+            {
+                unsupportedLines++;
+            }
+        }
+
+        line.clear();
+    }
+
+    fclose( file );
+
+    if ( unsupportedLines > 0 )
+    {
+        std::string msg = boost::str( boost::format("Skipped %1% unsupported lines in compose file %2%") % unsupportedLines % path );
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, msg );
+    }
+
+    return Compile( sequences, errorLoggerFunctor );
+}
+
+
+
+namespace
+{
+    /// what a symbol types when it is NOT part of a sequence
+    inline size_t EmitPlain( const uint32_t symbol, uint32_t* output )
+    {
+        const uint32_t codePoint = symbol & GitHubSample::KeyboardLayout::kCodePointMask;
+        output[0] = codePoint;
+        return ( codePoint != 0 && symbol != GitHubSample::KeyboardLayout::kMultiKey );
+    }
+}
+
+
+GitHubSample::ComposeState::ComposeState( const CancelPolicy policy )
+    : m_table( NULL ),
+      m_policy( policy ),
+      m_node( 0 ),
+      m_pendingCount( 0 )
+{
+}
+
+
+void GitHubSample::ComposeState::SetTable( const ComposeTable* table )
+{
+    m_table = ( table && ! table->IsEmpty() ) ? table : NULL;
+    Cancel();
+}
+
+
+void GitHubSample::ComposeState::Cancel()
+{
+    m_node = 0;
+    m_pendingCount = 0;
+}
+
+
+size_t GitHubSample::ComposeState::EmitPending( uint32_t* output ) const
+{
+    size_t count = 0;
+    for ( size_t i = 0; i < m_pendingCount; i++ )
+    {
+        count += EmitPlain( m_pending[i], output + count );
+    }
+    return count;
+}
+
+
+/**
+   The cost is constant: one alphabet lookup and one child lookup.  Only a
+   cancelled sequence costs more, and that is bounded by kMaxSequenceLength.
+
+   When a sequence is cancelled under kCancelEmitsPending, the symbol that
+   broke it is then handled as if nothing had been pending, so it can type
+   itself or start a new sequence (dead acute, then dead grave, types the
+   acute and leaves dead grave pending).
+*/
+size_t GitHubSample::ComposeState::Feed( const uint32_t symbol, uint32_t* output )
+{
+    if ( ! m_table )
+    {
+        return EmitPlain( symbol, output );
+    }
+
+    const unsigned int alphabetIndex = m_table->AlphabetIndex( symbol );
+    size_t count = 0;
+
+    if ( m_node != 0 )
+    {
+        const unsigned int child = m_table->Child( m_node, alphabetIndex );
+
+        if ( child == ComposeTable::kNoNode )
+        {
+            if ( m_policy == kCancelDiscards )
+            {
+                Cancel();
+                return 0; // the key that broke the sequence goes too
+            }
+
+            count = EmitPending( output );
+            Cancel();
+        }
+        else if ( m_table->Result( child ) != 0 )
+        {
+            output[0] = m_table->Result( child );
+            Cancel();
+            return 1;
+        }
+        else
+        {
+            m_pending[ m_pendingCount++ ] = symbol;
+            m_node = child;
+            return 0;
+        }
+    }
+
+    // nothing pending (any more)
+    const unsigned int child = m_table->Child( 0, alphabetIndex );
+
+    if ( child == ComposeTable::kNoNode )
+    {
+        return count + EmitPlain( symbol, output + count );
+    }
+
+    if ( m_table->Result( child ) != 0 )
+    {
+        output[ count ] = m_table->Result( child );
+        return count + 1;
+    }
+
+    m_pending[ 0 ] = symbol;
+    m_pendingCount = 1;
+    m_node = child;
+    return count;
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::ComposeTable::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) );
+    report.AddHeap( MemoryUsageReport::kComposeTables,
+                    CapacityBytes( m_alphabetBlockIndex ) + CapacityBytes( m_alphabetBlocks )
+                    + CapacityBytes( m_nodeResult ) + CapacityBytes( m_nodeChildRow ) + CapacityBytes( m_children ) );
+    return report;
+}
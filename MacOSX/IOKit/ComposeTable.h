@@ -0,0 +1,175 @@
+
+#ifndef GITHUBSAMPLE_COMPOSE_TABLE_H
+#define GITHUBSAMPLE_COMPOSE_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+
+#include "MemoryUsage.h"
+
+
+namespace GitHubSample
+{
+
+    /**
+       Dead-key and compose sequences (e.g. dead acute, then 'e', makes 'é'),
+       compiled into a trie so that each keystroke costs a constant amount of
+       work no matter how many thousands of sequences there are.
+
+       The input symbols are what KeyboardLayout produces: plain code points,
+       dead keys (the spacing accent with KeyboardLayout::kDeadKeyFlag set) and
+       KeyboardLayout::kMultiKey.  Every distinct symbol used by any sequence
+       gets a small "alphabet" index, looked up through a two-level table.
+
+       Only the INTERIOR nodes of the trie get a child array, and each child
+       array is dense: one uint16 per alphabet symbol.  Leaves only hold their
+       result.  Interior nodes are few (the dead keys, Multi_key, and the
+       first character after Multi_key), so this stays at a few hundred KB
+       even for the full X11 en_US.UTF-8 table.
+
+       A ComposeTable is immutable once compiled, so one table can be shared by
+       every device.  The per-device state lives in ComposeState.
+     */
+    class ComposeTable
+    {
+    public:
+
+        struct Sequence
+        {
+            std::vector< uint32_t > symbols;
+            uint32_t result;
+        };
+
+        enum
+        {
+            kMaxSequenceLength = 8,
+            kNoNode = 0xFFFF
+        };
+
+        ComposeTable();
+
+        /// Will return false (and leave the table empty) in case of error.
+        bool Compile
+        (
+         const std::vector< Sequence >& sequences,
+         boost::function< void ( const std::string msg ) > errorLoggerFunctor = 0
+        );
+
+        /**
+           Reads the X11 Compose file syntax, for example:
+
+               <dead_acute> <e>          : "é"   eacute
+               <Multi_key> <o> <c>       : "©"   copyright
+               <U00B4> <U0041>           : "Á"
+
+           Supported keysym names are: single ASCII letters and digits,
+           Uxxxx, Multi_key, the common dead_* accents and the ASCII
+           punctuation names (space, apostrophe, comma, ...).  Lines using
+           anything else (and 'include' lines) are skipped, and counted in one
+           message to the error logger.
+         */
+        bool LoadFromFile
+        (
+         const std::string& path,
+         boost::function< void ( const std::string msg ) > errorLoggerFunctor = 0
+        );
+
+        bool IsEmpty() const { return m_nodeResult.empty(); }
+        size_t NodeCount() const { return m_nodeResult.size(); }
+        size_t AlphabetSize() const { return m_alphabetSize; }
+        size_t MemoryFootprint() const;
+
+        /// zero when 'symbol' appears in no sequence
+        unsigned int AlphabetIndex( uint32_t symbol ) const
+        {
+            const uint32_t key = SymbolKey( symbol );
+            return m_alphabetBlocks[ ( m_alphabetBlockIndex[ key >> 8 ] << 8 ) | ( key & 0xFF ) ];
+        }
+
+        /// kNoNode when there is no such child (always the case for alphabet index zero)
+        unsigned int Child( unsigned int node, unsigned int alphabetIndex ) const
+        {
+            const unsigned int row = m_nodeChildRow[ node ];
+            return ( row == kNoNode ) ? static_cast<unsigned int>( kNoNode ) : m_children[ row * m_alphabetSize + alphabetIndex ];
+        }
+
+        /// non-zero only for leaves
+        uint32_t Result( unsigned int node ) const { return m_nodeResult[ node ]; }
+
+        MemoryUsageReport MemoryUsage() const;
+
+    private:
+
+        /// code points are 21 bits; the dead key flag becomes bit 21
+        static uint32_t SymbolKey( uint32_t symbol )
+        {
+            return ( symbol & 0x1FFFFF ) | ( ( symbol >> 10 ) & 0x200000 );
+        }
+
+        size_t m_alphabetSize; ///< includes the unused index zero
+
+        /// SymbolKey >> 8 selects a block, SymbolKey & 0xFF the entry within it. block zero is all zeros.
+        std::vector< uint16_t > m_alphabetBlockIndex;
+        std::vector< uint16_t > m_alphabetBlocks;
+
+        std::vector< uint32_t > m_nodeResult;
+        std::vector< uint16_t > m_nodeChildRow;
+        std::vector< uint16_t > m_children;
+
+        void Clear();
+        unsigned int AddToAlphabet( uint32_t symbol );
+    };
+
+
+    /**
+       Where one device is within a compose sequence.
+
+       Feed takes one symbol from the layout and writes the code points that
+       are now final (zero, one, or, when a sequence is cancelled, several).
+     */
+    class ComposeState
+    {
+    public:
+
+        /// what to do with the keys of a sequence that turned out not to exist
+        enum CancelPolicy
+        {
+            kCancelEmitsPending,  ///< dead acute then 'q' types "´q" (what mac and windows do)
+            kCancelDiscards       ///< dead acute then 'q' types nothing (what X11 does)
+        };
+
+        /// at most this many code points come out of one Feed
+        enum { kMaxOutput = ComposeTable::kMaxSequenceLength + 1 };
+
+        explicit ComposeState( CancelPolicy policy = kCancelEmitsPending );
+
+        /// 'table' may be NULL (every symbol then passes straight through)
+        void SetTable( const ComposeTable* table );
+        void SetCancelPolicy( CancelPolicy policy ) { m_policy = policy; }
+
+        /// returns how many code points were written to 'output' (which needs room for kMaxOutput)
+        size_t Feed( uint32_t symbol, uint32_t* output );
+
+        /// abandons a pending sequence without typing anything (e.g. on Escape)
+        void Cancel();
+
+        bool IsPending() const { return m_node != 0; }
+        size_t PendingCount() const { return m_pendingCount; }
+
+    private:
+
+        const ComposeTable* m_table;
+        CancelPolicy m_policy;
+        unsigned int m_node;
+        size_t m_pendingCount;
+        uint32_t m_pending[ ComposeTable::kMaxSequenceLength ];
+
+        size_t EmitPending( uint32_t* output ) const;
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_COMPOSE_TABLE_H
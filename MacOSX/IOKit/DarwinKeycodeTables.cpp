@@ -0,0 +1,298 @@
+
+
+#include "DarwinKeycodeTables.h"
+#include "ScancodeTranslation.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+
+namespace
+{
+    // the mac virtual keycodes of the modifier keys (from SDL_QuartzKeys.h)
+    const unsigned QZ_RMETA    = 0x36;
+    const unsigned QZ_LMETA    = 0x37;
+    const unsigned QZ_LSHIFT   = 0x38;
+    const unsigned QZ_CAPSLOCK = 0x39;
+    const unsigned QZ_LALT     = 0x3A;
+    const unsigned QZ_LCTRL    = 0x3B;
+    const unsigned QZ_RSHIFT   = 0x3C;
+    const unsigned QZ_RALT     = 0x3D;
+    const unsigned QZ_RCTRL    = 0x3E;
+    const unsigned QZ_FN       = 0x3F;
+    const unsigned QZ_NUMLOCK  = 0x47;
+
+    const unsigned KEYCODE_COUNT = GitHubSample::kDarwinKeycodeCount;
+
+    /**
+       Mac virtual keycode to set-1 scancode, built from the one key table in
+       ScancodeTranslation.cpp (whose mac column is g_aDarwinToSet1 of
+       third_party_samples/DarwinKeyboard.cpp, checked against
+       SDL_QuartzKeys.h).  Zero where the key has no set-1 scancode, and for
+       Pause, whose bytes are not one (prefix, code).
+     */
+    struct Set1ByDarwinKeycodeTable
+    {
+        uint16_t set1[ KEYCODE_COUNT ];
+
+        Set1ByDarwinKeycodeTable()
+        {
+            for ( unsigned keycode = 0; keycode < KEYCODE_COUNT; keycode++ )
+            {
+                const uint16_t code = GitHubSample::TranslateKeyCode( GitHubSample::kDarwinKeycode,
+                                                                      GitHubSample::kSet1Scancode,
+                                                                      static_cast<uint16_t>( keycode ) );
+
+                const bool single = ( code != GitHubSample::kNoKeyCode ) && ! ( code & GitHubSample::kScancodeSpecial );
+                set1[ keycode ] = single ? code : 0;
+            }
+        }
+    };
+
+    const Set1ByDarwinKeycodeTable& Set1ByDarwinKeycode()
+    {
+        static const Set1ByDarwinKeycodeTable table;
+        return table;
+    }
+
+    /// the inverse of KEYCODE_BY_MODIFIER_BIT
+    const uint32_t MODIFIER_MASK_BY_DARWIN_KEYCODE[ KEYCODE_COUNT ] =
+    {
+        /* 0x00 */ 0, 0, 0, 0, 0, 0, 0, 0,
+        /* 0x08 */ 0, 0, 0, 0, 0, 0, 0, 0,
+        /* 0x10 */ 0, 0, 0, 0, 0, 0, 0, 0,
+        /* 0x18 */ 0, 0, 0, 0, 0, 0, 0, 0,
+        /* 0x20 */ 0, 0, 0, 0, 0, 0, 0, 0,
+        /* 0x28 */ 0, 0, 0, 0, 0, 0, 0, 0,
+        /* 0x30 */ 0, 0, 0, 0, 0, 0,
+        /* 0x36 */ GitHubSample::kDarwinRightCmdKey,          // QZ_RMETA
+        /* 0x37 */ GitHubSample::kDarwinCmdKey,               // QZ_LMETA
+        /* 0x38 */ GitHubSample::kDarwinShiftKey,             // QZ_LSHIFT
+        /* 0x39 */ GitHubSample::kDarwinAlphaLock,            // QZ_CAPSLOCK
+        /* 0x3A */ GitHubSample::kDarwinOptionKey,            // QZ_LALT
+        /* 0x3B */ GitHubSample::kDarwinControlKey,           // QZ_LCTRL
+        /* 0x3C */ GitHubSample::kDarwinRightShiftKey,        // QZ_RSHIFT
+        /* 0x3D */ GitHubSample::kDarwinRightOptionKey,       // QZ_RALT
+        /* 0x3E */ GitHubSample::kDarwinRightControlKey,      // QZ_RCTRL
+        /* 0x3F */ GitHubSample::kDarwinFn,                   // QZ_FN
+        /* 0x40 */ 0, 0, 0, 0, 0, 0, 0,
+        /* 0x47 */ GitHubSample::kDarwinNumLock,              // QZ_NUMLOCK
+        /* 0x48 */ 0, 0, 0, 0, 0, 0, 0, 0,
+        /* 0x50 */ 0, 0, 0, 0, 0, 0, 0, 0,
+        /* 0x58 */ 0, 0, 0, 0, 0, 0, 0, 0,
+        /* 0x60 */ 0, 0, 0, 0, 0, 0, 0, 0,
+        /* 0x68 */ 0, 0, 0, 0, 0, 0, 0, 0,
+        /* 0x70 */ 0, 0, 0, 0, 0, 0, 0, 0,
+        /* 0x78 */ 0, 0, 0, 0, 0, 0, 0, 0
+    };
+
+    /// indexed by the bit number of a DarwinModifierMask. bit 31 is never a modifier (see below).
+    const uint8_t KEYCODE_BY_MODIFIER_BIT[ 32 ] =
+    {
+        /*  0 */ 0, 0, 0, 0, 0, 0, 0, 0,
+        /*  8 */ QZ_LMETA, QZ_LSHIFT, QZ_CAPSLOCK, QZ_LALT, QZ_LCTRL, QZ_RSHIFT, QZ_RALT, QZ_RCTRL,
+        /* 16 */ QZ_NUMLOCK, QZ_FN, 0, 0, 0, 0, 0, 0,
+        /* 24 */ 0, 0, 0, QZ_RMETA, 0, 0, 0, 0
+    };
+
+    inline unsigned ModifierMaskToKeycode( uint32_t modifiers )
+    {
+        modifiers &= GitHubSample::kDarwinAllModifiers;
+
+        // OR-ing in bit 31 keeps ctz defined for an empty mask, and that bit's entry is zero
+        const unsigned keycode = KEYCODE_BY_MODIFIER_BIT[ __builtin_ctz( modifiers | 0x80000000u ) ];
+
+        return ( __builtin_popcount( modifiers ) > 1 ) ? static_cast<unsigned>( GitHubSample::kMultipleModifiers ) : keycode;
+    }
+
+
+    /// the four left/right pairs that DarwinAdjustModifierMask corrects
+    const uint32_t MODIFIER_PAIRS[ 4 ] =
+    {
+        GitHubSample::kDarwinShiftKey   | GitHubSample::kDarwinRightShiftKey,
+        GitHubSample::kDarwinControlKey | GitHubSample::kDarwinRightControlKey,
+        GitHubSample::kDarwinOptionKey  | GitHubSample::kDarwinRightOptionKey,
+        GitHubSample::kDarwinCmdKey     | GitHubSample::kDarwinRightCmdKey
+    };
+
+    /// The pair bits live in bits 8..15, plus right command in bit 27.  This
+    /// squeezes them into 9 bits: bit 8 of the index is right command.
+    inline unsigned PairIndex( const uint32_t modifiers )
+    {
+        return ( ( modifiers >> 8 ) & 0xFF ) | ( ( modifiers >> 19 ) & 0x100 );
+    }
+
+    /**
+       For every PairIndex: the union of the pairs that have at least one bit
+       set.  A pair is corrected when it is present in BOTH masks, so the
+       correction mask is one lookup for each, ANDed.
+     */
+    struct PairMaskTable
+    {
+        uint32_t presentPairs[ 0x200 ];
+
+        PairMaskTable()
+        {
+            for ( unsigned index = 0; index < 0x200; index++ )
+            {
+                const uint32_t modifiers = ( ( index & 0xFF ) << 8 ) | ( ( index & 0x100 ) << 19 );
+
+                presentPairs[ index ] = 0;
+                for ( size_t pair = 0; pair < 4; pair++ )
+                {
+                    if ( modifiers & MODIFIER_PAIRS[ pair ] )
+                    {
+                        presentPairs[ index ] |= MODIFIER_PAIRS[ pair ];
+                    }
+                }
+            }
+        }
+    };
+
+    const PairMaskTable& PairMasks()
+    {
+        static const PairMaskTable table;
+        return table;
+    }
+
+    /// the bits of a HID boot protocol modifier byte, in Carbon terms
+    const uint32_t DARWIN_MASK_BY_HID_MODIFIER_BIT[ 8 ] =
+    {
+        GitHubSample::kDarwinControlKey,      GitHubSample::kDarwinShiftKey,
+        GitHubSample::kDarwinOptionKey,       GitHubSample::kDarwinCmdKey,
+        GitHubSample::kDarwinRightControlKey, GitHubSample::kDarwinRightShiftKey,
+        GitHubSample::kDarwinRightOptionKey,  GitHubSample::kDarwinRightCmdKey
+    };
+}
+
+
+
+unsigned GitHubSample::DarwinKeycodeToSet1Scancode( const unsigned keycode )
+{
+    return ( keycode < KEYCODE_COUNT ) ? Set1ByDarwinKeycode().set1[ keycode ] : 0;
+}
+
+
+uint32_t GitHubSample::DarwinKeycodeToDarwinModifierMask( const unsigned keycode )
+{
+    return ( keycode < KEYCODE_COUNT ) ? MODIFIER_MASK_BY_DARWIN_KEYCODE[ keycode ] : 0;
+}
+
+
+unsigned GitHubSample::DarwinModifierMaskToDarwinKeycode( const uint32_t modifiers )
+{
+    return ModifierMaskToKeycode( modifiers );
+}
+
+
+unsigned GitHubSample::DarwinModifierMaskToSet1Scancode( const uint32_t modifiers )
+{
+    const unsigned keycode = ModifierMaskToKeycode( modifiers );
+
+    // every keycode in KEYCODE_BY_MODIFIER_BIT is below KEYCODE_COUNT, so only 'multiple' is out of range
+    return ( keycode < KEYCODE_COUNT ) ? Set1ByDarwinKeycode().set1[ keycode ] : keycode;
+}
+
+
+void GitHubSample::DarwinKeycodesToSet1Scancodes( const uint16_t* keycodes, uint16_t* scancodes, const size_t count )
+{
+    const uint16_t* set1 = Set1ByDarwinKeycode().set1;
+
+    for ( size_t i = 0; i < count; i++ )
+    {
+        // masking instead of comparing keeps the loop free of branches.  out of range keycodes become zero below.
+        const unsigned keycode = keycodes[i];
+        scancodes[i] = static_cast<uint16_t>( set1[ keycode & ( KEYCODE_COUNT - 1 ) ]
+                                              & -static_cast<int>( keycode < KEYCODE_COUNT ) );
+    }
+}
+
+
+void GitHubSample::DarwinKeycodesToDarwinModifierMasks( const uint16_t* keycodes, uint32_t* modifierMasks, const size_t count )
+{
+    for ( size_t i = 0; i < count; i++ )
+    {
+        const unsigned keycode = keycodes[i];
+        modifierMasks[i] = MODIFIER_MASK_BY_DARWIN_KEYCODE[ keycode & ( KEYCODE_COUNT - 1 ) ]
+            & -static_cast<uint32_t>( keycode < KEYCODE_COUNT );
+    }
+}
+
+
+void GitHubSample::DarwinModifierMasksToDarwinKeycodes( const uint32_t* modifierMasks, unsigned* keycodes, const size_t count )
+{
+    for ( size_t i = 0; i < count; i++ )
+    {
+        keycodes[i] = ModifierMaskToKeycode( modifierMasks[i] );
+    }
+}
+
+
+uint32_t GitHubSample::HidModifiersToDarwinModifierMask( const uint8_t hidModifiers )
+{
+    uint32_t modifiers = 0;
+
+    for ( unsigned bit = 0; bit < 8; bit++ )
+    {
+        modifiers |= DARWIN_MASK_BY_HID_MODIFIER_BIT[ bit ] & -static_cast<uint32_t>( ( hidModifiers >> bit ) & 1 );
+    }
+
+    return modifiers;
+}
+
+
+uint32_t GitHubSample::DarwinAdjustModifierMask( const uint32_t modifiers, const uint32_t currentModifiers )
+{
+    const PairMaskTable& table = PairMasks();
+    const uint32_t correct = table.presentPairs[ PairIndex( modifiers ) ] & table.presentPairs[ PairIndex( currentModifiers ) ];
+
+    return ( modifiers & ~correct ) | ( currentModifiers & correct );
+}
+
+
+/**
+   'currentModifiers' is the same for the whole batch, so only the pairs it
+   holds can ever be corrected.  For each of those, a mask either has the
+   pair or not: SSE2 does four masks at a time with one AND and one compare
+   per pair.
+*/
+void GitHubSample::DarwinAdjustModifierMasks( uint32_t* modifierMasks, const size_t count, const uint32_t currentModifiers )
+{
+    const uint32_t currentPairs = PairMasks().presentPairs[ PairIndex( currentModifiers ) ];
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i current = _mm_set1_epi32( static_cast<int>( currentModifiers ) );
+    const __m128i zero = _mm_setzero_si128();
+    __m128i pairs[ 4 ];
+    for ( size_t pair = 0; pair < 4; pair++ )
+    {
+        // a pair that 'currentModifiers' does not hold becomes zero, and then never matches
+        pairs[ pair ] = _mm_set1_epi32( static_cast<int>( MODIFIER_PAIRS[ pair ] & currentPairs ) );
+    }
+
+    for ( ; i + 4 <= count; i += 4 )
+    {
+        __m128i masks = _mm_loadu_si128( reinterpret_cast<const __m128i*>( modifierMasks + i ) );
+        __m128i correct = zero;
+
+        for ( size_t pair = 0; pair < 4; pair++ )
+        {
+            const __m128i absent = _mm_cmpeq_epi32( _mm_and_si128( masks, pairs[ pair ] ), zero );
+            correct = _mm_or_si128( correct, _mm_andnot_si128( absent, pairs[ pair ] ) );
+        }
+
+        masks = _mm_or_si128( _mm_andnot_si128( correct, masks ), _mm_and_si128( current, correct ) );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( modifierMasks + i ), masks );
+    }
+#endif // __SSE2__
+
+    const PairMaskTable& table = PairMasks();
+    for ( ; i < count; i++ )
+    {
+        const uint32_t correct = table.presentPairs[ PairIndex( modifierMasks[i] ) ] & currentPairs;
+        modifierMasks[i] = ( modifierMasks[i] & ~correct ) | ( currentModifiers & correct );
+    }
+}
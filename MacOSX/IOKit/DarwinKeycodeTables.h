@@ -0,0 +1,97 @@
+
+#ifndef GITHUBSAMPLE_DARWIN_KEYCODE_TABLES_H
+#define GITHUBSAMPLE_DARWIN_KEYCODE_TABLES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace GitHubSample
+{
+
+    /**
+       Translations between mac virtual keycodes (the 'keyCode' of a Carbon or
+       Cocoa key event), Carbon modifier masks and PC set-1 scancodes.
+
+       These replace the if/else chains of DarwinModifierMaskToDarwinKeycode
+       and DarwinKeyCodeToDarwinModifierMask in
+       third_party_samples/DarwinKeyboard.cpp with table lookups, so a stream
+       of modifier events (which is most of what a VM sees while the user
+       holds shortcuts) does not pay a mispredicted branch per event.  The
+       batch versions translate whole arrays.
+     */
+
+    /// Carbon modifier masks (Events.h), plus the three that Carbon lacks
+    enum DarwinModifierMask
+    {
+        kDarwinCmdKey          = 0x00000100, ///< cmdKey
+        kDarwinShiftKey        = 0x00000200, ///< shiftKey
+        kDarwinAlphaLock       = 0x00000400, ///< alphaLock (caps lock)
+        kDarwinOptionKey       = 0x00000800, ///< optionKey
+        kDarwinControlKey      = 0x00001000, ///< controlKey
+        kDarwinRightShiftKey   = 0x00002000, ///< rightShiftKey
+        kDarwinRightOptionKey  = 0x00004000, ///< rightOptionKey
+        kDarwinRightControlKey = 0x00008000, ///< rightControlKey
+        kDarwinNumLock         = 0x00010000, ///< kEventKeyModifierNumLockMask
+        kDarwinFn              = 0x00020000, ///< kEventKeyModifierFnMask
+        kDarwinRightCmdKey     = 0x08000000, ///< not a real Carbon mask.  the same hack as VirtualBox.
+
+        kDarwinAllModifiers    = 0x0803FF00
+    };
+
+    /// bits ORed into a set-1 scancode by DarwinKeycodeToSet1Scancode (the K_EX, K_MOD and K_LOCK of VirtualBox)
+    enum Set1ScancodeFlags
+    {
+        kSet1Extended = 0x0100, ///< sent with an 0xE0 prefix
+        kSet1Modifier = 0x0400,
+        kSet1Lock     = 0x0800,
+        kSet1CodeMask = 0x00FF
+    };
+
+    enum
+    {
+        kDarwinKeycodeCount = 128,
+        /// returned by the mask-to-keycode functions when more than one modifier is set
+        kMultipleModifiers  = ~0U
+    };
+
+    /// zero for keycodes that have no set-1 scancode (or are out of range), and for Pause: see ScancodeEncoder
+    unsigned DarwinKeycodeToSet1Scancode( unsigned keycode );
+
+    /// zero when 'keycode' is not a modifier
+    uint32_t DarwinKeycodeToDarwinModifierMask( unsigned keycode );
+
+    /// zero when no modifier is set, kMultipleModifiers when more than one is.  Unknown bits are ignored.
+    unsigned DarwinModifierMaskToDarwinKeycode( uint32_t modifiers );
+
+    /// zero when no modifier is set, kMultipleModifiers when more than one is.
+    unsigned DarwinModifierMaskToSet1Scancode( uint32_t modifiers );
+
+    /**
+       Left/right correction of a Carbon modifier mask, as in
+       DarwinAdjustModifierMask of the VirtualBox sample: Carbon events often
+       say "shift" when it was the RIGHT shift.  For each pair (shift,
+       control, option, command) that is set in 'modifiers' AND in
+       'currentModifiers' (what the keyboards really hold, e.g.
+       HidModifiersToDarwinModifierMask of ModifierAggregator::MergedModifiers),
+       the pair's bits are taken from 'currentModifiers'.
+
+       Unlike the sample this does not refresh any HID cache: the caller
+       passes the current state in, once per batch.
+     */
+    uint32_t DarwinAdjustModifierMask( uint32_t modifiers, uint32_t currentModifiers );
+
+    /// The same, in place, for every mask in 'modifierMasks'.
+    void DarwinAdjustModifierMasks( uint32_t* modifierMasks, size_t count, uint32_t currentModifiers );
+
+    /// HID boot protocol modifier byte (bit 0 is left control ... bit 7 is right GUI) to Carbon mask
+    uint32_t HidModifiersToDarwinModifierMask( uint8_t hidModifiers );
+
+    /// 'keycodes' and 'scancodes' may be the same array
+    void DarwinKeycodesToSet1Scancodes( const uint16_t* keycodes, uint16_t* scancodes, size_t count );
+    void DarwinKeycodesToDarwinModifierMasks( const uint16_t* keycodes, uint32_t* modifierMasks, size_t count );
+    void DarwinModifierMasksToDarwinKeycodes( const uint32_t* modifierMasks, unsigned* keycodes, size_t count );
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_DARWIN_KEYCODE_TABLES_H
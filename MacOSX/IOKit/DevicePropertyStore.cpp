@@ -0,0 +1,249 @@
+
+
+#include "DevicePropertyStore.h"
+
+#include <IOKit/hid/IOHIDKeys.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <set>
+
+
+
+namespace
+{
+    /// in the order of DevicePropertyStore::Property
+    const char* const PROPERTY_NAMES[ GitHubSample::DevicePropertyStore::kPropertyCount ] =
+    {
+        kIOHIDTransportKey,
+        kIOHIDVendorIDKey,
+        kIOHIDVendorIDSourceKey,
+        kIOHIDProductIDKey,
+        kIOHIDVersionNumberKey,
+        kIOHIDManufacturerKey,
+        kIOHIDProductKey,
+        kIOHIDSerialNumberKey,
+        kIOHIDCountryCodeKey,
+        kIOHIDLocationIDKey
+    };
+
+    CFStringRef PropertyKey( const GitHubSample::DevicePropertyStore::Property property )
+    {
+        // CFSTR needs a literal, hence the switch
+        switch ( property )
+        {
+        case GitHubSample::DevicePropertyStore::kTransport:      return CFSTR( kIOHIDTransportKey );
+        case GitHubSample::DevicePropertyStore::kVendorId:       return CFSTR( kIOHIDVendorIDKey );
+        case GitHubSample::DevicePropertyStore::kVendorIdSource: return CFSTR( kIOHIDVendorIDSourceKey );
+        case GitHubSample::DevicePropertyStore::kProductId:      return CFSTR( kIOHIDProductIDKey );
+        case GitHubSample::DevicePropertyStore::kVersionNumber:  return CFSTR( kIOHIDVersionNumberKey );
+        case GitHubSample::DevicePropertyStore::kManufacturer:   return CFSTR( kIOHIDManufacturerKey );
+        case GitHubSample::DevicePropertyStore::kProduct:        return CFSTR( kIOHIDProductKey );
+        case GitHubSample::DevicePropertyStore::kSerialNumber:   return CFSTR( kIOHIDSerialNumberKey );
+        case GitHubSample::DevicePropertyStore::kCountryCode:    return CFSTR( kIOHIDCountryCodeKey );
+        case GitHubSample::DevicePropertyStore::kLocationId:     return CFSTR( kIOHIDLocationIDKey );
+        default:                                                 return NULL;
+        }
+    }
+
+    /// The UTF-8 form of 'cf_str', interned.  Short strings (all the
+    /// keyboard properties) go through a stack buffer.
+    const char* InternCFString( CFStringRef cf_str )
+    {
+        static const CFStringEncoding encoding = kCFStringEncodingUTF8;
+        char buffer[ 256 ];
+
+        if (CFStringGetCString (cf_str, buffer, sizeof(buffer), encoding))
+        {
+            return GitHubSample::DevicePropertyStore::Intern( buffer ); // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+        }
+
+        const CFIndex max_utf8_str_len = CFStringGetMaximumSizeForEncoding
+            ( CFStringGetLength (cf_str), encoding );
+
+        if ( max_utf8_str_len > 0 )
+        {
+            std::string result;
+            result.resize(max_utf8_str_len);
+
+            if (CFStringGetCString (cf_str, &result[0], result.size(), encoding))
+            {
+                return GitHubSample::DevicePropertyStore::Intern( result.c_str() );
+            }
+        }
+
+        return "";
+    }
+
+    /// node-based, so the c_str() of an element never moves
+    std::set< std::string >& InternPool()
+    {
+        static std::set< std::string > pool;
+        return pool;
+    }
+
+    pthread_mutex_t INTERN_POOL_MUTEX = PTHREAD_MUTEX_INITIALIZER;
+}
+
+
+
+GitHubSample::DevicePropertyStore::DevicePropertyStore()
+{
+    SetFetchFunctor( FetchFunctor() );
+}
+
+
+void GitHubSample::DevicePropertyStore::SetFetchFunctor( FetchFunctor fetchFunctor )
+{
+    m_fetchFunctor = fetchFunctor;
+
+    for ( size_t i = 0; i < kPropertyCount; i++ )
+    {
+        m_kinds[ i ] = kNotFetched;
+        m_numbers[ i ] = 0;
+        m_strings[ i ] = "";
+    }
+}
+
+
+void GitHubSample::DevicePropertyStore::Fetch( const Property property ) const
+{
+    m_kinds[ property ] = kAbsent;
+
+    if ( ! m_fetchFunctor )
+    {
+        return; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    CFTypeRef value = m_fetchFunctor( PropertyKey( property ) );
+
+    if ( ! value )
+    {
+        return; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    if ( CFGetTypeID(value) == CFNumberGetTypeID() )
+    {
+        // 64 bits whatever 'long' is: a location id such as 0xFA120000 is negative as a 32 bit long
+        int64_t number = 0;
+        CFNumberGetValue((CFNumberRef) value, kCFNumberSInt64Type, &number);
+        m_numbers[ property ] = number;
+        m_kinds[ property ] = kNumber;
+    }
+    else if ( CFGetTypeID(value) == CFStringGetTypeID() )
+    {
+        m_strings[ property ] = InternCFString( (CFStringRef) value );
+        m_kinds[ property ] = kString;
+    }
+    else
+    {
+        m_kinds[ property ] = kOtherType;
+    }
+
+    CFRelease(value);
+}
+
+
+bool GitHubSample::DevicePropertyStore::Has( const Property property ) const
+{
+    if ( property >= kPropertyCount )
+    {
+        return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    if ( m_kinds[ property ] == kNotFetched )
+    {
+        Fetch( property );
+    }
+
+    return m_kinds[ property ] != kAbsent;
+}
+
+
+int64_t GitHubSample::DevicePropertyStore::Number( const Property property ) const
+{
+    return Has( property ) ? m_numbers[ property ] : 0;
+}
+
+
+const char* GitHubSample::DevicePropertyStore::String( const Property property ) const
+{
+    return Has( property ) ? m_strings[ property ] : "";
+}
+
+
+std::string GitHubSample::DevicePropertyStore::Describe() const
+{
+    std::string result;
+
+    for ( size_t i = 0; i < kPropertyCount; i++ )
+    {
+        const Property property = static_cast<Property>( i );
+        if ( ! Has( property ) )
+        {
+            continue;
+        }
+
+        result += PROPERTY_NAMES[ i ];
+        result += ": ";
+
+        switch ( m_kinds[ i ] )
+        {
+        case kNumber:
+            {
+                char number[ 32 ];
+                snprintf( number, sizeof(number), "%lld", static_cast<long long int>( m_numbers[ i ] ) );
+                result += number;
+            }
+            break;
+        case kString:
+            result += m_strings[ i ];
+            break;
+        default:
+            result += "<type error>";
+            break;
+        }
+
+        result += "\n";
+    }
+
+    return result;
+}
+
+
+const char* GitHubSample::DevicePropertyStore::PropertyName( const Property property )
+{
+    return ( property < kPropertyCount ) ? PROPERTY_NAMES[ property ] : "?";
+}
+
+
+const char* GitHubSample::DevicePropertyStore::Intern( const char* utf8 )
+{
+    if ( ! utf8 || ! *utf8 )
+    {
+        return ""; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    pthread_mutex_lock( &INTERN_POOL_MUTEX );
+    const char* interned = InternPool().insert( std::string( utf8 ) ).first->c_str();
+    pthread_mutex_unlock( &INTERN_POOL_MUTEX );
+
+    return interned;
+}
+
+
+size_t GitHubSample::DevicePropertyStore::InternedBytes()
+{
+    size_t bytes = 0;
+
+    pthread_mutex_lock( &INTERN_POOL_MUTEX );
+    const std::set< std::string >& pool = InternPool();
+    for ( std::set< std::string >::const_iterator it = pool.begin(); it != pool.end(); ++it )
+    {
+        bytes += it->capacity() + 1;
+    }
+    pthread_mutex_unlock( &INTERN_POOL_MUTEX );
+
+    return bytes;
+}
@@ -0,0 +1,112 @@
+
+#ifndef GITHUBSAMPLE_DEVICE_PROPERTY_STORE_H
+#define GITHUBSAMPLE_DEVICE_PROPERTY_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <boost/function.hpp>
+
+#include <CoreFoundation/CFString.h>
+
+
+namespace GitHubSample
+{
+
+    /**
+       The registry properties of one HID device, typed, and fetched only
+       when somebody asks for them.
+
+       Numbers stay numbers (no "VendorID: 1452" strings to parse back), and
+       strings are interned: every device reporting "USB" or "Apple Inc."
+       points at the same copy, which lives as long as the process.  Each
+       property costs one IORegistryEntryCreateCFProperty, the first time it
+       is read, and none at all when nobody reads it.
+
+       Not thread-safe (reading a property may fetch it).  Use it from the
+       thread that owns the reader.
+     */
+    class DevicePropertyStore
+    {
+    public:
+
+        /// the kIOHID*Key properties we know about
+        enum Property
+        {
+            kTransport,
+            kVendorId,
+            kVendorIdSource,
+            kProductId,
+            kVersionNumber,
+            kManufacturer,
+            kProduct,
+            kSerialNumber,
+            kCountryCode,
+            kLocationId,
+            kPropertyCount
+        };
+
+        /// Follows the Create rule: returns a reference that the store
+        /// releases, or NULL when the device has no such property.
+        typedef boost::function< CFTypeRef ( CFStringRef key ) > FetchFunctor;
+
+        DevicePropertyStore();
+
+        /// Forgets whatever was fetched.  An empty functor makes every property absent.
+        void SetFetchFunctor( FetchFunctor fetchFunctor );
+
+        /// false when the device did not report it.  The ONLY way to tell an absent number from a zero.
+        bool Has( Property property ) const;
+
+        /// zero when the property is absent or not a number
+        int64_t Number( Property property ) const;
+
+        /// interned; valid for the lifetime of the process.  "" when the property is absent or not a string.
+        const char* String( Property property ) const;
+
+        /// the registry holds these as 32 bit numbers (a location id uses all of them)
+        uint32_t VendorId() const { return static_cast<uint32_t>( Number( kVendorId ) ); }
+        uint32_t ProductId() const { return static_cast<uint32_t>( Number( kProductId ) ); }
+        uint32_t VersionNumber() const { return static_cast<uint32_t>( Number( kVersionNumber ) ); }
+        uint32_t LocationId() const { return static_cast<uint32_t>( Number( kLocationId ) ); }
+        uint32_t CountryCode() const { return static_cast<uint32_t>( Number( kCountryCode ) ); }
+        const char* Transport() const { return String( kTransport ); }
+        const char* Manufacturer() const { return String( kManufacturer ); }
+        const char* Product() const { return String( kProduct ); }
+        const char* SerialNumber() const { return String( kSerialNumber ); }
+
+        /// Fetches everything, and returns one "property: value" line per
+        /// property the device reported.  Meant for error messages.
+        std::string Describe() const;
+
+        /// the registry key, e.g. "VendorID"
+        static const char* PropertyName( Property property );
+
+        /// The one copy of 'utf8' that all devices share.  Thread-safe.
+        static const char* Intern( const char* utf8 );
+
+        /// what all interned strings take, for all devices together
+        static size_t InternedBytes();
+
+    private:
+
+        enum Kind
+        {
+            kNotFetched,
+            kAbsent,
+            kNumber,
+            kString,
+            kOtherType
+        };
+
+        FetchFunctor m_fetchFunctor;
+        mutable uint8_t m_kinds[ kPropertyCount ];
+        mutable int64_t m_numbers[ kPropertyCount ];
+        mutable const char* m_strings[ kPropertyCount ];
+
+        void Fetch( Property property ) const;
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_DEVICE_PROPERTY_STORE_H
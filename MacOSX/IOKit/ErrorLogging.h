@@ -0,0 +1,28 @@
+
+#ifndef GITHUBSAMPLE_ERROR_LOGGING_H
+#define GITHUBSAMPLE_ERROR_LOGGING_H
+
+#include <string>
+#include <boost/function.hpp>
+
+
+namespace GitHubSample
+{
+
+    /// Every class here reports problems through an optional functor of this
+    /// shape (see the HelperForKeyboardReaderIOKit constructor).
+    inline void LogErrorWhenFunctorIsntEmpty
+    (
+     boost::function< void ( const std::string msg ) > errorLoggerFunctor,
+     const std::string error
+    )
+    {
+        if( errorLoggerFunctor.empty() == false )
+        {
+            errorLoggerFunctor( error );
+        }
+    }
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_ERROR_LOGGING_H
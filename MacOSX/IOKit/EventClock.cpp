@@ -0,0 +1,52 @@
+
+
+#include "EventClock.h"
+#include "HighResolutionClock.h"
+
+#include <errno.h>
+#include <time.h>
+
+
+
+namespace
+{
+    class SystemClock : public GitHubSample::EventClock
+    {
+    public:
+
+        SystemClock() : m_clock( GitHubSample::HighResolutionClock::ForEventTimestamps() ) {}
+
+        virtual uint64_t Now() const { return m_clock.Now(); }
+
+        virtual uint64_t ToNanoseconds( uint64_t ticks ) const { return m_clock.ToNanoseconds( ticks ); }
+
+        virtual void SleepUntil( const uint64_t deadline )
+        {
+            const uint64_t now = NowNanoseconds();
+            if ( deadline <= now )
+            {
+                return; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+            }
+
+            struct timespec remaining;
+            remaining.tv_sec = static_cast<time_t>( ( deadline - now ) / 1000000000u );
+            remaining.tv_nsec = static_cast<long>( ( deadline - now ) % 1000000000u );
+
+            while ( nanosleep( &remaining, &remaining ) != 0 && errno == EINTR )
+            {
+            }
+        }
+
+    private:
+
+        const GitHubSample::HighResolutionClock& m_clock;
+    };
+}
+
+
+
+GitHubSample::EventClock& GitHubSample::EventClock::System()
+{
+    static SystemClock clock;
+    return clock;
+}
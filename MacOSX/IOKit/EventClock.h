@@ -0,0 +1,84 @@
+
+#ifndef GITHUBSAMPLE_EVENT_CLOCK_H
+#define GITHUBSAMPLE_EVENT_CLOCK_H
+
+#include <stdint.h>
+
+
+namespace GitHubSample
+{
+
+    /**
+       Where the stages get the time from, and how they wait for it.
+
+       Anything that schedules itself (AdaptivePoller, and the loops that
+       drive EventCoalescer and DeviceClockCorrector) reads the time through
+       one of these instead of calling HighResolutionClock directly.  In
+       production that is System(); under test or replay it is a
+       VirtualClock, whose time only moves when it is told to, so a day of
+       typing can be pushed through in seconds and come out the same every
+       time.
+
+       Now() is in the units of KeyEvent::timestamp.
+     */
+    class EventClock
+    {
+    public:
+
+        virtual ~EventClock() {}
+
+        /// ticks
+        virtual uint64_t Now() const = 0;
+
+        virtual uint64_t ToNanoseconds( uint64_t ticks ) const = 0;
+
+        uint64_t NowNanoseconds() const { return ToNanoseconds( Now() ); }
+
+        /// Returns once NowNanoseconds() has reached 'deadline'.  Right away when it already has.
+        virtual void SleepUntil( uint64_t deadline ) = 0;
+
+        /// HighResolutionClock::ForEventTimestamps, and nanosleep.  Shared by every thread.
+        static EventClock& System();
+    };
+
+
+    /**
+       A clock that stands still until it is moved.  Ticks ARE nanoseconds.
+
+       SleepUntil does not wait: it jumps to the deadline, so a stage that
+       sleeps between polls simply skips ahead.  Time never goes backwards;
+       moving to an earlier time changes nothing.
+
+       Not thread-safe.  Run the whole pipeline that uses it on one thread
+       (EventReplay does).
+     */
+    class VirtualClock : public EventClock
+    {
+    public:
+
+        explicit VirtualClock( uint64_t start = 0 ) : m_now( start ) {}
+
+        virtual uint64_t Now() const { return m_now; }
+
+        virtual uint64_t ToNanoseconds( uint64_t ticks ) const { return ticks; }
+
+        virtual void SleepUntil( uint64_t deadline ) { AdvanceTo( deadline ); }
+
+        void AdvanceTo( uint64_t time )
+        {
+            if ( time > m_now )
+            {
+                m_now = time;
+            }
+        }
+
+        void Advance( uint64_t nanoseconds ) { AdvanceTo( m_now + nanoseconds ); }
+
+    private:
+
+        uint64_t m_now;
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_EVENT_CLOCK_H
@@ -0,0 +1,246 @@
+
+
+#include "EventCoalescer.h"
+#include "RealtimeThreadConfig.h"
+
+#include <string.h>
+
+
+
+namespace
+{
+    // these are the kHIDUsage_* values
+    const uint16_t USAGE_PAGE_KEYBOARD_OR_KEYPAD = 0x07;
+    const uint16_t USAGE_ESCAPE                  = 0x29;
+
+    const uint64_t NEVER = ~static_cast<uint64_t>( 0 );
+
+    size_t LatencyBucket( const uint64_t latency )
+    {
+        const uint64_t microseconds = latency / 1000;
+        if ( microseconds == 0 )
+        {
+            return 0; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+        }
+
+        const size_t bucket = 64 - __builtin_clzll( microseconds );
+        return ( bucket < GitHubSample::EventCoalescer::kLatencyBucketCount ) ? bucket : GitHubSample::EventCoalescer::kLatencyBucketCount - 1;
+    }
+}
+
+
+
+GitHubSample::EventCoalescer::EventCoalescer( const uint64_t budget, const uint64_t timerSlack, const size_t capacity )
+    : m_budget( budget ),
+      m_timerSlack( timerSlack ),
+      m_events( capacity ? capacity : 1 ),
+      m_arrivalTimes( capacity ? capacity : 1 ),
+      m_count( 0 ),
+      m_head( 0 ),
+      m_deadline( 0 ),
+      m_priorityPending( false )
+{
+    memset( m_priorityKeys, 0, sizeof(m_priorityKeys) );
+    SetPriorityKey( USAGE_ESCAPE, true );
+    ResetStats( 0 );
+}
+
+
+void GitHubSample::EventCoalescer::SetPriorityKey( const uint16_t usage, const bool isPriority )
+{
+    if ( usage >= KeyStateBitmap::kWordCount * 32 )
+    {
+        return; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    const uint32_t bit = 1u << ( usage & 31 );
+    if ( isPriority )
+    {
+        m_priorityKeys[ usage >> 5 ] |= bit;
+    }
+    else
+    {
+        m_priorityKeys[ usage >> 5 ] &= ~bit;
+    }
+}
+
+
+bool GitHubSample::EventCoalescer::IsPriority( const KeyEvent& event ) const
+{
+    return event.usagePage == USAGE_PAGE_KEYBOARD_OR_KEYPAD
+        && event.usage < KeyStateBitmap::kWordCount * 32
+        && ( ( m_priorityKeys[ event.usage >> 5 ] >> ( event.usage & 31 ) ) & 1 );
+}
+
+
+size_t GitHubSample::EventCoalescer::Offer( const KeyEvent* events, const size_t count, const uint64_t now )
+{
+    if ( count == 0 )
+    {
+        return 0; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    if ( m_count == 0 )
+    {
+        // the first event of a batch sets the deadline: t0 + budget, down to the slack grid, but not before t0
+        m_deadline = now + m_budget;
+        if ( m_timerSlack != 0 && m_deadline - m_deadline % m_timerSlack >= now )
+        {
+            m_deadline -= m_deadline % m_timerSlack;
+        }
+    }
+
+    const size_t room = m_events.size() - m_count;
+    const size_t taken = ( count < room ) ? count : room;
+
+    for ( size_t i = 0; i < taken; i++ )
+    {
+        m_events[ m_count ] = events[ i ];
+        m_arrivalTimes[ m_count ] = now;
+        m_count++;
+
+        if ( IsPriority( events[ i ] ) )
+        {
+            m_priorityPending = true;
+        }
+    }
+
+    m_stats.droppedEvents += count - taken;
+    return taken;
+}
+
+
+GitHubSample::EventCoalescer::State GitHubSample::EventCoalescer::CurrentState( const uint64_t now ) const
+{
+    if ( m_count == m_head )
+    {
+        return kIdle;
+    }
+
+    if ( m_priorityPending || m_head != 0 || m_count == m_events.size() || now >= m_deadline )
+    {
+        return kDue;
+    }
+
+    return kCollecting;
+}
+
+
+uint64_t GitHubSample::EventCoalescer::NanosecondsUntilDelivery( const uint64_t now ) const
+{
+    switch ( CurrentState( now ) )
+    {
+    case kIdle:
+        return NEVER;
+    case kCollecting:
+        return m_deadline - now;
+    default:
+        return 0;
+    }
+}
+
+
+size_t GitHubSample::EventCoalescer::Deliver( KeyEvent* events, const size_t capacity, const uint64_t now )
+{
+    if ( CurrentState( now ) != kDue )
+    {
+        return 0; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    if ( m_head == 0 )
+    {
+        // one wake-up per batch, even when the caller takes it in pieces
+        m_stats.wakeups++;
+        if ( m_priorityPending && now < m_deadline )
+        {
+            m_stats.priorityWakeups++;
+        }
+    }
+
+    const size_t available = m_count - m_head;
+    const size_t delivered = ( capacity < available ) ? capacity : available;
+
+    for ( size_t i = 0; i < delivered; i++ )
+    {
+        events[ i ] = m_events[ m_head + i ];
+
+        const uint64_t arrival = m_arrivalTimes[ m_head + i ];
+        const uint64_t latency = ( now > arrival ) ? now - arrival : 0;
+        m_stats.totalLatency += latency;
+        if ( latency > m_stats.maximumLatency )
+        {
+            m_stats.maximumLatency = latency;
+        }
+        m_stats.latencyHistogram[ LatencyBucket( latency ) ]++;
+    }
+
+    m_stats.events += delivered;
+    m_head += delivered;
+
+    if ( m_head == m_count )
+    {
+        m_head = 0;
+        m_count = 0;
+        m_priorityPending = false;
+    }
+
+    return delivered;
+}
+
+
+void GitHubSample::EventCoalescer::ResetStats( const uint64_t now )
+{
+    memset( &m_stats, 0, sizeof(m_stats) );
+    m_stats.startTime = now;
+}
+
+
+double GitHubSample::EventCoalescer::WakeupsPerSecond( const uint64_t now ) const
+{
+    if ( now <= m_stats.startTime )
+    {
+        return 0.0;
+    }
+
+    return static_cast<double>( m_stats.wakeups ) * 1e9 / static_cast<double>( now - m_stats.startTime );
+}
+
+
+uint64_t GitHubSample::EventCoalescer::LatencyPercentile( const double fraction ) const
+{
+    if ( m_stats.events == 0 )
+    {
+        return 0; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    const double wanted = fraction * static_cast<double>( m_stats.events );
+    uint64_t seen = 0;
+
+    for ( size_t bucket = 0; bucket < kLatencyBucketCount - 1; bucket++ )
+    {
+        seen += m_stats.latencyHistogram[ bucket ];
+        if ( static_cast<double>( seen ) >= wanted )
+        {
+            const uint64_t upperBound = ( static_cast<uint64_t>( 1 ) << bucket ) * 1000;
+            return ( upperBound < m_stats.maximumLatency ) ? upperBound : m_stats.maximumLatency;
+        }
+    }
+
+    return m_stats.maximumLatency;
+}
+
+
+void GitHubSample::EventCoalescer::LockBuffers( RealtimeThreadConfig& realtime )
+{
+    realtime.LockVector( m_events );
+    realtime.LockVector( m_arrivalTimes );
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::EventCoalescer::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) );
+    report.AddHeap( MemoryUsageReport::kEventBuffers, CapacityBytes( m_events ) + CapacityBytes( m_arrivalTimes ) );
+    return report;
+}
@@ -0,0 +1,131 @@
+
+#ifndef GITHUBSAMPLE_EVENT_COALESCER_H
+#define GITHUBSAMPLE_EVENT_COALESCER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "KeyEvent.h"
+#include "MemoryUsage.h"
+
+
+namespace GitHubSample
+{
+
+    class RealtimeThreadConfig;
+
+    /**
+       Holds events back for up to a LATENCY BUDGET, so that the consumer
+       wakes once per burst instead of once per keystroke (a laptop's CPU
+       stays in deep idle states between the wake-ups).
+
+       The states:
+
+         - kIdle: nothing held.  The consumer can sleep as long as it likes.
+         - kCollecting: the first event arrived at t0.  Everything that
+           arrives before the deadline joins the batch.  The deadline is
+           t0 + budget rounded DOWN to a multiple of 'timerSlack', so that
+           wake-ups from everything using the same grid line up (never
+           earlier than t0, never later than t0 + budget).
+         - kDue: the deadline passed, the buffer is full, or a PRIORITY key
+           (Escape, by default) arrived.  Deliver hands the batch out.
+
+       The consumer loop is:
+
+           coalescer.Offer( events, reader.ReadEventsFromQueue( events, capacity ), now );
+           sleep for coalescer.NanosecondsUntilDelivery( now ) (or until the next event, when idle)
+           count = coalescer.Deliver( batch, batchCapacity, now );
+
+       All times are nanoseconds of one clock (e.g. HighResolutionClock),
+       passed in by the caller.  The buffer is allocated once, at
+       construction.
+
+       The statistics are the wake-ups (deliveries) per second, and the
+       distribution of the latency that holding events back ADDED (delivery
+       time minus arrival time), in power-of-two microsecond buckets.
+     */
+    class EventCoalescer
+    {
+    public:
+
+        enum State
+        {
+            kIdle,
+            kCollecting,
+            kDue
+        };
+
+        enum
+        {
+            /// bucket 0 is below 1 us, bucket i (i > 0) is [ 2^(i-1), 2^i ) us, the last one is open ended
+            kLatencyBucketCount = 24
+        };
+
+        struct Statistics
+        {
+            uint64_t wakeups;
+            uint64_t priorityWakeups;
+            uint64_t events;
+            uint64_t droppedEvents;
+            uint64_t totalLatency;
+            uint64_t maximumLatency;
+            uint64_t latencyHistogram[ kLatencyBucketCount ];
+            /// when the statistics were (re)started, in the caller's clock
+            uint64_t startTime;
+        };
+
+        /// 'budget' and 'timerSlack' in nanoseconds. a zero budget delivers every event right away.
+        EventCoalescer( uint64_t budget = 8000000, uint64_t timerSlack = 1000000, size_t capacity = 256 );
+
+        /// Priority keys (kHIDPage_KeyboardOrKeypad usages) make the batch due at once, on press and release.
+        void SetPriorityKey( uint16_t usage, bool isPriority );
+
+        /**
+           Adds events that arrived at 'now'.  Returns how many were taken:
+           when the buffer is full the batch becomes due, and the rest are
+           counted in droppedEvents unless the caller delivers and offers
+           them again.
+         */
+        size_t Offer( const KeyEvent* events, size_t count, uint64_t now );
+
+        State CurrentState( uint64_t now ) const;
+
+        /// zero when due. UINT64_MAX when idle (sleep until the next event).
+        uint64_t NanosecondsUntilDelivery( uint64_t now ) const;
+
+        /// Hands out the batch (up to 'capacity') when it is due, and counts
+        /// one wake-up.  Returns zero, and counts nothing, when it is not due.
+        size_t Deliver( KeyEvent* events, size_t capacity, uint64_t now );
+
+        const Statistics& Stats() const { return m_stats; }
+        void ResetStats( uint64_t now );
+
+        double WakeupsPerSecond( uint64_t now ) const;
+        /// upper bound of the histogram bucket that holds the given fraction (0..1) of the latencies, in nanoseconds
+        uint64_t LatencyPercentile( double fraction ) const;
+
+        /// Hands the buffer to 'realtime' to be prefaulted and mlocked.  This object must outlive it.
+        void LockBuffers( RealtimeThreadConfig& realtime );
+
+        MemoryUsageReport MemoryUsage() const;
+
+    private:
+
+        uint64_t m_budget;
+        uint64_t m_timerSlack;
+        std::vector< KeyEvent > m_events;
+        std::vector< uint64_t > m_arrivalTimes;
+        size_t m_count;
+        size_t m_head;
+        uint64_t m_deadline;
+        bool m_priorityPending;
+        uint32_t m_priorityKeys[ KeyStateBitmap::kWordCount ];
+        Statistics m_stats;
+
+        bool IsPriority( const KeyEvent& event ) const;
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_EVENT_COALESCER_H
@@ -0,0 +1,255 @@
+
+
+#include "EventReplay.h"
+#include "ErrorLogging.h"
+#include "LittleEndian.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <boost/format.hpp>
+
+
+
+namespace
+{
+    const char   RECORDING_FILE_MAGIC[4] = { 'K', 'E', 'V', 'R' };
+    const size_t RECORDING_FILE_VERSION = 1;
+    const size_t RECORDING_FILE_HEADER_SIZE = 16;
+    const size_t RECORDING_ENTRY_SIZE = 32;
+
+    /*
+      One entry.  All multi-byte values are little-endian.
+
+          offset  size  contents
+          ------  ----  -------------------
+               0     8  arrival time
+               8     8  timestamp
+              16     2  usage page
+              18     2  usage
+              20     4  value
+              24     2  device index
+              26     2  flags
+              28     4  reserved, zero
+    */
+    void WriteEntry( uint8_t* bytes, const GitHubSample::EventRecording::Entry& entry )
+    {
+        GitHubSample::WriteLittleEndian64( bytes,      entry.arrival );
+        GitHubSample::WriteLittleEndian64( bytes + 8,  entry.event.timestamp );
+        GitHubSample::WriteLittleEndian16( bytes + 16, entry.event.usagePage );
+        GitHubSample::WriteLittleEndian16( bytes + 18, entry.event.usage );
+        GitHubSample::WriteLittleEndian32( bytes + 20, static_cast<uint32_t>( entry.event.value ) );
+        GitHubSample::WriteLittleEndian16( bytes + 24, entry.event.deviceIndex );
+        GitHubSample::WriteLittleEndian16( bytes + 26, entry.event.flags );
+        GitHubSample::WriteLittleEndian32( bytes + 28, 0 );
+    }
+
+    void ReadEntry( const uint8_t* bytes, GitHubSample::EventRecording::Entry& entry )
+    {
+        entry.arrival = GitHubSample::ReadLittleEndian64( bytes );
+        entry.event.timestamp = GitHubSample::ReadLittleEndian64( bytes + 8 );
+        entry.event.usagePage = GitHubSample::ReadLittleEndian16( bytes + 16 );
+        entry.event.usage = GitHubSample::ReadLittleEndian16( bytes + 18 );
+        entry.event.value = static_cast<int32_t>( GitHubSample::ReadLittleEndian32( bytes + 20 ) );
+        entry.event.deviceIndex = GitHubSample::ReadLittleEndian16( bytes + 24 );
+        entry.event.flags = GitHubSample::ReadLittleEndian16( bytes + 26 );
+    }
+}
+
+
+
+void GitHubSample::EventRecording::Append( const KeyEvent* events, const size_t count, uint64_t arrival )
+{
+    if ( ! m_entries.empty() && arrival < m_entries.back().arrival )
+    {
+        arrival = m_entries.back().arrival;
+    }
+
+    for ( size_t i = 0; i < count; i++ )
+    {
+        Entry entry;
+        entry.arrival = arrival;
+        entry.event = events[ i ];
+        m_entries.push_back( entry );
+    }
+}
+
+
+bool GitHubSample::EventRecording::Save
+(
+ const std::string& path,
+ boost::function< void ( const std::string msg ) > errorLoggerFunctor
+) const
+{
+    uint8_t header[ RECORDING_FILE_HEADER_SIZE ];
+    memset( header, 0, sizeof(header) );
+    memcpy( header, RECORDING_FILE_MAGIC, sizeof(RECORDING_FILE_MAGIC) );
+    WriteLittleEndian16( header + 4, RECORDING_FILE_VERSION );
+    WriteLittleEndian64( header + 8, m_entries.size() );
+
+    FILE* file = fopen( path.c_str(), "wb" );
+    bool success = file && fwrite( header, 1, sizeof(header), file ) == sizeof(header);
+
+    // a day of input is too big to build in memory first, so it goes out in chunks
+    uint8_t chunk[ 256 * RECORDING_ENTRY_SIZE ];
+    for ( size_t i = 0; success && i < m_entries.size(); i += 256 )
+    {
+        const size_t count = ( m_entries.size() - i < 256 ) ? m_entries.size() - i : 256;
+        for ( size_t j = 0; j < count; j++ )
+        {
+            WriteEntry( chunk + ( j * RECORDING_ENTRY_SIZE ), m_entries[ i + j ] );
+        }
+        success = ( fwrite( chunk, RECORDING_ENTRY_SIZE, count, file ) == count );
+    }
+
+    if ( file && 0 != fclose( file ) )
+    {
+        success = false;
+    }
+
+    if ( ! success )
+    {
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, "Failed to write event recording: " + path );
+    }
+
+    return success;
+}
+
+
+bool GitHubSample::EventRecording::Load
+(
+ const std::string& path,
+ boost::function< void ( const std::string msg ) > errorLoggerFunctor
+)
+{
+    m_entries.clear();
+
+    FILE* file = fopen( path.c_str(), "rb" );
+    if ( ! file )
+    {
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, "Failed to open event recording: " + path );
+        return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    uint8_t header[ RECORDING_FILE_HEADER_SIZE ];
+    if ( fread( header, 1, sizeof(header), file ) != sizeof(header)
+         || 0 != memcmp( header, RECORDING_FILE_MAGIC, sizeof(RECORDING_FILE_MAGIC) )
+         || ReadLittleEndian16( header + 4 ) != RECORDING_FILE_VERSION )
+    {
+        fclose( file );
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, "Not an event recording (or not this version): " + path );
+        return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    const uint64_t count = ReadLittleEndian64( header + 8 );
+
+    uint8_t chunk[ 256 * RECORDING_ENTRY_SIZE ];
+    size_t entriesRead = 0;
+    while ( (entriesRead = fread( chunk, RECORDING_ENTRY_SIZE, 256, file )) > 0 )
+    {
+        for ( size_t j = 0; j < entriesRead; j++ )
+        {
+            Entry entry;
+            ReadEntry( chunk + ( j * RECORDING_ENTRY_SIZE ), entry );
+            m_entries.push_back( entry );
+        }
+    }
+
+    const bool readError = ( ferror( file ) != 0 );
+    fclose( file );
+
+    if ( readError || m_entries.size() != count )
+    {
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor,
+                                      boost::str( boost::format("Event recording %1% is damaged: %2% of %3% events.")
+                                                  % path % m_entries.size() % count ) );
+        m_entries.clear();
+        return false;
+    }
+
+    return true;
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::EventRecording::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) );
+    report.AddHeap( MemoryUsageReport::kEventBuffers, CapacityBytes( m_entries ) );
+    return report;
+}
+
+
+
+GitHubSample::EventReplay::EventReplay( const EventRecording& recording, VirtualClock& clock, const unsigned int speed )
+    : m_recording( recording ),
+      m_clock( clock ),
+      m_speed( speed ),
+      m_next( 0 ),
+      m_paced( false ),
+      m_realStart( 0 ),
+      m_virtualStart( 0 )
+{
+}
+
+
+void GitHubSample::EventReplay::SetSpeed( const unsigned int speed )
+{
+    m_speed = speed;
+    m_paced = false;
+}
+
+
+size_t GitHubSample::EventReplay::ReadEvents( KeyEvent* events, const size_t capacity )
+{
+    const uint64_t now = m_clock.NowNanoseconds();
+    size_t count = 0;
+
+    while ( count < capacity && m_next < m_recording.Count() && m_recording.At( m_next ).arrival <= now )
+    {
+        events[ count++ ] = m_recording.At( m_next++ ).event;
+    }
+
+    return count;
+}
+
+
+bool GitHubSample::EventReplay::Advance( const uint64_t deadline )
+{
+    const uint64_t now = m_clock.NowNanoseconds();
+    uint64_t target = deadline;
+
+    if ( ! Finished() )
+    {
+        if ( NextArrival() <= now )
+        {
+            return true; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+        }
+
+        if ( NextArrival() < target )
+        {
+            target = NextArrival();
+        }
+    }
+    else if ( deadline == ~static_cast<uint64_t>( 0 ) )
+    {
+        return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    if ( m_speed != kMaximumSpeed && target > now )
+    {
+        // measured from where the pacing started, so that rounding and late wake-ups do not add up
+        EventClock& realClock = EventClock::System();
+        if ( ! m_paced )
+        {
+            m_paced = true;
+            m_realStart = realClock.NowNanoseconds();
+            m_virtualStart = now;
+        }
+
+        realClock.SleepUntil( m_realStart + ( target - m_virtualStart ) / m_speed );
+    }
+
+    m_clock.AdvanceTo( target );
+    return true;
+}
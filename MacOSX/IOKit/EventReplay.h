@@ -0,0 +1,158 @@
+
+#ifndef GITHUBSAMPLE_EVENT_REPLAY_H
+#define GITHUBSAMPLE_EVENT_REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+
+#include "EventClock.h"
+#include "KeyEvent.h"
+#include "MemoryUsage.h"
+
+
+namespace GitHubSample
+{
+
+    /// HelperForKeyboardReaderIOKit::ReadEventsFromQueue, or EventReplay::ReadEvents
+    typedef boost::function< size_t ( KeyEvent* events, size_t capacity ) > EventSourceFunctor;
+
+
+    /**
+       A session of input: every batch the reader handed out, and when.
+
+       The arrival times are nanoseconds of the clock the pipeline ran on
+       (EventClock::NowNanoseconds).  Record events whose timestamps were
+       converted to nanoseconds (HighResolutionClock::TimestampsToNanoseconds)
+       and the recording replays the same on any machine.
+
+       The file is little-endian: a 16 byte header (magic 'KEVR', version,
+       reserved, entry count) and then 32 bytes per event (arrival time,
+       timestamp, usage page, usage, value, device index, flags).  A day of
+       steady typing is well under 100 MB.
+     */
+    class EventRecording
+    {
+    public:
+
+        struct Entry
+        {
+            uint64_t arrival;
+            KeyEvent event;
+        };
+
+        EventRecording() {}
+
+        /// An 'arrival' earlier than the last one is taken as the last one.
+        void Append( const KeyEvent* events, size_t count, uint64_t arrival );
+
+        size_t Count() const { return m_entries.size(); }
+        const Entry& At( size_t index ) const { return m_entries[ index ]; }
+
+        void Clear() { m_entries.clear(); }
+
+        bool Save( const std::string& path, boost::function< void ( const std::string msg ) > errorLoggerFunctor = 0 ) const;
+
+        /// Replaces what was recorded.  On failure the recording is empty.
+        bool Load( const std::string& path, boost::function< void ( const std::string msg ) > errorLoggerFunctor = 0 );
+
+        MemoryUsageReport MemoryUsage() const;
+
+    private:
+
+        std::vector< Entry > m_entries;
+    };
+
+
+    /**
+       Plays an EventRecording back through the stages, on a VirtualClock.
+
+       It stands in for the reader: ReadEvents has the signature of
+       ReadEventsFromQueue and hands out the events that have 'arrived' by
+       the clock's time.  Advance moves the clock to the next arrival, or
+       to an earlier deadline (e.g. when an EventCoalescer batch or an
+       AdaptivePoller poll is due):
+
+           GitHubSample::VirtualClock clock;
+           GitHubSample::EventReplay replay( recording, clock );
+
+           for (;;)
+           {
+               const uint64_t wait = coalescer.NanosecondsUntilDelivery( clock.NowNanoseconds() );
+               if ( ! replay.Advance( ( wait == NEVER ) ? NEVER : clock.NowNanoseconds() + wait ) )
+               {
+                   break;
+               }
+
+               coalescer.Offer( events, replay.ReadEvents( events, capacity ), clock.NowNanoseconds() );
+               count = coalescer.Deliver( batch, batchCapacity, clock.NowNanoseconds() );
+               ...
+           }
+
+       At kMaximumSpeed the clock jumps, so the run takes as long as the
+       stages take to compute.  At 1x (or 10x) Advance first waits, on the
+       real clock, for the (tenth of the) virtual time it is about to skip.
+       Either way the stages see the same times in the same order, so
+       their output is identical at every speed.
+
+       Not thread-safe.  The recording and the clock must outlive the replay.
+     */
+    class EventReplay
+    {
+    public:
+
+        enum
+        {
+            /// never wait on the real clock
+            kMaximumSpeed = 0
+        };
+
+        EventReplay( const EventRecording& recording, VirtualClock& clock, unsigned int speed = kMaximumSpeed );
+
+        /// 1 is real time, 10 is ten times as fast, kMaximumSpeed is as fast as the stages go
+        void SetSpeed( unsigned int speed );
+        unsigned int Speed() const { return m_speed; }
+
+        /// Up to 'capacity' of the events that arrived by now (on the virtual clock).
+        size_t ReadEvents( KeyEvent* events, size_t capacity );
+
+        /**
+           Moves the clock to the next arrival, or to 'deadline' when that
+           comes first.  Returns false, and leaves the clock alone, when
+           every event was read and there is no deadline (the default).
+           Does not move the clock while events that already arrived are
+           still unread.
+         */
+        bool Advance( uint64_t deadline = ~static_cast<uint64_t>( 0 ) );
+
+        bool Finished() const { return m_next == m_recording.Count(); }
+
+        /// the arrival time of the next unread event.  only valid when not Finished.
+        uint64_t NextArrival() const { return m_recording.At( m_next ).arrival; }
+
+        /// Goes back to the first event.  The clock does not go back: replay again on a new VirtualClock.
+        void Rewind() { m_next = 0; }
+
+    private:
+
+        const EventRecording& m_recording;
+        VirtualClock& m_clock;
+        unsigned int m_speed;
+        size_t m_next;
+
+        /// real and virtual time when the pacing (re)started, for speeds other than kMaximumSpeed
+        bool m_paced;
+        uint64_t m_realStart;
+        uint64_t m_virtualStart;
+
+        /// declared private so as to make this class non-copyable
+        EventReplay(const EventReplay&);
+        /// declared private so as to make this class non-copyable
+        EventReplay& operator=(const EventReplay&);
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_EVENT_REPLAY_H
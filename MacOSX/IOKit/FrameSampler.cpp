@@ -0,0 +1,187 @@
+
+
+#include "FrameSampler.h"
+#include "AtomicOps.h"
+#include "RealtimeThreadConfig.h"
+
+#include <string.h>
+
+
+
+namespace
+{
+    // this is kHIDPage_KeyboardOrKeypad
+    const uint16_t USAGE_PAGE_KEYBOARD_OR_KEYPAD = 0x07;
+
+    size_t RoundUpToPowerOfTwo( const size_t value )
+    {
+        size_t result = 1;
+        while ( result < value )
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+}
+
+
+
+GitHubSample::FrameSampler::FrameSampler( const size_t capacity )
+    : m_ring( RoundUpToPowerOfTwo( capacity ? capacity : 1 ) ),
+      m_mask( static_cast<uint32_t>( m_ring.size() - 1 ) ),
+      m_writeIndex( 0 ),
+      m_droppedEvents( 0 ),
+      m_readIndex( 0 ),
+      m_frameEnd( 0 ),
+      m_droppedEventsSeen( 0 )
+{
+    memset( &m_state, 0, sizeof(m_state) );
+    memset( &m_sample, 0, sizeof(m_sample) );
+}
+
+
+size_t GitHubSample::FrameSampler::ContiguousFreeSlots( const uint32_t writeIndex ) const
+{
+    // the consumer only ever moves m_readIndex forward, so this can only underestimate the room
+    const uint32_t used = writeIndex - LoadAcquire( &m_readIndex );
+    const size_t room = ( m_mask + 1 ) - used;
+    const size_t untilWrap = ( m_mask + 1 ) - ( writeIndex & m_mask );
+    return ( room < untilWrap ) ? room : untilWrap;
+}
+
+
+size_t GitHubSample::FrameSampler::Produce( const EventSourceFunctor& source )
+{
+    size_t total = 0;
+
+    // at most twice: up to the end of the ring, then on from its start
+    for ( int pass = 0; pass < 2; pass++ )
+    {
+        const uint32_t writeIndex = m_writeIndex;
+        const size_t room = ContiguousFreeSlots( writeIndex );
+        if ( room == 0 )
+        {
+            break;
+        }
+
+        const size_t count = source( &m_ring[ writeIndex & m_mask ], room );
+        StoreRelease( &m_writeIndex, static_cast<uint32_t>( writeIndex + count ) );
+        total += count;
+
+        if ( count < room )
+        {
+            break; // the source is empty
+        }
+    }
+
+    return total;
+}
+
+
+size_t GitHubSample::FrameSampler::Publish( const KeyEvent* events, const size_t count )
+{
+    size_t taken = 0;
+
+    while ( taken < count )
+    {
+        const uint32_t writeIndex = m_writeIndex;
+        const size_t room = ContiguousFreeSlots( writeIndex );
+        if ( room == 0 )
+        {
+            break;
+        }
+
+        const size_t chunk = ( count - taken < room ) ? count - taken : room;
+        memcpy( &m_ring[ writeIndex & m_mask ], events + taken, chunk * sizeof(KeyEvent) );
+        StoreRelease( &m_writeIndex, static_cast<uint32_t>( writeIndex + chunk ) );
+        taken += chunk;
+    }
+
+    if ( taken < count )
+    {
+        StoreRelease( &m_droppedEvents, static_cast<uint32_t>( m_droppedEvents + ( count - taken ) ) );
+    }
+
+    return taken;
+}
+
+
+const GitHubSample::FrameSample& GitHubSample::FrameSampler::SampleFrame( const uint64_t frameDeadline )
+{
+    // the previous frame's events go back to the producer
+    StoreRelease( &m_readIndex, m_frameEnd );
+
+    const uint32_t begin = m_frameEnd;
+    const uint32_t available = LoadAcquire( &m_writeIndex ) - begin;
+
+    FrameSample& sample = m_sample;
+    sample.begin = m_state;
+    memset( &sample.pressed, 0, sizeof(sample.pressed) );
+    memset( &sample.released, 0, sizeof(sample.released) );
+
+    uint32_t count = 0;
+    while ( count < available )
+    {
+        const KeyEvent& event = m_ring[ ( begin + count ) & m_mask ];
+        if ( event.timestamp >= frameDeadline )
+        {
+            break;
+        }
+
+        if ( event.usagePage == USAGE_PAGE_KEYBOARD_OR_KEYPAD && event.usage <= 0xFF )
+        {
+            const bool down = ( event.value != 0 );
+            m_state.Set( event.usage, down );
+            if ( down )
+            {
+                sample.pressed.Set( event.usage, true );
+            }
+            else
+            {
+                sample.released.Set( event.usage, true );
+            }
+        }
+
+        count++;
+    }
+
+    const size_t start = begin & m_mask;
+    const size_t untilWrap = ( m_mask + 1 ) - start;
+    const size_t first = ( count < untilWrap ) ? count : untilWrap;
+
+    sample.spans[0].events = &m_ring[ start ];
+    sample.spans[0].count = first;
+    sample.spans[1].events = &m_ring[ 0 ];
+    sample.spans[1].count = count - first;
+    sample.eventCount = count;
+    sample.end = m_state;
+    sample.deadline = frameDeadline;
+
+    const uint32_t dropped = LoadAcquire( &m_droppedEvents );
+    sample.droppedEvents = dropped - m_droppedEventsSeen;
+    m_droppedEventsSeen = dropped;
+
+    m_frameEnd = begin + count;
+    return sample;
+}
+
+
+size_t GitHubSample::FrameSampler::PendingCount() const
+{
+    return LoadAcquire( &m_writeIndex ) - m_frameEnd;
+}
+
+
+void GitHubSample::FrameSampler::LockBuffers( RealtimeThreadConfig& realtime )
+{
+    realtime.LockVector( m_ring );
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::FrameSampler::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) );
+    report.AddHeap( MemoryUsageReport::kEventBuffers, CapacityBytes( m_ring ) );
+    return report;
+}
@@ -0,0 +1,155 @@
+
+#ifndef GITHUBSAMPLE_FRAME_SAMPLER_H
+#define GITHUBSAMPLE_FRAME_SAMPLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "EventReplay.h"
+#include "KeyEvent.h"
+#include "MemoryUsage.h"
+
+
+namespace GitHubSample
+{
+
+    class RealtimeThreadConfig;
+
+    /// Events that are contiguous in memory.  Points into someone else's buffer.
+    struct EventSpan
+    {
+        const KeyEvent* events;
+        size_t count;
+    };
+
+    /// What happened during one frame.  See FrameSampler::SampleFrame.
+    struct FrameSample
+    {
+        /// the frame's events, oldest first: all of spans[0], then all of
+        /// spans[1] (which is empty unless the ring wrapped around)
+        EventSpan spans[ 2 ];
+        size_t eventCount;
+
+        /// kHIDPage_KeyboardOrKeypad state when the frame started and when it ended
+        KeyStateBitmap begin;
+        KeyStateBitmap end;
+        /// keys that went down (or up) at least once during the frame.  a
+        /// key tapped within one frame is in both, and not in 'end'.
+        KeyStateBitmap pressed;
+        KeyStateBitmap released;
+
+        uint64_t deadline;
+        /// events Publish had to drop since the previous frame (the ring was full)
+        uint32_t droppedEvents;
+    };
+
+
+    /**
+       Hands a render loop "everything since the last frame, and the key
+       state at both ends of it" in one call, without locks and without
+       copying events.
+
+       The reader thread puts events into a single-producer single-consumer
+       ring: Produce lets ReadEventsFromQueue write straight into the ring,
+       Publish copies from anywhere else.  The render thread calls
+       SampleFrame once per frame.  It takes the events stamped before the
+       frame's deadline, walks them once to update the key state, and
+       returns spans that point into the ring.  Events stamped at or after
+       the deadline stay for the next frame.  The frame's events stay
+       valid, and untouched by the producer, until the next SampleFrame.
+
+       Neither side ever waits for the other.  The producer learns how much
+       room there is from one acquire load, the consumer how many events
+       there are from another.  An event is visible to the render thread as
+       soon as Produce (or Publish) returns.
+
+       This replaces draining the queue AND calling
+       CountOfCurrentlyDepressedKeys on the render thread: seed the state
+       once with SetKeyState (from SnapshotPressedKeys) and the bitmaps
+       follow the events from then on.
+
+       The deadline is in the units of KeyEvent::timestamp, and the events
+       must come in timestamp order (one reader, or the output of a
+       TimestampMerger).
+     */
+    class FrameSampler
+    {
+    public:
+
+        /// 'capacity' is rounded up to a power of two.  It must hold every event of the longest frame.
+        explicit FrameSampler( size_t capacity = 4096 );
+
+        // -- producer (reader thread) --
+
+        /// Lets 'source' (e.g. a bound ReadEventsFromQueue) write into the
+        /// free part of the ring, and publishes what it wrote.  Never drops:
+        /// what does not fit stays in the source.  Returns how many.
+        size_t Produce( const EventSourceFunctor& source );
+
+        /// Copies 'events' in.  What does not fit is dropped and reported
+        /// in the next FrameSample.  Returns how many were taken.
+        size_t Publish( const KeyEvent* events, size_t count );
+
+        // -- consumer (render thread) --
+
+        /// The key state the next frame begins with.
+        void SetKeyState( const KeyStateBitmap& state ) { m_state = state; }
+
+        /**
+           Releases the previous frame's events back to the producer, and
+           returns the events stamped before 'frameDeadline' with the key
+           state before and after them.  The sample, and the events it
+           points to, stay valid until the next call.
+         */
+        const FrameSample& SampleFrame( uint64_t frameDeadline );
+
+        /// events in the ring that no frame has taken yet.  a snapshot; the producer may be adding more.
+        size_t PendingCount() const;
+
+        size_t Capacity() const { return m_mask + 1; }
+
+        /// Hands the ring to 'realtime' to be prefaulted and mlocked.  This object must outlive it.
+        void LockBuffers( RealtimeThreadConfig& realtime );
+
+        MemoryUsageReport MemoryUsage() const;
+
+    private:
+
+        enum
+        {
+            /// keeps the indices the two threads write on cache lines of their own
+            kCacheLineSize = 64
+        };
+
+        std::vector< KeyEvent > m_ring;
+        uint32_t m_mask;
+
+        char m_padding0[ kCacheLineSize ];
+
+        /// written by the producer only.  counts up forever (and wraps); the slot is 'index & m_mask'.
+        volatile uint32_t m_writeIndex;
+        volatile uint32_t m_droppedEvents;
+
+        char m_padding1[ kCacheLineSize ];
+
+        /// written by the consumer only: where the current frame's events begin
+        volatile uint32_t m_readIndex;
+        /// consumer side only
+        uint32_t m_frameEnd;
+        uint32_t m_droppedEventsSeen;
+        KeyStateBitmap m_state;
+        FrameSample m_sample;
+
+        /// producer side: the contiguous free slots from m_writeIndex on
+        size_t ContiguousFreeSlots( uint32_t writeIndex ) const;
+
+        /// declared private so as to make this class non-copyable
+        FrameSampler(const FrameSampler&);
+        /// declared private so as to make this class non-copyable
+        FrameSampler& operator=(const FrameSampler&);
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_FRAME_SAMPLER_H
@@ -1,13 +1,18 @@
 
 
 #include "HelperForKeyboardReaderIOKit.h"
+#include "ErrorLogging.h"
+#include "KeyboardLayoutDatabase.h"
+#include "RealtimeThreadConfig.h"
 
 #define wxLogDebug(...)
 
 #include <boost/format.hpp>
+#include <boost/make_shared.hpp>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sysexits.h>
 #include <mach/mach_error.h>
 
@@ -20,101 +25,206 @@
 
 namespace
 {
-    void LogErrorWhenFunctorIsntEmpty
-    (
-     boost::function< void ( const std::string msg ) > errorLoggerFunctor,
-     const std::string error
-    )
+    /// how many events the IOHID queue holds before it drops the oldest.  a
+    /// mouse at 8 kHz reports X and Y 8,000 times a second (and a gamepad
+    /// half a dozen axes at 1 kHz), so their queues have to cover far more
+    /// than a keyboard's between two drains.
+    const uint32_t KEYBOARD_QUEUE_DEPTH = 200;
+    const uint32_t POINTER_QUEUE_DEPTH  = 4096;
+
+    /// axes of tablets and joysticks are positions; only deltas can be added up
+    bool IsRelativeElement( CFDictionaryRef element )
+    {
+        CFTypeRef isRelative = CFDictionaryGetValue(element, CFSTR(kIOHIDElementIsRelativeKey));
+
+        return isRelative != 0
+            && CFGetTypeID(isRelative) == CFBooleanGetTypeID()
+            && CFBooleanGetValue((CFBooleanRef) isRelative);
+    }
+
+    /// zero when the element has no such (numeric) key
+    int32_t ElementNumber( CFDictionaryRef element, CFStringRef key )
     {
-        if( errorLoggerFunctor.empty() == false )
+        CFTypeRef object = CFDictionaryGetValue(element, key);
+        long value = 0;
+
+        if ( object == 0
+             || CFGetTypeID(object) != CFNumberGetTypeID()
+             || ! CFNumberGetValue((CFNumberRef) object, kCFNumberLongType, &value) )
         {
-            errorLoggerFunctor( error );
+            return 0; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
         }
+
+        return static_cast<int32_t>( value );
     }
 
-    std::string CF2StdString ( CFStringRef cf_str )
+    /// the first HID device whose primary usage is kHIDUsage_GD_SystemControl.  zero when there is none.
+    io_service_t SystemControlService()
     {
-        std::string result;
-
-        if (cf_str)
+        CFMutableDictionaryRef matchingDictRef = IOServiceMatching(kIOHIDDeviceKey);
+        if ( ! matchingDictRef )
         {
-            static const CFStringEncoding encoding = kCFStringEncodingUTF8;
-            const CFIndex max_utf8_str_len = CFStringGetMaximumSizeForEncoding
-                ( CFStringGetLength (cf_str), encoding );
+            return (io_service_t)0; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+        }
 
-            if ( max_utf8_str_len > 0 )
-            {
-                result.resize(max_utf8_str_len);
+        UInt32 usagePage = kHIDPage_GenericDesktop;
+        UInt32 usage = kHIDUsage_GD_SystemControl;
+        CFNumberRef usagePageRef = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &usagePage);
+        CFNumberRef usageRef = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &usage);
 
-                if (CFStringGetCString (cf_str, &result[0], result.size(), encoding))
-                {
-                    result.resize(strlen(result.c_str()));
-                }
-            }
+        io_service_t result = (io_service_t)0;
+        if ( usagePageRef && usageRef )
+        {
+            CFDictionarySetValue(matchingDictRef, CFSTR(kIOHIDPrimaryUsagePageKey), usagePageRef);
+            CFDictionarySetValue(matchingDictRef, CFSTR(kIOHIDPrimaryUsageKey), usageRef);
+            result = IOServiceGetMatchingService(kIOMasterPortDefault, matchingDictRef);
+        }
+        else
+        {
+            CFRelease(matchingDictRef);
+        }
+
+        if (usageRef)
+        {
+            CFRelease(usageRef);
+        }
+        if (usagePageRef)
+        {
+            CFRelease(usagePageRef);
         }
 
         return result;
     }
 
+    /// a SelectionRule field: kMatchAny when the keyboard did not report the property, or it does not fit
+    uint16_t LayoutMatchField( const GitHubSample::DevicePropertyStore& properties, const GitHubSample::DevicePropertyStore::Property property )
+    {
+        const int64_t value = properties.Number( property );
+
+        return ( properties.Has( property ) && value >= 0 && value < GitHubSample::KeyboardLayoutDatabase::kMatchAny )
+            ? static_cast<uint16_t>( value ) : static_cast<uint16_t>( GitHubSample::KeyboardLayoutDatabase::kMatchAny );
+    }
 }
 
 
 
 /// a simple 'tuple' that contains the following items corresponding to ONE KEY on the keyboard:
 ///     a human-readable name, a usage-id, the mac cookie, and an ignore/utilize app-specific preference
+///
+/// 'excludedFromKeyCount' keys (the modifiers) are still delivered through the
+/// queue, but CountOfCurrentlyDepressedKeys does not count them.
+///
+/// Trivially destructible on purpose: the names are string literals, and the
+/// whole table lives inside PrivateImpl (see there).
 struct GitHubSample::HelperForKeyboardReaderIOKit::PerKeyData
 {
-    PerKeyData( const std::string& keyName,
-                const unsigned int usageId,
-                const IOHIDElementCookie cookie,
-                const bool ignore = false )
-        : name( keyName ),
-          usbOfficialUsageID( usageId ),
-          macCookieValue( cookie ),
-          mustBeIgnoredByOurApplication( ignore )
-    {}
-
-    std::string name;
+    const char* name;
     unsigned int usbOfficialUsageID;
     IOHIDElementCookie macCookieValue;
     bool mustBeIgnoredByOurApplication;
+    bool excludedFromKeyCount;
+
+    bool IsCounted() const
+    {
+        return macCookieValue != 0 && mustBeIgnoredByOurApplication == false && excludedFromKeyCount == false;
+    }
 
-    /// simple helper function used for the initial population of a vector of PerKeyData structs
+    /// simple helper function used for the initial population of the table of PerKeyData structs
     static void PushOneItem
     (
-     std::vector< boost::shared_ptr<GitHubSample::HelperForKeyboardReaderIOKit::PerKeyData> >& keysVector,
-     const std::string& keyName,
+     GitHubSample::HelperForKeyboardReaderIOKit::PrivateImpl& impl,
+     const char* keyName,
      const unsigned int usageId,
      const IOHIDElementCookie cookie,
-     const bool ignore = false
-    )
-    {
-        boost::shared_ptr< GitHubSample::HelperForKeyboardReaderIOKit::PerKeyData > ptr
-            ( new GitHubSample::HelperForKeyboardReaderIOKit::PerKeyData( keyName, usageId, cookie, ignore ) );
-        keysVector.push_back( ptr );
-    }
+     const bool ignore = false,
+     const bool excludeFromCount = false
+    );
 };
 
 
-/// Using the pimpl idiom so that IOKit headers don't have to be 'pound-included' in 'HelperForKeyboardReaderIOKit.h'
+/**
+   Using the pimpl idiom so that IOKit headers don't have to be 'pound-included' in 'HelperForKeyboardReaderIOKit.h'
+
+   It is also the reader's ARENA: the key table and the poll list are
+   fixed-size arrays in here (every element trivially destructible), and
+   the whole struct comes from one make_shared, so opening and closing a
+   keyboard (hotplug) costs a handful of allocations instead of hundreds.
+*/
 struct GitHubSample::HelperForKeyboardReaderIOKit::PrivateImpl
 {
+    enum
+    {
+        /// the table is indexed by usage id, up to and including kHIDUsage_KeyboardRightGUI
+        kKeyCount = kHIDUsage_KeyboardRightGUI + 1
+    };
+
     io_object_t            m_hidDevice;
     IOHIDDeviceInterface** m_hidDeviceInterface;
     IOCFPlugInInterface**  m_plugInInterface;
     IOHIDQueueInterface**  m_hidQueue;
 
+    PerKeyData m_keys[ kKeyCount ];
+    size_t m_keyCount;
+
+    /// the keys SnapshotPressedKeys reads, flattened out of m_keys so that a poll touches one array
+    struct PolledKey
+    {
+        IOHIDElementCookie cookie;
+        unsigned int usage;
+    };
+    PolledKey m_polledKeys[ kKeyCount ];
+    size_t m_polledKeyCount;
+
+    /// what PopulateVectorOfKeyInfo decided, for when there is no KeyMaskPublisher
+    KeyInterestMasks m_defaultMasks;
+    /// the keys that are on m_hidQueue right now, and the mask generation they match
+    KeyStateBitmap m_subscribed;
+    uint64_t m_appliedGeneration;
+
     PrivateImpl()
         : m_hidDevice( (io_object_t)0 ),
           m_hidDeviceInterface(NULL),
           m_plugInInterface(NULL),
-          m_hidQueue(NULL)
-    {}
+          m_hidQueue(NULL),
+          m_keyCount( 0 ),
+          m_polledKeyCount( 0 ),
+          m_appliedGeneration( 0 )
+    {
+        memset( m_keys, 0, sizeof(m_keys) );
+        memset( m_polledKeys, 0, sizeof(m_polledKeys) );
+        memset( &m_defaultMasks, 0, sizeof(m_defaultMasks) );
+        memset( &m_subscribed, 0, sizeof(m_subscribed) );
+    }
 
     ~PrivateImpl();
 };
 
 
+void GitHubSample::HelperForKeyboardReaderIOKit::PerKeyData::PushOneItem
+(
+ GitHubSample::HelperForKeyboardReaderIOKit::PrivateImpl& impl,
+ const char* keyName,
+ const unsigned int usageId,
+ const IOHIDElementCookie cookie,
+ const bool ignore,
+ const bool excludeFromCount
+)
+{
+    if ( impl.m_keyCount >= PrivateImpl::kKeyCount )
+    {
+        assert( ! "more keys than PrivateImpl::kKeyCount" );
+        return; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    PerKeyData& key = impl.m_keys[ impl.m_keyCount++ ];
+    key.name = keyName;
+    key.usbOfficialUsageID = usageId;
+    key.macCookieValue = cookie;
+    key.mustBeIgnoredByOurApplication = ignore;
+    key.excludedFromKeyCount = excludeFromCount;
+}
+
+
 GitHubSample::HelperForKeyboardReaderIOKit::PrivateImpl::~PrivateImpl()
 {
     /*
@@ -166,11 +276,17 @@ GitHubSample::HelperForKeyboardReaderIOKit::PrivateImpl::~PrivateImpl()
 GitHubSample::HelperForKeyboardReaderIOKit::HelperForKeyboardReaderIOKit
 (
  const bool enableQueue,
- boost::function< void ( const std::string msg ) > errorLoggerFunctor
+ boost::function< void ( const std::string msg ) > errorLoggerFunctor,
+ boost::shared_ptr< const KeyboardLayoutDatabase > layoutDatabase,
+ const DeviceKind deviceKind
 )
-    : m_pimpl( new PrivateImpl ),
+    : m_pimpl( boost::make_shared< PrivateImpl >() ),
       m_errorLoggerFunctor( errorLoggerFunctor ),
-      m_queueEnabled( enableQueue )
+      m_queueEnabled( enableQueue ),
+      m_deviceKind( deviceKind ),
+      m_layoutDatabase( layoutDatabase ),
+      m_layout( NULL ),
+      m_deviceIndex( 0 )
 {
     Initialize();
 }
@@ -183,7 +299,7 @@ void GitHubSample::HelperForKeyboardReaderIOKit::Initialize()
     if ( FindKeyboard()
          && CreatePluginInterface()
          && CreateDeviceInterface()
-         && PopulateVectorOfKeyInfo()
+         && ( m_deviceKind != kKeyboardDevice || PopulateVectorOfKeyInfo() )
          && FindKeypressCookies()
 
     )
@@ -214,22 +330,30 @@ void GitHubSample::HelperForKeyboardReaderIOKit::Initialize()
 
 void GitHubSample::HelperForKeyboardReaderIOKit::LogInitializationError( const std::string& errorDesc ) const
 {
-    std::string keyboardInfo;
-    std::vector< std::string >::const_iterator iter = m_deviceInformationProperties.begin();
-    while ( iter != m_deviceInformationProperties.end() )
+    // the only place that needs ALL the properties, and only ever on failure
+    std::string deviceInformation = m_properties.Describe();
+
+    if ( m_layout )
     {
-        keyboardInfo += (*iter);
-        keyboardInfo += "\n";
-        iter++;
+        const uint16_t countryCode = LayoutMatchField( m_properties, DevicePropertyStore::kCountryCode );
+
+        deviceInformation += "Keyboard layout: ";
+        deviceInformation += m_layout->Name();
+        deviceInformation += " (country code means: ";
+        deviceInformation += ( countryCode != KeyboardLayoutDatabase::kMatchAny )
+            ? KeyboardLayoutDatabase::CountryCodeName( countryCode ) : "not reported";
+        deviceInformation += ")\n";
     }
 
-    if ( m_deviceInformationProperties.empty() )
+    std::string keyboardInfo;
+
+    if ( deviceInformation.empty() )
     {
         keyboardInfo = errorDesc;
     }
     else
     {
-        keyboardInfo = errorDesc + " Keyboard description follows:\n" + keyboardInfo;
+        keyboardInfo = errorDesc + " Keyboard description follows:\n" + deviceInformation;
     }
 
     LogErrorWhenFunctorIsntEmpty( m_errorLoggerFunctor, keyboardInfo );
@@ -238,24 +362,28 @@ void GitHubSample::HelperForKeyboardReaderIOKit::LogInitializationError( const s
 // Note: we return a NEGATIVE value to indicate error.
 int GitHubSample::HelperForKeyboardReaderIOKit::CountOfCurrentlyDepressedKeys() const
 {
-    if ( ! m_pimpl )
+    if ( ! m_pimpl || m_deviceKind != kKeyboardDevice )
     {
+        // a pointer or a controller has no key table to count from
         return -1; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
     }
 
     DebugCheckErrorKeys();
 
+    KeyInterestMasks masks;
+    CurrentMasks( masks, 0 );
+
     int score = 0;
-    std::vector< boost::shared_ptr<PerKeyData> >::const_iterator iter = m_keys.begin();
-    while( iter != m_keys.end() )
+    const PerKeyData* iter = m_pimpl->m_keys;
+    while( iter != m_pimpl->m_keys + m_pimpl->m_keyCount )
     {
-        if( (*iter)->macCookieValue != 0 && (*iter)->mustBeIgnoredByOurApplication == false )
+        if( iter->macCookieValue != 0 && masks.counted.IsPressed( iter->usbOfficialUsageID ) )
         {
             IOHIDEventStruct theEvent;
 
             IOReturn ioReturnValue = (*m_pimpl->m_hidDeviceInterface)->getElementValue
                 (m_pimpl->m_hidDeviceInterface,
-                 (*iter)->macCookieValue,
+                 iter->macCookieValue,
                  &theEvent);
 
             if (ioReturnValue != kIOReturnSuccess)
@@ -278,14 +406,70 @@ int GitHubSample::HelperForKeyboardReaderIOKit::CountOfCurrentlyDepressedKeys()
 }
 
 
+bool GitHubSample::HelperForKeyboardReaderIOKit::SnapshotPressedKeys( KeyStateBitmap& pressed ) const
+{
+    memset( pressed.words, 0, sizeof(pressed.words) );
+
+    if ( ! m_pimpl )
+    {
+        return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    IOHIDDeviceInterface** deviceInterface = m_pimpl->m_hidDeviceInterface;
+    const PrivateImpl::PolledKey* keys = m_pimpl->m_polledKeys;
+    bool success = true;
+
+    KeyInterestMasks masks;
+    CurrentMasks( masks, 0 );
+
+    for ( size_t i = 0; i < m_pimpl->m_polledKeyCount; i++ )
+    {
+        if ( ! masks.delivered.IsPressed( keys[ i ].usage ) )
+        {
+            continue;
+        }
+
+        IOHIDEventStruct theEvent;
+
+        IOReturn ioReturnValue = (*deviceInterface)->getElementValue
+            (deviceInterface,
+             keys[ i ].cookie,
+             &theEvent);
+
+        if (ioReturnValue != kIOReturnSuccess)
+        {
+            success = false;
+            continue;
+        }
+
+        const unsigned int usage = keys[ i ].usage;
+        pressed.words[ usage >> 5 ] |= static_cast<uint32_t>( theEvent.value != 0 ) << ( usage & 31 );
+    }
+
+    if ( ! success )
+    {
+        memset( pressed.words, 0, sizeof(pressed.words) );
+        LogErrorWhenFunctorIsntEmpty( m_errorLoggerFunctor, "getElementValue failed while taking a key snapshot." );
+    }
+
+    return success;
+}
+
+
 void GitHubSample::HelperForKeyboardReaderIOKit::DebugCheckErrorKeys() const
 {
 #ifdef _DEBUG
 
+    // only a keyboard has the error keys, and only a full key table reaches up to kHIDUsage_KeyboardPower
+    if ( m_deviceKind != kKeyboardDevice || m_pimpl->m_keyCount <= kHIDUsage_KeyboardPower )
+    {
+        return; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
     IOHIDEventStruct theEvent;
     IOReturn ioReturnValue = (*m_pimpl->m_hidDeviceInterface)->getElementValue
         (m_pimpl->m_hidDeviceInterface,
-         (m_keys[kHIDUsage_KeyboardErrorRollOver])->macCookieValue,
+         m_pimpl->m_keys[kHIDUsage_KeyboardErrorRollOver].macCookieValue,
          &theEvent);
 
     if (ioReturnValue == kIOReturnSuccess)
@@ -298,7 +482,7 @@ void GitHubSample::HelperForKeyboardReaderIOKit::DebugCheckErrorKeys() const
 
     ioReturnValue = (*m_pimpl->m_hidDeviceInterface)->getElementValue
         (m_pimpl->m_hidDeviceInterface,
-         (m_keys[kHIDUsage_KeyboardPOSTFail])->macCookieValue,
+         m_pimpl->m_keys[kHIDUsage_KeyboardPOSTFail].macCookieValue,
          &theEvent);
 
     if (ioReturnValue == kIOReturnSuccess)
@@ -311,7 +495,7 @@ void GitHubSample::HelperForKeyboardReaderIOKit::DebugCheckErrorKeys() const
 
     ioReturnValue = (*m_pimpl->m_hidDeviceInterface)->getElementValue
         (m_pimpl->m_hidDeviceInterface,
-         (m_keys[kHIDUsage_KeyboardErrorUndefined])->macCookieValue,
+         m_pimpl->m_keys[kHIDUsage_KeyboardErrorUndefined].macCookieValue,
          &theEvent);
 
     if (ioReturnValue == kIOReturnSuccess)
@@ -324,7 +508,7 @@ void GitHubSample::HelperForKeyboardReaderIOKit::DebugCheckErrorKeys() const
 
     ioReturnValue = (*m_pimpl->m_hidDeviceInterface)->getElementValue
         (m_pimpl->m_hidDeviceInterface,
-         (m_keys[kHIDUsage_KeyboardPower])->macCookieValue,
+         m_pimpl->m_keys[kHIDUsage_KeyboardPower].macCookieValue,
          &theEvent);
 
     if (ioReturnValue == kIOReturnSuccess)
@@ -410,7 +594,7 @@ void GitHubSample::HelperForKeyboardReaderIOKit::ReadFromQueue_Experimental()
                 msg = "KEY RELEASE " + msg;
             }
 
-            // TODO - we could use m_keys to locate the elementCookie and get the 'name' string from the PerKeyData struct
+            // TODO - we could use m_pimpl->m_keys to locate the elementCookie and get the 'name' string from the PerKeyData struct
         }
     }
 
@@ -427,6 +611,78 @@ void GitHubSample::HelperForKeyboardReaderIOKit::ReadFromQueue_Experimental()
 }
 
 
+size_t GitHubSample::HelperForKeyboardReaderIOKit::ReadEventsFromQueue
+(
+ KeyEvent* events,
+ const size_t capacity
+)
+{
+    if ( (! m_pimpl) || (! m_pimpl->m_hidQueue) )
+    {
+        return 0; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    IOReturn ioReturnValue = kIOReturnSuccess;
+    AbsoluteTime zeroTime = {0, 0};
+    IOHIDEventStruct the_event;
+    size_t count = 0;
+
+    // keys can leave the mask before ReconcileQueueSubscriptions takes them off the queue
+    KeyInterestMasks masks;
+    CurrentMasks( masks, 0 );
+
+    // check 'count' FIRST, so that we never dequeue an event we have no room for
+    while( count < capacity
+           && kIOReturnSuccess ==
+           (ioReturnValue = (*(IOHIDQueueInterface**) m_pimpl->m_hidQueue)->
+            getNextEvent( m_pimpl->m_hidQueue,
+                          &the_event,
+                          zeroTime,
+                          0
+                          ))
+           )
+    {
+        // the registry keeps the latest value of every element, delivered or not
+        KeyEvent& keyEvent = events[ count ];
+        if ( ! m_usages.Decode( static_cast<uint32_t>( the_event.elementCookie ), the_event.value, keyEvent ) )
+        {
+            wxLogDebug( wxT("dropping an event for a cookie we never asked for") );
+            continue;
+        }
+
+        if ( keyEvent.usagePage == kHIDPage_KeyboardOrKeypad )
+        {
+            // the masks cover usages 0 - 0xFF
+            if ( the_event.type != kIOHIDElementTypeInput_Button || keyEvent.usage > 0xFF || ! masks.delivered.IsPressed( keyEvent.usage ) )
+            {
+                continue;
+            }
+        }
+        else if ( the_event.type != kIOHIDElementTypeInput_Button
+                  && the_event.type != kIOHIDElementTypeInput_Misc
+                  && the_event.type != kIOHIDElementTypeInput_Axis )
+        {
+            // consumer controls are buttons or one-bit 'misc' elements, depending on the
+            // descriptor.  pointer axes are 'misc' or 'axis', and their value is the delta.
+            continue;
+        }
+
+        keyEvent.timestamp = ( static_cast<uint64_t>( the_event.timestamp.hi ) << 32 ) | the_event.timestamp.lo;
+        keyEvent.deviceIndex = m_deviceIndex;
+        keyEvent.flags = 0;
+        count++;
+    }
+
+    if ( ioReturnValue != kIOReturnUnderrun && ioReturnValue != kIOReturnSuccess )
+    {
+        std::string msg = boost::str( boost::format("getNextEvent failed. code: %1%") % (int)ioReturnValue );
+        LogErrorWhenFunctorIsntEmpty( m_errorLoggerFunctor, msg );
+    }
+
+    return count;
+}
+
+
 /// Credit goes to Amit Singh.  http://osxbook.com/book/bonus/chapter10/kbdleds/
 bool GitHubSample::HelperForKeyboardReaderIOKit::FindKeyboard()
 {
@@ -488,13 +744,24 @@ bool GitHubSample::HelperForKeyboardReaderIOKit::FindKeyboard()
     CFNumberRef usageRef = (CFNumberRef)0;
     UInt32 usagePage = kHIDPage_GenericDesktop;
     UInt32 usage = kHIDUsage_GD_Keyboard;
+    switch ( m_deviceKind )
+    {
+    case kPointerDevice:  usage = kHIDUsage_GD_Mouse;    break;
+    case kGamepadDevice:  usage = kHIDUsage_GD_GamePad;  break;
+    case kJoystickDevice: usage = kHIDUsage_GD_Joystick; break;
+    case kConsumerControlDevice:
+        usagePage = kHIDPage_Consumer;
+        usage = kHIDUsage_Csmr_ConsumerControl;
+        break;
+    default:                                             break;
+    }
 
     usagePageRef = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &usagePage);
     usageRef = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &usage);
 
     if ( (!usagePageRef) || (!usageRef) )
     {
-        LogErrorWhenFunctorIsntEmpty( m_errorLoggerFunctor, "Failed to find kHIDPage_GenericDesktop and/or kHIDUsage_GD_Keyboard." );
+        LogErrorWhenFunctorIsntEmpty( m_errorLoggerFunctor, "Failed to find kHIDPage_GenericDesktop and/or the kHIDUsage_GD_* of the device kind." );
     }
     else
     {
@@ -534,6 +801,13 @@ bool GitHubSample::HelperForKeyboardReaderIOKit::FindKeyboard()
         CFRelease(usagePageRef);
     }
 
+    // power, sleep and wake come on their own interface when the device has no consumer controls.
+    // IOServiceGetMatchingService consumed the dictionary, so it takes a second one.
+    if ( result == 0 && m_deviceKind == kConsumerControlDevice )
+    {
+        result = SystemControlService();
+    }
+
     m_pimpl->m_hidDevice = result;
     return (result != 0);
 }
@@ -583,15 +857,14 @@ bool GitHubSample::HelperForKeyboardReaderIOKit::CreatePluginInterface()
     }
     else
     {
-        // we only use the keyboard properties as 'extra info', so we don't care
-        // if getting properties succeeds or not.
-
-        // Even though we use IORegistryEntryCreateCFProperty to get the
+        // the properties are only fetched when somebody reads them, but
+        // even though we use IORegistryEntryCreateCFProperty to get the
         // properties, and even though IORegistryEntryCreateCFProperty *only*
         // needs our 'io_object_t' (m_hidDevice), for some CRAZY reason we
         // cannot get any properties until our IOCFPlugInInterface
         // (m_plugInInterface) is created!
-        GetKeyboardProperties();
+        m_properties.SetFetchFunctor( boost::bind( &HelperForKeyboardReaderIOKit::FetchDeviceProperty, this, _1 ) );
+        SelectKeyboardLayout();
     }
 
     return (ioReturnValue==kIOReturnSuccess);
@@ -599,73 +872,42 @@ bool GitHubSample::HelperForKeyboardReaderIOKit::CreatePluginInterface()
 
 
 /**
-   We only use the properties as 'extra info', so we don't care if this fails.
-
-   Also: Even though we use IORegistryEntryCreateCFProperty to get the
-   properties, and even though IORegistryEntryCreateCFProperty *only* needs our
-   'io_object_t' (m_hidDevice), for some CRAZY reason we cannot get any
-   properties until our IOCFPlugInInterface (m_plugInInterface) is created!
+   The DevicePropertyStore's way into the registry.  NULL once the device
+   is gone (after a failed initialization), so a late read finds nothing
+   instead of asking a released io_object_t.
 */
-void GitHubSample::HelperForKeyboardReaderIOKit::GetKeyboardProperties()
-{
-    StoreOneProperty( CFSTR( kIOHIDTransportKey ) );
-    StoreOneProperty( CFSTR( kIOHIDVendorIDKey ) );
-    StoreOneProperty( CFSTR( kIOHIDVendorIDSourceKey ) );
-    StoreOneProperty( CFSTR( kIOHIDProductIDKey ) );
-    StoreOneProperty( CFSTR( kIOHIDVersionNumberKey ) );
-    StoreOneProperty( CFSTR( kIOHIDManufacturerKey ) );
-    StoreOneProperty( CFSTR( kIOHIDProductKey ) );
-    StoreOneProperty( CFSTR( kIOHIDSerialNumberKey ) );
-    StoreOneProperty( CFSTR( kIOHIDCountryCodeKey ) );
-    StoreOneProperty( CFSTR( kIOHIDLocationIDKey ) );
-}
-
-
-void GitHubSample::HelperForKeyboardReaderIOKit::StoreOneProperty
-(
- CFStringRef propertyKey
-)
+CFTypeRef GitHubSample::HelperForKeyboardReaderIOKit::FetchDeviceProperty( CFStringRef propertyKey ) const
 {
-    CFTypeRef propertyValueString;
+    if ( ! m_pimpl || ! m_pimpl->m_hidDevice )
+    {
+        return NULL; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
 
-    propertyValueString = IORegistryEntryCreateCFProperty
+    return IORegistryEntryCreateCFProperty
         ( m_pimpl->m_hidDevice,
           propertyKey,
           kCFAllocatorDefault,0);
+}
 
-    if (  !  propertyValueString)
-    {
-        wxLogDebug( wxT("didn't get property") );
-    }
-    else
-    {
-        std::string property = CF2StdString( propertyKey );
-        std::string asStdString = "<unknown>";
-
-        if ( CFGetTypeID(propertyValueString) == CFNumberGetTypeID() )
-        {
-            long value = 0;
-            CFNumberGetValue((CFNumberRef) propertyValueString, kCFNumberLongType, &value);
-            asStdString = boost::str( boost::format("%1%") % value );
-        }
-        else if ( CFGetTypeID(propertyValueString) == CFStringGetTypeID() )
-        {
-            asStdString = CF2StdString( (CFStringRef) propertyValueString );
-        }
-        else
-        {
-            asStdString = "<type error>";
-        }
 
-        m_deviceInformationProperties.push_back( property + ": " + asStdString );
-    }
-
-    if(propertyValueString)
+/**
+   Picks this keyboard's layout out of m_layoutDatabase.  The vendor and
+   product ids take part so that the database can carry quirk rules for
+   keyboards that report a wrong (or zero, "not supported") country code.
+*/
+void GitHubSample::HelperForKeyboardReaderIOKit::SelectKeyboardLayout()
+{
+    if ( ! m_layoutDatabase || m_deviceKind != kKeyboardDevice )
     {
-        CFRelease(propertyValueString);
+        return; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
     }
-}
 
+    // anything the keyboard did not report (or that does not fit) becomes a wildcard.  a reported
+    // country code of zero is a real answer ("not localized"), not a missing one.
+    m_layout = m_layoutDatabase->SelectLayout( LayoutMatchField( m_properties, DevicePropertyStore::kCountryCode ),
+                                               LayoutMatchField( m_properties, DevicePropertyStore::kVendorId ),
+                                               LayoutMatchField( m_properties, DevicePropertyStore::kProductId ) );
+}
 
 
 bool GitHubSample::HelperForKeyboardReaderIOKit::CreateDeviceInterface()
@@ -745,6 +987,9 @@ bool GitHubSample::HelperForKeyboardReaderIOKit::FindKeypressCookies()
     }
     else
     {
+        // one allocation per registry table, however many elements the device has
+        m_usages.Reserve( static_cast<size_t>( CFArrayGetCount(elements) ) );
+
         for (CFIndex i = 0; i < CFArrayGetCount(elements); i++)
         {
             // these THREE variables are 'helpers' ....
@@ -801,53 +1046,127 @@ bool GitHubSample::HelperForKeyboardReaderIOKit::FindKeypressCookies()
             // Yay! After all that conversion crud, we now have the usage id!
             usagePage = temp_number_reused;
 
+            if ( usage < 0 || usage > 0xFFFF || usagePage < 0 || usagePage > 0xFFFF )
+            {
+                wxLogDebug( wxT("A usage id or usage page that does not fit in 16 bits?") );
+                continue;
+            }
+
+            const uint8_t reportId = static_cast<uint8_t>( ElementNumber( element, CFSTR(kIOHIDElementReportIDKey) ) );
+
             if (usagePage == kHIDPage_KeyboardOrKeypad)
             {
-                if ( usage >= static_cast<long>(m_keys.size()) )
-                {
-                    // there are quite a few that are higher than we care about.
-                    //wxLogDebug(wxT("some usage key of a higher value than we care about was found.") );
-                }
-                else if ( usage < 0 )
-                {
-                    wxLogDebug( wxT("A negative valued usage id?") );
-                }
-                else
+                // the key table only covers the usages we have names and defaults for; the registry takes any of them
+                if ( usage < static_cast<long>(m_pimpl->m_keyCount) )
                 {
-                    if( m_keys[ usage ]->macCookieValue != 0 )
+                    if( m_pimpl->m_keys[ usage ].macCookieValue != 0 )
                     {
                         // I have so far never seen this happen...
                         assert( ! "we found the same usage key twice (or more) ?" );
                     }
                     else
                     {
-                        m_keys[ usage ]->macCookieValue = cookie;
+                        m_pimpl->m_keys[ usage ].macCookieValue = cookie;
                     }
                 }
+
+                m_usages.Add( kHIDPage_KeyboardOrKeypad, static_cast<uint16_t>( usage ), static_cast<uint32_t>( cookie ), reportId );
+            }
+            else
+            {
+                // LEDs, feature reports and collections have cookies too, but nothing ever comes from them on the queue
+                const long type = ElementNumber( element, CFSTR(kIOHIDElementTypeKey) );
+                if ( type != kIOHIDElementTypeInput_Button
+                     && type != kIOHIDElementTypeInput_Misc
+                     && type != kIOHIDElementTypeInput_Axis )
+                {
+                    continue;
+                }
+
+                const bool isAxis = ( usagePage == kHIDPage_GenericDesktop && usage >= kHIDUsage_GD_X && usage < kHIDUsage_GD_SystemControl );
+                const bool isController = ( m_deviceKind == kGamepadDevice || m_deviceKind == kJoystickDevice );
+
+                // pointers move (deltas), sticks are somewhere (positions)
+                if ( isAxis && IsRelativeElement( element ) == isController )
+                {
+                    wxLogDebug( wxT("skipping an axis of the wrong kind") );
+                    continue;
+                }
+
+                // media keys, volume, power and sleep; buttons and axes; vendor pages.  a usage that is
+                // listed in several reports gets one element per report id.
+                const unsigned int index =
+                    m_usages.Add( static_cast<uint16_t>( usagePage ), static_cast<uint16_t>( usage ), static_cast<uint32_t>( cookie ), reportId );
+
+                if ( index == UsageRegistry::kNoIndex )
+                {
+                    LogErrorWhenFunctorIsntEmpty( m_errorLoggerFunctor, "Too many elements (or a cookie out of range) for the usage registry." );
+                }
+                else if ( isAxis )
+                {
+                    UsageRegistry::Range range;
+                    range.logicalMin = ElementNumber( element, CFSTR(kIOHIDElementMinKey) );
+                    range.logicalMax = ElementNumber( element, CFSTR(kIOHIDElementMaxKey) );
+                    range.physicalMin = ElementNumber( element, CFSTR(kIOHIDElementScaledMinKey) );
+                    range.physicalMax = ElementNumber( element, CFSTR(kIOHIDElementScaledMaxKey) );
+                    m_usages.SetElementRange( index, range );
+                }
             }
         }
     }
 
     int score = 0;
-    std::vector< boost::shared_ptr<PerKeyData> >::const_iterator iter = m_keys.begin();
-    while( iter != m_keys.end() )
+    m_pimpl->m_polledKeyCount = 0;
+    const PerKeyData* iter = m_pimpl->m_keys;
+    while( iter != m_pimpl->m_keys + m_pimpl->m_keyCount )
     {
-        if( (*iter)->macCookieValue != 0 && (*iter)->mustBeIgnoredByOurApplication == false )
+        if( iter->IsCounted() )
         {
             score++;
-            wxLogDebug( wxT("located cookie for:\t%s"), (*iter)->name.c_str() );
+            wxLogDebug( wxT("located cookie for:\t%s"), iter->name );
+            m_pimpl->m_defaultMasks.counted.Set( iter->usbOfficialUsageID, true );
+        }
+
+        // every real key the keyboard has is a candidate; the masks decide which ones are used
+        if( iter->macCookieValue != 0 && iter->usbOfficialUsageID >= kHIDUsage_KeyboardA )
+        {
+            PrivateImpl::PolledKey& polledKey = m_pimpl->m_polledKeys[ m_pimpl->m_polledKeyCount++ ];
+            polledKey.cookie = iter->macCookieValue;
+            polledKey.usage = iter->usbOfficialUsageID;
+
+            // the same set of keys that AddElementsToQueue puts on the queue
+            m_pimpl->m_defaultMasks.delivered.Set( iter->usbOfficialUsageID, iter->mustBeIgnoredByOurApplication == false );
         }
 
         iter++;
     }
 
-    wxLogDebug( wxT("our vector size is %d and the score is %d"), m_keys.size(), score );
+    wxLogDebug( wxT("our table size is %d and the score is %d"), m_pimpl->m_keyCount, score );
 
     if(elements)
     {
         CFRelease(elements);
     }
 
+    if ( m_deviceKind == kPointerDevice )
+    {
+        // the buttons are optional (think trackpads), the two axes are not
+        return m_usages.IndexOf( kHIDPage_GenericDesktop, kHIDUsage_GD_X ) != UsageRegistry::kNoIndex
+            && m_usages.IndexOf( kHIDPage_GenericDesktop, kHIDUsage_GD_Y ) != UsageRegistry::kNoIndex;
+    }
+
+    if ( m_deviceKind == kGamepadDevice || m_deviceKind == kJoystickDevice )
+    {
+        // some pads are all buttons and a hat, some sticks have no buttons
+        return m_usages.Count() != 0;
+    }
+
+    if ( m_deviceKind == kConsumerControlDevice )
+    {
+        // a remote may have three buttons, a keyboard's media interface forty
+        return m_usages.Count() != 0;
+    }
+
     return (score > 40);// if we don't find at least 40 cookies, we consider our search to have FAILED
 }
 
@@ -877,7 +1196,8 @@ bool GitHubSample::HelperForKeyboardReaderIOKit::CreateQueue()
                  change.
               */
               0, // when i use zero, i appear to ONLY get what matches my cookies. however, to use 1, you apparently need to set at least 1 cookie still, but then you get EVERYTHING.
-              200  // The maximum number of elements in the queue before the oldest elements in the queue begin to be lost.
+              // The maximum number of elements in the queue before the oldest elements in the queue begin to be lost.
+              ( m_deviceKind == kKeyboardDevice || m_deviceKind == kConsumerControlDevice ) ? KEYBOARD_QUEUE_DEPTH : POINTER_QUEUE_DEPTH
             );
 
         if (kIOReturnSuccess != ioReturnValue)
@@ -911,24 +1231,160 @@ bool GitHubSample::HelperForKeyboardReaderIOKit::AddElementsToQueue()
 {
     bool success = true;
 
-    std::vector< boost::shared_ptr<PerKeyData> >::const_iterator iter = m_keys.begin();
-    while( iter != m_keys.end() )
+    const PerKeyData* iter = m_pimpl->m_keys;
+    while( iter != m_pimpl->m_keys + m_pimpl->m_keyCount )
     {
-        if( (*iter)->macCookieValue != 0 && (*iter)->mustBeIgnoredByOurApplication == false )
+        if( iter->macCookieValue != 0 && iter->mustBeIgnoredByOurApplication == false )
         {
             IOReturn ioReturnValue = (*(IOHIDQueueInterface**) m_pimpl->m_hidQueue)->addElement
-                (m_pimpl->m_hidQueue, (*iter)->macCookieValue , 0);
+                (m_pimpl->m_hidQueue, iter->macCookieValue , 0);
 
             if (ioReturnValue != kIOReturnSuccess)
             {
                 assert( ! "failed to add element to the queue" );
                 success = false;
             }
+            else
+            {
+                m_pimpl->m_subscribed.Set( iter->usbOfficialUsageID, true );
+            }
         }
 
         iter++;
     }
 
+    // the keyboard page is done above, with its masks.  the other pages are always on the queue.
+    for ( size_t i = 0; i < m_usages.Count(); i++ )
+    {
+        if ( m_usages.UsagePage( i ) == kHIDPage_KeyboardOrKeypad )
+        {
+            continue;
+        }
+
+        IOReturn ioReturnValue = (*(IOHIDQueueInterface**) m_pimpl->m_hidQueue)->addElement
+            (m_pimpl->m_hidQueue, (IOHIDElementCookie) m_usages.Cookie( i ), 0);
+
+        if (ioReturnValue != kIOReturnSuccess)
+        {
+            std::string msg = boost::str( boost::format("failed to add usage %1% of usage page %2% to the queue. code: %3%")
+                                          % m_usages.Usage( i ) % m_usages.UsagePage( i ) % (int)ioReturnValue );
+            LogErrorWhenFunctorIsntEmpty( m_errorLoggerFunctor, msg );
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+
+GitHubSample::KeyInterestMasks GitHubSample::HelperForKeyboardReaderIOKit::DefaultInterestMasks() const
+{
+    KeyInterestMasks masks;
+    if ( m_pimpl )
+    {
+        masks = m_pimpl->m_defaultMasks;
+    }
+    else
+    {
+        memset( &masks, 0, sizeof(masks) );
+    }
+    return masks;
+}
+
+
+void GitHubSample::HelperForKeyboardReaderIOKit::SetMaskPublisher( boost::shared_ptr< const KeyMaskPublisher > publisher )
+{
+    m_maskPublisher = publisher;
+
+    if ( m_pimpl )
+    {
+        // whatever the new publisher's generation is, it has not been applied yet
+        m_pimpl->m_appliedGeneration = ~static_cast<uint64_t>( 0 );
+    }
+}
+
+
+void GitHubSample::HelperForKeyboardReaderIOKit::CurrentMasks( KeyInterestMasks& masks, uint64_t* generation ) const
+{
+    if ( m_maskPublisher )
+    {
+        m_maskPublisher->Read( masks, generation );
+        return; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    masks = m_pimpl->m_defaultMasks;
+    if ( generation )
+    {
+        *generation = 0;
+    }
+}
+
+
+bool GitHubSample::HelperForKeyboardReaderIOKit::ReconcileQueueSubscriptions()
+{
+    if ( (! m_pimpl) || (! m_pimpl->m_hidQueue) )
+    {
+        return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    KeyInterestMasks masks;
+    uint64_t generation = 0;
+    CurrentMasks( masks, &generation );
+
+    if ( generation == m_pimpl->m_appliedGeneration )
+    {
+        return true; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    IOHIDQueueInterface** queue = m_pimpl->m_hidQueue;
+    bool stopped = false;
+    bool success = true;
+
+    for ( size_t i = 0; i < m_pimpl->m_polledKeyCount; i++ )
+    {
+        const PrivateImpl::PolledKey& key = m_pimpl->m_polledKeys[ i ];
+        const bool wanted = masks.delivered.IsPressed( key.usage );
+
+        if ( wanted == m_pimpl->m_subscribed.IsPressed( key.usage ) )
+        {
+            continue;
+        }
+
+        if ( ! stopped )
+        {
+            (void)(*queue)->stop( queue );
+            stopped = true;
+        }
+
+        const IOReturn ioReturnValue = wanted
+            ? (*queue)->addElement( queue, key.cookie, 0 )
+            : (*queue)->removeElement( queue, key.cookie );
+
+        if ( ioReturnValue == kIOReturnSuccess )
+        {
+            m_pimpl->m_subscribed.Set( key.usage, wanted );
+        }
+        else
+        {
+            std::string msg = boost::str( boost::format("%1% of usage %2% failed. code: %3%")
+                                          % ( wanted ? "addElement" : "removeElement" ) % key.usage % (int)ioReturnValue );
+            LogErrorWhenFunctorIsntEmpty( m_errorLoggerFunctor, msg );
+            success = false;
+        }
+    }
+
+    if ( stopped && (*queue)->start( queue ) != kIOReturnSuccess )
+    {
+        LogErrorWhenFunctorIsntEmpty( m_errorLoggerFunctor, "Failed to restart queue after changing its elements." );
+        success = false;
+    }
+
+    // on failure, try again next time
+    if ( success )
+    {
+        m_pimpl->m_appliedGeneration = generation;
+    }
+
     return success;
 }
 
@@ -941,7 +1397,7 @@ bool GitHubSample::HelperForKeyboardReaderIOKit::AddElementsToQueue()
 
 bool GitHubSample::HelperForKeyboardReaderIOKit::PopulateVectorOfKeyInfo()
 {
-    if ( false == m_keys.empty() )
+    if ( 0 != m_pimpl->m_keyCount )
     {
         assert( ! "\n\n you should only ever call this function ONCE, and that is when we do initial population\n\n" );
         return false; // BAILING OUT HERE!!  BAILING OUT HERE!!  BAILING OUT HERE!!
@@ -949,191 +1405,219 @@ bool GitHubSample::HelperForKeyboardReaderIOKit::PopulateVectorOfKeyInfo()
 
     static const bool FORCE_APPLICATION_TO_IGNORE_THIS_KEY = true;// this is passed to some PerKeyData structs
 
-    m_keys.reserve(250);
-
-    PerKeyData::PushOneItem( m_keys, "BOGUS PLACEHOLDER AT INDEX ZERO", 0, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "BOGUS PLACEHOLDER AT INDEX ZERO", 0, 0 );
 
     // this stuff was all automatically generated. I did not sit here and type this out!  :)
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardErrorRollOver", kHIDUsage_KeyboardErrorRollOver, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardPOSTFail", kHIDUsage_KeyboardPOSTFail, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardErrorUndefined", kHIDUsage_KeyboardErrorUndefined, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardA", kHIDUsage_KeyboardA, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardB", kHIDUsage_KeyboardB, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardC", kHIDUsage_KeyboardC, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardD", kHIDUsage_KeyboardD, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardE", kHIDUsage_KeyboardE, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF", kHIDUsage_KeyboardF, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardG", kHIDUsage_KeyboardG, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardH", kHIDUsage_KeyboardH, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardI", kHIDUsage_KeyboardI, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardJ", kHIDUsage_KeyboardJ, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardK", kHIDUsage_KeyboardK, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardL", kHIDUsage_KeyboardL, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardM", kHIDUsage_KeyboardM, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardN", kHIDUsage_KeyboardN, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardO", kHIDUsage_KeyboardO, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardP", kHIDUsage_KeyboardP, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardQ", kHIDUsage_KeyboardQ, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardR", kHIDUsage_KeyboardR, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardS", kHIDUsage_KeyboardS, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardT", kHIDUsage_KeyboardT, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardU", kHIDUsage_KeyboardU, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardV", kHIDUsage_KeyboardV, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardW", kHIDUsage_KeyboardW, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardX", kHIDUsage_KeyboardX, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardY", kHIDUsage_KeyboardY, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardZ", kHIDUsage_KeyboardZ, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keyboard1", kHIDUsage_Keyboard1, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keyboard2", kHIDUsage_Keyboard2, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keyboard3", kHIDUsage_Keyboard3, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keyboard4", kHIDUsage_Keyboard4, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keyboard5", kHIDUsage_Keyboard5, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keyboard6", kHIDUsage_Keyboard6, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keyboard7", kHIDUsage_Keyboard7, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keyboard8", kHIDUsage_Keyboard8, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keyboard9", kHIDUsage_Keyboard9, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keyboard0", kHIDUsage_Keyboard0, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardReturnOrEnter", kHIDUsage_KeyboardReturnOrEnter, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardEscape", kHIDUsage_KeyboardEscape, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardDeleteOrBackspace", kHIDUsage_KeyboardDeleteOrBackspace, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardTab", kHIDUsage_KeyboardTab, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardSpacebar", kHIDUsage_KeyboardSpacebar, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardHyphen", kHIDUsage_KeyboardHyphen, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardEqualSign", kHIDUsage_KeyboardEqualSign, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardOpenBracket", kHIDUsage_KeyboardOpenBracket, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardCloseBracket", kHIDUsage_KeyboardCloseBracket, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardBackslash", kHIDUsage_KeyboardBackslash, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardNonUSPound", kHIDUsage_KeyboardNonUSPound, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardSemicolon", kHIDUsage_KeyboardSemicolon, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardQuote", kHIDUsage_KeyboardQuote, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardGraveAccentAndTilde", kHIDUsage_KeyboardGraveAccentAndTilde, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardComma", kHIDUsage_KeyboardComma, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardPeriod", kHIDUsage_KeyboardPeriod, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardSlash", kHIDUsage_KeyboardSlash, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardCapsLock", kHIDUsage_KeyboardCapsLock, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF1", kHIDUsage_KeyboardF1, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF2", kHIDUsage_KeyboardF2, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF3", kHIDUsage_KeyboardF3, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF4", kHIDUsage_KeyboardF4, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF5", kHIDUsage_KeyboardF5, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF6", kHIDUsage_KeyboardF6, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF7", kHIDUsage_KeyboardF7, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF8", kHIDUsage_KeyboardF8, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF9", kHIDUsage_KeyboardF9, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF10", kHIDUsage_KeyboardF10, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF11", kHIDUsage_KeyboardF11, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF12", kHIDUsage_KeyboardF12, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardPrintScreen", kHIDUsage_KeyboardPrintScreen, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardScrollLock", kHIDUsage_KeyboardScrollLock, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardPause", kHIDUsage_KeyboardPause, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardInsert", kHIDUsage_KeyboardInsert, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardHome", kHIDUsage_KeyboardHome, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardPageUp", kHIDUsage_KeyboardPageUp, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardDeleteForward", kHIDUsage_KeyboardDeleteForward, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardEnd", kHIDUsage_KeyboardEnd, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardPageDown", kHIDUsage_KeyboardPageDown, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardRightArrow", kHIDUsage_KeyboardRightArrow, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardLeftArrow", kHIDUsage_KeyboardLeftArrow, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardDownArrow", kHIDUsage_KeyboardDownArrow, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardUpArrow", kHIDUsage_KeyboardUpArrow, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeypadNumLock", kHIDUsage_KeypadNumLock, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeypadSlash", kHIDUsage_KeypadSlash, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeypadAsterisk", kHIDUsage_KeypadAsterisk, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeypadHyphen", kHIDUsage_KeypadHyphen, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeypadPlus", kHIDUsage_KeypadPlus, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeypadEnter", kHIDUsage_KeypadEnter, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keypad1", kHIDUsage_Keypad1, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keypad2", kHIDUsage_Keypad2, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keypad3", kHIDUsage_Keypad3, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keypad4", kHIDUsage_Keypad4, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keypad5", kHIDUsage_Keypad5, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keypad6", kHIDUsage_Keypad6, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keypad7", kHIDUsage_Keypad7, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keypad8", kHIDUsage_Keypad8, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keypad9", kHIDUsage_Keypad9, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_Keypad0", kHIDUsage_Keypad0, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeypadPeriod", kHIDUsage_KeypadPeriod, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardNonUSBackslash", kHIDUsage_KeyboardNonUSBackslash, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardApplication", kHIDUsage_KeyboardApplication, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardPower", kHIDUsage_KeyboardPower, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeypadEqualSign", kHIDUsage_KeypadEqualSign, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF13", kHIDUsage_KeyboardF13, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF14", kHIDUsage_KeyboardF14, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF15", kHIDUsage_KeyboardF15, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF16", kHIDUsage_KeyboardF16, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF17", kHIDUsage_KeyboardF17, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF18", kHIDUsage_KeyboardF18, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF19", kHIDUsage_KeyboardF19, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF20", kHIDUsage_KeyboardF20, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF21", kHIDUsage_KeyboardF21, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF22", kHIDUsage_KeyboardF22, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF23", kHIDUsage_KeyboardF23, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardF24", kHIDUsage_KeyboardF24, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardExecute", kHIDUsage_KeyboardExecute, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardHelp", kHIDUsage_KeyboardHelp, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardMenu", kHIDUsage_KeyboardMenu, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardSelect", kHIDUsage_KeyboardSelect, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardStop", kHIDUsage_KeyboardStop, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardAgain", kHIDUsage_KeyboardAgain, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardUndo", kHIDUsage_KeyboardUndo, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardCut", kHIDUsage_KeyboardCut, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardCopy", kHIDUsage_KeyboardCopy, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardPaste", kHIDUsage_KeyboardPaste, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardFind", kHIDUsage_KeyboardFind, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardMute", kHIDUsage_KeyboardMute, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardVolumeUp", kHIDUsage_KeyboardVolumeUp, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardVolumeDown", kHIDUsage_KeyboardVolumeDown, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardLockingCapsLock", kHIDUsage_KeyboardLockingCapsLock, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardLockingNumLock", kHIDUsage_KeyboardLockingNumLock, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardLockingScrollLock", kHIDUsage_KeyboardLockingScrollLock, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeypadComma", kHIDUsage_KeypadComma, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeypadEqualSignAS400", kHIDUsage_KeypadEqualSignAS400, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardInternational1", kHIDUsage_KeyboardInternational1, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardInternational2", kHIDUsage_KeyboardInternational2, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardInternational3", kHIDUsage_KeyboardInternational3, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardInternational4", kHIDUsage_KeyboardInternational4, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardInternational5", kHIDUsage_KeyboardInternational5, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardInternational6", kHIDUsage_KeyboardInternational6, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardInternational7", kHIDUsage_KeyboardInternational7, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardInternational8", kHIDUsage_KeyboardInternational8, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardInternational9", kHIDUsage_KeyboardInternational9, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardLANG1", kHIDUsage_KeyboardLANG1, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardLANG2", kHIDUsage_KeyboardLANG2, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardLANG3", kHIDUsage_KeyboardLANG3, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardLANG4", kHIDUsage_KeyboardLANG4, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardLANG5", kHIDUsage_KeyboardLANG5, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardLANG6", kHIDUsage_KeyboardLANG6, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardLANG7", kHIDUsage_KeyboardLANG7, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardLANG8", kHIDUsage_KeyboardLANG8, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardLANG9", kHIDUsage_KeyboardLANG9, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardAlternateErase", kHIDUsage_KeyboardAlternateErase, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardSysReqOrAttention", kHIDUsage_KeyboardSysReqOrAttention, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardCancel", kHIDUsage_KeyboardCancel, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardClear", kHIDUsage_KeyboardClear, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardPrior", kHIDUsage_KeyboardPrior, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardReturn", kHIDUsage_KeyboardReturn, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardSeparator", kHIDUsage_KeyboardSeparator, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardOut", kHIDUsage_KeyboardOut, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardOper", kHIDUsage_KeyboardOper, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardClearOrAgain", kHIDUsage_KeyboardClearOrAgain, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardCrSelOrProps", kHIDUsage_KeyboardCrSelOrProps, 0 );
-    PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardExSel", kHIDUsage_KeyboardExSel, 0 );
-
-
-    // 0xA5-0xDF Reserved
-    /*
-      PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardLeftControl", kHIDUsage_KeyboardLeftControl, 0 );
-      PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardLeftShift", kHIDUsage_KeyboardLeftShift, 0 );
-      PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardLeftAlt", kHIDUsage_KeyboardLeftAlt, 0 );
-      PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardLeftGUI", kHIDUsage_KeyboardLeftGUI, 0 );
-      PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardRightControl", kHIDUsage_KeyboardRightControl, 0 );
-      PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardRightShift", kHIDUsage_KeyboardRightShift, 0 );
-      PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardRightAlt", kHIDUsage_KeyboardRightAlt, 0 );
-      PerKeyData::PushOneItem( m_keys, "kHIDUsage_KeyboardRightGUI", kHIDUsage_KeyboardRightGUI, 0 );
-    */
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardErrorRollOver", kHIDUsage_KeyboardErrorRollOver, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardPOSTFail", kHIDUsage_KeyboardPOSTFail, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardErrorUndefined", kHIDUsage_KeyboardErrorUndefined, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardA", kHIDUsage_KeyboardA, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardB", kHIDUsage_KeyboardB, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardC", kHIDUsage_KeyboardC, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardD", kHIDUsage_KeyboardD, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardE", kHIDUsage_KeyboardE, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF", kHIDUsage_KeyboardF, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardG", kHIDUsage_KeyboardG, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardH", kHIDUsage_KeyboardH, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardI", kHIDUsage_KeyboardI, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardJ", kHIDUsage_KeyboardJ, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardK", kHIDUsage_KeyboardK, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardL", kHIDUsage_KeyboardL, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardM", kHIDUsage_KeyboardM, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardN", kHIDUsage_KeyboardN, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardO", kHIDUsage_KeyboardO, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardP", kHIDUsage_KeyboardP, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardQ", kHIDUsage_KeyboardQ, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardR", kHIDUsage_KeyboardR, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardS", kHIDUsage_KeyboardS, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardT", kHIDUsage_KeyboardT, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardU", kHIDUsage_KeyboardU, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardV", kHIDUsage_KeyboardV, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardW", kHIDUsage_KeyboardW, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardX", kHIDUsage_KeyboardX, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardY", kHIDUsage_KeyboardY, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardZ", kHIDUsage_KeyboardZ, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keyboard1", kHIDUsage_Keyboard1, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keyboard2", kHIDUsage_Keyboard2, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keyboard3", kHIDUsage_Keyboard3, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keyboard4", kHIDUsage_Keyboard4, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keyboard5", kHIDUsage_Keyboard5, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keyboard6", kHIDUsage_Keyboard6, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keyboard7", kHIDUsage_Keyboard7, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keyboard8", kHIDUsage_Keyboard8, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keyboard9", kHIDUsage_Keyboard9, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keyboard0", kHIDUsage_Keyboard0, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardReturnOrEnter", kHIDUsage_KeyboardReturnOrEnter, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardEscape", kHIDUsage_KeyboardEscape, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardDeleteOrBackspace", kHIDUsage_KeyboardDeleteOrBackspace, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardTab", kHIDUsage_KeyboardTab, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardSpacebar", kHIDUsage_KeyboardSpacebar, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardHyphen", kHIDUsage_KeyboardHyphen, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardEqualSign", kHIDUsage_KeyboardEqualSign, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardOpenBracket", kHIDUsage_KeyboardOpenBracket, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardCloseBracket", kHIDUsage_KeyboardCloseBracket, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardBackslash", kHIDUsage_KeyboardBackslash, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardNonUSPound", kHIDUsage_KeyboardNonUSPound, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardSemicolon", kHIDUsage_KeyboardSemicolon, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardQuote", kHIDUsage_KeyboardQuote, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardGraveAccentAndTilde", kHIDUsage_KeyboardGraveAccentAndTilde, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardComma", kHIDUsage_KeyboardComma, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardPeriod", kHIDUsage_KeyboardPeriod, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardSlash", kHIDUsage_KeyboardSlash, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardCapsLock", kHIDUsage_KeyboardCapsLock, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF1", kHIDUsage_KeyboardF1, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF2", kHIDUsage_KeyboardF2, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF3", kHIDUsage_KeyboardF3, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF4", kHIDUsage_KeyboardF4, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF5", kHIDUsage_KeyboardF5, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF6", kHIDUsage_KeyboardF6, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF7", kHIDUsage_KeyboardF7, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF8", kHIDUsage_KeyboardF8, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF9", kHIDUsage_KeyboardF9, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF10", kHIDUsage_KeyboardF10, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF11", kHIDUsage_KeyboardF11, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF12", kHIDUsage_KeyboardF12, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardPrintScreen", kHIDUsage_KeyboardPrintScreen, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardScrollLock", kHIDUsage_KeyboardScrollLock, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardPause", kHIDUsage_KeyboardPause, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardInsert", kHIDUsage_KeyboardInsert, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardHome", kHIDUsage_KeyboardHome, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardPageUp", kHIDUsage_KeyboardPageUp, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardDeleteForward", kHIDUsage_KeyboardDeleteForward, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardEnd", kHIDUsage_KeyboardEnd, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardPageDown", kHIDUsage_KeyboardPageDown, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardRightArrow", kHIDUsage_KeyboardRightArrow, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardLeftArrow", kHIDUsage_KeyboardLeftArrow, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardDownArrow", kHIDUsage_KeyboardDownArrow, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardUpArrow", kHIDUsage_KeyboardUpArrow, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeypadNumLock", kHIDUsage_KeypadNumLock, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeypadSlash", kHIDUsage_KeypadSlash, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeypadAsterisk", kHIDUsage_KeypadAsterisk, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeypadHyphen", kHIDUsage_KeypadHyphen, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeypadPlus", kHIDUsage_KeypadPlus, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeypadEnter", kHIDUsage_KeypadEnter, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keypad1", kHIDUsage_Keypad1, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keypad2", kHIDUsage_Keypad2, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keypad3", kHIDUsage_Keypad3, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keypad4", kHIDUsage_Keypad4, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keypad5", kHIDUsage_Keypad5, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keypad6", kHIDUsage_Keypad6, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keypad7", kHIDUsage_Keypad7, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keypad8", kHIDUsage_Keypad8, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keypad9", kHIDUsage_Keypad9, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_Keypad0", kHIDUsage_Keypad0, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeypadPeriod", kHIDUsage_KeypadPeriod, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardNonUSBackslash", kHIDUsage_KeyboardNonUSBackslash, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardApplication", kHIDUsage_KeyboardApplication, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardPower", kHIDUsage_KeyboardPower, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeypadEqualSign", kHIDUsage_KeypadEqualSign, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF13", kHIDUsage_KeyboardF13, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF14", kHIDUsage_KeyboardF14, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF15", kHIDUsage_KeyboardF15, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF16", kHIDUsage_KeyboardF16, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF17", kHIDUsage_KeyboardF17, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF18", kHIDUsage_KeyboardF18, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF19", kHIDUsage_KeyboardF19, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF20", kHIDUsage_KeyboardF20, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF21", kHIDUsage_KeyboardF21, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF22", kHIDUsage_KeyboardF22, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF23", kHIDUsage_KeyboardF23, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardF24", kHIDUsage_KeyboardF24, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardExecute", kHIDUsage_KeyboardExecute, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardHelp", kHIDUsage_KeyboardHelp, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardMenu", kHIDUsage_KeyboardMenu, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardSelect", kHIDUsage_KeyboardSelect, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardStop", kHIDUsage_KeyboardStop, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardAgain", kHIDUsage_KeyboardAgain, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardUndo", kHIDUsage_KeyboardUndo, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardCut", kHIDUsage_KeyboardCut, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardCopy", kHIDUsage_KeyboardCopy, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardPaste", kHIDUsage_KeyboardPaste, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardFind", kHIDUsage_KeyboardFind, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardMute", kHIDUsage_KeyboardMute, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardVolumeUp", kHIDUsage_KeyboardVolumeUp, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardVolumeDown", kHIDUsage_KeyboardVolumeDown, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardLockingCapsLock", kHIDUsage_KeyboardLockingCapsLock, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardLockingNumLock", kHIDUsage_KeyboardLockingNumLock, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardLockingScrollLock", kHIDUsage_KeyboardLockingScrollLock, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeypadComma", kHIDUsage_KeypadComma, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeypadEqualSignAS400", kHIDUsage_KeypadEqualSignAS400, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardInternational1", kHIDUsage_KeyboardInternational1, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardInternational2", kHIDUsage_KeyboardInternational2, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardInternational3", kHIDUsage_KeyboardInternational3, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardInternational4", kHIDUsage_KeyboardInternational4, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardInternational5", kHIDUsage_KeyboardInternational5, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardInternational6", kHIDUsage_KeyboardInternational6, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardInternational7", kHIDUsage_KeyboardInternational7, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardInternational8", kHIDUsage_KeyboardInternational8, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardInternational9", kHIDUsage_KeyboardInternational9, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardLANG1", kHIDUsage_KeyboardLANG1, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardLANG2", kHIDUsage_KeyboardLANG2, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardLANG3", kHIDUsage_KeyboardLANG3, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardLANG4", kHIDUsage_KeyboardLANG4, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardLANG5", kHIDUsage_KeyboardLANG5, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardLANG6", kHIDUsage_KeyboardLANG6, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardLANG7", kHIDUsage_KeyboardLANG7, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardLANG8", kHIDUsage_KeyboardLANG8, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardLANG9", kHIDUsage_KeyboardLANG9, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardAlternateErase", kHIDUsage_KeyboardAlternateErase, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardSysReqOrAttention", kHIDUsage_KeyboardSysReqOrAttention, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardCancel", kHIDUsage_KeyboardCancel, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardClear", kHIDUsage_KeyboardClear, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardPrior", kHIDUsage_KeyboardPrior, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardReturn", kHIDUsage_KeyboardReturn, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardSeparator", kHIDUsage_KeyboardSeparator, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardOut", kHIDUsage_KeyboardOut, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardOper", kHIDUsage_KeyboardOper, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardClearOrAgain", kHIDUsage_KeyboardClearOrAgain, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardCrSelOrProps", kHIDUsage_KeyboardCrSelOrProps, 0 );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardExSel", kHIDUsage_KeyboardExSel, 0 );
+
+
+    // 0xA5-0xDF Reserved.  The table is indexed by usage id, so the gap still needs entries.
+    while ( m_pimpl->m_keyCount < kHIDUsage_KeyboardLeftControl )
+    {
+        PerKeyData::PushOneItem( *m_pimpl, "RESERVED", m_pimpl->m_keyCount, 0, FORCE_APPLICATION_TO_IGNORE_THIS_KEY );
+    }
+
+    // The modifiers are queued (ReadEventsFromQueue needs them for text reconstruction), but
+    // holding shift is not a 'depressed key' as far as CountOfCurrentlyDepressedKeys is concerned.
+    static const bool EXCLUDE_FROM_KEY_COUNT = true;
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardLeftControl", kHIDUsage_KeyboardLeftControl, 0, false, EXCLUDE_FROM_KEY_COUNT );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardLeftShift", kHIDUsage_KeyboardLeftShift, 0, false, EXCLUDE_FROM_KEY_COUNT );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardLeftAlt", kHIDUsage_KeyboardLeftAlt, 0, false, EXCLUDE_FROM_KEY_COUNT );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardLeftGUI", kHIDUsage_KeyboardLeftGUI, 0, false, EXCLUDE_FROM_KEY_COUNT );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardRightControl", kHIDUsage_KeyboardRightControl, 0, false, EXCLUDE_FROM_KEY_COUNT );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardRightShift", kHIDUsage_KeyboardRightShift, 0, false, EXCLUDE_FROM_KEY_COUNT );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardRightAlt", kHIDUsage_KeyboardRightAlt, 0, false, EXCLUDE_FROM_KEY_COUNT );
+    PerKeyData::PushOneItem( *m_pimpl, "kHIDUsage_KeyboardRightGUI", kHIDUsage_KeyboardRightGUI, 0, false, EXCLUDE_FROM_KEY_COUNT );
+
     // 0xE8-0xFFFF Reserved
 
     return true; // there isn't a way to "fail", so it's always true. but the structure of Initialize needs us to return bool
 }
 
 
+void GitHubSample::HelperForKeyboardReaderIOKit::LockBuffers( RealtimeThreadConfig& realtime )
+{
+    if ( m_pimpl )
+    {
+        // the key table, the polled keys and the masks: everything a poll or a drain reads
+        realtime.LockRegion( m_pimpl.get(), sizeof(PrivateImpl) );
+    }
+    m_usages.LockBuffers( realtime );
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::HelperForKeyboardReaderIOKit::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) );
+    if ( m_pimpl )
+    {
+        // the pimpl is mostly the key table
+        report.AddHeap( MemoryUsageReport::kKeyTables, sizeof(PrivateImpl) );
+    }
+    report.AddHeap( MemoryUsageReport::kKeyTables, m_usages.TableBytes() );
+    return report;
+}
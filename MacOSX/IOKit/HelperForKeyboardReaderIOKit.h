@@ -7,10 +7,20 @@
 
 #include <CoreFoundation/CFString.h>
 
+#include "DevicePropertyStore.h"
+#include "KeyEvent.h"
+#include "KeyMaskPublisher.h"
+#include "MemoryUsage.h"
+#include "UsageRegistry.h"
+
 
 namespace GitHubSample
 {
 
+    class KeyboardLayout;
+    class RealtimeThreadConfig;
+    class KeyboardLayoutDatabase;
+
     /**
        Providing two synchronous ways of reading keyboard state and receiving
        keyboard input.  One way is to poll the keyboard device for the current
@@ -25,19 +35,123 @@ namespace GitHubSample
     {
     public:
 
+        /// what FindKeyboard looks for (the name stuck from when keyboards were all there was)
+        enum DeviceKind
+        {
+            kKeyboardDevice, ///< kHIDUsage_GD_Keyboard
+            kPointerDevice,  ///< kHIDUsage_GD_Mouse: buttons and relative axes, see PointerMotionCoalescer
+            kGamepadDevice,  ///< kHIDUsage_GD_GamePad: buttons and absolute axes, see AxisPipeline
+            kJoystickDevice, ///< kHIDUsage_GD_Joystick: the same as a gamepad
+            /// kHIDUsage_Csmr_ConsumerControl, or failing that kHIDUsage_GD_SystemControl: media keys,
+            /// volume, brightness, power and sleep.  Most keyboards report these on an interface of
+            /// their own, which a kKeyboardDevice reader never opens.
+            kConsumerControlDevice
+        };
+
+        /// When a 'layoutDatabase' is given, the layout for this keyboard is
+        /// picked from it (by country code, vendor and product id) as soon as
+        /// the device is opened.  Share ONE database among all readers.
         explicit HelperForKeyboardReaderIOKit
         (
          bool enableQueue,
-         boost::function< void ( const std::string msg ) > errorLoggerFunctor = 0
+         boost::function< void ( const std::string msg ) > errorLoggerFunctor = 0,
+         boost::shared_ptr< const KeyboardLayoutDatabase > layoutDatabase = boost::shared_ptr< const KeyboardLayoutDatabase >(),
+         DeviceKind deviceKind = kKeyboardDevice
         );
 
-        /// Will return a NEGATIVE value in case of error.
+        /// Will return a NEGATIVE value in case of error, and always for a
+        /// device that is not a kKeyboardDevice.
         int CountOfCurrentlyDepressedKeys() const;
 
+        /**
+           Reads the state of every key we listen to (modifiers included) in
+           one pass, and sets one bit per pressed usage id.  This is the
+           poll-only counterpart of ReadEventsFromQueue: diff two snapshots to
+           find the edges (AdaptivePoller does that, and decides how often to
+           poll).  Returns false, with 'pressed' all zero, when the device is
+           not open or a key could not be read.
+         */
+        bool SnapshotPressedKeys( KeyStateBitmap& pressed ) const;
+
         /// Warning: this seems to receive keypresses that happen even when OUR
         /// APPLICATION is NOT the foreground application
         void ReadFromQueue_Experimental();
 
+        /// Drains up to 'capacity' events from the queue into 'events' and
+        /// returns how many were written.  Each event has its cookie translated
+        /// back into (usage page, usage id), and the 'deviceIndex' set by SetDeviceIndex.  The
+        /// modifier keys ARE delivered here (so that text can be reconstructed
+        /// downstream) even though CountOfCurrentlyDepressedKeys ignores them.
+        /// So are the media keys, system controls and any other input elements
+        /// the device has (see UsageRegistry), with their own usage page.  A kPointerDevice
+        /// delivers its buttons (kHIDPage_Button) and, for each report, the
+        /// DELTA of each relative axis that moved; at up to 8 kHz that is a
+        /// lot of events, so pass them through a PointerMotionCoalescer.  A
+        /// kGamepadDevice or kJoystickDevice delivers its buttons and the
+        /// RAW value of each absolute axis; AxisPipeline scales them.
+        size_t ReadEventsFromQueue( KeyEvent* events, size_t capacity );
+
+        /// Stamped on every KeyEvent from this reader (zero by default).  Give
+        /// each keyboard its own index when their events are merged, e.g. by
+        /// ModifierAggregator.
+        void SetDeviceIndex( uint16_t deviceIndex ) { m_deviceIndex = deviceIndex; }
+        uint16_t DeviceIndex() const { return m_deviceIndex; }
+
+        DeviceKind Kind() const { return m_deviceKind; }
+
+        /// Every element this reader listens to, with the logical and
+        /// physical ranges of the analog ones (AxisPipeline::ConfigurePad
+        /// reads them from here) and the last value ReadEventsFromQueue saw
+        /// for each.  Empty when the device could not be opened.
+        const UsageRegistry& Elements() const { return m_usages; }
+
+        /// The masks that match the built-in choices: the F keys, arrows,
+        /// keypad etc are ignored, the modifiers are delivered but not counted.
+        KeyInterestMasks DefaultInterestMasks() const;
+
+        /**
+           From now on, which keys CountOfCurrentlyDepressedKeys counts and
+           which keys ReadEventsFromQueue / SnapshotPressedKeys hand out comes
+           from 'publisher' (an empty pointer goes back to the defaults).
+           The masks can then change as often as needed without ever
+           blocking a reader.  Set this before any thread starts reading.
+         */
+        void SetMaskPublisher( boost::shared_ptr< const KeyMaskPublisher > publisher );
+
+        /**
+           Brings the IOHID queue's element list in line with the delivered
+           mask, adding and removing only the keys that changed.  Costs one
+           generation check when nothing changed.  Until this runs, keys that
+           were dropped from the mask are filtered out of ReadEventsFromQueue,
+           and keys that were added are not on the queue yet.  Call it from
+           the thread that drains the queue, between drains (the queue is
+           stopped for the few calls that change it).  Returns false when an
+           element could not be added or removed.
+         */
+        bool ReconcileQueueSubscriptions();
+
+        /// The layout picked for this keyboard.  It lives in the database that
+        /// was passed to the constructor.  NULL when there was no database.
+        const KeyboardLayout* Layout() const { return m_layout; }
+
+        /// kIOHIDCountryCodeKey as a number.  Zero (which is also "not localized") when the keyboard did
+        /// not report one: Properties().Has( DevicePropertyStore::kCountryCode ) tells the two apart.
+        uint32_t CountryCode() const { return m_properties.CountryCode(); }
+
+        /// Vendor, product, location etc, each fetched from the registry the
+        /// first time it is read.  All absent when no keyboard was found.
+        const DevicePropertyStore& Properties() const { return m_properties; }
+
+        /**
+           Hands the key table and the usage registry to 'realtime' to be
+           prefaulted and mlocked, for a reader thread that must not fault.
+           Call it after the device is open; this object must outlive 'realtime'.
+         */
+        void LockBuffers( RealtimeThreadConfig& realtime );
+
+        /// the key table and usage registry.  Layout() belongs to the database, so it is not counted.
+        MemoryUsageReport MemoryUsage() const;
+
     private:
 
         /// opaque struct. not meant to be used outside this class.
@@ -46,19 +160,26 @@ namespace GitHubSample
         struct PrivateImpl;
         boost::shared_ptr< PrivateImpl > m_pimpl;
 
-        std::vector< boost::shared_ptr<PerKeyData> > m_keys;
+        /// every element we listen to, whatever its usage page, and the cookie -> (page, usage) decoding
+        UsageRegistry m_usages;
         boost::function< void ( const std::string msg ) > m_errorLoggerFunctor;
-        std::vector< std::string > m_deviceInformationProperties;
         const bool m_queueEnabled;
+        const DeviceKind m_deviceKind;
+        boost::shared_ptr< const KeyboardLayoutDatabase > m_layoutDatabase;
+        boost::shared_ptr< const KeyMaskPublisher > m_maskPublisher;
+        const KeyboardLayout* m_layout;
+        DevicePropertyStore m_properties;
+        uint16_t m_deviceIndex;
 
         void Initialize();
         void LogInitializationError( const std::string& errorDesc ) const;
         void DebugCheckErrorKeys() const;
+        void CurrentMasks( KeyInterestMasks& masks, uint64_t* generation ) const;
 
         bool FindKeyboard();
         bool CreatePluginInterface();
-        void GetKeyboardProperties();
-        void StoreOneProperty( CFStringRef propertyKey );
+        CFTypeRef FetchDeviceProperty( CFStringRef propertyKey ) const;
+        void SelectKeyboardLayout();
         bool CreateDeviceInterface();
         bool CreateQueue();
         bool PopulateVectorOfKeyInfo();
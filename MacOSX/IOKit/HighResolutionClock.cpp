@@ -0,0 +1,274 @@
+
+
+#include "HighResolutionClock.h"
+
+#include <time.h>
+
+#ifdef __DARWIN__
+#include <mach/mach_time.h>
+#endif
+
+#if defined(__linux__) && ( defined(__i386__) || defined(__x86_64__) )
+#define GITHUBSAMPLE_CLOCK_HAS_TSC 1
+#include <cpuid.h>
+#endif
+
+
+
+namespace
+{
+#ifdef GITHUBSAMPLE_CLOCK_HAS_TSC
+
+    inline uint64_t ReadTimeStampCounter()
+    {
+        uint32_t low, high;
+        __asm__ __volatile__( "rdtsc" : "=a" ( low ), "=d" ( high ) );
+        return ( static_cast<uint64_t>( high ) << 32 ) | low;
+    }
+
+    /// CPUID leaf 0x80000007, EDX bit 8: the TSC ticks at a constant rate in every P-, C- and T-state
+    bool TimeStampCounterIsInvariant()
+    {
+        unsigned int eax, ebx, ecx, edx;
+        if ( ! __get_cpuid( 0x80000000, &eax, &ebx, &ecx, &edx ) || eax < 0x80000007 )
+        {
+            return false;
+        }
+
+        __get_cpuid( 0x80000007, &eax, &ebx, &ecx, &edx );
+        return ( edx & ( 1 << 8 ) ) != 0;
+    }
+
+#endif // GITHUBSAMPLE_CLOCK_HAS_TSC
+
+    uint64_t GreatestCommonDivisor( uint64_t a, uint64_t b )
+    {
+        while ( b != 0 )
+        {
+            const uint64_t remainder = a % b;
+            a = b;
+            b = remainder;
+        }
+        return a;
+    }
+
+    /// numerator / denominator as a 32-bit fixed point multiplier and a shift (see SetRatio)
+    struct FixedPointRatio
+    {
+        uint32_t numerator;
+        uint32_t denominator;
+        uint64_t multiplier;
+        unsigned int shift;
+    };
+
+    /**
+       Reduces the ratio until both terms fit in 32 bits, then picks the
+       largest shift (at most 32) that keeps the multiplier below 2^32, so the
+       two 32x32 bit products in ScaleTicks cannot overflow.
+    */
+    FixedPointRatio MakeFixedPointRatio( uint64_t numerator, uint64_t denominator )
+    {
+        const uint64_t divisor = GreatestCommonDivisor( numerator, denominator );
+        numerator /= divisor;
+        denominator /= divisor;
+
+        while ( numerator > 0xFFFFFFFFu || denominator > 0xFFFFFFFFu )
+        {
+            numerator = ( numerator + 1 ) >> 1;
+            denominator = ( denominator + 1 ) >> 1;
+        }
+
+        FixedPointRatio ratio;
+        ratio.numerator = static_cast<uint32_t>( numerator );
+        ratio.denominator = static_cast<uint32_t>( denominator );
+
+        ratio.shift = 32;
+        while ( ratio.shift > 0 && ( ( numerator << ratio.shift ) / denominator ) > 0xFFFFFFFFu )
+        {
+            ratio.shift--;
+        }
+        ratio.multiplier = ( numerator << ratio.shift ) / denominator;
+        return ratio;
+    }
+
+    /// HighResolutionClock::ToNanoseconds, for a ratio that is not in a clock
+    inline uint64_t ScaleTicks( const uint64_t ticks, const FixedPointRatio& ratio )
+    {
+        const uint64_t high = ( ticks >> 32 ) * ratio.multiplier;
+        const uint64_t low = ( ticks & 0xFFFFFFFFu ) * ratio.multiplier;
+        return ( high << ( 32 - ratio.shift ) ) + ( low >> ratio.shift );
+    }
+
+#ifdef __DARWIN__
+
+    const FixedPointRatio& MachTimebase()
+    {
+        struct Timebase
+        {
+            FixedPointRatio ratio;
+
+            Timebase()
+            {
+                mach_timebase_info_data_t timebase;
+                mach_timebase_info( &timebase );
+                ratio = MakeFixedPointRatio( timebase.numer, timebase.denom );
+            }
+        };
+
+        static const Timebase timebase;
+        return timebase.ratio;
+    }
+
+#endif // __DARWIN__
+}
+
+
+
+uint64_t GitHubSample::HighResolutionClock::OperatingSystemNanoseconds()
+{
+#ifdef __DARWIN__
+    // there is no clock_gettime on 10.5.  and not ticks * numer / denom:
+    // numer is around 10^9 on PowerPC, so that overflows within hours of uptime.
+    return ScaleTicks( mach_absolute_time(), MachTimebase() );
+#else
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return ( static_cast<uint64_t>( now.tv_sec ) * 1000000000u ) + now.tv_nsec;
+#endif
+}
+
+
+GitHubSample::HighResolutionClock::HighResolutionClock( const unsigned int calibrationMilliseconds )
+    : m_source( kMonotonic ),
+      m_numerator( 1 ),
+      m_denominator( 1 ),
+      m_multiplier( 0 ),
+      m_shift( 0 ),
+      m_startTicks( 0 ),
+      m_startOperatingSystemNanoseconds( 0 )
+{
+    SetRatio( 1, 1 );
+
+#ifdef __DARWIN__
+
+    m_source = kMachAbsoluteTime;
+    SetRatio( MachTimebase().numerator, MachTimebase().denominator );
+
+#elif defined(GITHUBSAMPLE_CLOCK_HAS_TSC)
+
+    if ( calibrationMilliseconds > 0 && TimeStampCounterIsInvariant() )
+    {
+        // Spin rather than sleep: the point is to bracket the interval as
+        // tightly as possible, on both clocks, at both ends.
+        const uint64_t startNanoseconds = OperatingSystemNanoseconds();
+        const uint64_t startTicks = ReadTimeStampCounter();
+        const uint64_t wanted = static_cast<uint64_t>( calibrationMilliseconds ) * 1000000u;
+
+        uint64_t elapsedNanoseconds = 0;
+        while ( elapsedNanoseconds < wanted )
+        {
+            elapsedNanoseconds = OperatingSystemNanoseconds() - startNanoseconds;
+        }
+        const uint64_t elapsedTicks = ReadTimeStampCounter() - startTicks;
+
+        if ( elapsedTicks > 0 )
+        {
+            m_source = kTimeStampCounter;
+            SetRatio( elapsedNanoseconds, elapsedTicks );
+        }
+    }
+
+#endif
+
+    m_startOperatingSystemNanoseconds = OperatingSystemNanoseconds();
+    m_startTicks = Now();
+}
+
+
+void GitHubSample::HighResolutionClock::SetRatio( const uint64_t numerator, const uint64_t denominator )
+{
+    const FixedPointRatio ratio = MakeFixedPointRatio( numerator, denominator );
+    m_numerator = ratio.numerator;
+    m_denominator = ratio.denominator;
+    m_multiplier = ratio.multiplier;
+    m_shift = ratio.shift;
+}
+
+
+const GitHubSample::HighResolutionClock& GitHubSample::HighResolutionClock::ForEventTimestamps()
+{
+    static const HighResolutionClock clock( 0 );
+    return clock;
+}
+
+
+const char* GitHubSample::HighResolutionClock::SourceName( const Source source )
+{
+    switch ( source )
+    {
+    case kMachAbsoluteTime: return "mach_absolute_time";
+    case kTimeStampCounter: return "TSC";
+    case kMonotonic:        return "CLOCK_MONOTONIC";
+    }
+
+    return "unknown";
+}
+
+
+uint64_t GitHubSample::HighResolutionClock::Now() const
+{
+#ifdef __DARWIN__
+    return mach_absolute_time();
+#else
+#ifdef GITHUBSAMPLE_CLOCK_HAS_TSC
+    if ( m_source == kTimeStampCounter )
+    {
+        return ReadTimeStampCounter();
+    }
+#endif
+    return OperatingSystemNanoseconds();
+#endif
+}
+
+
+void GitHubSample::HighResolutionClock::ToNanoseconds( const uint64_t* ticks, uint64_t* nanoseconds, const size_t count ) const
+{
+    // the members go into locals so the compiler knows the stores cannot change them
+    const uint64_t multiplier = m_multiplier;
+    const unsigned int shift = m_shift;
+
+    for ( size_t i = 0; i < count; i++ )
+    {
+        const uint64_t high = ( ticks[i] >> 32 ) * multiplier;
+        const uint64_t low = ( ticks[i] & 0xFFFFFFFFu ) * multiplier;
+        nanoseconds[i] = ( high << ( 32 - shift ) ) + ( low >> shift );
+    }
+}
+
+
+void GitHubSample::HighResolutionClock::TimestampsToNanoseconds( KeyEvent* events, const size_t count ) const
+{
+    const uint64_t multiplier = m_multiplier;
+    const unsigned int shift = m_shift;
+
+    for ( size_t i = 0; i < count; i++ )
+    {
+        const uint64_t ticks = events[i].timestamp;
+        events[i].timestamp = ( ( ( ticks >> 32 ) * multiplier ) << ( 32 - shift ) ) + ( ( ( ticks & 0xFFFFFFFFu ) * multiplier ) >> shift );
+    }
+}
+
+
+double GitHubSample::HighResolutionClock::MeasureDriftPartsPerMillion() const
+{
+    const uint64_t operatingSystemElapsed = OperatingSystemNanoseconds() - m_startOperatingSystemNanoseconds;
+    const uint64_t clockElapsed = ToNanoseconds( Now() - m_startTicks );
+
+    if ( operatingSystemElapsed == 0 )
+    {
+        return 0.0;
+    }
+
+    return ( static_cast<double>( clockElapsed ) - static_cast<double>( operatingSystemElapsed ) )
+        * 1e6 / static_cast<double>( operatingSystemElapsed );
+}
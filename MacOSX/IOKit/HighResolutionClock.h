@@ -0,0 +1,115 @@
+
+#ifndef GITHUBSAMPLE_HIGH_RESOLUTION_CLOCK_H
+#define GITHUBSAMPLE_HIGH_RESOLUTION_CLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "KeyEvent.h"
+
+
+namespace GitHubSample
+{
+
+    /**
+       Raw clock ticks, and their conversion to nanoseconds.
+
+       KeyEvent::timestamp is the raw AbsoluteTime from IOHIDEventStruct,
+       which is in mach_absolute_time units.  Those are nanoseconds on Intel
+       macs, but not on PowerPC, so nothing can be compared or subtracted
+       before converting.  The conversion is the mach_timebase_info ratio
+       (numerator / denominator), turned ONCE into a 32-bit fixed point
+       multiplier and a shift, so converting is two multiplies and two
+       shifts, with no division.
+
+       The sources:
+
+         - kMachAbsoluteTime: the mac.  Use this one for KeyEvent timestamps.
+         - kTimeStampCounter: rdtsc on x86 Linux, calibrated against
+           CLOCK_MONOTONIC.  Only chosen when the CPU says the TSC is
+           invariant (constant rate, does not stop in sleep states).
+         - kMonotonic: CLOCK_MONOTONIC everywhere else.  Ticks ARE nanoseconds.
+
+       A clock is immutable after construction, so one clock can be shared
+       by every thread.
+     */
+    class HighResolutionClock
+    {
+    public:
+
+        enum Source
+        {
+            kMachAbsoluteTime,
+            kTimeStampCounter,
+            kMonotonic
+        };
+
+        /// Picks the best source for this machine.  Calibrating the TSC takes
+        /// about 'calibrationMilliseconds'; zero means "never use the TSC".
+        explicit HighResolutionClock( unsigned int calibrationMilliseconds = 20 );
+
+        /// the OS clock (never the TSC), which is what KeyEvent timestamps come from
+        static const HighResolutionClock& ForEventTimestamps();
+
+        Source ClockSource() const { return m_source; }
+        static const char* SourceName( Source source );
+
+        /// nanoseconds per tick is Numerator() / Denominator()
+        uint32_t Numerator() const { return m_numerator; }
+        uint32_t Denominator() const { return m_denominator; }
+
+        /// raw ticks of ClockSource()
+        uint64_t Now() const;
+
+        uint64_t NowNanoseconds() const { return ToNanoseconds( Now() ); }
+
+        /**
+           Never overflows in the intermediate steps.  The multiplier is
+           truncated, and the shift is at most 32, so the result is low by
+           less than one part in ( 2^32 * nanoseconds per tick ): one part in
+           2^31 or better from half a nanosecond per tick up (mach_absolute_time,
+           CLOCK_MONOTONIC), but about one part in 1.4 * 10^9 for a 3 GHz TSC
+           (60 us a day), and proportionally worse for faster ones.
+         */
+        uint64_t ToNanoseconds( uint64_t ticks ) const
+        {
+            const uint64_t high = ( ticks >> 32 ) * m_multiplier;
+            const uint64_t low = ( ticks & 0xFFFFFFFFu ) * m_multiplier;
+            return ( high << ( 32 - m_shift ) ) + ( low >> m_shift );
+        }
+
+        /// 'ticks' and 'nanoseconds' may be the same array
+        void ToNanoseconds( const uint64_t* ticks, uint64_t* nanoseconds, size_t count ) const;
+
+        /// rewrites each KeyEvent::timestamp from raw ticks to nanoseconds, in place
+        void TimestampsToNanoseconds( KeyEvent* events, size_t count ) const;
+
+        /**
+           How far this clock has wandered from the operating system's clock
+           since it was constructed, in parts per million (positive when this
+           clock runs fast).  Zero for kMonotonic, which IS the OS clock.
+           Worth checking now and then for kTimeStampCounter, whose rate was
+           measured over only a few milliseconds.
+         */
+        double MeasureDriftPartsPerMillion() const;
+
+        /// the OS clock (CLOCK_MONOTONIC, or mach_absolute_time on the mac), in nanoseconds
+        static uint64_t OperatingSystemNanoseconds();
+
+    private:
+
+        Source m_source;
+        uint32_t m_numerator;
+        uint32_t m_denominator;
+        /// ticks * m_multiplier >> m_shift is nanoseconds
+        uint64_t m_multiplier;
+        unsigned int m_shift;
+        uint64_t m_startTicks;
+        uint64_t m_startOperatingSystemNanoseconds;
+
+        void SetRatio( uint64_t numerator, uint64_t denominator );
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_HIGH_RESOLUTION_CLOCK_H
@@ -0,0 +1,322 @@
+
+
+#include "InputProfile.h"
+#include "AtomicOps.h"
+#include "ErrorLogging.h"
+
+#include <boost/format.hpp>
+
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+
+
+
+namespace
+{
+    // this is kHIDPage_KeyboardOrKeypad
+    const uint16_t USAGE_PAGE_KEYBOARD_OR_KEYPAD = 0x07;
+
+    const size_t WORD_COUNT = GitHubSample::KeyStateBitmap::kWordCount;
+
+    /// ModifierAggregator order (left control, shift, alt, GUI, then the right ones) folded onto HotkeyModifiers
+    uint8_t EitherSide( const uint8_t modifiers )
+    {
+        return static_cast<uint8_t>( ( modifiers | ( modifiers >> 4 ) ) & 0x0F );
+    }
+
+    void SetAll( GitHubSample::KeyStateBitmap& bitmap )
+    {
+        memset( bitmap.words, 0xFF, sizeof(bitmap.words) );
+    }
+}
+
+
+
+GitHubSample::InputProfile::Definition::Definition()
+    : repeatDelay( 0 ),
+      repeatInterval( 0 )
+{
+    SetAll( masks.delivered );
+    SetAll( masks.counted );
+}
+
+
+GitHubSample::InputProfile::InputProfile()
+{
+    memset( &m_tables, 0, sizeof(m_tables) );
+    SetAll( m_tables.masks.delivered );
+    SetAll( m_tables.masks.counted );
+
+    for ( size_t usage = 0; usage < kUsageCount; usage++ )
+    {
+        m_tables.remap[ usage ] = static_cast<uint16_t>( usage );
+    }
+}
+
+
+bool GitHubSample::InputProfile::Compile
+(
+ const Definition& definition,
+ boost::function< void ( const std::string msg ) > errorLoggerFunctor
+)
+{
+    if ( definition.hotkeys.size() > kMaxHotkeys )
+    {
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor,
+                                      boost::str( boost::format("Input profile '%1%' has %2% hotkeys; at most %3% are supported.")
+                                                  % definition.name % definition.hotkeys.size() % kMaxHotkeys ) );
+        return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    Tables tables;
+    memset( &tables, 0, sizeof(tables) );
+    tables.masks = definition.masks;
+    tables.repeatDelay = definition.repeatDelay;
+    tables.repeatInterval = definition.repeatInterval;
+
+    for ( size_t usage = 0; usage < kUsageCount; usage++ )
+    {
+        tables.remap[ usage ] = static_cast<uint16_t>( usage );
+    }
+
+    for ( size_t i = 0; i < definition.remaps.size(); i++ )
+    {
+        const Remap& remap = definition.remaps[ i ];
+        if ( remap.from >= kUsageCount || remap.to >= kUsageCount )
+        {
+            LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor,
+                                          boost::str( boost::format("Input profile '%1%': cannot remap usage 0x%2$X to 0x%3$X.")
+                                                      % definition.name % remap.from % remap.to ) );
+            return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+        }
+
+        tables.remap[ remap.from ] = remap.to;
+    }
+
+    for ( size_t i = 0; i < definition.hotkeys.size(); i++ )
+    {
+        const Hotkey& hotkey = definition.hotkeys[ i ];
+        if ( hotkey.usage >= kUsageCount || hotkey.modifiers > 0x0F || hotkey.id == kNoHotkey )
+        {
+            LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor,
+                                          boost::str( boost::format("Input profile '%1%': invalid hotkey (modifiers 0x%2$X, usage 0x%3$X, id %4%).")
+                                                      % definition.name % static_cast<unsigned>( hotkey.modifiers ) % hotkey.usage % hotkey.id ) );
+            return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+        }
+
+        tables.hotkeys[ i ] = hotkey;
+        tables.hotkeyUsages.Set( hotkey.usage, true );
+    }
+
+    tables.hotkeyCount = definition.hotkeys.size();
+    std::sort( tables.hotkeys, tables.hotkeys + tables.hotkeyCount, HotkeyLess );
+
+    for ( size_t i = 1; i < tables.hotkeyCount; i++ )
+    {
+        if ( ! HotkeyLess( tables.hotkeys[ i - 1 ], tables.hotkeys[ i ] ) )
+        {
+            LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor,
+                                          boost::str( boost::format("Input profile '%1%': hotkey (modifiers 0x%2$X, usage 0x%3$X) is defined twice.")
+                                                      % definition.name % static_cast<unsigned>( tables.hotkeys[ i ].modifiers ) % tables.hotkeys[ i ].usage ) );
+            return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+        }
+    }
+
+    m_name = definition.name;
+    m_tables = tables;
+    return true;
+}
+
+
+uint32_t GitHubSample::InputProfile::HotkeyFor( const uint8_t modifiers, const uint16_t usage ) const
+{
+    if ( usage >= kUsageCount || ! m_tables.hotkeyUsages.IsPressed( usage ) )
+    {
+        return kNoHotkey; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    Hotkey wanted;
+    wanted.modifiers = EitherSide( modifiers );
+    wanted.usage = usage;
+    wanted.id = kNoHotkey;
+
+    const Hotkey* end = m_tables.hotkeys + m_tables.hotkeyCount;
+    const Hotkey* found = std::lower_bound( m_tables.hotkeys, end, wanted, HotkeyLess );
+
+    return ( found != end && ! HotkeyLess( wanted, *found ) ) ? found->id : static_cast<uint32_t>( kNoHotkey );
+}
+
+
+void GitHubSample::InputProfile::PressedKeys::Reset()
+{
+    for ( size_t usage = 0; usage < kUsageCount; usage++ )
+    {
+        deliveredAs[ usage ] = kNotPressed;
+    }
+}
+
+
+size_t GitHubSample::InputProfile::Apply( KeyEvent* events, const size_t count, PressedKeys& pressedKeys ) const
+{
+    size_t kept = 0;
+
+    for ( size_t i = 0; i < count; i++ )
+    {
+        KeyEvent event = events[ i ];
+
+        if ( event.usagePage == USAGE_PAGE_KEYBOARD_OR_KEYPAD && event.usage < kUsageCount )
+        {
+            uint16_t& deliveredAs = pressedKeys.deliveredAs[ event.usage ];
+
+            if ( deliveredAs == PressedKeys::kNotPressed )
+            {
+                // a fresh press, or the release of a key that was down before we started: this profile decides
+                const bool delivered = m_tables.masks.delivered.IsPressed( event.usage );
+                if ( event.value != 0 )
+                {
+                    deliveredAs = delivered ? m_tables.remap[ event.usage ] : static_cast<uint16_t>( PressedKeys::kPressDropped );
+                }
+                if ( ! delivered )
+                {
+                    continue;
+                }
+                event.usage = m_tables.remap[ event.usage ];
+            }
+            else
+            {
+                // the key is down: it goes out as its press did, whatever the profile says now
+                const uint16_t usage = deliveredAs;
+                if ( event.value == 0 )
+                {
+                    deliveredAs = PressedKeys::kNotPressed;
+                }
+                if ( usage == PressedKeys::kPressDropped )
+                {
+                    continue;
+                }
+                event.usage = usage;
+            }
+        }
+
+        events[ kept++ ] = event;
+    }
+
+    return kept;
+}
+
+
+unsigned int GitHubSample::InputProfile::CountPressed( const KeyStateBitmap& pressed ) const
+{
+    unsigned int count = 0;
+
+    for ( size_t w = 0; w < WORD_COUNT; w++ )
+    {
+        count += __builtin_popcount( pressed.words[ w ] & m_tables.masks.counted.words[ w ] );
+    }
+
+    return count;
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::InputProfile::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) );
+    report.AddHeap( MemoryUsageReport::kKeyTables, m_name.capacity() );
+    return report;
+}
+
+
+
+GitHubSample::InputProfileSwitch::InputProfileSwitch( boost::shared_ptr< const InputProfile > initial )
+    : m_active( initial.get() )
+{
+    if ( ! initial )
+    {
+        assert( ! "InputProfileSwitch needs an initial profile" );
+    }
+
+    m_profiles.push_back( initial );
+    m_union = initial->Masks();
+    m_maskPublisher.reset( new KeyMaskPublisher( m_union ) );
+}
+
+
+size_t GitHubSample::InputProfileSwitch::Add( boost::shared_ptr< const InputProfile > profile )
+{
+    if ( ! profile )
+    {
+        assert( ! "InputProfileSwitch::Add needs a profile" );
+    }
+
+    m_profiles.push_back( profile );
+
+    const KeyInterestMasks& masks = profile->Masks();
+    bool widened = false;
+
+    for ( size_t w = 0; w < WORD_COUNT; w++ )
+    {
+        const uint32_t delivered = m_union.delivered.words[ w ] | masks.delivered.words[ w ];
+        const uint32_t counted = m_union.counted.words[ w ] | masks.counted.words[ w ];
+
+        widened = widened || delivered != m_union.delivered.words[ w ] || counted != m_union.counted.words[ w ];
+
+        m_union.delivered.words[ w ] = delivered;
+        m_union.counted.words[ w ] = counted;
+    }
+
+    if ( widened )
+    {
+        m_maskPublisher->Publish( m_union );
+    }
+
+    return m_profiles.size() - 1;
+}
+
+
+bool GitHubSample::InputProfileSwitch::Activate( const size_t index )
+{
+    if ( index >= m_profiles.size() )
+    {
+        return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    StoreRelease( &m_active, m_profiles[ index ].get() );
+    return true;
+}
+
+
+bool GitHubSample::InputProfileSwitch::Activate( const std::string& name )
+{
+    for ( size_t i = 0; i < m_profiles.size(); i++ )
+    {
+        if ( m_profiles[ i ]->Name() == name )
+        {
+            return Activate( i );
+        }
+    }
+
+    return false;
+}
+
+
+const GitHubSample::InputProfile* GitHubSample::InputProfileSwitch::Active() const
+{
+    return LoadAcquire( &m_active );
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::InputProfileSwitch::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) + sizeof(KeyMaskPublisher) );
+    report.AddHeap( MemoryUsageReport::kKeyTables, CapacityBytes( m_profiles ) );
+
+    for ( size_t i = 0; i < m_profiles.size(); i++ )
+    {
+        report += m_profiles[ i ]->MemoryUsage();
+    }
+
+    return report;
+}
@@ -0,0 +1,238 @@
+
+#ifndef GITHUBSAMPLE_INPUT_PROFILE_H
+#define GITHUBSAMPLE_INPUT_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "KeyEvent.h"
+#include "KeyMaskPublisher.h"
+#include "MemoryUsage.h"
+
+
+namespace GitHubSample
+{
+
+    /**
+       Everything that differs between one application context and the next:
+       which keys are delivered and counted, which keys are remapped to
+       others, which key combinations are hotkeys, and the key repeat rate.
+
+       A profile is compiled once, up front, and is immutable from then on.
+       All of its tables live inside the object itself (no pointers out of
+       it), so one profile is one block of memory, and any number of threads
+       can read it at the same time without any locking.  Switching between
+       profiles is InputProfileSwitch's job.
+
+       Only kHIDPage_KeyboardOrKeypad usages (0..255) can be masked,
+       remapped or used as hotkeys.
+     */
+    class InputProfile
+    {
+    public:
+
+        /// bits of Hotkey::modifiers.  either the left or the right key satisfies them.
+        enum HotkeyModifiers
+        {
+            kHotkeyControl = 0x01,
+            kHotkeyShift   = 0x02,
+            kHotkeyAlt     = 0x04,
+            kHotkeyGUI     = 0x08
+        };
+
+        enum
+        {
+            kUsageCount = KeyStateBitmap::kWordCount * 32,
+            kMaxHotkeys = 64,
+            kNoHotkey = 0
+        };
+
+        struct Remap
+        {
+            uint16_t from;
+            uint16_t to;
+        };
+
+        struct Hotkey
+        {
+            /// HotkeyModifiers.  these have to be held, and no others.
+            uint8_t modifiers;
+            uint16_t usage;
+            /// what HotkeyFor returns.  must not be kNoHotkey.
+            uint32_t id;
+        };
+
+        struct Definition
+        {
+            Definition();
+
+            std::string name;
+            KeyInterestMasks masks;
+            std::vector< Remap > remaps;
+            std::vector< Hotkey > hotkeys;
+            /// nanoseconds from the press to the first repeat, and between repeats.  zero means no repeat.
+            uint64_t repeatDelay;
+            uint64_t repeatInterval;
+        };
+
+        /**
+           What Apply remembers between batches: for each key that is down,
+           the usage its press went out as, or that it was dropped.  Its
+           release then goes out the same way, even when the profile was
+           switched (or the remap changed) while the key was down, so no key
+           is left stuck down downstream.  One per stream of events (per
+           reader), owned by the caller, and kept across profile switches.
+         */
+        struct PressedKeys
+        {
+            enum
+            {
+                kNotPressed = 0xFFFF,  ///< no press seen: the release follows the profile
+                kPressDropped = 0xFFFE ///< the press was not delivered, so neither is the release
+            };
+
+            PressedKeys() { Reset(); }
+
+            /// e.g. after the device was re-opened
+            void Reset();
+
+            uint16_t deliveredAs[ kUsageCount ];
+        };
+
+        /// An empty profile: every key delivered and counted, nothing remapped, no hotkeys, no repeat.
+        InputProfile();
+
+        /// Will return false (and leave the profile as it was) in case of error.
+        bool Compile
+        (
+         const Definition& definition,
+         boost::function< void ( const std::string msg ) > errorLoggerFunctor = 0
+        );
+
+        const std::string& Name() const { return m_name; }
+        const KeyInterestMasks& Masks() const { return m_tables.masks; }
+        uint64_t RepeatDelay() const { return m_tables.repeatDelay; }
+        uint64_t RepeatInterval() const { return m_tables.repeatInterval; }
+
+        /// the usage a key turns into (itself when it is not remapped)
+        uint16_t Remapped( uint16_t usage ) const
+        {
+            return ( usage < kUsageCount ) ? m_tables.remap[ usage ] : usage;
+        }
+
+        /**
+           The id of the hotkey that pressing 'usage' (the REMAPPED usage)
+           triggers while 'modifiers' are held (ModifierAggregator order: bit 0
+           is left control ... bit 7 is right GUI).  kNoHotkey when there is
+           none.  Keys that are no hotkey at all cost one bit test.
+         */
+        uint32_t HotkeyFor( uint8_t modifiers, uint16_t usage ) const;
+
+        /**
+           Applies the profile to a batch straight from the reader, in place:
+           keyboard events for keys that are not delivered are dropped, and
+           the rest are remapped.  Releases go out as their press did (see
+           PressedKeys).  Events of other usage pages pass untouched.
+           Returns how many events are left (at the front).
+         */
+        size_t Apply( KeyEvent* events, size_t count, PressedKeys& pressedKeys ) const;
+
+        /// how many keys of 'pressed' (a SnapshotPressedKeys result) this profile counts
+        unsigned int CountPressed( const KeyStateBitmap& pressed ) const;
+
+        MemoryUsageReport MemoryUsage() const;
+
+    private:
+
+        struct Tables
+        {
+            KeyInterestMasks masks;
+            uint16_t remap[ kUsageCount ];
+            /// the usages that are used by at least one hotkey
+            KeyStateBitmap hotkeyUsages;
+            /// sorted by HotkeyKey
+            Hotkey hotkeys[ kMaxHotkeys ];
+            size_t hotkeyCount;
+            uint64_t repeatDelay;
+            uint64_t repeatInterval;
+        };
+
+        std::string m_name;
+        Tables m_tables;
+
+        static uint32_t HotkeyKey( uint8_t modifiers, uint16_t usage )
+        {
+            return ( static_cast<uint32_t>( usage ) << 8 ) | modifiers;
+        }
+
+        static bool HotkeyLess( const Hotkey& a, const Hotkey& b )
+        {
+            return HotkeyKey( a.modifiers, a.usage ) < HotkeyKey( b.modifiers, b.usage );
+        }
+    };
+
+
+    /**
+       A set of precompiled InputProfiles, one of which is active.
+
+       Activate is a single pointer store: it does not touch any device,
+       queue or reader, and readers of Active() never block.  Profiles are
+       kept until the switch itself goes away, so a consumer that loaded the
+       old pointer just before a switch can still finish its batch with it.
+       Load Active() ONCE per batch, so that one batch is handled by one
+       profile from start to end.
+
+       The readers themselves should not drop anything that ANY profile may
+       want, or the keys that one profile delivers and another ignores would
+       be missing from the IOHID queue right after a switch.  Hand
+       MaskPublisher() to HelperForKeyboardReaderIOKit::SetMaskPublisher:
+       it publishes the union of the masks of all profiles, which changes
+       only when a profile is added, never on Activate.  Each batch is then
+       narrowed down by InputProfile::Apply of the active profile, with the
+       reader's own PressedKeys, so keys held across a switch come back up.
+
+       Add and Activate may be called from ONE thread at a time.
+     */
+    class InputProfileSwitch
+    {
+    public:
+
+        /// 'initial' is added and active.  must not be empty.
+        explicit InputProfileSwitch( boost::shared_ptr< const InputProfile > initial );
+
+        /// returns the index of the profile, for Activate
+        size_t Add( boost::shared_ptr< const InputProfile > profile );
+
+        /// false when there is no such profile (and the active one stays active)
+        bool Activate( size_t index );
+        bool Activate( const std::string& name );
+
+        /// Any thread.  Never NULL.
+        const InputProfile* Active() const;
+
+        size_t ProfileCount() const { return m_profiles.size(); }
+        boost::shared_ptr< const KeyMaskPublisher > MaskPublisher() const { return m_maskPublisher; }
+
+        /// the switch and every profile in it
+        MemoryUsageReport MemoryUsage() const;
+
+    private:
+
+        std::vector< boost::shared_ptr< const InputProfile > > m_profiles;
+        const InputProfile* volatile m_active;
+        KeyInterestMasks m_union;
+        boost::shared_ptr< KeyMaskPublisher > m_maskPublisher;
+
+        /// declared private so as to make this class non-copyable
+        InputProfileSwitch(const InputProfileSwitch&);
+        /// declared private so as to make this class non-copyable
+        InputProfileSwitch& operator=(const InputProfileSwitch&);
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_INPUT_PROFILE_H
@@ -0,0 +1,65 @@
+
+#ifndef GITHUBSAMPLE_KEY_EVENT_H
+#define GITHUBSAMPLE_KEY_EVENT_H
+
+#include <stdint.h>
+
+
+namespace GitHubSample
+{
+
+    /// bits of KeyEvent::flags
+    enum KeyEventFlags
+    {
+        /// TimestampMerger saw this event after it had already emitted later ones
+        kKeyEventLate = 0x0001
+    };
+
+    /**
+       One input edge, in the form that the post-processing stages consume.
+
+       HelperForKeyboardReaderIOKit produces these from IOHIDEventStruct (it
+       translates the element cookie back into a usage page and usage id), and
+       the stages (text reconstruction, etc) only ever see arrays of them.
+       Keeping it a small POD means that a recorded session is just a flat
+       array that can be replayed through the stages as fast as memory allows.
+     */
+    struct KeyEvent
+    {
+        /// raw device timestamp, the 64-bit value of the AbsoluteTime in IOHIDEventStruct
+        uint64_t timestamp;
+        /// e.g. kHIDPage_KeyboardOrKeypad
+        uint16_t usagePage;
+        /// e.g. kHIDUsage_KeyboardA
+        uint16_t usage;
+        /// for button elements, non-zero means PRESSED and zero means RELEASED
+        int32_t  value;
+        /// which reader (keyboard) the event came from
+        uint16_t deviceIndex;
+        /// KeyEventFlags, set by the stages. zero when it comes out of the reader.
+        uint16_t flags;
+    };
+
+    /// One bit per usage id of kHIDPage_KeyboardOrKeypad: set means PRESSED.
+    /// Filled by HelperForKeyboardReaderIOKit::SnapshotPressedKeys.
+    struct KeyStateBitmap
+    {
+        enum { kWordCount = 8 };
+
+        uint32_t words[ kWordCount ];
+
+        bool IsPressed( unsigned int usage ) const
+        {
+            return ( words[ ( usage >> 5 ) & 7 ] >> ( usage & 31 ) ) & 1;
+        }
+
+        void Set( unsigned int usage, bool pressed )
+        {
+            const uint32_t bit = 1u << ( usage & 31 );
+            words[ ( usage >> 5 ) & 7 ] = pressed ? ( words[ ( usage >> 5 ) & 7 ] | bit ) : ( words[ ( usage >> 5 ) & 7 ] & ~bit );
+        }
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_KEY_EVENT_H
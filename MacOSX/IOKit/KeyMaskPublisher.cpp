@@ -0,0 +1,78 @@
+
+
+#include "KeyMaskPublisher.h"
+#include "AtomicOps.h"
+
+#include <string.h>
+
+
+
+GitHubSample::KeyMaskPublisher::KeyMaskPublisher( const KeyInterestMasks& initial )
+    : m_current( m_slots ),
+      m_generation( 0 )
+{
+    memset( m_slots, 0, sizeof(m_slots) );
+    m_slots[ 0 ].masks = initial;
+    FullMemoryBarrier();
+}
+
+
+void GitHubSample::KeyMaskPublisher::Publish( const KeyInterestMasks& masks )
+{
+    m_generation++;
+    Slot& slot = m_slots[ m_generation % kSlotCount ];
+
+    // odd: any reader still copying this (old) slot will see the change and retry
+    StoreRelease( &slot.sequence, slot.sequence + 1 );
+    // a release only keeps EARLIER accesses above it: without this the mask stores below could become visible before the odd count
+    FullMemoryBarrier();
+    slot.generation = m_generation;
+    slot.masks = masks;
+    StoreRelease( &slot.sequence, slot.sequence + 1 );
+
+    StoreRelease( &m_current, &slot );
+}
+
+
+void GitHubSample::KeyMaskPublisher::Read( KeyInterestMasks& masks, uint64_t* generation ) const
+{
+    for ( ;; )
+    {
+        const Slot* slot = LoadAcquire( &m_current );
+        const uint32_t before = LoadAcquire( &slot->sequence );
+
+        if ( before & 1 )
+        {
+            continue; // the writer lapped us and is refilling this very slot
+        }
+
+        // or it lapped us and has refilled it, but not made it current yet: 'current' still names the
+        // publish before, and copying this slot now would hand out a generation that the next Read goes back from
+        if ( LoadAcquire( &m_current ) != slot )
+        {
+            continue;
+        }
+
+        masks = slot->masks;
+        const uint64_t slotGeneration = slot->generation;
+
+        FullMemoryBarrier();
+        if ( slot->sequence == before )
+        {
+            if ( generation )
+            {
+                *generation = slotGeneration;
+            }
+            return;
+        }
+    }
+}
+
+
+uint64_t GitHubSample::KeyMaskPublisher::Generation() const
+{
+    KeyInterestMasks unused;
+    uint64_t generation = 0;
+    Read( unused, &generation );
+    return generation;
+}
@@ -0,0 +1,84 @@
+
+#ifndef GITHUBSAMPLE_KEY_MASK_PUBLISHER_H
+#define GITHUBSAMPLE_KEY_MASK_PUBLISHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "KeyEvent.h"
+
+
+namespace GitHubSample
+{
+
+    /// Which keys an application context cares about, one bit per usage id
+    /// of kHIDPage_KeyboardOrKeypad.
+    struct KeyInterestMasks
+    {
+        /// put on the IOHID queue and handed out by ReadEventsFromQueue / SnapshotPressedKeys
+        KeyStateBitmap delivered;
+        /// counted by CountOfCurrentlyDepressedKeys (a key can be delivered but not counted, like the modifiers)
+        KeyStateBitmap counted;
+    };
+
+
+    /**
+       Publishes KeyInterestMasks from one thread to any number of readers,
+       read-copy-update style: readers NEVER block and never take a lock.
+
+       Each Publish writes the masks into the next of kSlotCount slots and
+       then swaps the 'current' pointer to it.  A reader loads the pointer
+       and copies the slot out (64 bytes).  Slots are only reused
+       kSlotCount - 1 publishes later, and each slot carries a sequence
+       number, so a reader that was preempted for that long notices that
+       its slot was rewritten under it and simply copies the new current
+       one instead.  Nothing is ever freed, so there is no grace period to
+       wait for.
+
+       Publish may be called from ONE thread at a time (use a mutex around
+       it when several threads change the masks).  Publishing is cheap;
+       many changes per second are fine.
+     */
+    class KeyMaskPublisher
+    {
+    public:
+
+        explicit KeyMaskPublisher( const KeyInterestMasks& initial );
+
+        void Publish( const KeyInterestMasks& masks );
+
+        /// Any thread.  'generation' (when not NULL) receives the number of the
+        /// publish that produced 'masks', which grows by one with every Publish.
+        /// The masks are always those of the latest publish at some moment
+        /// during the call, so one thread's Reads never go back a generation.
+        void Read( KeyInterestMasks& masks, uint64_t* generation = 0 ) const;
+
+        /// the number of the latest publish. cheap enough to check on every drain.
+        uint64_t Generation() const;
+
+    private:
+
+        enum { kSlotCount = 8 };
+
+        struct Slot
+        {
+            /// odd while the writer is filling the slot
+            volatile uint32_t sequence;
+            uint64_t generation;
+            KeyInterestMasks masks;
+        };
+
+        Slot m_slots[ kSlotCount ];
+        Slot* volatile m_current;
+        /// writer side only
+        uint64_t m_generation;
+
+        /// declared private so as to make this class non-copyable
+        KeyMaskPublisher(const KeyMaskPublisher&);
+        /// declared private so as to make this class non-copyable
+        KeyMaskPublisher& operator=(const KeyMaskPublisher&);
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_KEY_MASK_PUBLISHER_H
@@ -0,0 +1,346 @@
+
+
+#include "KeyboardLayout.h"
+#include "ErrorLogging.h"
+#include "LittleEndian.h"
+
+#include <boost/format.hpp>
+
+#include <algorithm>
+
+#include <stdio.h>
+#include <string.h>
+
+
+
+namespace
+{
+    const char   LAYOUT_FILE_MAGIC[4] = { 'K', 'B', 'L', 'T' };
+    const size_t LAYOUT_FILE_VERSION = 1;
+    const size_t LAYOUT_FILE_HEADER_SIZE = 32;
+    const size_t LAYOUT_FILE_NAME_SIZE = 16;
+
+    /// the text stage encodes whatever it finds in the table without checking,
+    /// so anything that is not a Unicode scalar value (optionally flagged as a
+    /// dead key), or the Multi_key, must never get into a table.
+    bool IsValidLayoutSymbol( const uint32_t symbol )
+    {
+        if ( symbol == GitHubSample::KeyboardLayout::kMultiKey )
+        {
+            return true;
+        }
+
+        const uint32_t codePoint = symbol & ~GitHubSample::KeyboardLayout::kDeadKeyFlag;
+        const bool isSurrogate = ( codePoint >= 0xD800 && codePoint <= 0xDFFF );
+        return ( codePoint <= 0x10FFFF && ! isSurrogate );
+    }
+}
+
+
+const uint32_t GitHubSample::KeyboardLayout::kDeadKeyFlag;
+const uint32_t GitHubSample::KeyboardLayout::kMultiKey;
+const uint32_t GitHubSample::KeyboardLayout::kCodePointMask;
+
+
+
+GitHubSample::KeyboardLayout::KeyboardLayout()
+    : m_layoutFlags( 0 ),
+      m_codePointTable( 0 ),
+      m_keyFlagTable( 0 )
+{
+}
+
+
+void GitHubSample::KeyboardLayout::Clear()
+{
+    m_name.clear();
+    m_layoutFlags = 0;
+    m_codePointTable = 0;
+    m_keyFlagTable = 0;
+    m_ownedCodePoints.clear();
+    m_ownedKeyFlags.clear();
+}
+
+
+size_t GitHubSample::KeyboardLayout::ImageSize()
+{
+    return LAYOUT_FILE_HEADER_SIZE + kUsageCount + ( kLevelCount * kUsageCount * sizeof(uint32_t) );
+}
+
+
+bool GitHubSample::KeyboardLayout::LoadFromFile
+(
+ const std::string& path,
+ boost::function< void ( const std::string msg ) > errorLoggerFunctor
+)
+{
+    Clear();
+
+    FILE* file = fopen( path.c_str(), "rb" );
+    if ( ! file )
+    {
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, "Failed to open keyboard layout file: " + path );
+        return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    std::vector< uint8_t > image;
+    uint8_t chunk[4096];
+    size_t bytesRead = 0;
+    while ( (bytesRead = fread( chunk, 1, sizeof(chunk), file )) > 0 )
+    {
+        image.insert( image.end(), chunk, chunk + bytesRead );
+    }
+
+    const bool readError = ( ferror( file ) != 0 );
+    fclose( file );
+
+    if ( readError || image.empty() )
+    {
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, "Failed to read keyboard layout file: " + path );
+        return false;
+    }
+
+    return LoadFromMemory( &image[0], image.size(), errorLoggerFunctor );
+}
+
+
+/*
+  Binary layout image.  All multi-byte values are little-endian.
+
+      offset  size  contents
+      ------  ----  --------------------------------------------------------
+           0     4  magic 'KBLT'
+           4     2  version (1)
+           6     2  level count (must be KeyboardLayout::kLevelCount)
+           8     2  usage count (must be KeyboardLayout::kUsageCount)
+          10     2  layout flags (KeyboardLayout::LayoutFlags)
+          12     4  reserved, zero
+          16    16  layout name, UTF-8, zero padded
+          32   256  one KeyFlags byte per usage id
+         288  4096  code points, uint32 each, level-major (all of level 0 first)
+
+  That is 4384 bytes per layout, which is small enough that we never bother
+  compressing it, and the code point table begins on a 32-byte boundary so it
+  can be used in place once it has been mapped into memory.
+*/
+/// Checks the header, fills in the name and layout flags, and returns a pointer to the
+/// KeyFlags bytes (the code points follow them).  Returns NULL when the image is unusable.
+const uint8_t* GitHubSample::KeyboardLayout::ParseHeader
+(
+ const void* data,
+ const size_t size,
+ boost::function< void ( const std::string msg ) > errorLoggerFunctor
+)
+{
+    Clear();
+
+    const uint8_t* bytes = static_cast<const uint8_t*>( data );
+
+    if ( ! bytes || size < LAYOUT_FILE_HEADER_SIZE || 0 != memcmp( bytes, LAYOUT_FILE_MAGIC, sizeof(LAYOUT_FILE_MAGIC) ) )
+    {
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, "Keyboard layout image has no 'KBLT' header." );
+        return 0; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    const uint16_t version = ReadLittleEndian16( bytes + 4 );
+    const uint16_t levelCount = ReadLittleEndian16( bytes + 6 );
+    const uint16_t usageCount = ReadLittleEndian16( bytes + 8 );
+
+    if ( version != LAYOUT_FILE_VERSION || levelCount != kLevelCount || usageCount != kUsageCount || size < ImageSize() )
+    {
+        std::string msg = boost::str( boost::format("Unsupported keyboard layout image. version: %1%. levels: %2%. usages: %3%. size: %4%")
+                                      % version % levelCount % usageCount % size );
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, msg );
+        return 0;
+    }
+
+    // no strnlen on 10.5
+    const char* name = reinterpret_cast<const char*>( bytes + 16 );
+    const void* terminator = memchr( name, '\0', LAYOUT_FILE_NAME_SIZE );
+    m_name.assign( name, terminator ? static_cast<const char*>( terminator ) - name : LAYOUT_FILE_NAME_SIZE );
+    m_layoutFlags = ReadLittleEndian16( bytes + 10 );
+
+    return bytes + LAYOUT_FILE_HEADER_SIZE;
+}
+
+
+bool GitHubSample::KeyboardLayout::LoadFromMemory
+(
+ const void* data,
+ const size_t size,
+ boost::function< void ( const std::string msg ) > errorLoggerFunctor
+)
+{
+    const uint8_t* flags = ParseHeader( data, size, errorLoggerFunctor );
+    if ( ! flags )
+    {
+        return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    m_ownedKeyFlags.assign( flags, flags + kUsageCount );
+
+    const uint8_t* codePoints = flags + kUsageCount;
+    m_ownedCodePoints.resize( kLevelCount * kUsageCount );
+    for ( size_t i = 0; i < m_ownedCodePoints.size(); i++ )
+    {
+        const uint32_t symbol = ReadLittleEndian32( codePoints + ( i * sizeof(uint32_t) ) );
+        m_ownedCodePoints[i] = IsValidLayoutSymbol( symbol ) ? symbol : 0;
+    }
+
+    m_keyFlagTable = &m_ownedKeyFlags[0];
+    m_codePointTable = &m_ownedCodePoints[0];
+    return true;
+}
+
+
+bool GitHubSample::KeyboardLayout::AttachToMemory
+(
+ const void* data,
+ const size_t size,
+ boost::function< void ( const std::string msg ) > errorLoggerFunctor
+)
+{
+    const uint8_t* flags = ParseHeader( data, size, errorLoggerFunctor );
+    if ( ! flags )
+    {
+        return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    const uint8_t* codePointBytes = flags + kUsageCount;
+    bool usableInPlace = HostIsLittleEndian() && ( 0 == ( reinterpret_cast<size_t>( codePointBytes ) % sizeof(uint32_t) ) );
+
+    const uint32_t* codePoints = reinterpret_cast<const uint32_t*>( codePointBytes );
+    for ( size_t i = 0; usableInPlace && i < kLevelCount * kUsageCount; i++ )
+    {
+        usableInPlace = IsValidLayoutSymbol( codePoints[i] );
+    }
+
+    if ( ! usableInPlace )
+    {
+        return LoadFromMemory( data, size, errorLoggerFunctor );
+    }
+
+    m_keyFlagTable = flags;
+    m_codePointTable = codePoints;
+    return true;
+}
+
+
+std::vector< uint8_t > GitHubSample::KeyboardLayout::SaveToMemory() const
+{
+    std::vector< uint8_t > image;
+
+    if ( IsEmpty() )
+    {
+        return image;
+    }
+
+    image.resize( ImageSize(), 0 );
+
+    memcpy( &image[0], LAYOUT_FILE_MAGIC, sizeof(LAYOUT_FILE_MAGIC) );
+    WriteLittleEndian16( &image[4], LAYOUT_FILE_VERSION );
+    WriteLittleEndian16( &image[6], kLevelCount );
+    WriteLittleEndian16( &image[8], kUsageCount );
+    WriteLittleEndian16( &image[10], m_layoutFlags );
+    memcpy( &image[16], m_name.data(), std::min( m_name.size(), LAYOUT_FILE_NAME_SIZE ) );
+
+    memcpy( &image[LAYOUT_FILE_HEADER_SIZE], m_keyFlagTable, kUsageCount );
+
+    uint8_t* codePoints = &image[LAYOUT_FILE_HEADER_SIZE + kUsageCount];
+    for ( size_t i = 0; i < kLevelCount * kUsageCount; i++ )
+    {
+        WriteLittleEndian32( codePoints + ( i * sizeof(uint32_t) ), m_codePointTable[i] );
+    }
+
+    return image;
+}
+
+
+void GitHubSample::KeyboardLayout::SetKey
+(
+ const unsigned int usage,
+ const uint32_t base,
+ const uint32_t shifted,
+ const uint8_t flags
+)
+{
+    m_ownedCodePoints[ kLevelBase  * kUsageCount + usage ] = base;
+    m_ownedCodePoints[ kLevelShift * kUsageCount + usage ] = shifted;
+    m_ownedKeyFlags[ usage ] = flags;
+}
+
+
+/**
+   The usage ids here are the kHIDUsage_Keyboard* / kHIDUsage_Keypad* values
+   from IOHIDUsageTables.h.  We spell them as numbers so that this file does not
+   need any IOKit headers (the layout code is also used off-mac, on recorded
+   sessions).
+*/
+void GitHubSample::KeyboardLayout::LoadBuiltInUSLayout()
+{
+    Clear();
+
+    m_name = "US";
+    m_ownedCodePoints.resize( kLevelCount * kUsageCount, 0 );
+    m_ownedKeyFlags.resize( kUsageCount, 0 );
+    m_codePointTable = &m_ownedCodePoints[0];
+    m_keyFlagTable = &m_ownedKeyFlags[0];
+
+    // kHIDUsage_KeyboardA through kHIDUsage_KeyboardZ
+    for ( unsigned int i = 0; i < 26; i++ )
+    {
+        SetKey( 0x04 + i, 'a' + i, 'A' + i, kCapsLockAffectsKey );
+    }
+
+    // kHIDUsage_Keyboard1 through kHIDUsage_Keyboard0
+    static const char digits[]        = "1234567890";
+    static const char shiftedDigits[] = "!@#$%^&*()";
+    for ( unsigned int i = 0; i < 10; i++ )
+    {
+        SetKey( 0x1E + i, digits[i], shiftedDigits[i] );
+    }
+
+    SetKey( 0x28, '\n', '\n' ); // kHIDUsage_KeyboardReturnOrEnter
+    SetKey( 0x2A, '\b', '\b' ); // kHIDUsage_KeyboardDeleteOrBackspace
+    SetKey( 0x2B, '\t', '\t' ); // kHIDUsage_KeyboardTab
+    SetKey( 0x2C, ' ',  ' '  ); // kHIDUsage_KeyboardSpacebar
+    SetKey( 0x2D, '-',  '_'  ); // kHIDUsage_KeyboardHyphen
+    SetKey( 0x2E, '=',  '+'  ); // kHIDUsage_KeyboardEqualSign
+    SetKey( 0x2F, '[',  '{'  ); // kHIDUsage_KeyboardOpenBracket
+    SetKey( 0x30, ']',  '}'  ); // kHIDUsage_KeyboardCloseBracket
+    SetKey( 0x31, '\\', '|'  ); // kHIDUsage_KeyboardBackslash
+    SetKey( 0x33, ';',  ':'  ); // kHIDUsage_KeyboardSemicolon
+    SetKey( 0x34, '\'', '"'  ); // kHIDUsage_KeyboardQuote
+    SetKey( 0x35, '`',  '~'  ); // kHIDUsage_KeyboardGraveAccentAndTilde
+    SetKey( 0x36, ',',  '<'  ); // kHIDUsage_KeyboardComma
+    SetKey( 0x37, '.',  '>'  ); // kHIDUsage_KeyboardPeriod
+    SetKey( 0x38, '/',  '?'  ); // kHIDUsage_KeyboardSlash
+
+    SetKey( 0x54, '/',  '/'  ); // kHIDUsage_KeypadSlash
+    SetKey( 0x55, '*',  '*'  ); // kHIDUsage_KeypadAsterisk
+    SetKey( 0x56, '-',  '-'  ); // kHIDUsage_KeypadHyphen
+    SetKey( 0x57, '+',  '+'  ); // kHIDUsage_KeypadPlus
+    SetKey( 0x58, '\n', '\n' ); // kHIDUsage_KeypadEnter
+
+    // kHIDUsage_Keypad1 through kHIDUsage_Keypad0, then kHIDUsage_KeypadPeriod.
+    // With num lock off these are navigation keys, so they make no text.
+    static const char keypad[] = "1234567890.";
+    for ( unsigned int i = 0; i < 11; i++ )
+    {
+        SetKey( 0x59 + i, keypad[i], 0, kNumLockAffectsKey );
+    }
+
+    SetKey( 0x67, '=',  '='  ); // kHIDUsage_KeypadEqualSign
+
+    // the AltGr levels stay empty. US ANSI has nothing there.
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::KeyboardLayout::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) );
+    report.AddHeap( MemoryUsageReport::kLayoutTables, CapacityBytes( m_ownedCodePoints ) + CapacityBytes( m_ownedKeyFlags ) );
+    report.AddHeap( MemoryUsageReport::kLayoutTables, m_name.capacity() );
+    return report;
+}
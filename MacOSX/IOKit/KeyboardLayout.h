@@ -0,0 +1,165 @@
+
+#ifndef GITHUBSAMPLE_KEYBOARD_LAYOUT_H
+#define GITHUBSAMPLE_KEYBOARD_LAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+
+#include "MemoryUsage.h"
+
+
+namespace GitHubSample
+{
+
+    /**
+       A dense, precomputed table that maps (modifier level, keyboard usage id)
+       to a Unicode code point.
+
+       Every level is a flat array of kUsageCount code points indexed directly
+       by the usage id from kHIDPage_KeyboardOrKeypad, so a lookup is one
+       multiply-add and one load.  A code point of zero means "this key does not
+       produce text at this level".
+
+       Layouts are stored on disk in a compact binary form (see the comment
+       block above LoadFromMemory in KeyboardLayout.cpp for the byte layout).
+       A US layout is built in, so that text reconstruction works even when no
+       layout file is available.
+     */
+    class KeyboardLayout
+    {
+    public:
+
+        enum
+        {
+            kUsageCount = 256,
+            kLevelCount = 4
+        };
+
+        /// the row of the table to use. bit 0 is 'shift', bit 1 is 'AltGr' (Option on a mac).
+        enum Level
+        {
+            kLevelBase       = 0,
+            kLevelShift      = 1,
+            kLevelAltGr      = 2,
+            kLevelShiftAltGr = 3
+        };
+
+        /// per-usage flags that tell the text stage how lock keys interact with the key
+        enum KeyFlags
+        {
+            kCapsLockAffectsKey = 0x01, ///< caps lock inverts 'shift' for this key (letters)
+            kNumLockAffectsKey  = 0x02  ///< key only produces text while num lock is on (keypad)
+        };
+
+        /// A code point with this bit set is a DEAD KEY: the accent waits for
+        /// the next key (see ComposeTable).  The rest of the value is the
+        /// spacing form of the accent, which is what gets typed when the dead
+        /// key is not followed by anything it combines with.
+        static const uint32_t kDeadKeyFlag = 0x80000000u;
+        /// the X11 Multi_key (compose key).  It types nothing by itself.
+        static const uint32_t kMultiKey = 0x801FFFFFu;
+        /// strips kDeadKeyFlag
+        static const uint32_t kCodePointMask = 0x001FFFFFu;
+
+        /// whole-layout flags
+        enum LayoutFlags
+        {
+            kLeftAltActsAsAltGr = 0x0001 ///< mac style: BOTH option keys select the AltGr level
+        };
+
+        KeyboardLayout();
+
+        /// Will return false (and leave the layout empty) in case of error.
+        bool LoadFromFile
+        (
+         const std::string& path,
+         boost::function< void ( const std::string msg ) > errorLoggerFunctor = 0
+        );
+
+        /// Same as LoadFromFile, but parses a layout image that is already in memory.  The bytes are copied.
+        bool LoadFromMemory
+        (
+         const void* data,
+         size_t size,
+         boost::function< void ( const std::string msg ) > errorLoggerFunctor = 0
+        );
+
+        /**
+           Like LoadFromMemory, but the tables are used IN PLACE (no copy), so
+           'data' must stay valid for as long as this layout is used.  This is
+           how KeyboardLayoutDatabase shares one read-only mapping among every
+           reader.  When the image cannot be used in place (big-endian host,
+           misaligned, or it holds invalid symbols) this quietly falls back
+           to a copy.
+         */
+        bool AttachToMemory
+        (
+         const void* data,
+         size_t size,
+         boost::function< void ( const std::string msg ) > errorLoggerFunctor = 0
+        );
+
+        /// the size of one layout image, as written by SaveToMemory
+        static size_t ImageSize();
+
+        /// Replaces the contents of this layout with the built-in US (ANSI) layout.
+        void LoadBuiltInUSLayout();
+
+        /// Serializes the layout into the same binary form that LoadFromMemory reads.
+        std::vector< uint8_t > SaveToMemory() const;
+
+        bool IsEmpty() const { return m_codePointTable == 0; }
+        /// true when the tables live in someone else's memory (see AttachToMemory)
+        bool IsAttached() const { return m_codePointTable != 0 && m_ownedCodePoints.empty(); }
+        const std::string& Name() const { return m_name; }
+        uint16_t Flags() const { return m_layoutFlags; }
+
+        /// 'usage' MUST be below kUsageCount and 'level' MUST be below kLevelCount.
+        uint32_t CodePoint( unsigned int level, unsigned int usage ) const
+        {
+            return m_codePointTable[ level * kUsageCount + usage ];
+        }
+
+        uint8_t KeyFlagsForUsage( unsigned int usage ) const
+        {
+            return m_keyFlagTable[ usage ];
+        }
+
+        /// the raw dense tables. kLevelCount * kUsageCount code points, and kUsageCount flag bytes.
+        const uint32_t* CodePointTable() const { return m_codePointTable; }
+        const uint8_t* KeyFlagsTable() const { return m_keyFlagTable; }
+
+        /// an attached layout owns no tables (they belong to the database's mapping)
+        MemoryUsageReport MemoryUsage() const;
+
+    private:
+
+        std::string m_name;
+        uint16_t m_layoutFlags;
+        /// these point either at the two vectors below, or into attached memory
+        const uint32_t* m_codePointTable;
+        const uint8_t* m_keyFlagTable;
+        std::vector< uint32_t > m_ownedCodePoints;
+        std::vector< uint8_t > m_ownedKeyFlags;
+
+        void Clear();
+        const uint8_t* ParseHeader
+        (
+         const void* data,
+         size_t size,
+         boost::function< void ( const std::string msg ) > errorLoggerFunctor
+        );
+        void SetKey( unsigned int usage, uint32_t base, uint32_t shifted, uint8_t flags = 0 );
+
+        /// declared private so as to make this class non-copyable
+        KeyboardLayout(const KeyboardLayout&);
+        /// declared private so as to make this class non-copyable
+        KeyboardLayout& operator=(const KeyboardLayout&);
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_KEYBOARD_LAYOUT_H
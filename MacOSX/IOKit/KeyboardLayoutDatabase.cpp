@@ -0,0 +1,314 @@
+
+
+#include "KeyboardLayoutDatabase.h"
+#include "ErrorLogging.h"
+#include "LittleEndian.h"
+
+#include <boost/format.hpp>
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+
+namespace
+{
+    const char   DATABASE_FILE_MAGIC[4] = { 'K', 'B', 'D', 'B' };
+    const size_t DATABASE_FILE_VERSION = 1;
+    const size_t DATABASE_FILE_HEADER_SIZE = 32;
+    const size_t DATABASE_RULE_SIZE = 8;
+    /// layouts start on this boundary (and KeyboardLayout::ImageSize() is a multiple of it)
+    const size_t DATABASE_LAYOUT_ALIGNMENT = 32;
+
+    size_t RoundUpToLayoutAlignment( const size_t offset )
+    {
+        return ( offset + DATABASE_LAYOUT_ALIGNMENT - 1 ) & ~( DATABASE_LAYOUT_ALIGNMENT - 1 );
+    }
+}
+
+
+
+GitHubSample::KeyboardLayoutDatabase::KeyboardLayoutDatabase()
+    : m_mappedAddress( MAP_FAILED ),
+      m_mappedSize( 0 )
+{
+}
+
+
+GitHubSample::KeyboardLayoutDatabase::~KeyboardLayoutDatabase()
+{
+    Close();
+}
+
+
+void GitHubSample::KeyboardLayoutDatabase::Close()
+{
+    // the layouts point into the mapping, so they go first
+    m_layouts.clear();
+    m_rules.clear();
+
+    if ( m_mappedAddress != MAP_FAILED )
+    {
+        munmap( m_mappedAddress, m_mappedSize );
+        m_mappedAddress = MAP_FAILED;
+        m_mappedSize = 0;
+    }
+}
+
+
+/*
+  Database file.  All multi-byte values are little-endian.
+
+      offset  size  contents
+      ------  ----  --------------------------------------------------------
+           0     4  magic 'KBDB'
+           4     2  version (1)
+           6     2  layout count
+           8     2  rule count
+          10     2  reserved, zero
+          12     4  file offset of the first layout image (a multiple of 32)
+          16    16  reserved, zero
+          32   8*n  SelectionRule: country code, vendor id, product id, layout index
+                    (uint16 each)
+         ...        zero padding up to the first layout image
+         ...        the layout images, back to back, each exactly
+                    KeyboardLayout::ImageSize() bytes (see KeyboardLayout.cpp)
+*/
+bool GitHubSample::KeyboardLayoutDatabase::Open
+(
+ const std::string& path,
+ boost::function< void ( const std::string msg ) > errorLoggerFunctor
+)
+{
+    Close();
+
+    const int fd = open( path.c_str(), O_RDONLY );
+    if ( fd < 0 )
+    {
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, "Failed to open keyboard layout database: " + path );
+        return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    struct stat fileInfo;
+    if ( 0 == fstat( fd, &fileInfo ) && fileInfo.st_size >= static_cast<off_t>( DATABASE_FILE_HEADER_SIZE ) )
+    {
+        m_mappedSize = static_cast<size_t>( fileInfo.st_size );
+        m_mappedAddress = mmap( 0, m_mappedSize, PROT_READ, MAP_SHARED, fd, 0 );
+    }
+
+    // the mapping keeps its own reference to the file
+    close( fd );
+
+    if ( m_mappedAddress == MAP_FAILED )
+    {
+        m_mappedSize = 0;
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, "Failed to map keyboard layout database: " + path );
+        return false;
+    }
+
+    const uint8_t* bytes = static_cast<const uint8_t*>( m_mappedAddress );
+
+    const size_t layoutCount = ReadLittleEndian16( bytes + 6 );
+    const size_t ruleCount = ReadLittleEndian16( bytes + 8 );
+    const size_t firstLayoutOffset = ReadLittleEndian32( bytes + 12 );
+
+    const bool headerIsSane =
+        0 == memcmp( bytes, DATABASE_FILE_MAGIC, sizeof(DATABASE_FILE_MAGIC) )
+        && ReadLittleEndian16( bytes + 4 ) == DATABASE_FILE_VERSION
+        && firstLayoutOffset % DATABASE_LAYOUT_ALIGNMENT == 0
+        && firstLayoutOffset >= DATABASE_FILE_HEADER_SIZE + ( ruleCount * DATABASE_RULE_SIZE )
+        // subtract, don't add: with a 32-bit size_t an offset near 4 GB plus the images would wrap around
+        && firstLayoutOffset <= m_mappedSize
+        && layoutCount <= ( m_mappedSize - firstLayoutOffset ) / KeyboardLayout::ImageSize();
+
+    if ( ! headerIsSane )
+    {
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, "Keyboard layout database is damaged or of an unknown version: " + path );
+        Close();
+        return false;
+    }
+
+    for ( size_t i = 0; i < ruleCount; i++ )
+    {
+        const uint8_t* ruleBytes = bytes + DATABASE_FILE_HEADER_SIZE + ( i * DATABASE_RULE_SIZE );
+
+        SelectionRule rule;
+        rule.countryCode = ReadLittleEndian16( ruleBytes );
+        rule.vendorId    = ReadLittleEndian16( ruleBytes + 2 );
+        rule.productId   = ReadLittleEndian16( ruleBytes + 4 );
+        rule.layoutIndex = ReadLittleEndian16( ruleBytes + 6 );
+
+        if ( rule.layoutIndex >= layoutCount )
+        {
+            std::string msg = boost::str( boost::format("Keyboard layout database rule %1% names layout %2%, but there are only %3%.")
+                                          % i % rule.layoutIndex % layoutCount );
+            LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, msg );
+            continue;
+        }
+
+        m_rules.push_back( rule );
+    }
+
+    for ( size_t i = 0; i < layoutCount; i++ )
+    {
+        boost::shared_ptr< KeyboardLayout > layout( new KeyboardLayout );
+
+        const uint8_t* image = bytes + firstLayoutOffset + ( i * KeyboardLayout::ImageSize() );
+        if ( ! layout->AttachToMemory( image, KeyboardLayout::ImageSize(), errorLoggerFunctor ) )
+        {
+            Close();
+            return false;
+        }
+
+        m_layouts.push_back( layout );
+    }
+
+    return true;
+}
+
+
+bool GitHubSample::KeyboardLayoutDatabase::Save
+(
+ const std::string& path,
+ const std::vector< const KeyboardLayout* >& layouts,
+ const std::vector< SelectionRule >& rules,
+ boost::function< void ( const std::string msg ) > errorLoggerFunctor
+)
+{
+    // the header has 16 bits for each count
+    if ( layouts.size() > 0xFFFF || rules.size() > 0xFFFF )
+    {
+        std::string msg = boost::str( boost::format("Refusing to save %1% keyboard layouts and %2% rules: a database holds at most 65535 of each.")
+                                      % layouts.size() % rules.size() );
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, msg );
+        return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    const size_t firstLayoutOffset = RoundUpToLayoutAlignment( DATABASE_FILE_HEADER_SIZE + ( rules.size() * DATABASE_RULE_SIZE ) );
+
+    std::vector< uint8_t > image( firstLayoutOffset, 0 );
+
+    memcpy( &image[0], DATABASE_FILE_MAGIC, sizeof(DATABASE_FILE_MAGIC) );
+    WriteLittleEndian16( &image[4], DATABASE_FILE_VERSION );
+    WriteLittleEndian16( &image[6], static_cast<uint16_t>( layouts.size() ) );
+    WriteLittleEndian16( &image[8], static_cast<uint16_t>( rules.size() ) );
+    WriteLittleEndian32( &image[12], static_cast<uint32_t>( firstLayoutOffset ) );
+
+    for ( size_t i = 0; i < rules.size(); i++ )
+    {
+        uint8_t* ruleBytes = &image[ DATABASE_FILE_HEADER_SIZE + ( i * DATABASE_RULE_SIZE ) ];
+        WriteLittleEndian16( ruleBytes,     rules[i].countryCode );
+        WriteLittleEndian16( ruleBytes + 2, rules[i].vendorId );
+        WriteLittleEndian16( ruleBytes + 4, rules[i].productId );
+        WriteLittleEndian16( ruleBytes + 6, rules[i].layoutIndex );
+    }
+
+    for ( size_t i = 0; i < layouts.size(); i++ )
+    {
+        const std::vector< uint8_t > layoutImage = layouts[i]->SaveToMemory();
+        if ( layoutImage.size() != KeyboardLayout::ImageSize() )
+        {
+            LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, "Refusing to save an empty keyboard layout into a database." );
+            return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+        }
+
+        image.insert( image.end(), layoutImage.begin(), layoutImage.end() );
+    }
+
+    FILE* file = fopen( path.c_str(), "wb" );
+    const bool success = file
+        && fwrite( &image[0], 1, image.size(), file ) == image.size()
+        && 0 == fclose( file );
+
+    if ( ! success )
+    {
+        LogErrorWhenFunctorIsntEmpty( errorLoggerFunctor, "Failed to write keyboard layout database: " + path );
+    }
+
+    return success;
+}
+
+
+const GitHubSample::KeyboardLayout* GitHubSample::KeyboardLayoutDatabase::SelectLayout
+(
+ const uint16_t countryCode,
+ const uint16_t vendorId,
+ const uint16_t productId
+) const
+{
+    if ( m_layouts.empty() )
+    {
+        return NULL;
+    }
+
+    size_t bestLayout = 0;
+    int bestScore = -1;
+
+    std::vector< SelectionRule >::const_iterator iter = m_rules.begin();
+    while ( iter != m_rules.end() )
+    {
+        // a wildcard matches anything, and scores nothing
+        const bool countryMatches = ( iter->countryCode == kMatchAny || iter->countryCode == countryCode );
+        const bool vendorMatches  = ( iter->vendorId    == kMatchAny || iter->vendorId    == vendorId );
+        const bool productMatches = ( iter->productId   == kMatchAny || iter->productId   == productId );
+
+        if ( countryMatches && vendorMatches && productMatches )
+        {
+            const int score = ( iter->productId   != kMatchAny ? 4 : 0 )
+                +             ( iter->vendorId    != kMatchAny ? 2 : 0 )
+                +             ( iter->countryCode != kMatchAny ? 1 : 0 );
+
+            if ( score > bestScore )
+            {
+                bestScore = score;
+                bestLayout = iter->layoutIndex;
+            }
+        }
+
+        iter++;
+    }
+
+    return m_layouts[ bestLayout ].get();
+}
+
+
+const char* GitHubSample::KeyboardLayoutDatabase::CountryCodeName( const uint16_t countryCode )
+{
+    static const char* const names[] =
+    {
+        "Not Supported", "Arabic", "Belgian", "Canadian-Bilingual", "Canadian-French",
+        "Czech Republic", "Danish", "Finnish", "French", "German", "Greek", "Hebrew",
+        "Hungary", "International (ISO)", "Italian", "Japan (Katakana)", "Korean",
+        "Latin American", "Netherlands/Dutch", "Norwegian", "Persian (Farsi)", "Poland",
+        "Portuguese", "Russia", "Slovakia", "Spanish", "Swedish", "Swiss/French",
+        "Swiss/German", "Switzerland", "Taiwan", "Turkish-Q", "UK", "US", "Yugoslavia",
+        "Turkish-F"
+    };
+
+    if ( countryCode >= sizeof(names) / sizeof(names[0]) )
+    {
+        return "Unknown";
+    }
+
+    return names[ countryCode ];
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::KeyboardLayoutDatabase::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) );
+    report.AddMapping( MemoryUsageReport::kLayoutTables, m_mappedAddress, m_mappedSize );
+    report.AddHeap( MemoryUsageReport::kLayoutTables, CapacityBytes( m_layouts ) + CapacityBytes( m_rules ) );
+
+    for ( size_t i = 0; i < m_layouts.size(); i++ )
+    {
+        report += m_layouts[ i ]->MemoryUsage();
+    }
+
+    return report;
+}
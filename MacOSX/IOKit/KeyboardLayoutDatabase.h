@@ -0,0 +1,108 @@
+
+#ifndef GITHUBSAMPLE_KEYBOARD_LAYOUT_DATABASE_H
+#define GITHUBSAMPLE_KEYBOARD_LAYOUT_DATABASE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+
+#include "KeyboardLayout.h"
+#include "MemoryUsage.h"
+
+
+namespace GitHubSample
+{
+
+    /**
+       A read-only file of many KeyboardLayout images plus the rules that pick
+       one of them for a given keyboard.
+
+       The file is mmap'ed (read-only, shared), and every KeyboardLayout handed
+       out is attached IN PLACE to that mapping.  So no matter how many readers
+       (or processes) open the same database, there is exactly one copy of the
+       tables in memory: the page cache.  Create ONE database and pass the same
+       boost::shared_ptr to every HelperForKeyboardReaderIOKit.
+
+       Selection uses the HID country code (kIOHIDCountryCodeKey, see section
+       6.2.1 of the USB HID spec) together with the vendor and product ids.
+       Vendor/product rules exist for the keyboards that report a useless
+       country code (many report zero, "not supported").
+     */
+    class KeyboardLayoutDatabase
+    {
+    public:
+
+        enum
+        {
+            kMatchAny = 0xFFFF ///< wildcard for any field of a SelectionRule
+        };
+
+        /// 'layoutIndex' is used when the keyboard matches every non-wildcard field
+        struct SelectionRule
+        {
+            uint16_t countryCode;
+            uint16_t vendorId;
+            uint16_t productId;
+            uint16_t layoutIndex;
+        };
+
+        KeyboardLayoutDatabase();
+        ~KeyboardLayoutDatabase();
+
+        /// Will return false (and leave the database empty) in case of error.
+        bool Open
+        (
+         const std::string& path,
+         boost::function< void ( const std::string msg ) > errorLoggerFunctor = 0
+        );
+
+        /// Writes a database file that Open can read.  Fails (and logs) for more than 65535 layouts or rules.
+        static bool Save
+        (
+         const std::string& path,
+         const std::vector< const KeyboardLayout* >& layouts,
+         const std::vector< SelectionRule >& rules,
+         boost::function< void ( const std::string msg ) > errorLoggerFunctor = 0
+        );
+
+        size_t LayoutCount() const { return m_layouts.size(); }
+        const KeyboardLayout& LayoutAt( size_t index ) const { return *m_layouts[ index ]; }
+
+        /**
+           The most specific matching rule wins: a product match beats a vendor
+           match, which beats a country code match.  Among equally specific
+           rules the first one in the file wins.  When nothing matches, the
+           first layout in the file is returned.  Returns NULL only when the
+           database is empty.
+
+           Pass kMatchAny for anything the device did not report.
+         */
+        const KeyboardLayout* SelectLayout( uint16_t countryCode, uint16_t vendorId, uint16_t productId ) const;
+
+        /// "German", "US", etc.  The names from the USB HID spec.  "Unknown" when out of range.
+        static const char* CountryCodeName( uint16_t countryCode );
+
+        /// the mapping (resident is how much of it was touched), plus every layout and rule
+        MemoryUsageReport MemoryUsage() const;
+
+    private:
+
+        void* m_mappedAddress;
+        size_t m_mappedSize;
+        std::vector< boost::shared_ptr< KeyboardLayout > > m_layouts;
+        std::vector< SelectionRule > m_rules;
+
+        void Close();
+
+        /// declared private so as to make this class non-copyable
+        KeyboardLayoutDatabase(const KeyboardLayoutDatabase&);
+        /// declared private so as to make this class non-copyable
+        KeyboardLayoutDatabase& operator=(const KeyboardLayoutDatabase&);
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_KEYBOARD_LAYOUT_DATABASE_H
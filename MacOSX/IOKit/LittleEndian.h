@@ -0,0 +1,61 @@
+
+#ifndef GITHUBSAMPLE_LITTLE_ENDIAN_H
+#define GITHUBSAMPLE_LITTLE_ENDIAN_H
+
+#include <stdint.h>
+
+
+namespace GitHubSample
+{
+
+    /// Our binary files are always little-endian, no matter what the host is
+    /// (10.5 still runs on PowerPC).  These read and write them byte by byte.
+
+    inline uint16_t ReadLittleEndian16( const uint8_t* p )
+    {
+        return static_cast<uint16_t>( p[0] | (p[1] << 8) );
+    }
+
+    inline uint32_t ReadLittleEndian32( const uint8_t* p )
+    {
+        return static_cast<uint32_t>( p[0] )
+            | ( static_cast<uint32_t>( p[1] ) << 8 )
+            | ( static_cast<uint32_t>( p[2] ) << 16 )
+            | ( static_cast<uint32_t>( p[3] ) << 24 );
+    }
+
+    inline uint64_t ReadLittleEndian64( const uint8_t* p )
+    {
+        return static_cast<uint64_t>( ReadLittleEndian32( p ) )
+            | ( static_cast<uint64_t>( ReadLittleEndian32( p + 4 ) ) << 32 );
+    }
+
+    inline void WriteLittleEndian16( uint8_t* p, const uint16_t value )
+    {
+        p[0] = static_cast<uint8_t>( value );
+        p[1] = static_cast<uint8_t>( value >> 8 );
+    }
+
+    inline void WriteLittleEndian32( uint8_t* p, const uint32_t value )
+    {
+        p[0] = static_cast<uint8_t>( value );
+        p[1] = static_cast<uint8_t>( value >> 8 );
+        p[2] = static_cast<uint8_t>( value >> 16 );
+        p[3] = static_cast<uint8_t>( value >> 24 );
+    }
+
+    inline void WriteLittleEndian64( uint8_t* p, const uint64_t value )
+    {
+        WriteLittleEndian32( p, static_cast<uint32_t>( value ) );
+        WriteLittleEndian32( p + 4, static_cast<uint32_t>( value >> 32 ) );
+    }
+
+    inline bool HostIsLittleEndian()
+    {
+        static const uint32_t one = 1;
+        return ( *reinterpret_cast<const uint8_t*>( &one ) == 1 );
+    }
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_LITTLE_ENDIAN_H
@@ -0,0 +1,141 @@
+
+
+#include "MemoryUsage.h"
+
+#include <boost/format.hpp>
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+
+
+namespace
+{
+    const char* const CATEGORY_NAMES[ GitHubSample::MemoryUsageReport::kCategoryCount ] =
+    {
+        "object",
+        "key tables",
+        "property strings",
+        "layout tables",
+        "compose tables",
+        "event buffers",
+        "device state"
+    };
+
+#ifdef __DARWIN__
+    typedef char MincoreByte;
+#else
+    typedef unsigned char MincoreByte;
+#endif
+}
+
+
+
+GitHubSample::MemoryUsageReport::MemoryUsageReport()
+{
+    memset( m_bytes, 0, sizeof(m_bytes) );
+}
+
+
+void GitHubSample::MemoryUsageReport::AddHeap( const Category category, const size_t bytes )
+{
+    m_bytes[ category ].reserved += bytes;
+    m_bytes[ category ].resident += bytes;
+}
+
+
+void GitHubSample::MemoryUsageReport::AddMapping( const Category category, const void* address, const size_t size )
+{
+    // whole pages are resident, but only 'size' of them is ours
+    const size_t resident = ResidentBytesOf( address, size );
+    m_bytes[ category ].reserved += size;
+    m_bytes[ category ].resident += ( resident < size ) ? resident : size;
+}
+
+
+GitHubSample::MemoryUsageReport& GitHubSample::MemoryUsageReport::operator+=( const MemoryUsageReport& other )
+{
+    for ( size_t i = 0; i < kCategoryCount; i++ )
+    {
+        m_bytes[ i ].reserved += other.m_bytes[ i ].reserved;
+        m_bytes[ i ].resident += other.m_bytes[ i ].resident;
+    }
+
+    return *this;
+}
+
+
+size_t GitHubSample::MemoryUsageReport::ReservedBytes() const
+{
+    size_t total = 0;
+    for ( size_t i = 0; i < kCategoryCount; i++ )
+    {
+        total += m_bytes[ i ].reserved;
+    }
+    return total;
+}
+
+
+size_t GitHubSample::MemoryUsageReport::ResidentBytes() const
+{
+    size_t total = 0;
+    for ( size_t i = 0; i < kCategoryCount; i++ )
+    {
+        total += m_bytes[ i ].resident;
+    }
+    return total;
+}
+
+
+const char* GitHubSample::MemoryUsageReport::CategoryName( const Category category )
+{
+    return ( category < kCategoryCount ) ? CATEGORY_NAMES[ category ] : "?";
+}
+
+
+std::string GitHubSample::MemoryUsageReport::ToString() const
+{
+    std::string result;
+
+    for ( size_t i = 0; i < kCategoryCount; i++ )
+    {
+        if ( m_bytes[ i ].reserved != 0 )
+        {
+            result += boost::str( boost::format("%1%: %2% bytes reserved, %3% resident\n")
+                                  % CATEGORY_NAMES[ i ] % m_bytes[ i ].reserved % m_bytes[ i ].resident );
+        }
+    }
+
+    result += boost::str( boost::format("total: %1% bytes reserved, %2% resident\n") % ReservedBytes() % ResidentBytes() );
+    return result;
+}
+
+
+size_t GitHubSample::MemoryUsageReport::ResidentBytesOf( const void* address, const size_t size )
+{
+    if ( address == 0 || size == 0 )
+    {
+        return 0; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    const size_t pageSize = static_cast<size_t>( sysconf( _SC_PAGESIZE ) );
+    const uintptr_t start = reinterpret_cast<uintptr_t>( address ) & ~( pageSize - 1 );
+    const uintptr_t end = reinterpret_cast<uintptr_t>( address ) + size;
+    const size_t pageCount = ( end - start + pageSize - 1 ) / pageSize;
+
+    std::vector< MincoreByte > pages( pageCount );
+    if ( mincore( reinterpret_cast<void*>( start ), end - start, &pages[ 0 ] ) != 0 )
+    {
+        return 0; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    size_t residentPages = 0;
+    for ( size_t i = 0; i < pageCount; i++ )
+    {
+        residentPages += pages[ i ] & 1;
+    }
+
+    return residentPages * pageSize;
+}
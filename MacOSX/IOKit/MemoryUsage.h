@@ -0,0 +1,86 @@
+
+#ifndef GITHUBSAMPLE_MEMORY_USAGE_H
+#define GITHUBSAMPLE_MEMORY_USAGE_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+
+namespace GitHubSample
+{
+
+    /**
+       How much memory one reader, stage or table holds, by category.
+
+       Every MemoryUsage() report counts the object itself (kObject) plus
+       everything it owns: heap blocks at their CAPACITY, and mapped files.
+       Memory that is only borrowed (e.g. the layout a reader points into,
+       which belongs to the KeyboardLayoutDatabase) is not counted, so the
+       reports of the parts of a pipeline can simply be added up.
+
+       'reserved' is address space, 'resident' is what is actually in RAM.
+       Heap blocks are taken to be resident.  For mapped regions 'resident'
+       comes from mincore, so a database of hundreds of layouts of which
+       only one is in use shows up as mostly reserved.
+     */
+    class MemoryUsageReport
+    {
+    public:
+
+        enum Category
+        {
+            kObject,           ///< sizeof the reporting objects themselves
+            kKeyTables,        ///< per-key tables and cookie maps
+            kPropertyStrings,  ///< device properties kept for diagnostics
+            kLayoutTables,     ///< keyboard layout code points and flags
+            kComposeTables,    ///< compose sequence tries
+            kEventBuffers,     ///< queued or batched KeyEvents
+            kDeviceState,      ///< per-device state of multi-device stages
+            kCategoryCount
+        };
+
+        struct Bytes
+        {
+            size_t reserved;
+            size_t resident;
+        };
+
+        MemoryUsageReport();
+
+        /// heap memory: reserved and resident alike
+        void AddHeap( Category category, size_t bytes );
+
+        /// a mapped region: reserved is 'size', resident is asked of the kernel
+        void AddMapping( Category category, const void* address, size_t size );
+
+        MemoryUsageReport& operator+=( const MemoryUsageReport& other );
+
+        const Bytes& ForCategory( Category category ) const { return m_bytes[ category ]; }
+        size_t ReservedBytes() const;
+        size_t ResidentBytes() const;
+
+        static const char* CategoryName( Category category );
+
+        /// one line per category that holds anything, then the totals
+        std::string ToString() const;
+
+        /// how much of [address, address + size) is in RAM right now (mincore). whole pages.
+        static size_t ResidentBytesOf( const void* address, size_t size );
+
+    private:
+
+        Bytes m_bytes[ kCategoryCount ];
+    };
+
+
+    /// what a vector holds on the heap
+    template< class T >
+    inline size_t CapacityBytes( const std::vector< T >& vec )
+    {
+        return vec.capacity() * sizeof( T );
+    }
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_MEMORY_USAGE_H
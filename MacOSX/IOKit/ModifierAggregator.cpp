@@ -0,0 +1,142 @@
+
+
+#include "ModifierAggregator.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+
+namespace
+{
+    // these are the kHIDUsage_* values
+    const uint16_t USAGE_PAGE_KEYBOARD_OR_KEYPAD = 0x07;
+    const unsigned int USAGE_LEFT_CONTROL        = 0xE0;
+    const unsigned int USAGE_RIGHT_GUI           = 0xE7;
+
+    const uint64_t LOW_SEVEN_BITS_OF_EACH_BYTE = 0x7F7F7F7F7F7F7F7FULL;
+    const uint64_t HIGH_BIT_OF_EACH_BYTE       = 0x8080808080808080ULL;
+}
+
+
+
+GitHubSample::ModifierAggregator::ModifierAggregator()
+    : m_holdCounts( 0 ),
+      m_mergedModifiers( 0 )
+{
+}
+
+
+void GitHubSample::ModifierAggregator::Reset()
+{
+    m_holdCounts = 0;
+    m_mergedModifiers = 0;
+    m_deviceModifiers.clear();
+}
+
+
+/**
+   One bit per counter: set when the counter is non-zero.
+
+   Only the x86 build has SSE2; the PowerPC build of 10.5 does not, so there
+   the same thing is done inside a plain 64-bit register.
+*/
+uint8_t GitHubSample::ModifierAggregator::NonZeroCounters() const
+{
+#ifdef __SSE2__
+    // x86 is little-endian, so byte i in memory is counter i
+    const __m128i counts = _mm_loadl_epi64( reinterpret_cast<const __m128i*>( &m_holdCounts ) );
+    const int zeroBytes = _mm_movemask_epi8( _mm_cmpeq_epi8( counts, _mm_setzero_si128() ) );
+    return static_cast<uint8_t>( ~zeroBytes );
+#else
+    // the high bit of each byte ends up set when any bit of that byte is
+    const uint64_t nonZero = ( ( ( m_holdCounts & LOW_SEVEN_BITS_OF_EACH_BYTE ) + LOW_SEVEN_BITS_OF_EACH_BYTE ) | m_holdCounts )
+        & HIGH_BIT_OF_EACH_BYTE;
+    // gathers the eight high bits into the top byte, byte i becoming bit i
+    return static_cast<uint8_t>( ( ( nonZero >> 7 ) * 0x0102040810204080ULL ) >> 56 );
+#endif
+}
+
+
+bool GitHubSample::ModifierAggregator::SetDeviceModifiers( const uint16_t deviceIndex, const uint8_t modifiers )
+{
+    if ( deviceIndex >= m_deviceModifiers.size() )
+    {
+        if ( modifiers == 0 )
+        {
+            return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+        }
+
+        m_deviceModifiers.resize( deviceIndex + 1, 0 );
+    }
+
+    uint8_t& deviceModifiers = m_deviceModifiers[ deviceIndex ];
+    unsigned int changed = deviceModifiers ^ modifiers;
+
+    if ( changed == 0 )
+    {
+        return false; // the usual case for key repeat and duplicate reports
+    }
+
+    // normally exactly one bit changed
+    while ( changed )
+    {
+        const unsigned int modifierIndex = __builtin_ctz( changed );
+        const uint64_t one = 1ULL << ( modifierIndex * 8 );
+        const unsigned int count = HoldCount( modifierIndex );
+
+        if ( modifiers & ( 1 << modifierIndex ) )
+        {
+            m_holdCounts += ( count != 0xFF ) ? one : 0;
+        }
+        else
+        {
+            m_holdCounts -= ( count != 0 ) ? one : 0;
+        }
+
+        changed &= changed - 1;
+    }
+
+    deviceModifiers = modifiers;
+
+    const uint8_t previous = m_mergedModifiers;
+    m_mergedModifiers = NonZeroCounters();
+    return ( m_mergedModifiers != previous );
+}
+
+
+bool GitHubSample::ModifierAggregator::OnEvent( const KeyEvent& event )
+{
+    if ( event.usagePage != USAGE_PAGE_KEYBOARD_OR_KEYPAD || event.usage < USAGE_LEFT_CONTROL || event.usage > USAGE_RIGHT_GUI )
+    {
+        return false;
+    }
+
+    const uint8_t bit = static_cast<uint8_t>( 1 << ( event.usage - USAGE_LEFT_CONTROL ) );
+    const uint8_t current = DeviceModifiers( event.deviceIndex );
+
+    return SetDeviceModifiers( event.deviceIndex, event.value ? ( current | bit ) : ( current & ~bit ) );
+}
+
+
+bool GitHubSample::ModifierAggregator::OnEvents( const KeyEvent* events, const size_t eventCount )
+{
+    bool changed = false;
+
+    for ( size_t i = 0; i < eventCount; i++ )
+    {
+        changed |= OnEvent( events[i] );
+    }
+
+    return changed;
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::ModifierAggregator::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) );
+    report.AddHeap( MemoryUsageReport::kDeviceState, CapacityBytes( m_deviceModifiers ) );
+    return report;
+}
@@ -0,0 +1,91 @@
+
+#ifndef GITHUBSAMPLE_MODIFIER_AGGREGATOR_H
+#define GITHUBSAMPLE_MODIFIER_AGGREGATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "KeyEvent.h"
+#include "MemoryUsage.h"
+
+
+namespace GitHubSample
+{
+
+    /**
+       The modifier state of the WHOLE system, when several keyboards are
+       plugged in.
+
+       The VirtualBox sample (see darwinQueueCallback in
+       third_party_samples/DarwinKeyboard.cpp) keeps one global mask, so when
+       shift is held on one keyboard and pressed and released on another, shift
+       reads as released while the first keyboard still holds it.  Here every
+       modifier has a counter of how many devices hold it, and the merged mask
+       is "which counters are non-zero".
+
+       The eight counters are one byte each, packed into one 64-bit word, so
+       the merged mask is a single compare-against-zero over all of them (an
+       SSE2 compare and movemask, or a SWAR trick where there is no SSE2).
+
+       Each device also has its own mask (HID boot protocol order, the same as
+       TextReconstructionStage::ModifierKeys), which makes the counting
+       idempotent: a repeated press, or a release of a key that was never seen
+       pressed, changes nothing.
+
+       Not thread-safe.  Feed it from the one thread that drains the queues.
+     */
+    class ModifierAggregator
+    {
+    public:
+
+        enum
+        {
+            kModifierCount = 8 ///< kHIDUsage_KeyboardLeftControl ... kHIDUsage_KeyboardRightGUI
+        };
+
+        ModifierAggregator();
+
+        /// Returns true when the merged mask changed.  Non-modifier events are ignored.
+        bool OnEvent( const KeyEvent& event );
+
+        /// Same as calling OnEvent for each event.  Returns true when the merged mask changed at all.
+        bool OnEvents( const KeyEvent* events, size_t eventCount );
+
+        /// Replaces what one device holds, e.g. after polling it.  Returns true when the merged mask changed.
+        bool SetDeviceModifiers( uint16_t deviceIndex, uint8_t modifiers );
+
+        /// The device went away: whatever it held is released.
+        bool RemoveDevice( uint16_t deviceIndex ) { return SetDeviceModifiers( deviceIndex, 0 ); }
+
+        void Reset();
+
+        /// bit 0 is left control ... bit 7 is right GUI.  Held on ANY device.
+        uint8_t MergedModifiers() const { return m_mergedModifiers; }
+
+        uint8_t DeviceModifiers( uint16_t deviceIndex ) const
+        {
+            return ( deviceIndex < m_deviceModifiers.size() ) ? m_deviceModifiers[ deviceIndex ] : 0;
+        }
+
+        /// how many devices hold modifier 'modifierIndex' (0..7). saturates at 255.
+        unsigned int HoldCount( unsigned int modifierIndex ) const
+        {
+            return static_cast<unsigned int>( ( m_holdCounts >> ( modifierIndex * 8 ) ) & 0xFF );
+        }
+
+        MemoryUsageReport MemoryUsage() const;
+
+    private:
+
+        /// byte i (counting from the least significant) is the hold count of modifier i
+        uint64_t m_holdCounts;
+        uint8_t m_mergedModifiers;
+        std::vector< uint8_t > m_deviceModifiers;
+
+        uint8_t NonZeroCounters() const;
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_MODIFIER_AGGREGATOR_H
@@ -0,0 +1,226 @@
+
+
+#include "PointerMotionCoalescer.h"
+#include "RealtimeThreadConfig.h"
+
+#include <string.h>
+
+
+
+namespace
+{
+    // these are the kHIDPage_* and kHIDUsage_* values
+    const uint16_t USAGE_PAGE_GENERIC_DESKTOP = 0x01;
+    const uint16_t USAGE_PAGE_CONSUMER        = 0x0C;
+    const uint16_t USAGE_GD_X                 = 0x30;
+    const uint16_t USAGE_GD_Y                 = 0x31;
+    const uint16_t USAGE_GD_WHEEL             = 0x38;
+    const uint16_t USAGE_AC_PAN               = 0x238;
+
+    /// (page, usage) of each PointerMotionCoalescer::Axis
+    const uint16_t AXIS_USAGES[ GitHubSample::PointerMotionCoalescer::kAxisCount ][ 2 ] =
+    {
+        { USAGE_PAGE_GENERIC_DESKTOP, USAGE_GD_X },
+        { USAGE_PAGE_GENERIC_DESKTOP, USAGE_GD_Y },
+        { USAGE_PAGE_GENERIC_DESKTOP, USAGE_GD_WHEEL },
+        { USAGE_PAGE_CONSUMER,        USAGE_AC_PAN }
+    };
+
+    const int64_t LARGEST_VALUE  = 0x7FFFFFFF;
+    const int64_t SMALLEST_VALUE = -LARGEST_VALUE - 1;
+
+    /// KeyEvent::value is 32 bits; a sum of 8,000 reports a second can be more
+    int32_t Saturate( const int64_t sum )
+    {
+        if ( sum > LARGEST_VALUE )
+        {
+            return static_cast<int32_t>( LARGEST_VALUE );
+        }
+        return static_cast<int32_t>( ( sum < SMALLEST_VALUE ) ? SMALLEST_VALUE : sum );
+    }
+}
+
+
+
+GitHubSample::PointerMotionCoalescer::PointerMotionCoalescer( const size_t capacity )
+    : m_events( capacity > kAxisCount ? capacity : kAxisCount + 1 ),
+      m_count( 0 ),
+      m_head( 0 ),
+      m_movedAxes( 0 ),
+      m_motionDevice( 0 )
+{
+    memset( m_sums, 0, sizeof(m_sums) );
+    memset( m_timestamps, 0, sizeof(m_timestamps) );
+    ResetStats();
+}
+
+
+void GitHubSample::PointerMotionCoalescer::ResetStats()
+{
+    memset( &m_stats, 0, sizeof(m_stats) );
+}
+
+
+GitHubSample::PointerMotionCoalescer::Axis GitHubSample::PointerMotionCoalescer::AxisOf( const KeyEvent& event )
+{
+    if ( event.usagePage == USAGE_PAGE_GENERIC_DESKTOP )
+    {
+        switch ( event.usage )
+        {
+        case USAGE_GD_X:     return kAxisX;
+        case USAGE_GD_Y:     return kAxisY;
+        case USAGE_GD_WHEEL: return kAxisWheel;
+        default:             return kAxisCount;
+        }
+    }
+
+    return ( event.usagePage == USAGE_PAGE_CONSUMER && event.usage == USAGE_AC_PAN ) ? kAxisPan : kAxisCount;
+}
+
+
+void GitHubSample::PointerMotionCoalescer::Offer( const KeyEvent* events, const size_t count )
+{
+    for ( size_t i = 0; i < count; i++ )
+    {
+        const KeyEvent& event = events[ i ];
+        const Axis axis = AxisOf( event );
+
+        if ( axis == kAxisCount )
+        {
+            m_stats.exactEvents++;
+
+            // the motion so far goes out BEFORE the edge, or the click lands in the wrong place
+            if ( ! CloseMotion() || ! Append( event ) )
+            {
+                m_stats.droppedExactEvents++;
+            }
+            continue;
+        }
+
+        m_stats.motionIn++;
+
+        if ( m_movedAxes != 0 && event.deviceIndex != m_motionDevice && ! CloseMotion() )
+        {
+            m_stats.droppedMotion++;
+            memset( m_sums, 0, sizeof(m_sums) );
+            m_movedAxes = 0;
+        }
+
+        m_motionDevice = event.deviceIndex;
+        m_sums[ axis ] += event.value;
+        m_timestamps[ axis ] = event.timestamp;
+        m_movedAxes |= 1u << axis;
+    }
+}
+
+
+size_t GitHubSample::PointerMotionCoalescer::Drain( KeyEvent* events, const size_t capacity )
+{
+    size_t written = 0;
+
+    for ( ;; )
+    {
+        // when the buffer is too full for the sums, they go out on the second round
+        CloseMotion();
+
+        const size_t available = m_count - m_head;
+        const size_t taken = ( capacity - written < available ) ? capacity - written : available;
+
+        for ( size_t i = 0; i < taken; i++ )
+        {
+            events[ written++ ] = m_events[ m_head++ ];
+        }
+
+        if ( m_head == m_count )
+        {
+            m_head = 0;
+            m_count = 0;
+        }
+
+        if ( m_movedAxes == 0 || written == capacity )
+        {
+            break;
+        }
+    }
+
+    return written;
+}
+
+
+bool GitHubSample::PointerMotionCoalescer::CloseMotion()
+{
+    if ( m_movedAxes == 0 )
+    {
+        return true; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    if ( m_head != 0 && m_count + __builtin_popcount( m_movedAxes ) > m_events.size() )
+    {
+        // the consumer took some from the front: move the rest down
+        memmove( &m_events[ 0 ], &m_events[ m_head ], ( m_count - m_head ) * sizeof(KeyEvent) );
+        m_count -= m_head;
+        m_head = 0;
+    }
+
+    if ( m_count + __builtin_popcount( m_movedAxes ) > m_events.size() )
+    {
+        return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    for ( unsigned int axis = 0; axis < kAxisCount; axis++ )
+    {
+        // a mouse that went back and forth to where it started did not move
+        if ( ( m_movedAxes & ( 1u << axis ) ) == 0 || m_sums[ axis ] == 0 )
+        {
+            continue;
+        }
+
+        KeyEvent& event = m_events[ m_count++ ];
+        event.timestamp = m_timestamps[ axis ];
+        event.usagePage = AXIS_USAGES[ axis ][ 0 ];
+        event.usage = AXIS_USAGES[ axis ][ 1 ];
+        event.value = Saturate( m_sums[ axis ] );
+        event.deviceIndex = m_motionDevice;
+        event.flags = 0;
+
+        m_stats.motionOut++;
+    }
+
+    memset( m_sums, 0, sizeof(m_sums) );
+    m_movedAxes = 0;
+    return true;
+}
+
+
+bool GitHubSample::PointerMotionCoalescer::Append( const KeyEvent& event )
+{
+    if ( m_count == m_events.size() && m_head != 0 )
+    {
+        memmove( &m_events[ 0 ], &m_events[ m_head ], ( m_count - m_head ) * sizeof(KeyEvent) );
+        m_count -= m_head;
+        m_head = 0;
+    }
+
+    if ( m_count == m_events.size() )
+    {
+        return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    m_events[ m_count++ ] = event;
+    return true;
+}
+
+
+void GitHubSample::PointerMotionCoalescer::LockBuffers( RealtimeThreadConfig& realtime )
+{
+    realtime.LockVector( m_events );
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::PointerMotionCoalescer::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) );
+    report.AddHeap( MemoryUsageReport::kEventBuffers, CapacityBytes( m_events ) );
+    return report;
+}
@@ -0,0 +1,116 @@
+
+#ifndef GITHUBSAMPLE_POINTER_MOTION_COALESCER_H
+#define GITHUBSAMPLE_POINTER_MOTION_COALESCER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "KeyEvent.h"
+#include "MemoryUsage.h"
+
+
+namespace GitHubSample
+{
+
+    class RealtimeThreadConfig;
+
+    /**
+       Sums the relative motion of a pointer device between two reads by
+       the consumer, and keeps everything else (button edges) exact.
+
+       A gaming mouse at 8 kHz sends 8,000 reports a second, each one an X
+       and a Y delta (and maybe a wheel step).  Nobody wants 16,000 motion
+       events a second; everybody wants every click, in the right place
+       relative to the motion.  So:
+
+         - X, Y, the wheel and AC Pan deltas are added up, per axis.
+         - Any other event (a button, a key) first closes the running sum:
+           one event per axis that moved goes out, stamped with the time of
+           the last report that moved it, and then the event itself.  So a
+           click lands between the motion before it and the motion after it.
+         - Drain closes the running sum too, and hands everything out.
+
+       Between two Drains the output is therefore at most one motion event
+       per axis per button edge, however many reports came in, and the work
+       per report is one add.  Events of several devices may be mixed: a
+       change of deviceIndex closes the sum like a button does.
+
+       The exact events wait in a buffer allocated once, at construction.
+       When the consumer falls so far behind that it fills up, further exact
+       events are dropped and counted.  Motion keeps adding up; only when
+       the device changes while the buffer is full are the old device's
+       sums dropped (and counted).
+
+       Not thread-safe.  Feed it from the thread that drains the readers.
+     */
+    class PointerMotionCoalescer
+    {
+    public:
+
+        enum Axis
+        {
+            kAxisX,
+            kAxisY,
+            kAxisWheel,
+            kAxisPan,
+            kAxisCount
+        };
+
+        struct Statistics
+        {
+            /// motion events that went in, and the summed ones that came out
+            uint64_t motionIn;
+            uint64_t motionOut;
+            uint64_t exactEvents;
+            uint64_t droppedExactEvents;
+            uint64_t droppedMotion;
+        };
+
+        explicit PointerMotionCoalescer( size_t capacity = 256 );
+
+        /// Takes a batch from ReadEventsFromQueue.  Never blocks, never allocates.
+        void Offer( const KeyEvent* events, size_t count );
+
+        /// Writes up to 'capacity' events, oldest first, and returns how many.
+        /// What does not fit stays for the next Drain.
+        size_t Drain( KeyEvent* events, size_t capacity );
+
+        bool HasPending() const { return m_count != m_head || m_movedAxes != 0; }
+
+        /// the motion added up since the last event went out, e.g. to move a cursor before the next Drain
+        int32_t PendingMotion( Axis axis ) const { return static_cast<int32_t>( m_sums[ axis ] ); }
+
+        const Statistics& Stats() const { return m_stats; }
+        void ResetStats();
+
+        /// kAxisCount when 'event' is not relative motion
+        static Axis AxisOf( const KeyEvent& event );
+
+        /// Hands the buffer to 'realtime' to be prefaulted and mlocked.  This object must outlive it.
+        void LockBuffers( RealtimeThreadConfig& realtime );
+
+        MemoryUsageReport MemoryUsage() const;
+
+    private:
+
+        std::vector< KeyEvent > m_events;
+        size_t m_count;
+        size_t m_head;
+
+        int64_t m_sums[ kAxisCount ];
+        uint64_t m_timestamps[ kAxisCount ];
+        /// one bit per Axis that moved since the sums were last closed
+        unsigned int m_movedAxes;
+        uint16_t m_motionDevice;
+
+        Statistics m_stats;
+
+        /// false (and nothing changes) when there is no room for the summed motion
+        bool CloseMotion();
+        bool Append( const KeyEvent& event );
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_POINTER_MOTION_COALESCER_H
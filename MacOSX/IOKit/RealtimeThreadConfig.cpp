@@ -0,0 +1,270 @@
+
+
+#include "RealtimeThreadConfig.h"
+#include "ErrorLogging.h"
+
+#include <boost/format.hpp>
+
+#include <alloca.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#ifdef __DARWIN__
+#include <mach/mach_init.h>
+#include <mach/thread_act.h>
+#include <mach/thread_policy.h>
+#endif
+
+
+
+namespace
+{
+    size_t PageSize()
+    {
+        static const size_t pageSize = static_cast<size_t>( sysconf( _SC_PAGESIZE ) );
+        return pageSize;
+    }
+
+    /// writes every page, so that it is resident and no longer shared copy-on-write (or the zero page)
+    void TouchPages( void* data, const size_t size )
+    {
+        volatile uint8_t* bytes = static_cast<volatile uint8_t*>( data );
+        const size_t pageSize = PageSize();
+
+        // the first byte of each page the region overlaps, and the last byte of the region
+        const size_t firstPageOffset = pageSize - ( reinterpret_cast<uintptr_t>( data ) % pageSize );
+        if ( size != 0 )
+        {
+            bytes[ 0 ] = bytes[ 0 ];
+            bytes[ size - 1 ] = bytes[ size - 1 ];
+        }
+        for ( size_t offset = firstPageOffset; offset < size; offset += pageSize )
+        {
+            bytes[ offset ] = bytes[ offset ];
+        }
+    }
+
+    /**
+       Faults in (and tries to lock) 'bytes' of stack below the caller's
+       frame.  The pages stay with the thread after this returns, which is
+       the point.  Returns the errno of mlock, or zero.
+     */
+    int __attribute__((noinline)) PrefaultStack( const size_t bytes )
+    {
+        void* stack = alloca( bytes );
+        memset( stack, 0, bytes );
+        return ( mlock( stack, bytes ) == 0 ) ? 0 : errno;
+    }
+
+    long FaultsSoFar( const bool major )
+    {
+        struct rusage usage;
+#if defined(__linux__) && defined(RUSAGE_THREAD)
+        getrusage( RUSAGE_THREAD, &usage );
+#else
+        getrusage( RUSAGE_SELF, &usage );
+#endif
+        return major ? usage.ru_majflt : usage.ru_minflt;
+    }
+}
+
+
+
+GitHubSample::RealtimeThreadConfig::RealtimeThreadConfig( boost::function< void ( const std::string msg ) > errorLoggerFunctor )
+    : m_errorLoggerFunctor( errorLoggerFunctor ),
+      m_policy( kSchedulingDefault ),
+      m_priority( -1 ),
+      m_cpu( -1 ),
+      m_stackPrefault( 64 * 1024 ),
+      m_lockedBytes( 0 )
+{
+}
+
+
+GitHubSample::RealtimeThreadConfig::~RealtimeThreadConfig()
+{
+    for ( size_t i = 0; i < m_regions.size(); i++ )
+    {
+        if ( m_regions[ i ].locked )
+        {
+            munlock( m_regions[ i ].data, m_regions[ i ].size );
+        }
+    }
+}
+
+
+void GitHubSample::RealtimeThreadConfig::SetScheduling( const SchedulingPolicy policy, const int priority )
+{
+    m_policy = policy;
+    m_priority = priority;
+}
+
+
+void GitHubSample::RealtimeThreadConfig::LockRegion( void* data, const size_t size )
+{
+    if ( data == 0 || size == 0 )
+    {
+        return; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    Region region;
+    region.data = data;
+    region.size = size;
+    region.locked = false;
+    m_regions.push_back( region );
+}
+
+
+bool GitHubSample::RealtimeThreadConfig::ApplyToCurrentThread()
+{
+    bool success = ApplyScheduling();
+    success = ApplyAffinity() && success;
+
+    if ( m_stackPrefault != 0 )
+    {
+        const int errorNumber = PrefaultStack( m_stackPrefault );
+        if ( errorNumber != 0 )
+        {
+            LogSystemError( "mlock of the stack", errorNumber );
+            success = false;
+        }
+    }
+
+    for ( size_t i = 0; i < m_regions.size(); i++ )
+    {
+        if ( ! m_regions[ i ].locked )
+        {
+            success = PrefaultAndLock( m_regions[ i ] ) && success;
+        }
+    }
+
+    return success;
+}
+
+
+bool GitHubSample::RealtimeThreadConfig::ApplyScheduling()
+{
+    if ( m_policy == kSchedulingDefault )
+    {
+        return true; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    const int policy = ( m_policy == kSchedulingFifo ) ? SCHED_FIFO : SCHED_RR;
+    const int lowest = sched_get_priority_min( policy );
+    const int highest = sched_get_priority_max( policy );
+
+    struct sched_param param;
+    memset( &param, 0, sizeof(param) );
+    param.sched_priority = ( m_priority < 0 || m_priority > highest ) ? highest : ( m_priority < lowest ? lowest : m_priority );
+
+    const int errorNumber = pthread_setschedparam( pthread_self(), policy, &param );
+    if ( errorNumber != 0 )
+    {
+        LogSystemError( "pthread_setschedparam", errorNumber );
+    }
+
+    return errorNumber == 0;
+}
+
+
+bool GitHubSample::RealtimeThreadConfig::ApplyAffinity()
+{
+    if ( m_cpu < 0 )
+    {
+        return true; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+#if defined(__DARWIN__)
+
+    // tag zero means "no affinity", so the tags are cpu + 1
+    thread_affinity_policy_data_t policy;
+    policy.affinity_tag = m_cpu + 1;
+
+    const kern_return_t kernReturn = thread_policy_set( mach_thread_self(),
+                                                        THREAD_AFFINITY_POLICY,
+                                                        reinterpret_cast<thread_policy_t>( &policy ),
+                                                        THREAD_AFFINITY_POLICY_COUNT );
+    if ( kernReturn != KERN_SUCCESS )
+    {
+        LogErrorWhenFunctorIsntEmpty( m_errorLoggerFunctor,
+                                      boost::str( boost::format("thread_policy_set(THREAD_AFFINITY_POLICY) failed. code: %1%") % (int)kernReturn ) );
+    }
+
+    return kernReturn == KERN_SUCCESS;
+
+#elif defined(__linux__)
+
+    cpu_set_t cpus;
+    CPU_ZERO( &cpus );
+    CPU_SET( m_cpu, &cpus );
+
+    const int errorNumber = pthread_setaffinity_np( pthread_self(), sizeof(cpus), &cpus );
+    if ( errorNumber != 0 )
+    {
+        LogSystemError( "pthread_setaffinity_np", errorNumber );
+    }
+
+    return errorNumber == 0;
+
+#else
+
+    LogErrorWhenFunctorIsntEmpty( m_errorLoggerFunctor, "Pinning a thread to a cpu is not supported on this system." );
+    return false;
+
+#endif
+}
+
+
+bool GitHubSample::RealtimeThreadConfig::PrefaultAndLock( Region& region )
+{
+    TouchPages( region.data, region.size );
+
+    if ( mlock( region.data, region.size ) != 0 )
+    {
+        LogSystemError( boost::str( boost::format("mlock of %1% bytes") % region.size ), errno );
+        return false;
+    }
+
+    region.locked = true;
+    m_lockedBytes += region.size;
+    return true;
+}
+
+
+void GitHubSample::RealtimeThreadConfig::LogSystemError( const std::string& what, const int errorNumber ) const
+{
+    LogErrorWhenFunctorIsntEmpty( m_errorLoggerFunctor,
+                                  boost::str( boost::format("%1% failed: %2%") % what % strerror( errorNumber ) ) );
+}
+
+
+
+GitHubSample::PageFaultCounter::PageFaultCounter()
+{
+    Restart();
+}
+
+
+void GitHubSample::PageFaultCounter::Restart()
+{
+    m_minorAtStart = FaultsSoFar( false );
+    m_majorAtStart = FaultsSoFar( true );
+}
+
+
+long GitHubSample::PageFaultCounter::MinorFaults() const
+{
+    return FaultsSoFar( false ) - m_minorAtStart;
+}
+
+
+long GitHubSample::PageFaultCounter::MajorFaults() const
+{
+    return FaultsSoFar( true ) - m_majorAtStart;
+}
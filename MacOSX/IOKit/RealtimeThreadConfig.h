@@ -0,0 +1,144 @@
+
+#ifndef GITHUBSAMPLE_REALTIME_THREAD_CONFIG_H
+#define GITHUBSAMPLE_REALTIME_THREAD_CONFIG_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+
+
+namespace GitHubSample
+{
+
+    /**
+       Settings for the thread that reads the keyboard, when a keypress must
+       never wait behind other threads or on a page fault.
+
+       Build everything first (readers, stages, and every array they will
+       ever use), register them (each reader and each stage that owns a
+       ring or state arrays has a LockBuffers( *this ), and LockRegion /
+       LockVector take your own arrays), and then call ApplyToCurrentThread
+       FROM the reader thread.  It:
+
+         - sets SCHED_FIFO or SCHED_RR at the given priority (needs root, or
+           CAP_SYS_NICE / an rtprio limit on Linux),
+         - pins the thread to one CPU (Linux).  On the mac there is no
+           pinning; the CPU number becomes a THREAD_AFFINITY_POLICY tag,
+           which is only a hint to keep the thread on its own L2,
+         - faults in 'stackPrefault' bytes of stack, and
+         - writes to every page of every registered region, then mlocks it,
+           so the pages are resident AND private (no copy-on-write fault on
+           the first store).
+
+       The regions stay locked until this object is destroyed.
+
+       After that, the hot path must not allocate: AdaptivePoller,
+       ModifierAggregator (once every device index has been seen),
+       ScancodeEncoder and TextReconstructionStage do not, while
+       TimestampMerger's queues do.  Use PageFaultCounter around the hot
+       path to check that it stays at zero.
+     */
+    class RealtimeThreadConfig
+    {
+    public:
+
+        enum SchedulingPolicy
+        {
+            kSchedulingDefault,    ///< leave the scheduling alone
+            kSchedulingFifo,       ///< SCHED_FIFO
+            kSchedulingRoundRobin  ///< SCHED_RR
+        };
+
+        explicit RealtimeThreadConfig( boost::function< void ( const std::string msg ) > errorLoggerFunctor = 0 );
+
+        /// munlocks the regions
+        ~RealtimeThreadConfig();
+
+        /// 'priority' is clamped to the policy's range. a negative value means "the highest".
+        void SetScheduling( SchedulingPolicy policy, int priority = -1 );
+
+        /// a negative cpu means "do not pin"
+        void SetCpu( int cpu ) { m_cpu = cpu; }
+
+        void SetStackPrefault( size_t bytes ) { m_stackPrefault = bytes; }
+
+        /// The memory must be writable, and must stay allocated while this object lives.
+        void LockRegion( void* data, size_t size );
+
+        /// the whole capacity, so reserve() the vector first
+        template< class T >
+        void LockVector( std::vector< T >& vec )
+        {
+            if ( vec.capacity() != 0 )
+            {
+                LockRegion( &vec[ 0 ], vec.capacity() * sizeof( T ) );
+            }
+        }
+
+        /// Applies everything to the CALLING thread.  Returns false when any
+        /// part of it failed (each failure is logged, and the rest is still applied).
+        bool ApplyToCurrentThread();
+
+        size_t LockedBytes() const { return m_lockedBytes; }
+
+    private:
+
+        struct Region
+        {
+            void* data;
+            size_t size;
+            bool locked;
+        };
+
+        boost::function< void ( const std::string msg ) > m_errorLoggerFunctor;
+        SchedulingPolicy m_policy;
+        int m_priority;
+        int m_cpu;
+        size_t m_stackPrefault;
+        std::vector< Region > m_regions;
+        size_t m_lockedBytes;
+
+        bool ApplyScheduling();
+        bool ApplyAffinity();
+        bool PrefaultAndLock( Region& region );
+        void LogSystemError( const std::string& what, int errorNumber ) const;
+
+        /// declared private so as to make this class non-copyable
+        RealtimeThreadConfig(const RealtimeThreadConfig&);
+        /// declared private so as to make this class non-copyable
+        RealtimeThreadConfig& operator=(const RealtimeThreadConfig&);
+    };
+
+
+    /**
+       Counts the page faults of the calling thread (the whole process on
+       the mac, which has no per-thread getrusage) since construction or the
+       last Restart.  Wrap the hot path with it:
+
+           GitHubSample::PageFaultCounter faults;
+           ... read, run the stages ...
+           assert( faults.MinorFaults() == 0 && faults.MajorFaults() == 0 );
+     */
+    class PageFaultCounter
+    {
+    public:
+
+        PageFaultCounter();
+
+        void Restart();
+
+        /// soft faults: the page was in memory but not mapped (first touch, copy on write)
+        long MinorFaults() const;
+        /// hard faults: the page had to be read from disk
+        long MajorFaults() const;
+
+    private:
+
+        long m_minorAtStart;
+        long m_majorAtStart;
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_REALTIME_THREAD_CONFIG_H
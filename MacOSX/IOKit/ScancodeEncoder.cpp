@@ -0,0 +1,187 @@
+
+
+#include "ScancodeEncoder.h"
+#include "ScancodeTranslation.h"
+
+#include <string.h>
+
+
+
+namespace
+{
+    // these are the kHIDUsage_* values
+    const uint16_t USAGE_PAGE_KEYBOARD_OR_KEYPAD = 0x07;
+    const unsigned int USAGE_PRINT_SCREEN        = 0x46;
+    const unsigned int USAGE_PAUSE               = 0x48;
+
+    const size_t USAGE_COUNT = 0x100;
+    const size_t TEMPLATE_SIZE = GitHubSample::ScancodeEncoder::kMaxBytesPerEvent;
+
+    const uint8_t PREFIX_EXTENDED = 0xE0;
+    const uint8_t SET1_BREAK_BIT  = 0x80;
+    const uint8_t SET2_BREAK      = 0xF0;
+
+    /// the keys that do not follow the (prefix, code) pattern. no bytes on release for Pause.
+    const uint8_t SET1_PRINT_SCREEN_MAKE[]  = { 0xE0, 0x2A, 0xE0, 0x37 };
+    const uint8_t SET1_PRINT_SCREEN_BREAK[] = { 0xE0, 0xB7, 0xE0, 0xAA };
+    const uint8_t SET1_PAUSE_MAKE[]         = { 0xE1, 0x1D, 0x45, 0xE1, 0x9D, 0xC5 };
+    const uint8_t SET2_PRINT_SCREEN_MAKE[]  = { 0xE0, 0x12, 0xE0, 0x7C };
+    const uint8_t SET2_PRINT_SCREEN_BREAK[] = { 0xE0, 0xF0, 0x7C, 0xE0, 0xF0, 0x12 };
+    const uint8_t SET2_PAUSE_MAKE[]         = { 0xE1, 0x14, 0x77, 0xE1, 0xF0, 0x14, 0xF0, 0x77 };
+
+
+    /**
+       For each set, for each (usage << 1) | pressed: the bytes, and how many
+       of them count.  Slot zero (usage zero) is always empty, which is where
+       events that are not keyboard usages get sent.
+     */
+    struct EncoderTemplates
+    {
+        uint8_t bytes[ 2 ][ USAGE_COUNT * 2 ][ TEMPLATE_SIZE ];
+        uint8_t lengths[ 2 ][ USAGE_COUNT * 2 ];
+
+        EncoderTemplates()
+        {
+            memset( bytes, 0, sizeof(bytes) );
+            memset( lengths, 0, sizeof(lengths) );
+
+            for ( unsigned int usage = 1; usage < USAGE_COUNT; usage++ )
+            {
+                BuildSet1( usage );
+                BuildSet2( usage );
+            }
+
+            Set( 0, USAGE_PRINT_SCREEN, true,  SET1_PRINT_SCREEN_MAKE,  sizeof(SET1_PRINT_SCREEN_MAKE) );
+            Set( 0, USAGE_PRINT_SCREEN, false, SET1_PRINT_SCREEN_BREAK, sizeof(SET1_PRINT_SCREEN_BREAK) );
+            Set( 0, USAGE_PAUSE,        true,  SET1_PAUSE_MAKE,         sizeof(SET1_PAUSE_MAKE) );
+            Set( 0, USAGE_PAUSE,        false, 0,                       0 );
+            Set( 1, USAGE_PRINT_SCREEN, true,  SET2_PRINT_SCREEN_MAKE,  sizeof(SET2_PRINT_SCREEN_MAKE) );
+            Set( 1, USAGE_PRINT_SCREEN, false, SET2_PRINT_SCREEN_BREAK, sizeof(SET2_PRINT_SCREEN_BREAK) );
+            Set( 1, USAGE_PAUSE,        true,  SET2_PAUSE_MAKE,         sizeof(SET2_PAUSE_MAKE) );
+            Set( 1, USAGE_PAUSE,        false, 0,                       0 );
+        }
+
+        void Set( const size_t set, const unsigned int usage, const bool pressed, const uint8_t* sequence, const size_t length )
+        {
+            const size_t slot = ( usage << 1 ) | ( pressed ? 1 : 0 );
+            memset( bytes[ set ][ slot ], 0, TEMPLATE_SIZE );
+            if ( length )
+            {
+                memcpy( bytes[ set ][ slot ], sequence, length );
+            }
+            lengths[ set ][ slot ] = static_cast<uint8_t>( length );
+        }
+
+        void BuildSet1( const unsigned int usage )
+        {
+            const uint16_t code = GitHubSample::TranslateKeyCode( GitHubSample::kHidUsage, GitHubSample::kSet1Scancode, usage );
+            if ( code == GitHubSample::kNoKeyCode || ( code & GitHubSample::kScancodeSpecial ) )
+            {
+                return;
+            }
+
+            uint8_t sequence[ 2 ];
+            size_t length = 0;
+            if ( code & GitHubSample::kScancodeExtended )
+            {
+                sequence[ length++ ] = PREFIX_EXTENDED;
+            }
+
+            sequence[ length ] = static_cast<uint8_t>( code & GitHubSample::kScancodeCodeMask );
+            Set( 0, usage, true, sequence, length + 1 );
+
+            sequence[ length ] |= SET1_BREAK_BIT;
+            Set( 0, usage, false, sequence, length + 1 );
+        }
+
+        void BuildSet2( const unsigned int usage )
+        {
+            const uint16_t code = GitHubSample::TranslateKeyCode( GitHubSample::kHidUsage, GitHubSample::kSet2Scancode, usage );
+            if ( code == GitHubSample::kNoKeyCode || ( code & GitHubSample::kScancodeSpecial ) )
+            {
+                return;
+            }
+
+            uint8_t sequence[ 3 ];
+            size_t length = 0;
+            if ( code & GitHubSample::kScancodeExtended )
+            {
+                sequence[ length++ ] = PREFIX_EXTENDED;
+            }
+
+            sequence[ length ] = static_cast<uint8_t>( code & GitHubSample::kScancodeCodeMask );
+            Set( 1, usage, true, sequence, length + 1 );
+
+            sequence[ length + 1 ] = sequence[ length ];
+            sequence[ length ] = SET2_BREAK;
+            Set( 1, usage, false, sequence, length + 2 );
+        }
+    };
+
+
+    const EncoderTemplates& Templates()
+    {
+        static const EncoderTemplates templates;
+        return templates;
+    }
+}
+
+
+
+GitHubSample::ScancodeEncoder::ScancodeEncoder( const ScancodeSet scancodeSet )
+    : m_set( scancodeSet ),
+      m_templates( Templates().bytes[ scancodeSet == kSet2 ? 1 : 0 ] ),
+      m_lengths( Templates().lengths[ scancodeSet == kSet2 ? 1 : 0 ] )
+{
+}
+
+
+size_t GitHubSample::ScancodeEncoder::EncodeOne( const uint16_t usage, const bool pressed, uint8_t* buffer ) const
+{
+    const size_t slot = ( usage < USAGE_COUNT ) ? ( ( usage << 1 ) | ( pressed ? 1 : 0 ) ) : 0;
+
+    memcpy( buffer, m_templates[ slot ], m_lengths[ slot ] );
+    return m_lengths[ slot ];
+}
+
+
+size_t GitHubSample::ScancodeEncoder::Encode
+(
+ const KeyEvent* events,
+ const size_t eventCount,
+ uint8_t* buffer,
+ const size_t bufferSize,
+ size_t* bytesWritten
+) const
+{
+    size_t written = 0;
+    size_t consumed = 0;
+
+    for ( ; consumed < eventCount && bufferSize - written >= kMaxBytesPerEvent; consumed++ )
+    {
+        const KeyEvent& event = events[ consumed ];
+
+        // anything that is not a keyboard usage goes to the empty slot zero
+        const bool isKey = ( event.usagePage == USAGE_PAGE_KEYBOARD_OR_KEYPAD ) & ( event.usage < USAGE_COUNT );
+        const size_t slot = isKey ? ( ( static_cast<size_t>( event.usage ) << 1 ) | ( event.value != 0 ) ) : 0;
+
+        // always the full template: a fixed size copy is a couple of moves, and the length decides what counts
+        memcpy( buffer + written, m_templates[ slot ], kMaxBytesPerEvent );
+        written += m_lengths[ slot ];
+    }
+
+    if ( bytesWritten )
+    {
+        *bytesWritten = written;
+    }
+
+    return consumed;
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::ScancodeEncoder::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) );
+    return report;
+}
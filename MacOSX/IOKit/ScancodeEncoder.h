@@ -0,0 +1,88 @@
+
+#ifndef GITHUBSAMPLE_SCANCODE_ENCODER_H
+#define GITHUBSAMPLE_SCANCODE_ENCODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "KeyEvent.h"
+#include "MemoryUsage.h"
+
+
+namespace GitHubSample
+{
+
+    /**
+       Turns KeyEvents into the make/break byte stream that a PC keyboard
+       controller (an emulated i8042) sends to the guest, in scancode set 1 or
+       set 2.
+
+       DarwinKeycodeToSet1Scancode in the VirtualBox sample gives one code per
+       key, and every caller then has to know about 0xE0 prefixes, about the
+       set-1 break bit, about set-2's 0xF0, and about Print Screen and Pause,
+       which send whole sequences.  Here all of that is worked out ONCE per
+       (usage, make or break) into a byte template of up to kMaxBytesPerEvent
+       bytes (from the table in ScancodeTranslation.cpp).  Encoding an event
+       copies the whole template and advances by its length, whatever the
+       key.
+
+       Not modelled: the different bytes some keyboards send for Print Screen
+       with Alt held (SysRq) and for Pause with Control held (Break), and the
+       fake shifts around the extended navigation keys.
+     */
+    class ScancodeEncoder
+    {
+    public:
+
+        enum ScancodeSet
+        {
+            kSet1 = 1,
+            kSet2 = 2
+        };
+
+        enum
+        {
+            /// the longest sequence (Pause in set 2).  Encode needs this much room for ANY event.
+            kMaxBytesPerEvent = 8
+        };
+
+        explicit ScancodeEncoder( ScancodeSet scancodeSet );
+
+        ScancodeSet Set() const { return m_set; }
+
+        /**
+           Appends the bytes for 'events' to 'buffer', in order.  Events of
+           other usage pages, and keys with no scancode, produce nothing.
+           Pause produces its whole sequence on press and nothing on release,
+           like a real keyboard.
+
+           Returns how many events were consumed.  That is less than
+           'eventCount' only when fewer than kMaxBytesPerEvent bytes were left
+           in 'buffer'.  'bytesWritten' receives the number of bytes written.
+         */
+        size_t Encode
+        (
+         const KeyEvent* events,
+         size_t eventCount,
+         uint8_t* buffer,
+         size_t bufferSize,
+         size_t* bytesWritten
+        ) const;
+
+        /// the bytes for one edge of one HID usage. returns the length (zero when the key has no scancode).
+        size_t EncodeOne( uint16_t usage, bool pressed, uint8_t* buffer ) const;
+
+        /// just the object: the templates are shared by every encoder
+        MemoryUsageReport MemoryUsage() const;
+
+    private:
+
+        ScancodeSet m_set;
+        /// indexed by (usage << 1) | pressed
+        const uint8_t (*m_templates)[ kMaxBytesPerEvent ];
+        const uint8_t* m_lengths;
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_SCANCODE_ENCODER_H
@@ -0,0 +1,296 @@
+
+
+#include "ScancodeTranslation.h"
+
+#include <string.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+
+
+/*
+  THE table.  One row per key:
+
+      KEY( HID usage,  set-1,  set-2,  Linux evdev,  mac virtual keycode )
+
+  NONE means "this key has no code there" (zero cannot, it is the mac
+  keycode of 'a').  EX is the 0xE0 prefix.  When two rows give the same
+  code (the mac has no Print Screen key, so it gets F13's keycode, and so
+  on), translating back picks the FIRST row.
+
+  Sources: the USB HID usage tables (chapter 10), the Microsoft "USB HID to
+  PS/2 Scan Code Translation Table", linux/input-event-codes.h, and
+  g_aDarwinToSet1 in third_party_samples/DarwinKeyboard.cpp.
+*/
+#define SCANCODE_TABLE( KEY )                                                          \
+    /*     HID    set-1            set-2            evdev mac        */                \
+    KEY( 0x04, 0x1E,            0x1C,            30,  0x00 ) /* a */                   \
+    KEY( 0x05, 0x30,            0x32,            48,  0x0B ) /* b */                   \
+    KEY( 0x06, 0x2E,            0x21,            46,  0x08 ) /* c */                   \
+    KEY( 0x07, 0x20,            0x23,            32,  0x02 ) /* d */                   \
+    KEY( 0x08, 0x12,            0x24,            18,  0x0E ) /* e */                   \
+    KEY( 0x09, 0x21,            0x2B,            33,  0x03 ) /* f */                   \
+    KEY( 0x0A, 0x22,            0x34,            34,  0x05 ) /* g */                   \
+    KEY( 0x0B, 0x23,            0x33,            35,  0x04 ) /* h */                   \
+    KEY( 0x0C, 0x17,            0x43,            23,  0x22 ) /* i */                   \
+    KEY( 0x0D, 0x24,            0x3B,            36,  0x26 ) /* j */                   \
+    KEY( 0x0E, 0x25,            0x42,            37,  0x28 ) /* k */                   \
+    KEY( 0x0F, 0x26,            0x4B,            38,  0x25 ) /* l */                   \
+    KEY( 0x10, 0x32,            0x3A,            50,  0x2E ) /* m */                   \
+    KEY( 0x11, 0x31,            0x31,            49,  0x2D ) /* n */                   \
+    KEY( 0x12, 0x18,            0x44,            24,  0x1F ) /* o */                   \
+    KEY( 0x13, 0x19,            0x4D,            25,  0x23 ) /* p */                   \
+    KEY( 0x14, 0x10,            0x15,            16,  0x0C ) /* q */                   \
+    KEY( 0x15, 0x13,            0x2D,            19,  0x0F ) /* r */                   \
+    KEY( 0x16, 0x1F,            0x1B,            31,  0x01 ) /* s */                   \
+    KEY( 0x17, 0x14,            0x2C,            20,  0x11 ) /* t */                   \
+    KEY( 0x18, 0x16,            0x3C,            22,  0x20 ) /* u */                   \
+    KEY( 0x19, 0x2F,            0x2A,            47,  0x09 ) /* v */                   \
+    KEY( 0x1A, 0x11,            0x1D,            17,  0x0D ) /* w */                   \
+    KEY( 0x1B, 0x2D,            0x22,            45,  0x07 ) /* x */                   \
+    KEY( 0x1C, 0x15,            0x35,            21,  0x10 ) /* y */                   \
+    KEY( 0x1D, 0x2C,            0x1A,            44,  0x06 ) /* z */                   \
+    KEY( 0x1E, 0x02,            0x16,             2,  0x12 ) /* 1 */                   \
+    KEY( 0x1F, 0x03,            0x1E,             3,  0x13 ) /* 2 */                   \
+    KEY( 0x20, 0x04,            0x26,             4,  0x14 ) /* 3 */                   \
+    KEY( 0x21, 0x05,            0x25,             5,  0x15 ) /* 4 */                   \
+    KEY( 0x22, 0x06,            0x2E,             6,  0x17 ) /* 5 */                   \
+    KEY( 0x23, 0x07,            0x36,             7,  0x16 ) /* 6 */                   \
+    KEY( 0x24, 0x08,            0x3D,             8,  0x1A ) /* 7 */                   \
+    KEY( 0x25, 0x09,            0x3E,             9,  0x1C ) /* 8 */                   \
+    KEY( 0x26, 0x0A,            0x46,            10,  0x19 ) /* 9 */                   \
+    KEY( 0x27, 0x0B,            0x45,            11,  0x1D ) /* 0 */                   \
+    KEY( 0x28, 0x1C,            0x5A,            28,  0x24 ) /* return */              \
+    KEY( 0x29, 0x01,            0x76,             1,  0x35 ) /* escape */              \
+    KEY( 0x2A, 0x0E,            0x66,            14,  0x33 ) /* backspace */           \
+    KEY( 0x2B, 0x0F,            0x0D,            15,  0x30 ) /* tab */                 \
+    KEY( 0x2C, 0x39,            0x29,            57,  0x31 ) /* space */               \
+    KEY( 0x2D, 0x0C,            0x4E,            12,  0x1B ) /* - */                   \
+    KEY( 0x2E, 0x0D,            0x55,            13,  0x18 ) /* = */                   \
+    KEY( 0x2F, 0x1A,            0x54,            26,  0x21 ) /* [ */                   \
+    KEY( 0x30, 0x1B,            0x5B,            27,  0x1E ) /* ] */                   \
+    KEY( 0x31, 0x2B,            0x5D,            43,  0x2A ) /* backslash */           \
+    KEY( 0x32, 0x2B,            0x5D,            43,  0x2A ) /* non-US # (same key) */ \
+    KEY( 0x33, 0x27,            0x4C,            39,  0x29 ) /* ; */                   \
+    KEY( 0x34, 0x28,            0x52,            40,  0x27 ) /* ' */                   \
+    KEY( 0x35, 0x29,            0x0E,            41,  0x32 ) /* ` */                   \
+    KEY( 0x36, 0x33,            0x41,            51,  0x2B ) /* , */                   \
+    KEY( 0x37, 0x34,            0x49,            52,  0x2F ) /* . */                   \
+    KEY( 0x38, 0x35,            0x4A,            53,  0x2C ) /* / */                   \
+    KEY( 0x39, 0x3A|LOCK,       0x58|LOCK,       58,  0x39 ) /* caps lock */           \
+    KEY( 0x3A, 0x3B,            0x05,            59,  0x7A ) /* F1 */                  \
+    KEY( 0x3B, 0x3C,            0x06,            60,  0x78 ) /* F2 */                  \
+    KEY( 0x3C, 0x3D,            0x04,            61,  0x63 ) /* F3 */                  \
+    KEY( 0x3D, 0x3E,            0x0C,            62,  0x76 ) /* F4 */                  \
+    KEY( 0x3E, 0x3F,            0x03,            63,  0x60 ) /* F5 */                  \
+    KEY( 0x3F, 0x40,            0x0B,            64,  0x61 ) /* F6 */                  \
+    KEY( 0x40, 0x41,            0x83,            65,  0x62 ) /* F7 */                  \
+    KEY( 0x41, 0x42,            0x0A,            66,  0x64 ) /* F8 */                  \
+    KEY( 0x42, 0x43,            0x01,            67,  0x65 ) /* F9 */                  \
+    KEY( 0x43, 0x44,            0x09,            68,  0x6D ) /* F10 */                 \
+    KEY( 0x44, 0x57,            0x78,            87,  0x67 ) /* F11 */                 \
+    KEY( 0x45, 0x58,            0x07,            88,  0x6F ) /* F12 */                 \
+    KEY( 0x46, 0x37|EX,         0x7C|EX,         99,  0x69 ) /* print screen */        \
+    KEY( 0x47, 0x46|LOCK,       0x7E|LOCK,       70,  0x6B ) /* scroll lock */         \
+    KEY( 0x48, 0x45|SPECIAL,    0x77|SPECIAL,   119,  0x71 ) /* pause */               \
+    KEY( 0x49, 0x52|EX,         0x70|EX,        110,  0x72 ) /* insert (help) */       \
+    KEY( 0x4A, 0x47|EX,         0x6C|EX,        102,  0x73 ) /* home */                \
+    KEY( 0x4B, 0x49|EX,         0x7D|EX,        104,  0x74 ) /* page up */             \
+    KEY( 0x4C, 0x53|EX,         0x71|EX,        111,  0x75 ) /* delete */              \
+    KEY( 0x4D, 0x4F|EX,         0x69|EX,        107,  0x77 ) /* end */                 \
+    KEY( 0x4E, 0x51|EX,         0x7A|EX,        109,  0x79 ) /* page down */           \
+    KEY( 0x4F, 0x4D|EX,         0x74|EX,        106,  0x7C ) /* right */               \
+    KEY( 0x50, 0x4B|EX,         0x6B|EX,        105,  0x7B ) /* left */                \
+    KEY( 0x51, 0x50|EX,         0x72|EX,        108,  0x7D ) /* down */                \
+    KEY( 0x52, 0x48|EX,         0x75|EX,        103,  0x7E ) /* up */                  \
+    KEY( 0x53, 0x45|LOCK,       0x77|LOCK,       69,  0x47 ) /* num lock (clear) */    \
+    KEY( 0x54, 0x35|EX,         0x4A|EX,         98,  0x4B ) /* keypad / */            \
+    KEY( 0x55, 0x37,            0x7C,            55,  0x43 ) /* keypad * */            \
+    KEY( 0x56, 0x4A,            0x7B,            74,  0x4E ) /* keypad - */            \
+    KEY( 0x57, 0x4E,            0x79,            78,  0x45 ) /* keypad + */            \
+    KEY( 0x58, 0x1C|EX,         0x5A|EX,         96,  0x4C ) /* keypad enter */        \
+    KEY( 0x59, 0x4F,            0x69,            79,  0x53 ) /* keypad 1 */            \
+    KEY( 0x5A, 0x50,            0x72,            80,  0x54 ) /* keypad 2 */            \
+    KEY( 0x5B, 0x51,            0x7A,            81,  0x55 ) /* keypad 3 */            \
+    KEY( 0x5C, 0x4B,            0x6B,            75,  0x56 ) /* keypad 4 */            \
+    KEY( 0x5D, 0x4C,            0x73,            76,  0x57 ) /* keypad 5 */            \
+    KEY( 0x5E, 0x4D,            0x74,            77,  0x58 ) /* keypad 6 */            \
+    KEY( 0x5F, 0x47,            0x6C,            71,  0x59 ) /* keypad 7 */            \
+    KEY( 0x60, 0x48,            0x75,            72,  0x5B ) /* keypad 8 */            \
+    KEY( 0x61, 0x49,            0x7D,            73,  0x5C ) /* keypad 9 */            \
+    KEY( 0x62, 0x52,            0x70,            82,  0x52 ) /* keypad 0 */            \
+    KEY( 0x63, 0x53,            0x71,            83,  0x41 ) /* keypad . */            \
+    KEY( 0x64, 0x56,            0x61,            86,  0x0A ) /* non-US backslash */    \
+    KEY( 0x65, 0x5D|EX,         0x2F|EX,        127,  0x6E ) /* application (menu) */  \
+    KEY( 0x66, 0x5E|EX,         0x37|EX,        116,  0x7F ) /* power */               \
+    KEY( 0x67, 0x59,            0x0F,           117,  0x51 ) /* keypad = */            \
+    KEY( 0x87, 0x73,            0x51,            89,  0x5E ) /* international 1 (ro) */\
+    KEY( 0x88, 0x70,            0x13,            93,  NONE ) /* international 2 (katakana/hiragana) */ \
+    KEY( 0x89, 0x7D,            0x6A,           124,  0x5D ) /* international 3 (yen) */ \
+    KEY( 0x8A, 0x79,            0x64,            92,  NONE ) /* international 4 (henkan) */ \
+    KEY( 0x8B, 0x7B,            0x67,            94,  NONE ) /* international 5 (muhenkan) */ \
+    KEY( 0x90, 0xF2,            0xF2,           122,  0x68 ) /* lang 1 (hangul, kana) */ \
+    KEY( 0x91, 0xF1,            0xF1,           123,  0x66 ) /* lang 2 (hanja, eisu) */ \
+    KEY( 0xE0, 0x1D|MOD,        0x14|MOD,        29,  0x3B ) /* left control */        \
+    KEY( 0xE1, 0x2A|MOD,        0x12|MOD,        42,  0x38 ) /* left shift */          \
+    KEY( 0xE2, 0x38|MOD,        0x11|MOD,        56,  0x3A ) /* left alt (option) */   \
+    KEY( 0xE3, 0x5B|EX|MOD,     0x1F|EX|MOD,    125,  0x37 ) /* left GUI (command) */  \
+    KEY( 0xE4, 0x1D|EX|MOD,     0x14|EX|MOD,     97,  0x3E ) /* right control */       \
+    KEY( 0xE5, 0x36|MOD,        0x59|MOD,        54,  0x3C ) /* right shift */         \
+    KEY( 0xE6, 0x38|EX|MOD,     0x11|EX|MOD,    100,  0x3D ) /* right alt (option) */  \
+    KEY( 0xE7, 0x5C|EX|MOD,     0x27|EX|MOD,    126,  0x36 ) /* right GUI (command) */
+
+
+
+namespace
+{
+    const uint16_t EX      = GitHubSample::kScancodeExtended;
+    const uint16_t MOD     = GitHubSample::kScancodeModifier;
+    const uint16_t LOCK    = GitHubSample::kScancodeLock;
+    const uint16_t SPECIAL = GitHubSample::kScancodeSpecial;
+    const uint16_t NONE    = GitHubSample::kNoKeyCode;
+
+    struct KeyRow
+    {
+        uint16_t code[ GitHubSample::kKeyCodeSpaceCount ];
+    };
+
+#define SCANCODE_TABLE_ROW( hid, set1, set2, evdev, mac ) { { hid, set1, set2, evdev, mac } },
+
+    const KeyRow KEY_ROWS[] =
+    {
+        SCANCODE_TABLE( SCANCODE_TABLE_ROW )
+    };
+
+#undef SCANCODE_TABLE_ROW
+
+    const size_t KEY_ROW_COUNT = sizeof(KEY_ROWS) / sizeof(KEY_ROWS[0]);
+
+    /// a scancode's index is its low byte plus the extended bit: the other flags are not part of its identity
+    const size_t CODE_INDEX_COUNT = 0x200;
+    const uint16_t CODE_INDEX_MASK = 0x1FF;
+    const size_t HID_USAGE_COUNT = 0x100;
+
+    /// the bits that may be set in an INPUT code of each space
+    const uint16_t VALID_INPUT_BITS[ GitHubSample::kKeyCodeSpaceCount ] =
+    {
+        0x00FF,                            // kHidUsage
+        CODE_INDEX_MASK | MOD | LOCK,      // kSet1Scancode
+        CODE_INDEX_MASK | MOD | LOCK,      // kSet2Scancode
+        0x00FF,                            // kLinuxEvdev
+        0x007F                             // kDarwinKeycode
+    };
+
+    /**
+       The dense tables that the single source table above expands into.  The
+       one extra entry at the end of each row lets a vector gather load 32
+       bits at the last index without reading past the array.
+     */
+    struct TranslationTables
+    {
+        uint16_t hidByCodeIndex[ GitHubSample::kKeyCodeSpaceCount ][ CODE_INDEX_COUNT + 1 ];
+        uint16_t codeByHid[ GitHubSample::kKeyCodeSpaceCount ][ HID_USAGE_COUNT + 1 ];
+
+        TranslationTables()
+        {
+            // HID usage zero is no key, and every code of it is kNoKeyCode
+            memset( hidByCodeIndex, 0, sizeof(hidByCodeIndex) );
+            memset( codeByHid, 0xFF, sizeof(codeByHid) );
+
+            for ( size_t row = 0; row < KEY_ROW_COUNT; row++ )
+            {
+                const uint16_t hid = KEY_ROWS[ row ].code[ GitHubSample::kHidUsage ];
+
+                for ( size_t space = 0; space < GitHubSample::kKeyCodeSpaceCount; space++ )
+                {
+                    const uint16_t code = KEY_ROWS[ row ].code[ space ];
+                    if ( code == NONE )
+                    {
+                        continue;
+                    }
+
+                    codeByHid[ space ][ hid ] = code;
+
+                    // Pause cannot be recognized by (prefix, code), so it has no way back
+                    uint16_t& back = hidByCodeIndex[ space ][ code & CODE_INDEX_MASK ];
+                    if ( back == 0 && ! ( code & SPECIAL ) )
+                    {
+                        back = hid; // the first row wins
+                    }
+                }
+            }
+        }
+
+        uint16_t Translate( const size_t from, const size_t to, const uint16_t code ) const
+        {
+            const bool valid = ( code & ~VALID_INPUT_BITS[ from ] ) == 0;
+            const uint16_t hid = hidByCodeIndex[ from ][ code & CODE_INDEX_MASK ] & -static_cast<int>( valid );
+            return codeByHid[ to ][ hid ];
+        }
+    };
+
+
+    /// The tables are built from KEY_ROWS the first time anyone translates anything.
+    const TranslationTables& Tables()
+    {
+        static const TranslationTables tables;
+        return tables;
+    }
+}
+
+
+
+uint16_t GitHubSample::TranslateKeyCode( const KeyCodeSpace from, const KeyCodeSpace to, const uint16_t code )
+{
+    return Tables().Translate( from, to, code );
+}
+
+
+/**
+   With AVX2 (not on any mac that runs 10.5, but on the servers that replay
+   recorded sessions) both lookups are done as 8-wide gathers.
+*/
+void GitHubSample::TranslateKeyCodes
+(
+ const KeyCodeSpace from,
+ const KeyCodeSpace to,
+ const uint16_t* input,
+ uint16_t* output,
+ const size_t count
+)
+{
+    const TranslationTables& tables = Tables();
+    size_t i = 0;
+
+#ifdef __AVX2__
+    const __m256i invalidBits = _mm256_set1_epi32( static_cast<uint16_t>( ~VALID_INPUT_BITS[ from ] ) );
+    const __m256i indexMask = _mm256_set1_epi32( CODE_INDEX_MASK );
+    const __m256i lowHalf = _mm256_set1_epi32( 0xFFFF );
+    const int* hidTable = reinterpret_cast<const int*>( tables.hidByCodeIndex[ from ] );
+    const int* codeTable = reinterpret_cast<const int*>( tables.codeByHid[ to ] );
+
+    for ( ; i + 8 <= count; i += 8 )
+    {
+        const __m256i codes = _mm256_cvtepu16_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>( input + i ) ) );
+        const __m256i valid = _mm256_cmpeq_epi32( _mm256_and_si256( codes, invalidBits ), _mm256_setzero_si256() );
+
+        // scale 2: the tables hold uint16, so each gather also picks up the NEXT entry in the high half
+        __m256i hids = _mm256_i32gather_epi32( hidTable, _mm256_and_si256( codes, indexMask ), 2 );
+        hids = _mm256_and_si256( _mm256_and_si256( hids, lowHalf ), valid );
+
+        __m256i results = _mm256_i32gather_epi32( codeTable, hids, 2 );
+        results = _mm256_and_si256( results, lowHalf );
+
+        // packus works within each 128-bit lane, so put the two halves back together afterwards
+        const __m256i packed = _mm256_permute4x64_epi64( _mm256_packus_epi32( results, results ), 0xD8 );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( output + i ), _mm256_castsi256_si128( packed ) );
+    }
+#endif // __AVX2__
+
+    for ( ; i < count; i++ )
+    {
+        output[i] = tables.Translate( from, to, input[i] );
+    }
+}
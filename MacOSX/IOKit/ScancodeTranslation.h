@@ -0,0 +1,69 @@
+
+#ifndef GITHUBSAMPLE_SCANCODE_TRANSLATION_H
+#define GITHUBSAMPLE_SCANCODE_TRANSLATION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "DarwinKeycodeTables.h"
+
+
+namespace GitHubSample
+{
+
+    /**
+       Translation between every way of numbering a key that our VM and
+       remote desktop code meets:
+
+         - HID usage ids (kHIDPage_KeyboardOrKeypad), what the reader delivers
+         - PC set-1 and set-2 scancodes (what an emulated i8042 sends)
+         - Linux evdev KEY_* codes
+         - mac virtual keycodes (see DarwinKeycodeTables.h)
+
+       All of it comes from ONE table in ScancodeTranslation.cpp (one row per
+       key, one column per numbering), so the directions cannot disagree.
+       Every direction goes through the HID usage, and each step is a single
+       array load.
+
+       Scancodes carry flag bits in the upper byte: kScancodeExtended means
+       "sent with an 0xE0 prefix".  Keys that do not fit (prefix, code) at all
+       (Pause) have kScancodeSpecial set; ScancodeEncoder knows their bytes.
+     */
+
+    enum KeyCodeSpace
+    {
+        kHidUsage,
+        kSet1Scancode,
+        kSet2Scancode,
+        kLinuxEvdev,
+        kDarwinKeycode,
+
+        kKeyCodeSpaceCount
+    };
+
+    /// the same bits as Set1ScancodeFlags (they mean the same for set-2)
+    enum ScancodeFlags
+    {
+        kScancodeExtended = kSet1Extended,
+        kScancodeModifier = kSet1Modifier,
+        kScancodeLock     = kSet1Lock,
+        kScancodeSpecial  = 0x1000,
+        kScancodeCodeMask = 0x00FF
+    };
+
+    enum
+    {
+        /// "this key has no code there".  Not zero: zero is a real mac keycode ('a').
+        kNoKeyCode = 0xFFFF
+    };
+
+    /// Returns kNoKeyCode when the key has no code in 'to' (or 'code' means nothing in 'from').
+    /// Flag bits of a scancode other than kScancodeExtended are ignored on input.
+    uint16_t TranslateKeyCode( KeyCodeSpace from, KeyCodeSpace to, uint16_t code );
+
+    /// The same for a whole array.  'input' and 'output' may be the same array.
+    void TranslateKeyCodes( KeyCodeSpace from, KeyCodeSpace to, const uint16_t* input, uint16_t* output, size_t count );
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_SCANCODE_TRANSLATION_H
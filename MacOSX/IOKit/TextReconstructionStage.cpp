@@ -0,0 +1,244 @@
+
+
+#include "TextReconstructionStage.h"
+
+#include "KeyboardLayout.h"
+
+
+
+namespace
+{
+    // these are the kHIDUsage_* values. see the comment on LoadBuiltInUSLayout.
+    const uint16_t USAGE_PAGE_KEYBOARD_OR_KEYPAD = 0x07;
+    const unsigned int USAGE_ESCAPE              = 0x29;
+    const unsigned int USAGE_BACKSPACE           = 0x2A;
+    const unsigned int USAGE_CAPS_LOCK           = 0x39;
+    const unsigned int USAGE_KEYPAD_NUM_LOCK     = 0x53;
+    const unsigned int USAGE_LEFT_CONTROL        = 0xE0;
+    const unsigned int USAGE_RIGHT_GUI           = 0xE7;
+
+    // bits of the HID boot protocol modifier byte
+    const uint8_t MODIFIERS_CONTROL  = 0x11;
+    const uint8_t MODIFIERS_SHIFT    = 0x22;
+    const uint8_t MODIFIERS_LEFT_ALT = 0x04;
+    const uint8_t MODIFIERS_GUI      = 0x88;
+    const uint8_t MODIFIERS_RIGHT_ALT = 0x40;
+
+    /// returns the number of bytes written (0 for the 'no character' code point zero)
+    inline size_t EncodeUtf8( const uint32_t codePoint, char* out )
+    {
+        if ( codePoint < 0x80 )
+        {
+            out[0] = static_cast<char>( codePoint );
+            return ( codePoint != 0 );
+        }
+        else if ( codePoint < 0x800 )
+        {
+            out[0] = static_cast<char>( 0xC0 | ( codePoint >> 6 ) );
+            out[1] = static_cast<char>( 0x80 | ( codePoint & 0x3F ) );
+            return 2;
+        }
+        else if ( codePoint < 0x10000 )
+        {
+            out[0] = static_cast<char>( 0xE0 | ( codePoint >> 12 ) );
+            out[1] = static_cast<char>( 0x80 | ( ( codePoint >> 6 ) & 0x3F ) );
+            out[2] = static_cast<char>( 0x80 | ( codePoint & 0x3F ) );
+            return 3;
+        }
+
+        out[0] = static_cast<char>( 0xF0 | ( codePoint >> 18 ) );
+        out[1] = static_cast<char>( 0x80 | ( ( codePoint >> 12 ) & 0x3F ) );
+        out[2] = static_cast<char>( 0x80 | ( ( codePoint >> 6 ) & 0x3F ) );
+        out[3] = static_cast<char>( 0x80 | ( codePoint & 0x3F ) );
+        return 4;
+    }
+}
+
+
+
+GitHubSample::TextReconstructionStage::TextReconstructionStage( const KeyboardLayout& layout )
+    : m_layout( &layout ),
+      m_modifierKeys( 0 ),
+      m_capsLockOn( false ),
+      m_numLockOn( false ),
+      m_state( 0 )
+{
+    RebuildSelectorTables();
+    RecomputeState();
+}
+
+
+void GitHubSample::TextReconstructionStage::SetLayout( const KeyboardLayout& layout )
+{
+    m_layout = &layout;
+    RecomputeState(); // the left-alt-is-AltGr rule comes from the layout
+}
+
+
+void GitHubSample::TextReconstructionStage::Reset()
+{
+    m_modifierKeys = 0;
+    m_capsLockOn = false;
+    m_numLockOn = false;
+    m_compose.Cancel();
+    RecomputeState();
+}
+
+
+void GitHubSample::TextReconstructionStage::SetLockState( const bool capsLockOn, const bool numLockOn )
+{
+    m_capsLockOn = capsLockOn;
+    m_numLockOn = numLockOn;
+    RecomputeState();
+}
+
+
+/**
+   A selector is (KeyFlags << 6) | StateBits.  For every possible selector we
+   decide, ONCE, which level of the layout applies and whether the key makes
+   any text at all.  The rules:
+
+     - Control or GUI held: no text.
+     - caps lock inverts shift, but only for keys flagged kCapsLockAffectsKey.
+     - keys flagged kNumLockAffectsKey make no text while num lock is off.
+*/
+void GitHubSample::TextReconstructionStage::RebuildSelectorTables()
+{
+    for ( unsigned int selector = 0; selector < kSelectorCount; selector++ )
+    {
+        const unsigned int state = selector & 0x3F;
+        const unsigned int keyFlags = selector >> 6;
+
+        bool shifted = ( state & kStateShift ) != 0;
+        if ( ( keyFlags & KeyboardLayout::kCapsLockAffectsKey ) && ( state & kStateCaps ) )
+        {
+            shifted = ! shifted;
+        }
+
+        bool emits = ( 0 == ( state & ( kStateControl | kStateGUI ) ) );
+        if ( ( keyFlags & KeyboardLayout::kNumLockAffectsKey ) && ! ( state & kStateNum ) )
+        {
+            emits = false;
+        }
+
+        const unsigned int level = ( shifted ? KeyboardLayout::kLevelShift : KeyboardLayout::kLevelBase )
+            | ( ( state & kStateAltGr ) ? KeyboardLayout::kLevelAltGr : 0 );
+
+        m_rowOffsetBySelector[ selector ] = static_cast<uint16_t>( level * KeyboardLayout::kUsageCount );
+        m_emitMaskBySelector[ selector ] = emits ? 0xFFFFFFFF : 0;
+    }
+}
+
+
+void GitHubSample::TextReconstructionStage::RecomputeState()
+{
+    uint8_t altGrKeys = MODIFIERS_RIGHT_ALT;
+    if ( m_layout->Flags() & KeyboardLayout::kLeftAltActsAsAltGr )
+    {
+        altGrKeys |= MODIFIERS_LEFT_ALT;
+    }
+
+    m_state = ( ( m_modifierKeys & MODIFIERS_SHIFT )   ? kStateShift   : 0 )
+        |     ( ( m_modifierKeys & altGrKeys )         ? kStateAltGr   : 0 )
+        |     ( m_capsLockOn                           ? kStateCaps    : 0 )
+        |     ( m_numLockOn                            ? kStateNum     : 0 )
+        |     ( ( m_modifierKeys & MODIFIERS_CONTROL ) ? kStateControl : 0 )
+        |     ( ( m_modifierKeys & MODIFIERS_GUI )     ? kStateGUI     : 0 );
+}
+
+
+size_t GitHubSample::TextReconstructionStage::Process
+(
+ const KeyEvent* events,
+ const size_t eventCount,
+ char* utf8Buffer,
+ const size_t bufferSize,
+ size_t* bytesWritten
+)
+{
+    size_t written = 0;
+    size_t consumed = 0;
+
+    // with an empty layout nothing makes text, but modifiers and locks are still tracked
+    const uint32_t* codePoints = m_layout->IsEmpty() ? 0 : m_layout->CodePointTable();
+    const uint8_t* keyFlags = m_layout->IsEmpty() ? 0 : m_layout->KeyFlagsTable();
+
+    for ( ; consumed < eventCount; consumed++ )
+    {
+        const KeyEvent& event = events[ consumed ];
+
+        if ( event.usagePage != USAGE_PAGE_KEYBOARD_OR_KEYPAD || event.usage >= KeyboardLayout::kUsageCount )
+        {
+            continue;
+        }
+
+        const unsigned int usage = event.usage;
+
+        if ( usage >= USAGE_LEFT_CONTROL && usage <= USAGE_RIGHT_GUI )
+        {
+            const uint8_t bit = static_cast<uint8_t>( 1 << ( usage - USAGE_LEFT_CONTROL ) );
+            m_modifierKeys = event.value ? ( m_modifierKeys | bit ) : ( m_modifierKeys & ~bit );
+            RecomputeState();
+            continue;
+        }
+
+        if ( event.value == 0 )
+        {
+            continue; // releases never make text
+        }
+
+        if ( usage == USAGE_CAPS_LOCK || usage == USAGE_KEYPAD_NUM_LOCK )
+        {
+            ( usage == USAGE_CAPS_LOCK ? m_capsLockOn : m_numLockOn ) ^= true;
+            RecomputeState();
+            continue;
+        }
+
+        if ( ! codePoints )
+        {
+            continue;
+        }
+
+        if ( bufferSize - written < kMaxBytesPerEvent )
+        {
+            break; // the caller's buffer is (nearly) full. resume from this event next time.
+        }
+
+        if ( ( usage == USAGE_ESCAPE || usage == USAGE_BACKSPACE ) && m_compose.IsPending() )
+        {
+            m_compose.Cancel();
+            continue;
+        }
+
+        const unsigned int selector = ( ( keyFlags[ usage ] & 0x03 ) << 6 ) | m_state;
+        const uint32_t symbol = codePoints[ m_rowOffsetBySelector[ selector ] + usage ] & m_emitMaskBySelector[ selector ];
+
+        if ( symbol == 0 )
+        {
+            continue;
+        }
+
+        uint32_t composed[ ComposeState::kMaxOutput ];
+        const size_t composedCount = m_compose.Feed( symbol, composed );
+
+        for ( size_t i = 0; i < composedCount; i++ )
+        {
+            written += EncodeUtf8( composed[i], utf8Buffer + written );
+        }
+    }
+
+    if ( bytesWritten )
+    {
+        *bytesWritten = written;
+    }
+
+    return consumed;
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::TextReconstructionStage::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) );
+    return report;
+}
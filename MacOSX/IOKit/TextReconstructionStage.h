@@ -0,0 +1,131 @@
+
+#ifndef GITHUBSAMPLE_TEXT_RECONSTRUCTION_STAGE_H
+#define GITHUBSAMPLE_TEXT_RECONSTRUCTION_STAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ComposeTable.h"
+#include "KeyEvent.h"
+#include "MemoryUsage.h"
+
+
+namespace GitHubSample
+{
+
+    class KeyboardLayout;
+
+    /**
+       Turns a stream of KeyEvent (HID usages, press and release) back into the
+       UTF-8 text that was typed.
+
+       The stage tracks the eight modifier keys (kHIDUsage_KeyboardLeftControl
+       through kHIDUsage_KeyboardRightGUI) and the caps lock and num lock
+       state.  All of the "which level of the layout applies to this key right
+       now" decisions are folded into two small tables that are rebuilt only
+       when a modifier or lock changes, so the per-keypress work is: one flag
+       load, one table lookup, one code point load, and the UTF-8 encoding.
+
+       Keys pressed while Control or Command (GUI) is held produce no text,
+       since those are shortcuts and not typing.
+
+       Dead keys and the compose key go through a ComposeState.  Without a
+       ComposeTable a dead key simply types its spacing accent.  Escape or
+       Backspace while a sequence is pending abandons the sequence and is
+       swallowed.
+
+       One stage per keyboard: modifier state is per device.
+     */
+    class TextReconstructionStage
+    {
+    public:
+
+        /// a cancelled compose sequence can flush several code points for one key
+        enum { kMaxBytesPerEvent = ComposeState::kMaxOutput * 4 };
+
+        /// the layout is NOT copied. it must outlive this stage.
+        explicit TextReconstructionStage( const KeyboardLayout& layout );
+
+        void SetLayout( const KeyboardLayout& layout );
+
+        /// the table is NOT copied. NULL turns composing off.
+        void SetComposeTable( const ComposeTable* table ) { m_compose.SetTable( table ); }
+        void SetComposeCancelPolicy( ComposeState::CancelPolicy policy ) { m_compose.SetCancelPolicy( policy ); }
+
+        /// forget modifiers, locks and any pending compose sequence (e.g. after the device was re-opened)
+        void Reset();
+
+        /// the reader cannot see the LED state, so the caller may seed the locks.
+        void SetLockState( bool capsLockOn, bool numLockOn );
+
+        /**
+           Consumes events and appends UTF-8 to 'utf8Buffer'.  Nothing is
+           zero-terminated.
+
+           Returns how many events were consumed.  That is less than
+           'eventCount' only when fewer than kMaxBytesPerEvent bytes were left
+           in 'utf8Buffer'; call again with the remaining events and a fresh
+           buffer.  'bytesWritten' receives the number of bytes placed in
+           'utf8Buffer'.
+         */
+        size_t Process
+        (
+         const KeyEvent* events,
+         size_t eventCount,
+         char* utf8Buffer,
+         size_t bufferSize,
+         size_t* bytesWritten
+        );
+
+        /// HID boot protocol order: bit 0 is left control ... bit 7 is right GUI
+        uint8_t ModifierKeys() const { return m_modifierKeys; }
+        bool CapsLockOn() const { return m_capsLockOn; }
+        bool NumLockOn() const { return m_numLockOn; }
+        bool ComposePending() const { return m_compose.IsPending(); }
+
+        /// the selector tables live in the object. the layout and compose table are borrowed, so not counted.
+        MemoryUsageReport MemoryUsage() const;
+
+    private:
+
+        enum
+        {
+            /// (2 bits of KeyboardLayout::KeyFlags) x (6 bits of StateBits)
+            kSelectorCount = 256
+        };
+
+        /// the six bits of state that decide which row of the layout is used
+        enum StateBits
+        {
+            kStateShift   = 0x01,
+            kStateAltGr   = 0x02,
+            kStateCaps    = 0x04,
+            kStateNum     = 0x08,
+            kStateControl = 0x10,
+            kStateGUI     = 0x20
+        };
+
+        const KeyboardLayout* m_layout;
+        uint8_t m_modifierKeys;
+        bool m_capsLockOn;
+        bool m_numLockOn;
+        unsigned int m_state;
+        ComposeState m_compose;
+
+        /// index of the first code point of the row to use, per selector
+        uint16_t m_rowOffsetBySelector[ kSelectorCount ];
+        /// all-ones when the key makes text, zero when it must be swallowed
+        uint32_t m_emitMaskBySelector[ kSelectorCount ];
+
+        void RebuildSelectorTables();
+        void RecomputeState();
+
+        /// declared private so as to make this class non-copyable
+        TextReconstructionStage(const TextReconstructionStage&);
+        /// declared private so as to make this class non-copyable
+        TextReconstructionStage& operator=(const TextReconstructionStage&);
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_TEXT_RECONSTRUCTION_STAGE_H
@@ -0,0 +1,175 @@
+
+
+#include "TimestampMerger.h"
+
+
+
+namespace
+{
+    const uint64_t NO_TIMESTAMP = ~static_cast<uint64_t>( 0 );
+}
+
+
+
+GitHubSample::TimestampMerger::TimestampMerger( const size_t deviceCount, const uint64_t reorderWindow )
+    : m_queues( deviceCount ),
+      m_leafBase( 1 ),
+      m_reorderWindow( reorderWindow ),
+      m_watermark( 0 ),
+      m_newestTimestamp( 0 ),
+      m_pendingCount( 0 ),
+      m_emptyQueueCount( deviceCount ),
+      m_lateCount( 0 )
+{
+    while ( m_leafBase < deviceCount )
+    {
+        m_leafBase <<= 1;
+    }
+
+    // The padding leaves hold a device index that does not exist, and so
+    // always lose.  Every node starts out as the leftmost leaf below it.
+    m_tree.resize( m_leafBase * 2 );
+    for ( size_t leaf = 0; leaf < m_leafBase; leaf++ )
+    {
+        m_tree[ m_leafBase + leaf ] = static_cast<uint32_t>( leaf );
+    }
+    for ( size_t node = m_leafBase - 1; node >= 1; node-- )
+    {
+        m_tree[ node ] = m_tree[ node * 2 ];
+    }
+}
+
+
+uint64_t GitHubSample::TimestampMerger::HeadTimestamp( const uint32_t device ) const
+{
+    if ( device >= m_queues.size() || m_queues[ device ].empty() )
+    {
+        return NO_TIMESTAMP;
+    }
+
+    return m_queues[ device ].front().timestamp;
+}
+
+
+/// The head of 'device' changed: replay its matches on the way up to the root.
+void GitHubSample::TimestampMerger::Replay( const size_t device )
+{
+    for ( size_t node = ( m_leafBase + device ) >> 1; node >= 1; node >>= 1 )
+    {
+        const uint32_t left = m_tree[ node * 2 ];
+        const uint32_t right = m_tree[ node * 2 + 1 ];
+
+        // ties go left, i.e. to the lower device index
+        m_tree[ node ] = ( HeadTimestamp( right ) < HeadTimestamp( left ) ) ? right : left;
+    }
+}
+
+
+bool GitHubSample::TimestampMerger::Push( const KeyEvent& event )
+{
+    if ( event.deviceIndex >= m_queues.size() )
+    {
+        return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    std::deque< KeyEvent >& queue = m_queues[ event.deviceIndex ];
+    const bool wasEmpty = queue.empty();
+
+    queue.push_back( event );
+
+    if ( event.timestamp < m_watermark )
+    {
+        // something later was already handed out
+        queue.back().flags |= kKeyEventLate;
+        m_lateCount++;
+    }
+
+    m_pendingCount++;
+    if ( event.timestamp > m_newestTimestamp )
+    {
+        m_newestTimestamp = event.timestamp;
+    }
+
+    // only a new HEAD can change the tournament
+    if ( wasEmpty )
+    {
+        m_emptyQueueCount--;
+        Replay( event.deviceIndex );
+    }
+
+    return true;
+}
+
+
+void GitHubSample::TimestampMerger::Push( const KeyEvent* events, const size_t eventCount )
+{
+    for ( size_t i = 0; i < eventCount; i++ )
+    {
+        Push( events[i] );
+    }
+}
+
+
+size_t GitHubSample::TimestampMerger::Drain( KeyEvent* events, const size_t capacity, const bool ignoreWindow )
+{
+    size_t count = 0;
+
+    while ( count < capacity && m_pendingCount > 0 )
+    {
+        const uint32_t device = m_tree[ 1 ];
+        std::deque< KeyEvent >& queue = m_queues[ device ];
+        const uint64_t timestamp = queue.front().timestamp;
+
+        // Safe when: it is late anyway, or every device has something queued
+        // (so nothing earlier can show up), or it has waited out the window.
+        const bool ready = ignoreWindow
+            || timestamp < m_watermark
+            || m_emptyQueueCount == 0
+            || m_newestTimestamp - timestamp > m_reorderWindow;
+
+        if ( ! ready )
+        {
+            break;
+        }
+
+        events[ count++ ] = queue.front();
+        queue.pop_front();
+        m_pendingCount--;
+
+        if ( timestamp > m_watermark )
+        {
+            m_watermark = timestamp;
+        }
+
+        if ( queue.empty() )
+        {
+            m_emptyQueueCount++;
+        }
+
+        Replay( device );
+    }
+
+    return count;
+}
+
+
+size_t GitHubSample::TimestampMerger::Pop( KeyEvent* events, const size_t capacity )
+{
+    return Drain( events, capacity, false );
+}
+
+
+size_t GitHubSample::TimestampMerger::Flush( KeyEvent* events, const size_t capacity )
+{
+    return Drain( events, capacity, true );
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::TimestampMerger::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) );
+    report.AddHeap( MemoryUsageReport::kDeviceState, CapacityBytes( m_queues ) + CapacityBytes( m_tree ) );
+    report.AddHeap( MemoryUsageReport::kEventBuffers, m_pendingCount * sizeof(KeyEvent) );
+    return report;
+}
@@ -0,0 +1,87 @@
+
+#ifndef GITHUBSAMPLE_TIMESTAMP_MERGER_H
+#define GITHUBSAMPLE_TIMESTAMP_MERGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+#include "KeyEvent.h"
+#include "MemoryUsage.h"
+
+
+namespace GitHubSample
+{
+
+    /**
+       Merges the events of several keyboards into ONE stream, in timestamp
+       order.
+
+       Each reader is drained whenever the caller gets around to it, so the
+       events of device 1 can arrive a whole batch after later events of
+       device 0.  Push everything in as it is drained (each device's own
+       events must be in order, which the IOHID queue guarantees), and Pop
+       hands events back out in global timestamp order.
+
+       An event is held back until either every device has something queued
+       (then nothing earlier can still come from anyone), or the newest
+       timestamp seen is more than 'reorderWindow' past it.  The window bounds
+       the added latency.  The watermark is the timestamp of the last event
+       handed out; an event that arrives below the watermark is too late to
+       be put in order, so it comes out next, with kKeyEventLate set.
+
+       The devices are the leaves of a tournament tree whose nodes hold the
+       device with the earliest queued event, so both Push and Pop cost
+       O(log devices).
+
+       Timestamps must be in one unit for all devices (e.g. nanoseconds from
+       HighResolutionClock, corrected per device).
+     */
+    class TimestampMerger
+    {
+    public:
+
+        /// 'deviceCount' is the number of distinct KeyEvent::deviceIndex values (0 .. deviceCount-1)
+        TimestampMerger( size_t deviceCount, uint64_t reorderWindow );
+
+        /// Events with a deviceIndex of deviceCount or more are dropped (returns false).
+        bool Push( const KeyEvent& event );
+        void Push( const KeyEvent* events, size_t eventCount );
+
+        /// Hands out, in order, up to 'capacity' events that are ready.  Returns how many.
+        size_t Pop( KeyEvent* events, size_t capacity );
+
+        /// Like Pop, but ignores the window: hands out everything (e.g. at shutdown).
+        size_t Flush( KeyEvent* events, size_t capacity );
+
+        uint64_t Watermark() const { return m_watermark; }
+        size_t PendingCount() const { return m_pendingCount; }
+        size_t DeviceCount() const { return m_queues.size(); }
+        /// how many events were flagged kKeyEventLate so far
+        uint64_t LateCount() const { return m_lateCount; }
+
+        /// the queued events are counted by size, since a deque does not show its blocks
+        MemoryUsageReport MemoryUsage() const;
+
+    private:
+
+        std::vector< std::deque< KeyEvent > > m_queues;
+        /// m_tree[1] is the root, m_tree[m_leafBase + device] the leaves. each node holds a device index.
+        std::vector< uint32_t > m_tree;
+        size_t m_leafBase;
+        uint64_t m_reorderWindow;
+        uint64_t m_watermark;
+        uint64_t m_newestTimestamp;
+        size_t m_pendingCount;
+        size_t m_emptyQueueCount;
+        uint64_t m_lateCount;
+
+        uint64_t HeadTimestamp( uint32_t device ) const;
+        void Replay( size_t device );
+        size_t Drain( KeyEvent* events, size_t capacity, bool ignoreWindow );
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_TIMESTAMP_MERGER_H
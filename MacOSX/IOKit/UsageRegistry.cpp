@@ -0,0 +1,223 @@
+
+
+#include "UsageRegistry.h"
+#include "RealtimeThreadConfig.h"
+
+#include <string.h>
+
+
+
+namespace
+{
+    /// cookies are small numbers (element indices), but a broken descriptor could report anything
+    const uint32_t MAX_COOKIE = 0xFFFF;
+
+    /// places in the block hash table to begin with (a power of two).  enough for a keyboard.
+    const size_t INITIAL_BLOCK_TABLE_SIZE = 32;
+}
+
+
+
+const uint32_t GitHubSample::UsageRegistry::kNoSlot;
+const uint32_t GitHubSample::UsageRegistry::kNoBlock;
+
+
+GitHubSample::UsageRegistry::UsageRegistry()
+    : m_blockKeys( INITIAL_BLOCK_TABLE_SIZE, kNoBlock ),
+      m_blockNumbers( INITIAL_BLOCK_TABLE_SIZE, 0 ),
+      m_blockCount( 0 ),
+      m_count( 0 )
+{
+}
+
+
+void GitHubSample::UsageRegistry::Reserve( const size_t expectedElements )
+{
+    const size_t elementCount = ( expectedElements < kNoIndex ) ? expectedElements : static_cast<size_t>( kNoIndex );
+
+    m_slots.reserve( elementCount );
+    m_usagePages.reserve( elementCount );
+    m_usages.reserve( elementCount );
+    m_reportIds.reserve( elementCount );
+    m_cookies.reserve( elementCount );
+    m_nextSameUsage.reserve( elementCount );
+    m_values.reserve( elementCount );
+    m_ranges.reserve( elementCount );
+
+    // cookies number the elements, so the largest is about the element count
+    m_indexByCookie.reserve( elementCount + 1 );
+
+    // as many blocks as the hash table holds before it grows, and never more than there are elements
+    const size_t blocks = ( elementCount < m_blockKeys.size() / 2 ) ? elementCount : m_blockKeys.size() / 2;
+    m_sparse.reserve( blocks * kBlockSize );
+}
+
+
+uint32_t GitHubSample::UsageRegistry::AllocateSparseSlot( const uint16_t usagePage, const uint16_t usage )
+{
+    const uint32_t existing = SparseSlot( usagePage, usage );
+    if ( existing != kNoSlot )
+    {
+        return existing; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    if ( m_blockCount >= kNoIndex )
+    {
+        return kNoSlot; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    // keep the table at most half full, so that a probe hardly ever goes past the first place
+    if ( ( m_blockCount + 1 ) * 2 > m_blockKeys.size() )
+    {
+        std::vector< uint32_t > oldKeys( m_blockKeys.size() * 2, kNoBlock );
+        std::vector< uint16_t > oldNumbers( m_blockNumbers.size() * 2, 0 );
+        oldKeys.swap( m_blockKeys );
+        oldNumbers.swap( m_blockNumbers );
+
+        for ( size_t i = 0; i < oldKeys.size(); i++ )
+        {
+            if ( oldKeys[ i ] != kNoBlock )
+            {
+                const size_t place = FindBlock( oldKeys[ i ] );
+                m_blockKeys[ place ] = oldKeys[ i ];
+                m_blockNumbers[ place ] = oldNumbers[ i ];
+            }
+        }
+    }
+
+    const size_t place = FindBlock( BlockKey( usagePage, usage ) );
+    m_blockKeys[ place ] = BlockKey( usagePage, usage );
+    m_blockNumbers[ place ] = static_cast<uint16_t>( m_blockCount++ );
+
+    // the contents do not matter: an entry only counts when the dense side points back at it
+    m_sparse.resize( m_blockCount * kBlockSize, 0 );
+
+    return SparseSlot( usagePage, usage );
+}
+
+
+unsigned int GitHubSample::UsageRegistry::Add
+(
+ const uint16_t usagePage,
+ const uint16_t usage,
+ const uint32_t cookie,
+ const uint8_t reportId
+)
+{
+    if ( cookie > MAX_COOKIE )
+    {
+        return kNoIndex; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    // a full registry still knows the elements it has
+    const unsigned int existing = IndexOf( usagePage, usage, reportId );
+    if ( existing != kNoIndex )
+    {
+        return existing; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    if ( m_count + 1 >= kNoIndex )
+    {
+        return kNoIndex; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    const uint32_t slot = AllocateSparseSlot( usagePage, usage );
+    if ( slot == kNoSlot )
+    {
+        return kNoIndex; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+    }
+
+    // the first element of a usage is found through the sparse array, the ones in other reports through the chain
+    unsigned int previous = IndexOf( usagePage, usage );
+    while ( previous != kNoIndex && m_nextSameUsage[ previous ] != kNoIndex )
+    {
+        previous = m_nextSameUsage[ previous ];
+    }
+
+    const unsigned int index = static_cast<unsigned int>( m_count++ );
+
+    // after a Clear the dense arrays are still there, so only grow them when they are full
+    if ( index == m_slots.size() )
+    {
+        m_slots.push_back( 0 );
+        m_usagePages.push_back( 0 );
+        m_usages.push_back( 0 );
+        m_reportIds.push_back( 0 );
+        m_cookies.push_back( 0 );
+        m_nextSameUsage.push_back( 0 );
+        m_values.push_back( 0 );
+        m_ranges.push_back( Range() );
+    }
+
+    if ( previous == kNoIndex )
+    {
+        m_sparse[ slot ] = static_cast<uint16_t>( index );
+    }
+    else
+    {
+        m_nextSameUsage[ previous ] = static_cast<uint16_t>( index );
+    }
+
+    m_slots[ index ] = slot;
+    m_usagePages[ index ] = usagePage;
+    m_usages[ index ] = usage;
+    m_reportIds[ index ] = reportId;
+    m_cookies[ index ] = cookie;
+    m_nextSameUsage[ index ] = static_cast<uint16_t>( kNoIndex );
+    m_values[ index ] = 0;
+    memset( &m_ranges[ index ], 0, sizeof(Range) );
+
+    if ( cookie >= m_indexByCookie.size() )
+    {
+        m_indexByCookie.resize( cookie + 1, static_cast<uint16_t>( kNoIndex ) );
+    }
+    m_indexByCookie[ cookie ] = static_cast<uint16_t>( index );
+
+    return index;
+}
+
+
+unsigned int GitHubSample::UsageRegistry::IndexOf( const uint16_t usagePage, const uint16_t usage, const uint8_t reportId ) const
+{
+    unsigned int index = IndexOf( usagePage, usage );
+    while ( index != kNoIndex && m_reportIds[ index ] != reportId )
+    {
+        index = m_nextSameUsage[ index ];
+    }
+    return index;
+}
+
+
+size_t GitHubSample::UsageRegistry::TableBytes() const
+{
+    return CapacityBytes( m_blockKeys ) + CapacityBytes( m_blockNumbers ) + CapacityBytes( m_sparse )
+        + CapacityBytes( m_slots ) + CapacityBytes( m_usagePages ) + CapacityBytes( m_usages )
+        + CapacityBytes( m_reportIds ) + CapacityBytes( m_cookies ) + CapacityBytes( m_nextSameUsage )
+        + CapacityBytes( m_values ) + CapacityBytes( m_ranges ) + CapacityBytes( m_indexByCookie );
+}
+
+
+void GitHubSample::UsageRegistry::LockBuffers( RealtimeThreadConfig& realtime )
+{
+    realtime.LockVector( m_blockKeys );
+    realtime.LockVector( m_blockNumbers );
+    realtime.LockVector( m_sparse );
+    realtime.LockVector( m_slots );
+    realtime.LockVector( m_usagePages );
+    realtime.LockVector( m_usages );
+    realtime.LockVector( m_reportIds );
+    realtime.LockVector( m_cookies );
+    realtime.LockVector( m_nextSameUsage );
+    realtime.LockVector( m_values );
+    realtime.LockVector( m_ranges );
+    realtime.LockVector( m_indexByCookie );
+}
+
+
+GitHubSample::MemoryUsageReport GitHubSample::UsageRegistry::MemoryUsage() const
+{
+    MemoryUsageReport report;
+    report.AddHeap( MemoryUsageReport::kObject, sizeof(*this) );
+    report.AddHeap( MemoryUsageReport::kKeyTables, TableBytes() );
+    return report;
+}
@@ -0,0 +1,220 @@
+
+#ifndef GITHUBSAMPLE_USAGE_REGISTRY_H
+#define GITHUBSAMPLE_USAGE_REGISTRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "KeyEvent.h"
+#include "MemoryUsage.h"
+
+
+namespace GitHubSample
+{
+
+    class RealtimeThreadConfig;
+
+    /**
+       The input elements of one device that we listen to: any usage page,
+       any usage, any report id.  Keys, media keys, system controls, the
+       buttons and axes of pointers and pads, and whatever a custom control
+       panel with thousands of knobs and switches chooses to report.
+
+       It is a sparse set.  Every (page, usage) has a slot in a 'sparse'
+       array that holds an index into the DENSE arrays (page, usage, report
+       id, cookie, value, ...), and an entry only counts when the dense side
+       points back at it.  So lookups are O(1), Clear is O(1), and walking
+       all the elements only touches the dense arrays, which stay
+       contiguous however many elements there are.
+
+       The sparse array cannot cover all 2^32 (page, usage) pairs, so it
+       is split into blocks of kBlockSize usages, allocated the first time
+       one of their usages is added.  A small hash table maps (page,
+       usage / kBlockSize) to the block.  A keyboard takes about ten
+       blocks; a panel whose buttons are numbered 1 .. 3000 takes 47.
+
+       The same usage can appear in several reports (one element per report
+       id).  IndexOf( page, usage ) finds the first of them, and
+       NextWithSameUsage walks on to the others.
+
+       A second table maps a cookie straight to its dense index, which is
+       how Decode turns a queue event into a KeyEvent: one read, whatever its page.
+
+       Not thread-safe.  Filled once, when the device is opened.
+     */
+    class UsageRegistry
+    {
+    public:
+
+        enum
+        {
+            kNoIndex = 0xFFFF
+        };
+
+        /// kIOHIDElementMinKey / MaxKey (logical) and ScaledMinKey / ScaledMaxKey (physical).  all zero when not known.
+        struct Range
+        {
+            int32_t logicalMin;
+            int32_t logicalMax;
+            int32_t physicalMin;
+            int32_t physicalMax;
+        };
+
+        UsageRegistry();
+
+        /**
+           Sizes every table for 'expectedElements' elements (and cookies up to
+           about that), so that filling the registry allocates each of them
+           once instead of growing it a doubling at a time.  Call it before
+           the first Add, e.g. with the number of elements the device
+           reports.  More elements than that still fit; they just grow the
+           tables again.
+         */
+        void Reserve( size_t expectedElements );
+
+        /// Returns the element's dense index (the existing one when the same
+        /// page, usage and report id was added before), or kNoIndex when the
+        /// registry is full (kNoIndex - 1 elements) or the cookie is out of range.
+        unsigned int Add( uint16_t usagePage, uint16_t usage, uint32_t cookie, uint8_t reportId = 0 );
+
+        void Clear() { m_count = 0; m_indexByCookie.clear(); }
+
+        size_t Count() const { return m_count; }
+
+        /// the first element added with this page and usage, whatever its report.  kNoIndex when there is none.
+        unsigned int IndexOf( uint16_t usagePage, uint16_t usage ) const
+        {
+            const uint32_t slot = SparseSlot( usagePage, usage );
+            if ( slot == kNoSlot )
+            {
+                return kNoIndex;
+            }
+
+            const unsigned int index = m_sparse[ slot ];
+            return ( index < m_count && m_slots[ index ] == slot ) ? index : static_cast<unsigned int>( kNoIndex );
+        }
+
+        /// kNoIndex when the device has no such element in that report
+        unsigned int IndexOf( uint16_t usagePage, uint16_t usage, uint8_t reportId ) const;
+
+        /// the next element with the same page and usage (in another report).  kNoIndex after the last one.
+        unsigned int NextWithSameUsage( unsigned int index ) const { return m_nextSameUsage[ index ]; }
+
+        /// kNoIndex for a cookie that was never added
+        unsigned int IndexOfCookie( uint32_t cookie ) const
+        {
+            return ( cookie < m_indexByCookie.size() ) ? m_indexByCookie[ cookie ] : static_cast<unsigned int>( kNoIndex );
+        }
+
+        /// A queue event: writes the page and usage of the element with 'cookie', and 'value',
+        /// into 'event' (the rest of it is left alone), and keeps 'value' as the element's
+        /// Value.  Returns false, and changes nothing, for a cookie that was never added.
+        bool Decode( uint32_t cookie, int32_t value, KeyEvent& event )
+        {
+            const unsigned int index = IndexOfCookie( cookie );
+            if ( index == kNoIndex )
+            {
+                return false;
+            }
+
+            m_values[ index ] = value;
+            event.usagePage = m_usagePages[ index ];
+            event.usage = m_usages[ index ];
+            event.value = value;
+            return true;
+        }
+
+        uint16_t UsagePage( unsigned int index ) const { return m_usagePages[ index ]; }
+        uint16_t Usage( unsigned int index ) const { return m_usages[ index ]; }
+        uint8_t ReportId( unsigned int index ) const { return m_reportIds[ index ]; }
+        uint32_t Cookie( unsigned int index ) const { return m_cookies[ index ]; }
+
+        /// the last value the reader saw for the element (zero until then)
+        int32_t Value( unsigned int index ) const { return m_values[ index ]; }
+        void SetValue( unsigned int index, int32_t value ) { m_values[ index ] = value; }
+
+        /// Value( i ) for every element, Count() of them, e.g. to copy a whole panel's state at once
+        const int32_t* Values() const { return m_values.empty() ? 0 : &m_values[ 0 ]; }
+
+        /// for analog elements (e.g. the axes of a gamepad), see AxisPipeline
+        const Range& ElementRange( unsigned int index ) const { return m_ranges[ index ]; }
+        void SetElementRange( unsigned int index, const Range& range ) { m_ranges[ index ] = range; }
+
+        /// the heap the arrays take (what MemoryUsage reports as kKeyTables), for objects that embed a registry
+        size_t TableBytes() const;
+
+        /// Hands every table to 'realtime' to be prefaulted and mlocked.  Adding may
+        /// reallocate them, so fill the registry first.  This object must outlive 'realtime'.
+        void LockBuffers( RealtimeThreadConfig& realtime );
+
+        MemoryUsageReport MemoryUsage() const;
+
+    private:
+
+        enum
+        {
+            kBlockBits = 6,
+            kBlockSize = 1 << kBlockBits
+        };
+
+        static const uint32_t kNoSlot = 0xFFFFFFFF;
+        static const uint32_t kNoBlock = 0xFFFFFFFF;
+
+        /// which block of kBlockSize usages (page, usage) falls in.  never kNoBlock.
+        static uint32_t BlockKey( uint16_t usagePage, uint16_t usage )
+        {
+            return ( static_cast<uint32_t>( usagePage ) << ( 16 - kBlockBits ) ) | ( usage >> kBlockBits );
+        }
+
+        /// where in m_blockKeys 'blockKey' is, or the empty place where it would go
+        size_t FindBlock( uint32_t blockKey ) const
+        {
+            const size_t mask = m_blockKeys.size() - 1;
+            uint32_t hash = blockKey * 2654435761u;
+            hash ^= hash >> 16; // the page is in the high bits of the key
+            size_t place = hash & mask;
+            while ( m_blockKeys[ place ] != kNoBlock && m_blockKeys[ place ] != blockKey )
+            {
+                place = ( place + 1 ) & mask;
+            }
+            return place;
+        }
+
+        /// where (page, usage) lives in m_sparse.  kNoSlot when its block was never allocated.
+        uint32_t SparseSlot( uint16_t usagePage, uint16_t usage ) const
+        {
+            const size_t place = FindBlock( BlockKey( usagePage, usage ) );
+            if ( m_blockKeys[ place ] == kNoBlock )
+            {
+                return kNoSlot;
+            }
+            return ( static_cast<uint32_t>( m_blockNumbers[ place ] ) << kBlockBits ) | ( usage & ( kBlockSize - 1 ) );
+        }
+
+        /// the same, allocating the block when needed
+        uint32_t AllocateSparseSlot( uint16_t usagePage, uint16_t usage );
+
+        /// open addressing, a power of two in size, never more than half full
+        std::vector< uint32_t > m_blockKeys;
+        std::vector< uint16_t > m_blockNumbers;
+        size_t m_blockCount;
+        /// kBlockSize entries per block, in the order the blocks were allocated
+        std::vector< uint16_t > m_sparse;
+
+        size_t m_count;
+        std::vector< uint32_t > m_slots;
+        std::vector< uint16_t > m_usagePages;
+        std::vector< uint16_t > m_usages;
+        std::vector< uint8_t > m_reportIds;
+        std::vector< uint32_t > m_cookies;
+        std::vector< uint16_t > m_nextSameUsage;
+        std::vector< int32_t > m_values;
+        std::vector< Range > m_ranges;
+
+        std::vector< uint16_t > m_indexByCookie;
+    };
+
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_USAGE_REGISTRY_H
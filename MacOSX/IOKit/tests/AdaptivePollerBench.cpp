@@ -0,0 +1,251 @@
+
+
+#include "TestCheck.h"
+
+#include "AdaptivePoller.h"
+
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+
+
+namespace
+{
+    const uint16_t FIRST_LETTER = 0x04;
+    const unsigned int LETTER_COUNT = 26;
+
+    /// the shortest keystroke MakeTyping makes
+    const uint64_t SHORTEST_KEYSTROKE = 40000000;
+
+    /// virtual time the typing is spread over
+    const uint64_t SESSION_NANOSECONDS = 30ULL * 60 * 1000000000;
+
+    uint32_t g_seed = 5;
+
+    unsigned int Random( const unsigned int range )
+    {
+        g_seed = g_seed * 1103515245u + 12345u;
+        return ( g_seed >> 16 ) % range;
+    }
+
+    uint32_t g_offsetSeed = 17;
+
+    /// 0 .. 999,999 ns, so that no edge lands on the millisecond grid the fixed pollers tick on.
+    /// its own generator: the offsets move the edges, not the rhythm of the typing
+    uint64_t SubMillisecond()
+    {
+        g_offsetSeed = g_offsetSeed * 1103515245u + 12345u;
+        return ( g_offsetSeed >> 8 ) % 1000000;
+    }
+
+
+    struct Keystroke
+    {
+        uint64_t down;
+        uint64_t up;
+        uint16_t usage;
+    };
+
+
+    /**
+       Bursts of typing (80..250 ms between keys, each held 40..120 ms), with
+       pauses of five seconds to two minutes between them.  The same key never
+       comes twice in a row, so no key is pressed while it is still down.
+       Every press and release is somewhere INSIDE a millisecond: on the
+       grid, a 1 kHz poller would see each edge the instant it happens.
+     */
+    std::vector< Keystroke > MakeTyping()
+    {
+        std::vector< Keystroke > typing;
+        uint64_t time = 1000000000;
+        uint16_t previous = 0;
+
+        while ( time < SESSION_NANOSECONDS )
+        {
+            const unsigned int burst = 20 + Random( 180 );
+            for ( unsigned int i = 0; i < burst; i++ )
+            {
+                Keystroke keystroke;
+                keystroke.down = time + SubMillisecond();
+                keystroke.up = keystroke.down + SHORTEST_KEYSTROKE + Random( 81 ) * 1000000ULL + SubMillisecond();
+                do
+                {
+                    keystroke.usage = static_cast<uint16_t>( FIRST_LETTER + Random( LETTER_COUNT ) );
+                }
+                while ( keystroke.usage == previous );
+                previous = keystroke.usage;
+
+                typing.push_back( keystroke );
+                time += ( 80 + Random( 171 ) ) * 1000000ULL;
+            }
+            time += ( 5 + Random( 116 ) ) * 1000000000ULL;
+        }
+
+        return typing;
+    }
+
+
+    /// the keyboard as SnapshotPressedKeys sees it, at the time of the virtual clock
+    class SimulatedKeyboard
+    {
+    public:
+
+        SimulatedKeyboard( const std::vector< Keystroke >& typing, const GitHubSample::EventClock& clock )
+            : m_typing( typing ),
+              m_clock( clock ),
+              m_firstNotUp( 0 )
+        {
+        }
+
+        bool Snapshot( GitHubSample::KeyStateBitmap& pressed )
+        {
+            const uint64_t now = m_clock.NowNanoseconds();
+            memset( pressed.words, 0, sizeof(pressed.words) );
+
+            while ( m_firstNotUp < m_typing.size() && m_typing[ m_firstNotUp ].up <= now )
+            {
+                m_firstNotUp++;
+            }
+            for ( size_t i = m_firstNotUp; i < m_typing.size() && m_typing[i].down <= now; i++ )
+            {
+                if ( now < m_typing[i].up )
+                {
+                    pressed.words[ m_typing[i].usage >> 5 ] |= 1u << ( m_typing[i].usage & 31 );
+                }
+            }
+            return true;
+        }
+
+    private:
+
+        const std::vector< Keystroke >& m_typing;
+        const GitHubSample::EventClock& m_clock;
+        size_t m_firstNotUp;
+    };
+
+
+    struct Result
+    {
+        double pollsPerSecond;
+        double nanosecondsPerPoll;
+        double meanLatencyMilliseconds;
+        double worstLatencyMilliseconds;
+        size_t missedPresses;
+    };
+
+
+    Result Run( const std::vector< Keystroke >& typing, const uint64_t minimumInterval, const uint64_t maximumInterval )
+    {
+        GitHubSample::VirtualClock clock;
+        SimulatedKeyboard keyboard( typing, clock );
+        GitHubSample::AdaptivePoller poller( boost::bind( &SimulatedKeyboard::Snapshot, &keyboard, _1 ),
+                                             minimumInterval, maximumInterval, 250000000, clock );
+
+        // per letter, the next keystroke of it whose press is still to be seen.  a keystroke that falls between two polls is never seen at all.
+        std::vector< size_t > nextOfUsage( LETTER_COUNT, 0 );
+        std::vector< std::vector< size_t > > keystrokesOfUsage( LETTER_COUNT );
+        for ( size_t i = 0; i < typing.size(); i++ )
+        {
+            keystrokesOfUsage[ typing[i].usage - FIRST_LETTER ].push_back( i );
+        }
+
+        double latencySum = 0.0;
+        uint64_t worstLatency = 0;
+        size_t presses = 0;
+        GitHubSample::KeyEvent events[ 64 ];
+
+        const uint64_t start = GitHubSample::Test::Nanoseconds();
+        while ( clock.NowNanoseconds() < SESSION_NANOSECONDS )
+        {
+            const size_t count = poller.WaitAndPoll( events, 64 );
+            for ( size_t i = 0; i < count; i++ )
+            {
+                if ( events[i].value == 0 )
+                {
+                    continue;
+                }
+
+                const unsigned int letter = events[i].usage - FIRST_LETTER;
+                const std::vector< size_t >& keystrokes = keystrokesOfUsage[ letter ];
+                size_t& next = nextOfUsage[ letter ];
+                while ( next + 1 < keystrokes.size() && typing[ keystrokes[ next + 1 ] ].down <= events[i].timestamp )
+                {
+                    next++;
+                }
+                const Keystroke& keystroke = typing[ keystrokes[ next++ ] ];
+                const uint64_t latency = events[i].timestamp - keystroke.down;
+                latencySum += static_cast<double>( latency );
+                worstLatency = std::max( worstLatency, latency );
+                presses++;
+            }
+        }
+        const uint64_t nanoseconds = GitHubSample::Test::Nanoseconds() - start;
+
+        Result result;
+        result.pollsPerSecond = static_cast<double>( poller.PollCount() ) * 1e9 / SESSION_NANOSECONDS;
+        result.nanosecondsPerPoll = static_cast<double>( nanoseconds ) / poller.PollCount();
+        result.meanLatencyMilliseconds = ( presses > 0 ) ? latencySum / presses / 1e6 : 0.0;
+        result.worstLatencyMilliseconds = static_cast<double>( worstLatency ) / 1e6;
+        result.missedPresses = typing.size() - presses;
+        return result;
+    }
+}
+
+
+
+int main()
+{
+    const std::vector< Keystroke > typing = MakeTyping();
+
+    struct Configuration
+    {
+        const char* name;
+        uint64_t minimumInterval;
+        uint64_t maximumInterval;
+    };
+
+    const Configuration configurations[] =
+    {
+        { "fixed 1 kHz",             1000000,  1000000 },
+        { "fixed 125 Hz",            8000000,  8000000 },
+        { "adaptive 1 .. 16 ms",     1000000, 16000000 },
+        { "adaptive 1 .. 32 ms",     1000000, 32000000 },
+        { "adaptive 1 .. 64 ms",     1000000, 64000000 }
+    };
+    const size_t configurationCount = sizeof(configurations) / sizeof(configurations[0]);
+
+    printf( "%lu keystrokes in %lu minutes of virtual time\n",
+            static_cast<unsigned long>( typing.size() ), static_cast<unsigned long>( SESSION_NANOSECONDS / 60000000000ULL ) );
+    printf( "%-22s %10s %12s %14s %15s %7s\n", "", "polls/s", "ns per poll", "mean latency", "worst latency", "missed" );
+
+    double fixedPollsPerSecond = 0.0;
+    for ( size_t c = 0; c < configurationCount; c++ )
+    {
+        const Configuration& configuration = configurations[c];
+        const Result result = Run( typing, configuration.minimumInterval, configuration.maximumInterval );
+
+        printf( "%-22s %10.1f %12.1f %11.2f ms %12.2f ms %7lu\n", configuration.name, result.pollsPerSecond, result.nanosecondsPerPoll,
+                result.meanLatencyMilliseconds, result.worstLatencyMilliseconds, static_cast<unsigned long>( result.missedPresses ) );
+
+        // no press waits longer than the longest interval.  and none is lost while that is shorter than a keystroke
+        CHECK( result.worstLatencyMilliseconds <= configuration.maximumInterval / 1e6 );
+        if ( configuration.maximumInterval < SHORTEST_KEYSTROKE )
+        {
+            CHECK( result.missedPresses == 0 );
+        }
+
+        if ( c == 0 )
+        {
+            fixedPollsPerSecond = result.pollsPerSecond;
+        }
+        else if ( configuration.minimumInterval != configuration.maximumInterval )
+        {
+            // the point of backing off: most of the session is idle
+            CHECK( result.pollsPerSecond < fixedPollsPerSecond / 4 );
+        }
+    }
+
+    return GitHubSample::Test::Finish( "AdaptivePollerBench" );
+}
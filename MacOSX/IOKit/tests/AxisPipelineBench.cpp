@@ -0,0 +1,250 @@
+
+
+#include "TestCheck.h"
+
+#include "AxisPipeline.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+
+
+namespace
+{
+    const uint16_t USAGE_PAGE_GENERIC_DESKTOP = 0x01;
+    const uint16_t USAGE_PAGE_BUTTON = 0x09;
+    const uint16_t USAGE_GD_X = 0x30;
+
+    const size_t AXES = GitHubSample::AxisPipeline::kAxesPerPad;
+
+    /// the same number of axis updates at every pad count, so the times compare
+    const size_t TOTAL_AXIS_UPDATES = 1 << 24;
+    const size_t MOST_PADS = 1024;
+    /// ticks cycle through this many batches of events, made up front
+    const size_t BATCHES = 4;
+
+    /// float against double: a few units in the last place, stretched by the deadzone and the cube
+    const double VALUE_TOLERANCE = 1e-5;
+
+    uint32_t g_seed = 7;
+
+    unsigned int Random( const unsigned int range )
+    {
+        g_seed = g_seed * 1103515245u + 12345u;
+        return ( g_seed >> 16 ) % range;
+    }
+
+
+    /**
+       A mix of what real pads report: a stick of 0 .. 255 that knows its
+       angle in degrees, a 16-bit signed axis, a 10-bit trigger, and now and
+       then an axis the pad does not have (never configured, reads zero).
+       Returns false for that last one.
+     */
+    bool MakeSettings( GitHubSample::AxisPipeline::AxisSettings& settings )
+    {
+        memset( &settings, 0, sizeof(settings) );
+        switch ( Random( 4 ) )
+        {
+        case 0:
+            settings.logicalMin = 0;
+            settings.logicalMax = 255;
+            settings.physicalMin = -45.0f;
+            settings.physicalMax = 45.0f;
+            break;
+        case 1:
+            settings.logicalMin = -32768;
+            settings.logicalMax = 32767;
+            break;
+        case 2:
+            settings.logicalMin = 0;
+            settings.logicalMax = 1023;
+            break;
+        default:
+            return false;
+        }
+        settings.deadzone = Random( 31 ) / 100.0f;
+        settings.curve = Random( 11 ) / 10.0f;
+        return true;
+    }
+
+
+    /// a raw value up to a tenth beyond either end, as worn or uncalibrated pads send
+    int32_t MakeRaw( const GitHubSample::AxisPipeline::AxisSettings& settings )
+    {
+        const int32_t range = settings.logicalMax - settings.logicalMin;
+        const int32_t spread = range + range / 5;
+        const int32_t offset = static_cast<int32_t>( Random( 65536 ) * static_cast<double>( spread ) / 65536.0 );
+        return settings.logicalMin - range / 10 + offset;
+    }
+
+
+    /// AxisPipeline's three steps, worked out in double from the settings
+    void Reference( const GitHubSample::AxisPipeline::AxisSettings& settings, const int32_t raw, double& value, double& physical )
+    {
+        const double center = 0.5 * ( static_cast<double>( settings.logicalMin ) + settings.logicalMax );
+        const double halfRange = 0.5 * ( static_cast<double>( settings.logicalMax ) - settings.logicalMin );
+
+        double scaled = ( raw - center ) / halfRange;
+        scaled = ( scaled > 1.0 ) ? 1.0 : ( ( scaled < -1.0 ) ? -1.0 : scaled );
+
+        physical = ( settings.physicalMin != settings.physicalMax )
+            ? 0.5 * ( settings.physicalMin + settings.physicalMax ) + scaled * 0.5 * ( settings.physicalMax - settings.physicalMin )
+            : center + scaled * halfRange;
+
+        const double magnitude = fabs( scaled );
+        const double live = ( magnitude > settings.deadzone ) ? ( magnitude - settings.deadzone ) / ( 1.0 - settings.deadzone ) : 0.0;
+        const double curved = ( 1.0 - settings.curve ) * live + settings.curve * live * live * live;
+
+        value = ( scaled < 0.0 ) ? -curved : curved;
+    }
+
+
+    struct Pads
+    {
+        std::vector< GitHubSample::AxisPipeline::AxisSettings > settings;
+        std::vector< bool > configured;
+        /// BATCHES ticks of events, each tick one event per axis and a button per pad
+        std::vector< GitHubSample::KeyEvent > events;
+        size_t eventsPerTick;
+    };
+
+
+    void MakePads( const size_t padCount, GitHubSample::AxisPipeline& pipeline, Pads& pads )
+    {
+        pads.settings.resize( padCount * AXES );
+        pads.configured.resize( padCount * AXES );
+        for ( size_t slot = 0; slot < padCount * AXES; slot++ )
+        {
+            pads.configured[ slot ] = MakeSettings( pads.settings[ slot ] );
+            if ( pads.configured[ slot ] )
+            {
+                pipeline.ConfigureAxis( slot / AXES, static_cast<unsigned int>( slot % AXES ), pads.settings[ slot ] );
+            }
+        }
+
+        pads.eventsPerTick = padCount * ( AXES + 1 );
+        pads.events.resize( BATCHES * pads.eventsPerTick );
+        memset( &pads.events[0], 0, pads.events.size() * sizeof(pads.events[0]) );
+
+        for ( size_t i = 0; i < pads.events.size(); i++ )
+        {
+            GitHubSample::KeyEvent& event = pads.events[i];
+            const size_t pad = ( i % pads.eventsPerTick ) / ( AXES + 1 );
+            const size_t axis = ( i % pads.eventsPerTick ) % ( AXES + 1 );
+
+            event.deviceIndex = static_cast<uint16_t>( pad );
+            if ( axis < AXES )
+            {
+                event.usagePage = USAGE_PAGE_GENERIC_DESKTOP;
+                event.usage = static_cast<uint16_t>( USAGE_GD_X + axis );
+                event.value = pads.configured[ pad * AXES + axis ] ? MakeRaw( pads.settings[ pad * AXES + axis ] ) : static_cast<int32_t>( Random( 256 ) );
+            }
+            else
+            {
+                event.usagePage = USAGE_PAGE_BUTTON;
+                event.usage = static_cast<uint16_t>( 1 + Random( 32 ) );
+                event.value = static_cast<int32_t>( Random( 2 ) );
+            }
+        }
+    }
+
+
+    /// Every value of the last Update against the double reference.  Returns the largest error.
+    double CheckValues( const GitHubSample::AxisPipeline& pipeline, const Pads& pads, const size_t lastBatch )
+    {
+        double largestError = 0.0;
+        const GitHubSample::KeyEvent* events = &pads.events[ lastBatch * pads.eventsPerTick ];
+
+        for ( size_t pad = 0; pad < pipeline.PadCount(); pad++ )
+        {
+            for ( unsigned int axis = 0; axis < AXES; axis++ )
+            {
+                const size_t slot = pad * AXES + axis;
+                if ( ! pads.configured[ slot ] )
+                {
+                    CHECK( pipeline.Value( pad, axis ) == 0.0f );
+                    CHECK( pipeline.PhysicalValue( pad, axis ) == 0.0f );
+                    continue;
+                }
+
+                const GitHubSample::AxisPipeline::AxisSettings& settings = pads.settings[ slot ];
+                double value = 0.0;
+                double physical = 0.0;
+                Reference( settings, events[ pad * ( AXES + 1 ) + axis ].value, value, physical );
+
+                const double error = fabs( pipeline.Value( pad, axis ) - value );
+                largestError = ( error > largestError ) ? error : largestError;
+                CHECK( error <= VALUE_TOLERANCE );
+
+                // the physical value is a sum of large terms: its error is relative to the range, not to the value
+                const double physicalScale = ( settings.physicalMin != settings.physicalMax )
+                    ? fabs( settings.physicalMin ) + fabs( settings.physicalMax )
+                    : fabs( static_cast<double>( settings.logicalMin ) ) + fabs( static_cast<double>( settings.logicalMax ) );
+                CHECK( fabs( pipeline.PhysicalValue( pad, axis ) - physical ) <= VALUE_TOLERANCE * physicalScale );
+            }
+        }
+
+        return largestError;
+    }
+}
+
+
+
+int main()
+{
+#ifdef __SSE2__
+    printf( "Update with SSE2, four axes at a time\n\n" );
+#else
+    printf( "Update with the scalar loop\n\n" );
+#endif
+
+    printf( "   pads     ticks   ns/event (Offer)   ns/axis (Update)   us/tick   bytes per pad   largest error\n" );
+
+    double fewestPadsNanoseconds = 0.0;
+    double mostPadsNanoseconds = 0.0;
+
+    for ( size_t padCount = 1; padCount <= MOST_PADS; padCount *= 4 )
+    {
+        GitHubSample::AxisPipeline pipeline( padCount );
+        Pads pads;
+        MakePads( padCount, pipeline, pads );
+
+        const size_t ticks = TOTAL_AXIS_UPDATES / ( padCount * AXES );
+        uint64_t offerNanoseconds = 0;
+        uint64_t updateNanoseconds = 0;
+        size_t lastBatch = 0;
+
+        for ( size_t tick = 0; tick < ticks; tick++ )
+        {
+            lastBatch = tick % BATCHES;
+
+            const uint64_t start = GitHubSample::Test::Nanoseconds();
+            pipeline.Offer( &pads.events[ lastBatch * pads.eventsPerTick ], pads.eventsPerTick );
+            const uint64_t offered = GitHubSample::Test::Nanoseconds();
+            pipeline.Update();
+            const uint64_t updated = GitHubSample::Test::Nanoseconds();
+
+            offerNanoseconds += offered - start;
+            updateNanoseconds += updated - offered;
+        }
+
+        const double largestError = CheckValues( pipeline, pads, lastBatch );
+        const double perAxis = static_cast<double>( updateNanoseconds ) / ( static_cast<double>( ticks ) * padCount * AXES );
+
+        printf( "%7lu   %7lu   %16.2f   %16.2f   %7.2f   %13lu   %13.1e\n", static_cast<unsigned long>( padCount ),
+                static_cast<unsigned long>( ticks ),
+                static_cast<double>( offerNanoseconds ) / ( static_cast<double>( ticks ) * pads.eventsPerTick ), perAxis,
+                ( offerNanoseconds + updateNanoseconds ) / 1000.0 / ticks,
+                static_cast<unsigned long>( pipeline.MemoryUsage().ReservedBytes() / padCount ), largestError );
+
+        fewestPadsNanoseconds = ( padCount == 1 ) ? perAxis : fewestPadsNanoseconds;
+        mostPadsNanoseconds = perAxis;
+    }
+
+    // no per-pad cost hiding in the loop.  the one pad pays for the timer; the thousand for the caches and, without SSE2, the branches
+    CHECK( mostPadsNanoseconds < 3.0 * fewestPadsNanoseconds + 1.0 );
+
+    return GitHubSample::Test::Finish( "AxisPipelineBench" );
+}
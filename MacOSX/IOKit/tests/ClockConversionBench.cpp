@@ -0,0 +1,127 @@
+
+
+#include "TestCheck.h"
+
+#include "HighResolutionClock.h"
+
+#include <string.h>
+#include <vector>
+
+
+
+namespace
+{
+    const size_t CONVERSIONS = 1 << 16;
+    const size_t ROUNDS = 64;
+
+    const uint64_t NANOSECONDS_PER_DAY = 86400ULL * 1000000000ULL;
+
+    volatile uint64_t g_sink = 0;
+
+
+    /// ticks spread over a year of uptime, so every bit of the high word is exercised
+    void MakeTicks( const GitHubSample::HighResolutionClock& clock, std::vector< uint64_t >& ticks )
+    {
+        const double ticksPerYear = 365.0 * NANOSECONDS_PER_DAY * clock.Denominator() / clock.Numerator();
+        const uint64_t step = static_cast<uint64_t>( ticksPerYear / ticks.size() );
+        for ( size_t i = 0; i < ticks.size(); i++ )
+        {
+            ticks[i] = i * step + ( i * 2654435761u ) % step;
+        }
+    }
+
+
+    /**
+       Times the three ways to convert (one at a time, an array, KeyEvents in
+       place), checks they agree, and checks the error against a double
+       computation of the exact ratio.
+     */
+    void Measure( const char* name, const GitHubSample::HighResolutionClock& clock )
+    {
+        std::vector< uint64_t > ticks( CONVERSIONS );
+        MakeTicks( clock, ticks );
+
+        std::vector< uint64_t > nanoseconds( CONVERSIONS );
+        std::vector< GitHubSample::KeyEvent > events( CONVERSIONS );
+        memset( &events[0], 0, events.size() * sizeof(events[0]) );
+
+        // one at a time
+        uint64_t sum = 0;
+        const uint64_t oneStart = clock.Now();
+        for ( size_t round = 0; round < ROUNDS; round++ )
+        {
+            for ( size_t i = 0; i < CONVERSIONS; i++ )
+            {
+                sum += clock.ToNanoseconds( ticks[i] );
+            }
+        }
+        const uint64_t oneTicks = clock.Now() - oneStart;
+        g_sink = sum;
+
+        const uint64_t arrayStart = clock.Now();
+        for ( size_t round = 0; round < ROUNDS; round++ )
+        {
+            clock.ToNanoseconds( &ticks[0], &nanoseconds[0], CONVERSIONS );
+        }
+        const uint64_t arrayTicks = clock.Now() - arrayStart;
+
+        uint64_t eventTicks = 0;
+        for ( size_t round = 0; round < ROUNDS; round++ )
+        {
+            for ( size_t i = 0; i < CONVERSIONS; i++ )
+            {
+                events[i].timestamp = ticks[i];
+            }
+            const uint64_t eventStart = clock.Now();
+            clock.TimestampsToNanoseconds( &events[0], CONVERSIONS );
+            eventTicks += clock.Now() - eventStart;
+        }
+
+        // the fixed point is only ever low, by less than one part in ( 2^32 * nanoseconds per tick ), plus the last nanosecond
+        const double nanosecondsPerTick = static_cast<double>( clock.Numerator() ) / clock.Denominator();
+        const double bound = 1.0 / ( 4294967296.0 * nanosecondsPerTick );
+        double largestError = 0.0;
+        bool agree = true;
+        uint64_t previous = 0;
+        for ( size_t i = 0; i < CONVERSIONS; i++ )
+        {
+            const double exact = static_cast<double>( ticks[i] ) * nanosecondsPerTick;
+            const double error = ( exact - static_cast<double>( nanoseconds[i] ) ) / ( exact + 1.0 );
+            largestError = ( error > largestError ) ? error : largestError;
+            CHECK( static_cast<double>( nanoseconds[i] ) <= exact + 1.0 );
+            CHECK( exact - static_cast<double>( nanoseconds[i] ) <= exact * bound * 1.001 + 2.0 );
+
+            agree = agree && nanoseconds[i] == clock.ToNanoseconds( ticks[i] ) && nanoseconds[i] == events[i].timestamp;
+            agree = agree && nanoseconds[i] >= previous;
+            previous = nanoseconds[i];
+        }
+        CHECK( agree );
+
+        const double count = static_cast<double>( CONVERSIONS ) * ROUNDS;
+        const double oneNanoseconds = static_cast<double>( clock.ToNanoseconds( oneTicks ) ) / count;
+        printf( "%-20s %9.3f   %8.2f ns (%5.2f ticks)   %8.2f ns   %8.2f ns   %9.2e   %9.2e   %8.1f us\n",
+                name, nanosecondsPerTick,
+                oneNanoseconds, oneTicks / count,
+                static_cast<double>( clock.ToNanoseconds( arrayTicks ) ) / count,
+                static_cast<double>( clock.ToNanoseconds( eventTicks ) ) / count,
+                largestError, bound, largestError * NANOSECONDS_PER_DAY / 1000.0 );
+
+        // "a few cycles": even one at a time, and with the loop around it, far below a cache miss
+        CHECK( oneNanoseconds < 20.0 );
+    }
+}
+
+
+
+int main()
+{
+    printf( "clock                ns/tick        one at a time          array        KeyEvents   largest err       bound   err a day\n" );
+
+    const GitHubSample::HighResolutionClock fastest;
+    const GitHubSample::HighResolutionClock& events = GitHubSample::HighResolutionClock::ForEventTimestamps();
+
+    Measure( GitHubSample::HighResolutionClock::SourceName( fastest.ClockSource() ), fastest );
+    Measure( GitHubSample::HighResolutionClock::SourceName( events.ClockSource() ), events );
+
+    return GitHubSample::Test::Finish( "ClockConversionBench" );
+}
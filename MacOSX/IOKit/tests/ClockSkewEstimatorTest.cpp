@@ -0,0 +1,167 @@
+
+
+#include "TestCheck.h"
+
+#include "ClockSkewEstimator.h"
+
+#include <math.h>
+
+
+
+namespace
+{
+    uint32_t g_seed = 11;
+
+    unsigned int Random( const unsigned int range )
+    {
+        g_seed = g_seed * 1103515245u + 12345u;
+        return ( g_seed >> 16 ) % range;
+    }
+
+
+    /**
+       A device clock that runs 'partsPerMillion' fast from its own origin,
+       and a transport that delivers each sample 100..600 us after it was
+       taken, and now and then 30 ms late (a descheduled reader).
+     */
+    class SimulatedDevice
+    {
+    public:
+
+        SimulatedDevice( const double partsPerMillion, const uint64_t deviceOrigin )
+            : m_rate( 1.0 + partsPerMillion * 1e-6 ),
+              m_deviceOrigin( deviceOrigin ),
+              m_hostStep( 0 )
+        {
+        }
+
+        /// the host clock is set (or the device counter restarts): arrivals move by 'nanoseconds' from now on
+        void StepHostClock( const int64_t nanoseconds ) { m_hostStep += nanoseconds; }
+
+        uint64_t DeviceTimestamp( const uint64_t hostTime ) const
+        {
+            return m_deviceOrigin + static_cast<uint64_t>( static_cast<double>( hostTime ) * m_rate );
+        }
+
+        /// where Correct should put 'hostTime': the host time it happened at, plus the mean delivery delay
+        uint64_t Expected( const uint64_t hostTime ) const { return hostTime + m_hostStep + MEAN_DELAY; }
+
+        void Sample( GitHubSample::ClockSkewEstimator& estimator, const uint64_t hostTime, const bool spikes ) const
+        {
+            uint64_t delay = 100000 + Random( 501 ) * 1000; // Random only goes to 65535
+            if ( spikes && Random( 50 ) == 0 )
+            {
+                delay += 30000000;
+            }
+            estimator.AddSample( DeviceTimestamp( hostTime ), hostTime + m_hostStep + delay );
+        }
+
+        static const uint64_t MEAN_DELAY = 350000;
+
+    private:
+
+        double m_rate;
+        uint64_t m_deviceOrigin;
+        int64_t m_hostStep;
+    };
+
+
+    double CorrectionError( const GitHubSample::ClockSkewEstimator& estimator, const SimulatedDevice& device, const uint64_t hostTime )
+    {
+        return static_cast<double>( static_cast<int64_t>( estimator.Correct( device.DeviceTimestamp( hostTime ) ) - device.Expected( hostTime ) ) );
+    }
+
+
+    void TestDriftAndJitter()
+    {
+        GitHubSample::ClockSkewEstimator estimator;
+        const SimulatedDevice device( 40.0, 3000000000ULL );
+
+        const uint64_t interval = 8000000;
+        const size_t sampleCount = 100000;
+        for ( size_t i = 0; i < sampleCount; i++ )
+        {
+            device.Sample( estimator, i * interval, true );
+        }
+
+        CHECK( fabs( estimator.SkewPartsPerMillion() - 40.0 ) < 2.0 );
+        CHECK( estimator.JitterNanoseconds() > 100000.0 && estimator.JitterNanoseconds() < 300000.0 );
+        // the 2 % spikes, and no more than a few of the ordinary samples
+        CHECK( estimator.RejectedCount() > sampleCount / 100 && estimator.RejectedCount() < sampleCount / 25 );
+        CHECK( estimator.ReseedCount() == 0 );
+
+        const uint64_t last = ( sampleCount - 1 ) * interval;
+        CHECK( fabs( CorrectionError( estimator, device, last ) ) < 100000.0 );
+        CHECK( fabs( CorrectionError( estimator, device, last - 1000 * interval ) ) < 100000.0 );
+    }
+
+
+    /// the case that rejected every sample after the step, and stayed 51 ms off
+    void TestStep()
+    {
+        GitHubSample::ClockSkewEstimator estimator;
+        SimulatedDevice device( -25.0, 0 );
+
+        const uint64_t interval = 8000000;
+        size_t i = 0;
+        for ( ; i < 2000; i++ )
+        {
+            device.Sample( estimator, i * interval, false );
+        }
+        CHECK( estimator.RejectedCount() < 20 );
+
+        device.StepHostClock( 50000000 );
+        const size_t rejectedBefore = estimator.RejectedCount();
+        for ( ; i < 3000; i++ )
+        {
+            device.Sample( estimator, i * interval, false );
+        }
+
+        CHECK( estimator.ReseedCount() == 1 );
+        CHECK( estimator.RejectedCount() - rejectedBefore < 20 );
+        CHECK( fabs( CorrectionError( estimator, device, ( i - 1 ) * interval ) ) < 200000.0 );
+        CHECK( fabs( estimator.SkewPartsPerMillion() + 25.0 ) < 20.0 );
+    }
+
+
+    /// days of uptime, from a device counter that is far from zero: the re-anchoring keeps the doubles precise
+    void TestLongUptime()
+    {
+        GitHubSample::ClockSkewEstimator estimator;
+        const SimulatedDevice device( 15.0, 0x3000000000000000ULL );
+
+        const uint64_t interval = 100000000;
+        const size_t sampleCount = 3 * 24 * 3600 * 10;
+        for ( size_t i = 0; i < sampleCount; i++ )
+        {
+            device.Sample( estimator, i * interval, false );
+        }
+
+        const uint64_t last = ( sampleCount - 1 ) * interval;
+        CHECK( fabs( estimator.SkewPartsPerMillion() - 15.0 ) < 1.0 );
+        CHECK( fabs( CorrectionError( estimator, device, last ) ) < 100000.0 );
+        CHECK( fabs( CorrectionError( estimator, device, last + 10 * interval ) ) < 100000.0 );
+        CHECK( estimator.ReseedCount() == 0 );
+    }
+
+
+    void TestBeforeAnySample()
+    {
+        GitHubSample::ClockSkewEstimator estimator;
+        CHECK( estimator.Correct( 12345 ) == 12345 );
+        CHECK( estimator.SampleCount() == 0 );
+        CHECK( estimator.SkewPartsPerMillion() == 0.0 );
+    }
+}
+
+
+
+int main()
+{
+    TestBeforeAnySample();
+    TestDriftAndJitter();
+    TestStep();
+    TestLongUptime();
+
+    return GitHubSample::Test::Finish( "ClockSkewEstimatorTest" );
+}
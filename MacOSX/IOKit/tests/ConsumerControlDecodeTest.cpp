@@ -0,0 +1,213 @@
+
+
+#include "TestCheck.h"
+
+#include "UsageRegistry.h"
+
+#include <string.h>
+
+
+
+namespace
+{
+    const uint16_t USAGE_PAGE_GENERIC_DESKTOP = 0x01;
+    const uint16_t USAGE_PAGE_KEYBOARD_OR_KEYPAD = 0x07;
+    const uint16_t USAGE_PAGE_CONSUMER = 0x0C;
+
+    const uint16_t USAGE_GD_SYSTEM_POWER_DOWN = 0x81;
+    const uint16_t USAGE_GD_SYSTEM_SLEEP = 0x82;
+    const uint16_t USAGE_GD_SYSTEM_WAKE_UP = 0x83;
+
+    const uint16_t USAGE_CSMR_DISPLAY_BRIGHTNESS_INCREMENT = 0x6F;
+    const uint16_t USAGE_CSMR_DISPLAY_BRIGHTNESS_DECREMENT = 0x70;
+    const uint16_t USAGE_CSMR_SCAN_NEXT_TRACK = 0xB5;
+    const uint16_t USAGE_CSMR_SCAN_PREVIOUS_TRACK = 0xB6;
+    const uint16_t USAGE_CSMR_PLAY_OR_PAUSE = 0xCD;
+    const uint16_t USAGE_CSMR_MUTE = 0xE2;
+    const uint16_t USAGE_CSMR_VOLUME_INCREMENT = 0xE9;
+    const uint16_t USAGE_CSMR_VOLUME_DECREMENT = 0xEA;
+    const uint16_t USAGE_CSMR_AC_PAN = 0x238;
+
+    const uint16_t USAGE_KEYBOARD_A = 0x04;
+
+    struct Element
+    {
+        uint16_t usagePage;
+        uint16_t usage;
+        uint32_t cookie;
+        uint8_t reportId;
+    };
+
+    /**
+       The media interface of a keyboard, as FindKeypressCookies registers
+       it: the consumer controls in report 1, the system controls in report
+       2, and Mute once more in report 3, as some keyboards send it from
+       two places.  Cookie 1 and the gaps are the collections, which are
+       never registered.  Last, one key of the keyboard page: an interface
+       that carries both must decode both.
+     */
+    const Element ELEMENTS[] =
+    {
+        { USAGE_PAGE_CONSUMER, USAGE_CSMR_PLAY_OR_PAUSE, 2, 1 },
+        { USAGE_PAGE_CONSUMER, USAGE_CSMR_SCAN_NEXT_TRACK, 3, 1 },
+        { USAGE_PAGE_CONSUMER, USAGE_CSMR_SCAN_PREVIOUS_TRACK, 4, 1 },
+        { USAGE_PAGE_CONSUMER, USAGE_CSMR_MUTE, 5, 1 },
+        { USAGE_PAGE_CONSUMER, USAGE_CSMR_VOLUME_INCREMENT, 6, 1 },
+        { USAGE_PAGE_CONSUMER, USAGE_CSMR_VOLUME_DECREMENT, 7, 1 },
+        { USAGE_PAGE_CONSUMER, USAGE_CSMR_DISPLAY_BRIGHTNESS_INCREMENT, 8, 1 },
+        { USAGE_PAGE_CONSUMER, USAGE_CSMR_DISPLAY_BRIGHTNESS_DECREMENT, 9, 1 },
+        { USAGE_PAGE_CONSUMER, USAGE_CSMR_AC_PAN, 10, 1 },
+        { USAGE_PAGE_GENERIC_DESKTOP, USAGE_GD_SYSTEM_POWER_DOWN, 12, 2 },
+        { USAGE_PAGE_GENERIC_DESKTOP, USAGE_GD_SYSTEM_SLEEP, 13, 2 },
+        { USAGE_PAGE_GENERIC_DESKTOP, USAGE_GD_SYSTEM_WAKE_UP, 14, 2 },
+        { USAGE_PAGE_CONSUMER, USAGE_CSMR_MUTE, 16, 3 },
+        { USAGE_PAGE_KEYBOARD_OR_KEYPAD, USAGE_KEYBOARD_A, 17, 4 }
+    };
+    const size_t ELEMENT_COUNT = sizeof(ELEMENTS) / sizeof(ELEMENTS[0]);
+
+    const uint32_t COLLECTION_COOKIE = 1;
+
+
+    /// what the reader fills in itself, so that Decode can be seen to leave it alone
+    GitHubSample::KeyEvent Sentinel()
+    {
+        GitHubSample::KeyEvent event;
+        memset( &event, 0, sizeof(event) );
+        event.timestamp = 0x123456789ULL;
+        event.deviceIndex = 7;
+        event.flags = 0x5A;
+        event.usagePage = 0xEEEE;
+        event.usage = 0xEEEE;
+        event.value = -12345;
+        return event;
+    }
+
+
+    bool SameEvent( const GitHubSample::KeyEvent& a, const GitHubSample::KeyEvent& b )
+    {
+        return a.timestamp == b.timestamp && a.deviceIndex == b.deviceIndex && a.flags == b.flags
+            && a.usagePage == b.usagePage && a.usage == b.usage && a.value == b.value;
+    }
+
+
+    void Register( GitHubSample::UsageRegistry& registry )
+    {
+        registry.Reserve( ELEMENT_COUNT );
+        for ( size_t i = 0; i < ELEMENT_COUNT; i++ )
+        {
+            CHECK( registry.Add( ELEMENTS[i].usagePage, ELEMENTS[i].usage, ELEMENTS[i].cookie, ELEMENTS[i].reportId ) == i );
+        }
+        CHECK( registry.Count() == ELEMENT_COUNT );
+    }
+
+
+    void TestEveryElementDecodes()
+    {
+        GitHubSample::UsageRegistry registry;
+        Register( registry );
+
+        for ( size_t i = 0; i < ELEMENT_COUNT; i++ )
+        {
+            // press, then release
+            for ( int32_t value = 1; value >= 0; value-- )
+            {
+                GitHubSample::KeyEvent event = Sentinel();
+                CHECK( registry.Decode( ELEMENTS[i].cookie, value, event ) );
+
+                CHECK( event.usagePage == ELEMENTS[i].usagePage );
+                CHECK( event.usage == ELEMENTS[i].usage );
+                CHECK( event.value == value );
+                CHECK( registry.Value( static_cast<unsigned int>( i ) ) == value );
+
+                const GitHubSample::KeyEvent sentinel = Sentinel();
+                CHECK( event.timestamp == sentinel.timestamp && event.deviceIndex == sentinel.deviceIndex && event.flags == sentinel.flags );
+            }
+        }
+    }
+
+
+    void TestUnknownCookies()
+    {
+        GitHubSample::UsageRegistry registry;
+        Register( registry );
+
+        const uint32_t unknown[] = { 0, COLLECTION_COOKIE, 11, 15, 18, 0xFFFF, 0x10000, 0xFFFFFFFF };
+        for ( size_t i = 0; i < sizeof(unknown) / sizeof(unknown[0]); i++ )
+        {
+            GitHubSample::KeyEvent event = Sentinel();
+            CHECK( ! registry.Decode( unknown[i], 1, event ) );
+            CHECK( SameEvent( event, Sentinel() ) );
+        }
+
+        // nothing was stored either
+        for ( size_t i = 0; i < ELEMENT_COUNT; i++ )
+        {
+            CHECK( registry.Value( static_cast<unsigned int>( i ) ) == 0 );
+        }
+
+        registry.Clear();
+        GitHubSample::KeyEvent event = Sentinel();
+        CHECK( ! registry.Decode( ELEMENTS[0].cookie, 1, event ) );
+        CHECK( SameEvent( event, Sentinel() ) );
+    }
+
+
+    /// AC Pan is a relative 'misc' element: its value is a signed step, not a press
+    void TestSignedValues()
+    {
+        GitHubSample::UsageRegistry registry;
+        Register( registry );
+
+        const unsigned int pan = registry.IndexOf( USAGE_PAGE_CONSUMER, USAGE_CSMR_AC_PAN );
+        CHECK( pan != GitHubSample::UsageRegistry::kNoIndex );
+
+        const int32_t steps[] = { -3, 127, -127, 0 };
+        for ( size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++ )
+        {
+            GitHubSample::KeyEvent event = Sentinel();
+            CHECK( registry.Decode( registry.Cookie( pan ), steps[i], event ) );
+            CHECK( event.usagePage == USAGE_PAGE_CONSUMER && event.usage == USAGE_CSMR_AC_PAN );
+            CHECK( event.value == steps[i] );
+            CHECK( registry.Value( pan ) == steps[i] );
+        }
+    }
+
+
+    /// Mute from report 1 and from report 3: the same usage, two elements, two values
+    void TestSameUsageInTwoReports()
+    {
+        GitHubSample::UsageRegistry registry;
+        Register( registry );
+
+        const unsigned int first = registry.IndexOf( USAGE_PAGE_CONSUMER, USAGE_CSMR_MUTE );
+        CHECK( first != GitHubSample::UsageRegistry::kNoIndex );
+        CHECK( registry.ReportId( first ) == 1 );
+        const unsigned int second = registry.NextWithSameUsage( first );
+        CHECK( second != GitHubSample::UsageRegistry::kNoIndex );
+        CHECK( registry.ReportId( second ) == 3 );
+        CHECK( registry.NextWithSameUsage( second ) == GitHubSample::UsageRegistry::kNoIndex );
+        CHECK( registry.IndexOf( USAGE_PAGE_CONSUMER, USAGE_CSMR_MUTE, 3 ) == second );
+
+        GitHubSample::KeyEvent event = Sentinel();
+        CHECK( registry.Decode( registry.Cookie( second ), 1, event ) );
+        CHECK( event.usagePage == USAGE_PAGE_CONSUMER && event.usage == USAGE_CSMR_MUTE );
+        CHECK( registry.Value( second ) == 1 );
+        CHECK( registry.Value( first ) == 0 );
+
+        // the system controls share no usage with the consumer page, whatever their numbers
+        CHECK( registry.IndexOf( USAGE_PAGE_CONSUMER, USAGE_GD_SYSTEM_SLEEP ) == GitHubSample::UsageRegistry::kNoIndex );
+        CHECK( registry.IndexOf( USAGE_PAGE_GENERIC_DESKTOP, USAGE_GD_SYSTEM_SLEEP, 2 ) != GitHubSample::UsageRegistry::kNoIndex );
+    }
+}
+
+
+
+int main()
+{
+    TestEveryElementDecodes();
+    TestUnknownCookies();
+    TestSignedValues();
+    TestSameUsageInTwoReports();
+
+    return GitHubSample::Test::Finish( "ConsumerControlDecodeTest" );
+}
@@ -0,0 +1,75 @@
+#ifndef GITHUBSAMPLE_COUNTING_ALLOCATOR_H
+#define GITHUBSAMPLE_COUNTING_ALLOCATOR_H
+
+#include <new>
+#include <stddef.h>
+#include <stdlib.h>
+
+/*
+   Replaces the global operator new and delete of the PROGRAM, so include
+   this from exactly one file of a test.  Allocations made through malloc
+   (IOKit, CoreFoundation) are not seen.
+
+       GitHubSample::Test::AllocationCount allocations;
+       ... the code that must not allocate ...
+       CHECK( allocations.Count() == 0 );
+*/
+
+
+namespace GitHubSample
+{
+namespace Test
+{
+
+    /// how many operator new calls the program made so far
+    inline size_t& AllocationsSoFar()
+    {
+        static size_t allocations = 0;
+        return allocations;
+    }
+
+    /// Counts the allocations since construction or the last Restart.
+    class AllocationCount
+    {
+    public:
+
+        AllocationCount() : m_start( AllocationsSoFar() ) {}
+
+        void Restart() { m_start = AllocationsSoFar(); }
+
+        size_t Count() const { return AllocationsSoFar() - m_start; }
+
+    private:
+
+        size_t m_start;
+    };
+
+
+    inline void* CountedAllocate( const size_t size )
+    {
+        AllocationsSoFar()++;
+
+        void* memory = malloc( size != 0 ? size : 1 );
+        if ( memory == 0 )
+        {
+            throw std::bad_alloc();
+        }
+        return memory;
+    }
+
+    /// out of line, or g++ sees the free() of what new returned and warns about the mismatch
+    inline void __attribute__((noinline)) CountedFree( void* memory )
+    {
+        free( memory );
+    }
+
+} // end namespace Test
+} // end namespace GitHubSample
+
+
+void* operator new( size_t size ) throw( std::bad_alloc ) { return GitHubSample::Test::CountedAllocate( size ); }
+void* operator new[]( size_t size ) throw( std::bad_alloc ) { return GitHubSample::Test::CountedAllocate( size ); }
+void operator delete( void* memory ) throw() { GitHubSample::Test::CountedFree( memory ); }
+void operator delete[]( void* memory ) throw() { GitHubSample::Test::CountedFree( memory ); }
+
+#endif // GITHUBSAMPLE_COUNTING_ALLOCATOR_H
@@ -0,0 +1,125 @@
+
+
+#include "TestCheck.h"
+
+#include "DarwinKeycodeTables.h"
+
+#include <vector>
+
+
+
+namespace
+{
+    const uint32_t SHIFT_PAIR   = GitHubSample::kDarwinShiftKey   | GitHubSample::kDarwinRightShiftKey;
+    const uint32_t CONTROL_PAIR = GitHubSample::kDarwinControlKey | GitHubSample::kDarwinRightControlKey;
+    const uint32_t OPTION_PAIR  = GitHubSample::kDarwinOptionKey  | GitHubSample::kDarwinRightOptionKey;
+    const uint32_t COMMAND_PAIR = GitHubSample::kDarwinCmdKey     | GitHubSample::kDarwinRightCmdKey;
+
+    /// the bits that are not part of a pair, and must come through untouched
+    const uint32_t OTHER_BITS[] =
+    {
+        0, GitHubSample::kDarwinAlphaLock, GitHubSample::kDarwinNumLock | GitHubSample::kDarwinFn, 0x80000001u
+    };
+
+
+    /// DarwinAdjustModifierMask of third_party_samples/DarwinKeyboard.cpp, with the HID cache passed in
+    uint32_t ReferenceAdjustModifierMask( uint32_t fModifiers, const uint32_t fAltModifiers )
+    {
+        if (fModifiers & (SHIFT_PAIR | CONTROL_PAIR | OPTION_PAIR | COMMAND_PAIR))
+        {
+            if (   (fModifiers    & SHIFT_PAIR)
+                && (fAltModifiers & SHIFT_PAIR))
+            {
+                fModifiers &= ~SHIFT_PAIR;
+                fModifiers |= fAltModifiers & SHIFT_PAIR;
+            }
+
+            if (   (fModifiers    & CONTROL_PAIR)
+                && (fAltModifiers & CONTROL_PAIR))
+            {
+                fModifiers &= ~CONTROL_PAIR;
+                fModifiers |= fAltModifiers & CONTROL_PAIR;
+            }
+
+            if (   (fModifiers    & OPTION_PAIR)
+                && (fAltModifiers & OPTION_PAIR))
+            {
+                fModifiers &= ~OPTION_PAIR;
+                fModifiers |= fAltModifiers & OPTION_PAIR;
+            }
+
+            if (   (fModifiers    & COMMAND_PAIR)
+                && (fAltModifiers & COMMAND_PAIR))
+            {
+                fModifiers &= ~COMMAND_PAIR;
+                fModifiers |= fAltModifiers & COMMAND_PAIR;
+            }
+        }
+
+        return fModifiers;
+    }
+
+
+    /**
+       Every combination of the eight pair bits in 'modifiers' and in
+       'currentModifiers' (2^16 of them), each with the other bits in a few
+       states, against the reference: the single version, and the batch
+       version at lengths that do and do not fill the SSE2 loop.
+     */
+    void TestEveryCombination()
+    {
+        const size_t otherCount = sizeof(OTHER_BITS) / sizeof(OTHER_BITS[0]);
+
+        std::vector< uint32_t > inputs;
+        for ( unsigned input = 0; input < 0x100; input++ )
+        {
+            for ( size_t other = 0; other < otherCount; other++ )
+            {
+                inputs.push_back( GitHubSample::HidModifiersToDarwinModifierMask( static_cast<uint8_t>( input ) ) | OTHER_BITS[ other ] );
+            }
+        }
+
+        for ( unsigned current = 0; current < 0x100; current++ )
+        {
+            for ( size_t other = 0; other < otherCount; other++ )
+            {
+                const uint32_t currentModifiers = GitHubSample::HidModifiersToDarwinModifierMask( static_cast<uint8_t>( current ) ) | OTHER_BITS[ other ];
+
+                // the whole array, and then three short tails on their own
+                std::vector< uint32_t > batch( inputs );
+                GitHubSample::DarwinAdjustModifierMasks( &batch[0], batch.size() - 3, currentModifiers );
+                GitHubSample::DarwinAdjustModifierMasks( &batch[ batch.size() - 3 ], 3, currentModifiers );
+
+                for ( size_t i = 0; i < inputs.size(); i++ )
+                {
+                    const uint32_t expected = ReferenceAdjustModifierMask( inputs[i], currentModifiers );
+                    CHECK( GitHubSample::DarwinAdjustModifierMask( inputs[i], currentModifiers ) == expected );
+                    CHECK( batch[i] == expected );
+                }
+            }
+        }
+    }
+
+
+    void TestHidModifiers()
+    {
+        CHECK( GitHubSample::HidModifiersToDarwinModifierMask( 0x00 ) == 0 );
+        CHECK( GitHubSample::HidModifiersToDarwinModifierMask( 0x02 ) == GitHubSample::kDarwinShiftKey );
+        CHECK( GitHubSample::HidModifiersToDarwinModifierMask( 0x20 ) == GitHubSample::kDarwinRightShiftKey );
+        CHECK( GitHubSample::HidModifiersToDarwinModifierMask( 0x80 ) == GitHubSample::kDarwinRightCmdKey );
+        CHECK( GitHubSample::HidModifiersToDarwinModifierMask( 0xFF ) == ( SHIFT_PAIR | CONTROL_PAIR | OPTION_PAIR | COMMAND_PAIR ) );
+
+        // "shift" from Carbon while the RIGHT shift is down
+        CHECK( GitHubSample::DarwinAdjustModifierMask( GitHubSample::kDarwinShiftKey, GitHubSample::kDarwinRightShiftKey ) == GitHubSample::kDarwinRightShiftKey );
+    }
+}
+
+
+
+int main()
+{
+    TestHidModifiers();
+    TestEveryCombination();
+
+    return GitHubSample::Test::Finish( "DarwinAdjustModifierMaskTest" );
+}
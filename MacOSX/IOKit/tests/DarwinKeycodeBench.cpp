@@ -0,0 +1,280 @@
+
+
+#include "TestCheck.h"
+
+#include "DarwinKeycodeTables.h"
+
+#include <vector>
+
+
+
+namespace
+{
+    const unsigned QZ_RMETA    = 0x36;
+    const unsigned QZ_LMETA    = 0x37;
+    const unsigned QZ_LSHIFT   = 0x38;
+    const unsigned QZ_CAPSLOCK = 0x39;
+    const unsigned QZ_LALT     = 0x3A;
+    const unsigned QZ_LCTRL    = 0x3B;
+    const unsigned QZ_RSHIFT   = 0x3C;
+    const unsigned QZ_RALT     = 0x3D;
+    const unsigned QZ_RCTRL    = 0x3E;
+    const unsigned QZ_FN       = 0x3F;
+    const unsigned QZ_NUMLOCK  = 0x47;
+
+    const size_t STREAM_LENGTH = 1 << 20;
+    const size_t PASSES = 20;
+
+
+    /// DarwinModifierMaskToDarwinKeycode of third_party_samples/DarwinKeyboard.cpp
+    unsigned ChainModifierMaskToDarwinKeycode( uint32_t fModifiers )
+    {
+        unsigned uKeyCode;
+
+        fModifiers &= GitHubSample::kDarwinAllModifiers;
+        if (fModifiers == GitHubSample::kDarwinShiftKey)
+            uKeyCode = QZ_LSHIFT;
+        else if (fModifiers == GitHubSample::kDarwinRightShiftKey)
+            uKeyCode = QZ_RSHIFT;
+        else if (fModifiers == GitHubSample::kDarwinControlKey)
+            uKeyCode = QZ_LCTRL;
+        else if (fModifiers == GitHubSample::kDarwinRightControlKey)
+            uKeyCode = QZ_RCTRL;
+        else if (fModifiers == GitHubSample::kDarwinOptionKey)
+            uKeyCode = QZ_LALT;
+        else if (fModifiers == GitHubSample::kDarwinRightOptionKey)
+            uKeyCode = QZ_RALT;
+        else if (fModifiers == GitHubSample::kDarwinCmdKey)
+            uKeyCode = QZ_LMETA;
+        else if (fModifiers == GitHubSample::kDarwinRightCmdKey)
+            uKeyCode = QZ_RMETA;
+        else if (fModifiers == GitHubSample::kDarwinAlphaLock)
+            uKeyCode = QZ_CAPSLOCK;
+        else if (fModifiers == GitHubSample::kDarwinNumLock)
+            uKeyCode = QZ_NUMLOCK;
+        else if (fModifiers == GitHubSample::kDarwinFn)
+            uKeyCode = QZ_FN;
+        else if (fModifiers == 0)
+            uKeyCode = 0;
+        else
+            uKeyCode = ~0U; /* multiple */
+        return uKeyCode;
+    }
+
+    /// DarwinKeyCodeToDarwinModifierMask of third_party_samples/DarwinKeyboard.cpp
+    uint32_t ChainKeyCodeToDarwinModifierMask( const unsigned uKeyCode )
+    {
+        uint32_t fModifiers;
+
+        if (uKeyCode == QZ_LSHIFT)
+            fModifiers = GitHubSample::kDarwinShiftKey;
+        else if (uKeyCode == QZ_RSHIFT)
+            fModifiers = GitHubSample::kDarwinRightShiftKey;
+        else if (uKeyCode == QZ_LCTRL)
+            fModifiers = GitHubSample::kDarwinControlKey;
+        else if (uKeyCode == QZ_RCTRL)
+            fModifiers = GitHubSample::kDarwinRightControlKey;
+        else if (uKeyCode == QZ_LALT)
+            fModifiers = GitHubSample::kDarwinOptionKey;
+        else if (uKeyCode == QZ_RALT)
+            fModifiers = GitHubSample::kDarwinRightOptionKey;
+        else if (uKeyCode == QZ_LMETA)
+            fModifiers = GitHubSample::kDarwinCmdKey;
+        else if (uKeyCode == QZ_RMETA)
+            fModifiers = GitHubSample::kDarwinRightCmdKey;
+        else if (uKeyCode == QZ_CAPSLOCK)
+            fModifiers = GitHubSample::kDarwinAlphaLock;
+        else if (uKeyCode == QZ_NUMLOCK)
+            fModifiers = GitHubSample::kDarwinNumLock;
+        else if (uKeyCode == QZ_FN)
+            fModifiers = GitHubSample::kDarwinFn;
+        else
+            fModifiers = 0;
+        return fModifiers;
+    }
+
+
+    uint32_t g_seed = 1;
+
+    unsigned int Random( const unsigned int range )
+    {
+        g_seed = g_seed * 1103515245u + 12345u;
+        return ( g_seed >> 16 ) % range;
+    }
+
+    /// what a VM sees while shortcuts are held: mostly one modifier, some none, some chords
+    uint32_t RandomModifierMask()
+    {
+        static const uint32_t singles[] =
+        {
+            GitHubSample::kDarwinShiftKey, GitHubSample::kDarwinRightShiftKey, GitHubSample::kDarwinControlKey,
+            GitHubSample::kDarwinRightControlKey, GitHubSample::kDarwinOptionKey, GitHubSample::kDarwinRightOptionKey,
+            GitHubSample::kDarwinCmdKey, GitHubSample::kDarwinRightCmdKey, GitHubSample::kDarwinAlphaLock,
+            GitHubSample::kDarwinNumLock, GitHubSample::kDarwinFn
+        };
+        const size_t singleCount = sizeof(singles) / sizeof(singles[0]);
+
+        const unsigned int roll = Random( 10 );
+        if ( roll == 0 )
+        {
+            return 0;
+        }
+        if ( roll < 8 )
+        {
+            return singles[ Random( singleCount ) ];
+        }
+        return singles[ Random( singleCount ) ] | singles[ Random( singleCount ) ];
+    }
+
+    /// half modifier keys, half anything
+    uint16_t RandomKeycode()
+    {
+        return static_cast<uint16_t>( Random( 2 ) ? QZ_RMETA + Random( 10 ) : Random( GitHubSample::kDarwinKeycodeCount ) );
+    }
+
+    /// keeps the compiler from dropping loops whose results are never used
+    volatile unsigned long g_sink = 0;
+
+    void Report( const char* what, const uint64_t nanoseconds, const unsigned long sink )
+    {
+        g_sink = sink;
+        printf( "%-40s %6.2f ns per item\n", what, static_cast<double>( nanoseconds ) / ( STREAM_LENGTH * PASSES ) );
+    }
+
+
+    void TestAgainstChains()
+    {
+        for ( unsigned first = 0; first < 32; first++ )
+        {
+            for ( unsigned second = 0; second < 32; second++ )
+            {
+                const uint32_t modifiers = ( 1u << first ) | ( 1u << second );
+                CHECK( GitHubSample::DarwinModifierMaskToDarwinKeycode( modifiers ) == ChainModifierMaskToDarwinKeycode( modifiers ) );
+            }
+        }
+        CHECK( GitHubSample::DarwinModifierMaskToDarwinKeycode( 0 ) == 0 );
+
+        for ( unsigned keycode = 0; keycode < 0x100; keycode++ )
+        {
+            CHECK( GitHubSample::DarwinKeycodeToDarwinModifierMask( keycode ) == ChainKeyCodeToDarwinModifierMask( keycode ) );
+        }
+    }
+}
+
+
+
+int main()
+{
+    TestAgainstChains();
+
+    std::vector< uint32_t > masks( STREAM_LENGTH );
+    std::vector< uint16_t > keycodes( STREAM_LENGTH );
+    for ( size_t i = 0; i < STREAM_LENGTH; i++ )
+    {
+        masks[i] = RandomModifierMask();
+        keycodes[i] = RandomKeycode();
+    }
+
+    std::vector< unsigned > keycodesOut( STREAM_LENGTH );
+    std::vector< uint32_t > masksOut( STREAM_LENGTH );
+    std::vector< uint16_t > scancodesOut( STREAM_LENGTH );
+    unsigned long sink = 0;
+    uint64_t start = 0;
+
+    // -- modifier mask to keycode --
+
+    start = GitHubSample::Test::Nanoseconds();
+    for ( size_t pass = 0; pass < PASSES; pass++ )
+    {
+        for ( size_t i = 0; i < STREAM_LENGTH; i++ )
+        {
+            sink += ChainModifierMaskToDarwinKeycode( masks[i] );
+        }
+    }
+    Report( "mask -> keycode, if/else chain", GitHubSample::Test::Nanoseconds() - start, sink );
+
+    start = GitHubSample::Test::Nanoseconds();
+    for ( size_t pass = 0; pass < PASSES; pass++ )
+    {
+        for ( size_t i = 0; i < STREAM_LENGTH; i++ )
+        {
+            sink += GitHubSample::DarwinModifierMaskToDarwinKeycode( masks[i] );
+        }
+    }
+    Report( "mask -> keycode, table", GitHubSample::Test::Nanoseconds() - start, sink );
+
+    start = GitHubSample::Test::Nanoseconds();
+    for ( size_t pass = 0; pass < PASSES; pass++ )
+    {
+        GitHubSample::DarwinModifierMasksToDarwinKeycodes( &masks[0], &keycodesOut[0], STREAM_LENGTH );
+        sink += keycodesOut[ pass ];
+    }
+    Report( "mask -> keycode, batch", GitHubSample::Test::Nanoseconds() - start, sink );
+
+    for ( size_t i = 0; i < STREAM_LENGTH; i++ )
+    {
+        CHECK( keycodesOut[i] == ChainModifierMaskToDarwinKeycode( masks[i] ) );
+    }
+
+    // -- keycode to modifier mask --
+
+    start = GitHubSample::Test::Nanoseconds();
+    for ( size_t pass = 0; pass < PASSES; pass++ )
+    {
+        for ( size_t i = 0; i < STREAM_LENGTH; i++ )
+        {
+            sink += ChainKeyCodeToDarwinModifierMask( keycodes[i] );
+        }
+    }
+    Report( "keycode -> mask, if/else chain", GitHubSample::Test::Nanoseconds() - start, sink );
+
+    start = GitHubSample::Test::Nanoseconds();
+    for ( size_t pass = 0; pass < PASSES; pass++ )
+    {
+        for ( size_t i = 0; i < STREAM_LENGTH; i++ )
+        {
+            sink += GitHubSample::DarwinKeycodeToDarwinModifierMask( keycodes[i] );
+        }
+    }
+    Report( "keycode -> mask, table", GitHubSample::Test::Nanoseconds() - start, sink );
+
+    start = GitHubSample::Test::Nanoseconds();
+    for ( size_t pass = 0; pass < PASSES; pass++ )
+    {
+        GitHubSample::DarwinKeycodesToDarwinModifierMasks( &keycodes[0], &masksOut[0], STREAM_LENGTH );
+        sink += masksOut[ pass ];
+    }
+    Report( "keycode -> mask, batch", GitHubSample::Test::Nanoseconds() - start, sink );
+
+    for ( size_t i = 0; i < STREAM_LENGTH; i++ )
+    {
+        CHECK( masksOut[i] == ChainKeyCodeToDarwinModifierMask( keycodes[i] ) );
+    }
+
+    // -- keycode to set-1 scancode --
+
+    start = GitHubSample::Test::Nanoseconds();
+    for ( size_t pass = 0; pass < PASSES; pass++ )
+    {
+        for ( size_t i = 0; i < STREAM_LENGTH; i++ )
+        {
+            sink += GitHubSample::DarwinKeycodeToSet1Scancode( keycodes[i] );
+        }
+    }
+    Report( "keycode -> set-1, table", GitHubSample::Test::Nanoseconds() - start, sink );
+
+    start = GitHubSample::Test::Nanoseconds();
+    for ( size_t pass = 0; pass < PASSES; pass++ )
+    {
+        GitHubSample::DarwinKeycodesToSet1Scancodes( &keycodes[0], &scancodesOut[0], STREAM_LENGTH );
+        sink += scancodesOut[ pass ];
+    }
+    Report( "keycode -> set-1, batch", GitHubSample::Test::Nanoseconds() - start, sink );
+
+    for ( size_t i = 0; i < STREAM_LENGTH; i++ )
+    {
+        CHECK( scancodesOut[i] == GitHubSample::DarwinKeycodeToSet1Scancode( keycodes[i] ) );
+    }
+
+    return GitHubSample::Test::Finish( "DarwinKeycodeBench" );
+}
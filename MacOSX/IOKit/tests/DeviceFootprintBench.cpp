@@ -0,0 +1,139 @@
+
+
+#include "TestCheck.h"
+
+#include "AdaptivePoller.h"
+#include "ClockSkewEstimator.h"
+#include "EventCoalescer.h"
+#include "KeyboardLayout.h"
+#include "ModifierAggregator.h"
+#include "TextReconstructionStage.h"
+#include "TimestampMerger.h"
+
+#include <string.h>
+#include <vector>
+
+
+
+namespace
+{
+    const uint16_t USAGE_PAGE_KEYBOARD_OR_KEYPAD = 0x07;
+    const uint16_t USAGE_LEFT_SHIFT = 0xE1;
+
+    const size_t MOST_DEVICES = 256;
+    const size_t EVENTS_PER_DEVICE = 32;
+
+
+    /**
+       What a process with 'deviceCount' keyboards holds: per device a
+       poller and a text stage (sharing ONE layout), and the multi-device
+       stages that every device's events pass through.  Each device types a
+       little, so state that grows on first use has grown.
+     */
+    GitHubSample::MemoryUsageReport Footprint( const size_t deviceCount, const GitHubSample::KeyboardLayout& layout )
+    {
+        GitHubSample::ModifierAggregator aggregator;
+        GitHubSample::TimestampMerger merger( deviceCount, 8000000 );
+        GitHubSample::DeviceClockCorrector corrector;
+        GitHubSample::EventCoalescer coalescer;
+
+        std::vector< GitHubSample::AdaptivePoller* > pollers;
+        std::vector< GitHubSample::TextReconstructionStage* > textStages;
+
+        std::vector< GitHubSample::KeyEvent > events( EVENTS_PER_DEVICE );
+        std::vector< GitHubSample::KeyEvent > delivered( 256 );
+        char utf8[ EVENTS_PER_DEVICE * GitHubSample::TextReconstructionStage::kMaxBytesPerEvent ];
+
+        for ( size_t device = 0; device < deviceCount; device++ )
+        {
+            pollers.push_back( new GitHubSample::AdaptivePoller( GitHubSample::AdaptivePoller::SnapshotFunctor() ) );
+            textStages.push_back( new GitHubSample::TextReconstructionStage( layout ) );
+
+            const uint64_t start = device * 1000000;
+            memset( &events[0], 0, events.size() * sizeof(events[0]) );
+            for ( size_t i = 0; i < EVENTS_PER_DEVICE; i++ )
+            {
+                events[i].timestamp = start + i * 100000;
+                events[i].usagePage = USAGE_PAGE_KEYBOARD_OR_KEYPAD;
+                events[i].usage = ( i % 8 == 0 ) ? USAGE_LEFT_SHIFT : static_cast<uint16_t>( 0x04 + ( i % 26 ) );
+                events[i].value = static_cast<int32_t>( ( i / 2 ) % 2 == 0 );
+                events[i].deviceIndex = static_cast<uint16_t>( device );
+            }
+
+            corrector.Correct( &events[0], events.size(), start + EVENTS_PER_DEVICE * 100000 + 500000 );
+            merger.Push( &events[0], events.size() );
+            aggregator.OnEvents( &events[0], events.size() );
+            coalescer.Offer( &events[0], events.size(), start );
+            coalescer.Deliver( &delivered[0], delivered.size(), start + 100000000 );
+
+            size_t bytes = 0;
+            textStages.back()->Process( &events[0], events.size(), utf8, sizeof(utf8), &bytes );
+        }
+        while ( merger.Pop( &delivered[0], delivered.size() ) > 0 )
+        {
+        }
+
+        GitHubSample::MemoryUsageReport report;
+        report += aggregator.MemoryUsage();
+        report += merger.MemoryUsage();
+        report += corrector.MemoryUsage();
+        report += coalescer.MemoryUsage();
+        for ( size_t device = 0; device < deviceCount; device++ )
+        {
+            report += pollers[ device ]->MemoryUsage();
+            report += textStages[ device ]->MemoryUsage();
+            delete pollers[ device ];
+            delete textStages[ device ];
+        }
+        return report;
+    }
+}
+
+
+
+int main()
+{
+    GitHubSample::KeyboardLayout layout;
+    layout.LoadBuiltInUSLayout();
+    printf( "the shared US layout: %lu bytes\n\n", static_cast<unsigned long>( layout.MemoryUsage().ReservedBytes() ) );
+
+    printf( "devices   reserved bytes   resident bytes   bytes per device   added per device\n" );
+
+    size_t oneDevice = 0;
+    double smallestAdded = 0.0;
+    double largestAdded = 0.0;
+    GitHubSample::MemoryUsageReport largest;
+
+    for ( size_t deviceCount = 1; deviceCount <= MOST_DEVICES; deviceCount *= 2 )
+    {
+        const GitHubSample::MemoryUsageReport report = Footprint( deviceCount, layout );
+        const size_t reserved = report.ReservedBytes();
+
+        double added = 0.0;
+        if ( deviceCount == 1 )
+        {
+            oneDevice = reserved;
+        }
+        else
+        {
+            // what each device beyond the first costs: this must not grow with the count
+            added = static_cast<double>( reserved - oneDevice ) / ( deviceCount - 1 );
+            smallestAdded = ( smallestAdded == 0.0 || added < smallestAdded ) ? added : smallestAdded;
+            largestAdded = ( added > largestAdded ) ? added : largestAdded;
+        }
+
+        printf( "%7lu   %14lu   %14lu   %16.0f   %16.0f\n", static_cast<unsigned long>( deviceCount ),
+                static_cast<unsigned long>( reserved ), static_cast<unsigned long>( report.ResidentBytes() ),
+                static_cast<double>( reserved ) / deviceCount, added );
+
+        CHECK( report.ResidentBytes() <= reserved );
+        largest = report;
+    }
+
+    printf( "\nby category, %lu devices:\n%s", static_cast<unsigned long>( MOST_DEVICES ), largest.ToString().c_str() );
+
+    // linear in the device count (vectors grow by doubling, hence the slack)
+    CHECK( largestAdded < 2.0 * smallestAdded );
+
+    return GitHubSample::Test::Finish( "DeviceFootprintBench" );
+}
@@ -0,0 +1,100 @@
+
+
+#include "TestCheck.h"
+
+#include "DevicePropertyStore.h"
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <IOKit/hid/IOHIDKeys.h>
+#include <boost/bind.hpp>
+#include <string.h>
+
+
+
+namespace
+{
+    /// a keyboard on a hub deep enough that its location id has the top bit set
+    const int64_t LOCATION_ID = 0xFA120000LL;
+    const int32_t VENDOR_ID = 0x05AC;
+
+
+    CFTypeRef CreateNumber( const int64_t value )
+    {
+        return CFNumberCreate( kCFAllocatorDefault, kCFNumberSInt64Type, &value );
+    }
+
+    /**
+       Reports a location id, a vendor id, a country code of ZERO (a real
+       answer: "not localized") and a transport.  No product id: that one is
+       absent.
+     */
+    CFTypeRef FetchProperty( CFStringRef key )
+    {
+        if ( CFEqual( key, CFSTR( kIOHIDLocationIDKey ) ) )
+        {
+            return CreateNumber( LOCATION_ID );
+        }
+        if ( CFEqual( key, CFSTR( kIOHIDVendorIDKey ) ) )
+        {
+            return CFNumberCreate( kCFAllocatorDefault, kCFNumberSInt32Type, &VENDOR_ID );
+        }
+        if ( CFEqual( key, CFSTR( kIOHIDCountryCodeKey ) ) )
+        {
+            return CreateNumber( 0 );
+        }
+        if ( CFEqual( key, CFSTR( kIOHIDTransportKey ) ) )
+        {
+            return CFStringCreateWithCString( kCFAllocatorDefault, "USB", kCFStringEncodingUTF8 );
+        }
+        return NULL;
+    }
+
+
+    void TestNumbers()
+    {
+        GitHubSample::DevicePropertyStore properties;
+        properties.SetFetchFunctor( boost::bind( &FetchProperty, _1 ) );
+
+        CHECK( properties.Has( GitHubSample::DevicePropertyStore::kLocationId ) );
+        CHECK( properties.Number( GitHubSample::DevicePropertyStore::kLocationId ) == LOCATION_ID );
+        CHECK( properties.LocationId() == 0xFA120000u );
+
+        CHECK( properties.VendorId() == 0x05AC );
+
+        // zero reported and nothing reported are told apart by Has, and only by Has
+        CHECK( properties.Has( GitHubSample::DevicePropertyStore::kCountryCode ) );
+        CHECK( properties.CountryCode() == 0 );
+        CHECK( ! properties.Has( GitHubSample::DevicePropertyStore::kProductId ) );
+        CHECK( properties.ProductId() == 0 );
+
+        // a string is no number
+        CHECK( properties.Has( GitHubSample::DevicePropertyStore::kTransport ) );
+        CHECK( properties.Number( GitHubSample::DevicePropertyStore::kTransport ) == 0 );
+        CHECK( strcmp( properties.Transport(), "USB" ) == 0 );
+
+        const std::string description = properties.Describe();
+        CHECK( description.find( "4195483648" ) != std::string::npos );
+        CHECK( description.find( "ProductID" ) == std::string::npos );
+    }
+
+
+    void TestNoDevice()
+    {
+        const GitHubSample::DevicePropertyStore properties;
+
+        CHECK( ! properties.Has( GitHubSample::DevicePropertyStore::kVendorId ) );
+        CHECK( properties.VendorId() == 0 );
+        CHECK( strcmp( properties.Manufacturer(), "" ) == 0 );
+        CHECK( properties.Describe().empty() );
+    }
+}
+
+
+
+int main()
+{
+    TestNumbers();
+    TestNoDevice();
+
+    return GitHubSample::Test::Finish( "DevicePropertyStoreTest" );
+}
@@ -0,0 +1,215 @@
+
+
+#include "TestCheck.h"
+
+#include "EventCoalescer.h"
+
+#include <string.h>
+
+
+
+namespace
+{
+    const uint16_t USAGE_PAGE_KEYBOARD_OR_KEYPAD = 0x07;
+    const uint16_t USAGE_A = 0x04;
+    const uint16_t USAGE_ESCAPE = 0x29;
+
+    const uint64_t MILLISECOND = 1000000;
+
+
+    GitHubSample::KeyEvent Key( const uint16_t usage, const bool pressed, const uint64_t timestamp = 0 )
+    {
+        GitHubSample::KeyEvent event;
+        memset( &event, 0, sizeof(event) );
+        event.timestamp = timestamp;
+        event.usagePage = USAGE_PAGE_KEYBOARD_OR_KEYPAD;
+        event.usage = usage;
+        event.value = pressed ? 1 : 0;
+        return event;
+    }
+
+
+    void TestDeadlineOnTheSlackGrid()
+    {
+        GitHubSample::EventCoalescer coalescer( 8 * MILLISECOND, MILLISECOND );
+        GitHubSample::KeyEvent batch[ 8 ];
+        const GitHubSample::KeyEvent a = Key( USAGE_A, true );
+
+        CHECK( coalescer.CurrentState( 0 ) == GitHubSample::EventCoalescer::kIdle );
+        CHECK( coalescer.NanosecondsUntilDelivery( 0 ) == UINT64_MAX );
+
+        // t0 + 8 ms is 9.234567 ms, down to the grid is 9 ms
+        const uint64_t t0 = 1234567;
+        CHECK( coalescer.Offer( &a, 1, t0 ) == 1 );
+        CHECK( coalescer.NanosecondsUntilDelivery( t0 ) == 9 * MILLISECOND - t0 );
+
+        // a later event joins the batch and does not move the deadline
+        CHECK( coalescer.Offer( &a, 1, 5 * MILLISECOND ) == 1 );
+        CHECK( coalescer.CurrentState( 9 * MILLISECOND - 1 ) == GitHubSample::EventCoalescer::kCollecting );
+        CHECK( coalescer.Deliver( batch, 8, 9 * MILLISECOND - 1 ) == 0 );
+        CHECK( coalescer.Stats().wakeups == 0 );
+
+        CHECK( coalescer.CurrentState( 9 * MILLISECOND ) == GitHubSample::EventCoalescer::kDue );
+        CHECK( coalescer.Deliver( batch, 8, 9 * MILLISECOND ) == 2 );
+        CHECK( coalescer.Stats().wakeups == 1 );
+        CHECK( coalescer.Stats().priorityWakeups == 0 );
+        CHECK( coalescer.CurrentState( 9 * MILLISECOND ) == GitHubSample::EventCoalescer::kIdle );
+
+        // a budget shorter than the slack: rounding down would land before t0, so the deadline is t0 + budget
+        GitHubSample::EventCoalescer shortBudget( 500000, MILLISECOND );
+        CHECK( shortBudget.Offer( &a, 1, 1200000 ) == 1 );
+        CHECK( shortBudget.NanosecondsUntilDelivery( 1200000 ) == 500000 );
+
+        // ... unless t0 is on the grid itself, and then it is t0
+        GitHubSample::EventCoalescer onTheGrid( 500000, MILLISECOND );
+        CHECK( onTheGrid.Offer( &a, 1, 2 * MILLISECOND ) == 1 );
+        CHECK( onTheGrid.CurrentState( 2 * MILLISECOND ) == GitHubSample::EventCoalescer::kDue );
+    }
+
+
+    void TestPriorityKey()
+    {
+        GitHubSample::EventCoalescer coalescer( 8 * MILLISECOND, MILLISECOND );
+        GitHubSample::KeyEvent batch[ 8 ];
+        const GitHubSample::KeyEvent a = Key( USAGE_A, true );
+        const GitHubSample::KeyEvent escapeDown = Key( USAGE_ESCAPE, true );
+        const GitHubSample::KeyEvent escapeUp = Key( USAGE_ESCAPE, false );
+
+        coalescer.Offer( &a, 1, MILLISECOND );
+        CHECK( coalescer.CurrentState( 2 * MILLISECOND ) == GitHubSample::EventCoalescer::kCollecting );
+
+        // Escape: due at once, with everything held before it
+        coalescer.Offer( &escapeDown, 1, 2 * MILLISECOND );
+        CHECK( coalescer.CurrentState( 2 * MILLISECOND ) == GitHubSample::EventCoalescer::kDue );
+        CHECK( coalescer.NanosecondsUntilDelivery( 2 * MILLISECOND ) == 0 );
+        CHECK( coalescer.Deliver( batch, 8, 2 * MILLISECOND ) == 2 );
+        CHECK( batch[0].usage == USAGE_A && batch[1].usage == USAGE_ESCAPE );
+
+        // the release too
+        coalescer.Offer( &escapeUp, 1, 3 * MILLISECOND );
+        CHECK( coalescer.Deliver( batch, 8, 3 * MILLISECOND ) == 1 );
+
+        CHECK( coalescer.Stats().wakeups == 2 );
+        CHECK( coalescer.Stats().priorityWakeups == 2 );
+
+        // and no longer once it is not a priority key
+        coalescer.SetPriorityKey( USAGE_ESCAPE, false );
+        coalescer.Offer( &escapeDown, 1, 4 * MILLISECOND );
+        CHECK( coalescer.CurrentState( 4 * MILLISECOND ) == GitHubSample::EventCoalescer::kCollecting );
+
+        // a priority batch that is delivered after its deadline anyway is not a priority wake-up
+        coalescer.SetPriorityKey( USAGE_A, true );
+        coalescer.Offer( &a, 1, 5 * MILLISECOND );
+        CHECK( coalescer.Deliver( batch, 8, 100 * MILLISECOND ) == 2 );
+        CHECK( coalescer.Stats().priorityWakeups == 2 );
+        CHECK( coalescer.Stats().wakeups == 3 );
+    }
+
+
+    void TestFullBufferAndPartialDeliver()
+    {
+        GitHubSample::EventCoalescer coalescer( 8 * MILLISECOND, MILLISECOND, 4 );
+        GitHubSample::KeyEvent events[ 6 ];
+        for ( size_t i = 0; i < 6; i++ )
+        {
+            events[i] = Key( static_cast<uint16_t>( USAGE_A + i ), true );
+        }
+
+        CHECK( coalescer.Offer( events, 3, MILLISECOND ) == 3 );
+        CHECK( coalescer.CurrentState( MILLISECOND ) == GitHubSample::EventCoalescer::kCollecting );
+
+        // one fits, two are dropped, and a full buffer is due long before the deadline
+        CHECK( coalescer.Offer( events + 3, 3, MILLISECOND ) == 1 );
+        CHECK( coalescer.Stats().droppedEvents == 2 );
+        CHECK( coalescer.CurrentState( MILLISECOND ) == GitHubSample::EventCoalescer::kDue );
+
+        // taken in pieces: still one wake-up, and due until the last piece
+        GitHubSample::KeyEvent batch[ 3 ];
+        CHECK( coalescer.Deliver( batch, 3, MILLISECOND ) == 3 );
+        CHECK( batch[0].usage == USAGE_A && batch[2].usage == USAGE_A + 2 );
+        CHECK( coalescer.CurrentState( MILLISECOND ) == GitHubSample::EventCoalescer::kDue );
+        CHECK( coalescer.Deliver( batch, 3, MILLISECOND ) == 1 );
+        CHECK( batch[0].usage == USAGE_A + 3 );
+        CHECK( coalescer.CurrentState( MILLISECOND ) == GitHubSample::EventCoalescer::kIdle );
+
+        CHECK( coalescer.Stats().wakeups == 1 );
+        CHECK( coalescer.Stats().events == 4 );
+    }
+
+
+    void TestZeroBudget()
+    {
+        GitHubSample::EventCoalescer coalescer( 0, MILLISECOND );
+        GitHubSample::KeyEvent batch[ 8 ];
+        const GitHubSample::KeyEvent a = Key( USAGE_A, true );
+
+        // off the grid and on it: either way due the moment it arrives
+        coalescer.Offer( &a, 1, 1234567 );
+        CHECK( coalescer.NanosecondsUntilDelivery( 1234567 ) == 0 );
+        CHECK( coalescer.Deliver( batch, 8, 1234567 ) == 1 );
+
+        coalescer.Offer( &a, 1, 3 * MILLISECOND );
+        CHECK( coalescer.Deliver( batch, 8, 3 * MILLISECOND ) == 1 );
+
+        CHECK( coalescer.Stats().wakeups == 2 );
+        CHECK( coalescer.Stats().maximumLatency == 0 );
+        CHECK( coalescer.Stats().latencyHistogram[ 0 ] == 2 );
+    }
+
+
+    void TestLatencyHistogram()
+    {
+        GitHubSample::EventCoalescer coalescer( 0, 0 );
+        GitHubSample::KeyEvent batch[ 8 ];
+        const GitHubSample::KeyEvent a = Key( USAGE_A, true );
+
+        coalescer.ResetStats( 0 );
+
+        // 0.5 us: bucket 0, below 1 us
+        coalescer.Offer( &a, 1, 0 );
+        coalescer.Deliver( batch, 8, 500 );
+        // 3 us: bucket 2, [ 2, 4 ) us
+        coalescer.Offer( &a, 1, 1000 );
+        coalescer.Deliver( batch, 8, 4000 );
+        // 5 ms: bucket 13, [ 4096, 8192 ) us
+        coalescer.Offer( &a, 1, 10000 );
+        coalescer.Deliver( batch, 8, 5010000 );
+        // 10 s: the open ended last bucket
+        coalescer.Offer( &a, 1, 6 * MILLISECOND );
+        coalescer.Deliver( batch, 8, 6 * MILLISECOND + 10000 * MILLISECOND );
+
+        const GitHubSample::EventCoalescer::Statistics& stats = coalescer.Stats();
+        CHECK( stats.latencyHistogram[ 0 ] == 1 );
+        CHECK( stats.latencyHistogram[ 2 ] == 1 );
+        CHECK( stats.latencyHistogram[ 13 ] == 1 );
+        CHECK( stats.latencyHistogram[ GitHubSample::EventCoalescer::kLatencyBucketCount - 1 ] == 1 );
+        CHECK( stats.maximumLatency == 10000 * MILLISECOND );
+        CHECK( stats.totalLatency == 500 + 3000 + 5000000 + 10000 * MILLISECOND );
+
+        // the upper bound of the bucket the fraction falls in, never past the largest latency seen
+        CHECK( coalescer.LatencyPercentile( 0.25 ) == 1000 );
+        CHECK( coalescer.LatencyPercentile( 0.5 ) == 4000 );
+        CHECK( coalescer.LatencyPercentile( 0.75 ) == 8192000 );
+        CHECK( coalescer.LatencyPercentile( 1.0 ) == 10000 * MILLISECOND );
+
+        // four wake-ups over the 10.006 s since ResetStats
+        const double wakeups = coalescer.WakeupsPerSecond( 6 * MILLISECOND + 10000 * MILLISECOND );
+        CHECK( wakeups > 0.399 && wakeups < 0.4 );
+
+        GitHubSample::EventCoalescer empty;
+        CHECK( empty.LatencyPercentile( 0.5 ) == 0 );
+    }
+}
+
+
+
+int main()
+{
+    TestDeadlineOnTheSlackGrid();
+    TestPriorityKey();
+    TestFullBufferAndPartialDeliver();
+    TestZeroBudget();
+    TestLatencyHistogram();
+
+    return GitHubSample::Test::Finish( "EventCoalescerTest" );
+}
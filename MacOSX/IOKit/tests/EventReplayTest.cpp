@@ -0,0 +1,332 @@
+
+
+#include "TestCheck.h"
+
+#include "EventCoalescer.h"
+#include "EventReplay.h"
+
+#include <boost/bind.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+
+
+namespace
+{
+    const uint16_t USAGE_PAGE_KEYBOARD_OR_KEYPAD = 0x07;
+    const uint16_t USAGE_A = 0x04;
+    const uint16_t USAGE_ESCAPE = 0x29;
+
+    const uint64_t MILLISECOND = 1000000;
+    const uint64_t NEVER = ~static_cast<uint64_t>( 0 );
+
+    /// where the session starts on the virtual clock.  not zero, so that a time mixed up with a duration shows
+    const uint64_t SESSION_START = 5000 * MILLISECOND;
+    const size_t KEYSTROKES = 400;
+
+    const size_t READ_CAPACITY = 16;
+    const size_t BATCH_CAPACITY = 8;
+
+    uint32_t g_seed = 31;
+
+    unsigned int Random( const unsigned int range )
+    {
+        g_seed = g_seed * 1103515245u + 12345u;
+        return ( g_seed >> 16 ) % range;
+    }
+
+    size_t g_errorCount = 0;
+
+    void CountError( const std::string )
+    {
+        g_errorCount++;
+    }
+
+
+    GitHubSample::KeyEvent Key( const uint16_t usage, const bool pressed, const uint64_t timestamp )
+    {
+        GitHubSample::KeyEvent event;
+        memset( &event, 0, sizeof(event) );
+        event.timestamp = timestamp;
+        event.usagePage = USAGE_PAGE_KEYBOARD_OR_KEYPAD;
+        event.usage = usage;
+        event.value = pressed ? 1 : 0;
+        event.deviceIndex = 1;
+        return event;
+    }
+
+
+    /**
+       About two seconds of fast typing: a key every 1 to 8 ms, now and
+       then a press and its release in the same read, and an Escape every
+       fifty keys so that some batches go out early.  Each event was stamped up to a millisecond
+       before it was read.
+     */
+    void MakeRecording( GitHubSample::EventRecording& recording )
+    {
+        uint64_t arrival = SESSION_START;
+        for ( size_t i = 0; i < KEYSTROKES; i++ )
+        {
+            const uint16_t usage = ( i % 50 == 49 ) ? USAGE_ESCAPE : static_cast<uint16_t>( USAGE_A + Random( 26 ) );
+            const uint64_t stamp = arrival - Random( 1000 ) * 1000;
+
+            GitHubSample::KeyEvent events[ 2 ];
+            events[0] = Key( usage, true, stamp );
+            events[1] = Key( usage, false, stamp + 500000 );
+
+            if ( Random( 4 ) == 0 )
+            {
+                recording.Append( events, 2, arrival );
+            }
+            else
+            {
+                recording.Append( events, 1, arrival );
+                recording.Append( events + 1, 1, arrival + 1 * MILLISECOND + Random( 1000 ) * 1000 );
+            }
+
+            arrival += ( 1 + Random( 8 ) ) * MILLISECOND;
+        }
+    }
+
+
+    /// FNV-1a, a byte at a time, so that the same values digest the same on any machine
+    void Digest( uint64_t& digest, const uint64_t value )
+    {
+        for ( unsigned int byte = 0; byte < 8; byte++ )
+        {
+            digest ^= ( value >> ( 8 * byte ) ) & 0xFF;
+            digest *= 1099511628211ULL;
+        }
+    }
+
+
+    struct Run
+    {
+        uint64_t digest;
+        uint64_t wallNanoseconds;
+        size_t delivered;
+        uint64_t virtualEnd;
+    };
+
+
+    /**
+       The loop of the EventReplay doc comment: the coalescer's deadline
+       and the next arrival take turns moving the virtual clock, and every
+       batch is digested with the time it went out.
+     */
+    Run Replay( const GitHubSample::EventRecording& recording, const unsigned int speed )
+    {
+        GitHubSample::VirtualClock clock( SESSION_START );
+        GitHubSample::EventReplay replay( recording, clock, speed );
+        GitHubSample::EventCoalescer coalescer( 8 * MILLISECOND );
+        coalescer.ResetStats( clock.NowNanoseconds() );
+
+        GitHubSample::KeyEvent events[ READ_CAPACITY ];
+        GitHubSample::KeyEvent batch[ BATCH_CAPACITY ];
+        Run run = { 14695981039346656037ULL, 0, 0, 0 };
+
+        const uint64_t start = GitHubSample::Test::Nanoseconds();
+        for ( ;; )
+        {
+            const uint64_t wait = coalescer.NanosecondsUntilDelivery( clock.NowNanoseconds() );
+            if ( ! replay.Advance( ( wait == NEVER ) ? NEVER : clock.NowNanoseconds() + wait ) )
+            {
+                break;
+            }
+
+            coalescer.Offer( events, replay.ReadEvents( events, READ_CAPACITY ), clock.NowNanoseconds() );
+
+            size_t count = 0;
+            while ( ( count = coalescer.Deliver( batch, BATCH_CAPACITY, clock.NowNanoseconds() ) ) > 0 )
+            {
+                for ( size_t i = 0; i < count; i++ )
+                {
+                    Digest( run.digest, clock.NowNanoseconds() );
+                    Digest( run.digest, batch[i].timestamp );
+                    Digest( run.digest, ( static_cast<uint64_t>( batch[i].usage ) << 32 ) | static_cast<uint32_t>( batch[i].value ) );
+                }
+                run.delivered += count;
+            }
+        }
+        run.wallNanoseconds = GitHubSample::Test::Nanoseconds() - start;
+        run.virtualEnd = clock.NowNanoseconds();
+
+        const GitHubSample::EventCoalescer::Statistics& stats = coalescer.Stats();
+        Digest( run.digest, stats.wakeups );
+        Digest( run.digest, stats.priorityWakeups );
+        Digest( run.digest, stats.totalLatency );
+        Digest( run.digest, stats.maximumLatency );
+
+        CHECK( replay.Finished() );
+        CHECK( stats.droppedEvents == 0 );
+        return run;
+    }
+
+
+    bool SameEntries( const GitHubSample::EventRecording& a, const GitHubSample::EventRecording& b )
+    {
+        if ( a.Count() != b.Count() )
+        {
+            return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+        }
+
+        for ( size_t i = 0; i < a.Count(); i++ )
+        {
+            const GitHubSample::EventRecording::Entry& x = a.At( i );
+            const GitHubSample::EventRecording::Entry& y = b.At( i );
+            if ( x.arrival != y.arrival || x.event.timestamp != y.event.timestamp || x.event.usagePage != y.event.usagePage
+                 || x.event.usage != y.event.usage || x.event.value != y.event.value
+                 || x.event.deviceIndex != y.event.deviceIndex || x.event.flags != y.event.flags )
+            {
+                return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+            }
+        }
+        return true;
+    }
+
+
+    std::vector< uint8_t > ReadFile( const std::string& path )
+    {
+        std::vector< uint8_t > bytes;
+        FILE* file = fopen( path.c_str(), "rb" );
+        if ( file )
+        {
+            uint8_t buffer[ 4096 ];
+            size_t count = 0;
+            while ( ( count = fread( buffer, 1, sizeof(buffer), file ) ) > 0 )
+            {
+                bytes.insert( bytes.end(), buffer, buffer + count );
+            }
+            fclose( file );
+        }
+        return bytes;
+    }
+
+
+    void WriteFile( const std::string& path, const std::vector< uint8_t >& bytes )
+    {
+        FILE* file = fopen( path.c_str(), "wb" );
+        CHECK( file && fwrite( &bytes[0], 1, bytes.size(), file ) == bytes.size() );
+        if ( file )
+        {
+            fclose( file );
+        }
+    }
+
+
+    /// Load must refuse 'bytes', say so once, and leave the recording empty
+    void CheckRejected( const std::string& path, const std::vector< uint8_t >& bytes )
+    {
+        WriteFile( path, bytes );
+
+        GitHubSample::EventRecording recording;
+        const GitHubSample::KeyEvent event = Key( USAGE_A, true, 0 );
+        recording.Append( &event, 1, 0 );
+
+        g_errorCount = 0;
+        CHECK( ! recording.Load( path, boost::bind( &CountError, _1 ) ) );
+        CHECK( g_errorCount == 1 );
+        CHECK( recording.Count() == 0 );
+    }
+
+
+    void TestSameDigestEveryRun( const GitHubSample::EventRecording& recording )
+    {
+        const Run first = Replay( recording, GitHubSample::EventReplay::kMaximumSpeed );
+        const Run second = Replay( recording, GitHubSample::EventReplay::kMaximumSpeed );
+
+        CHECK( first.delivered == recording.Count() );
+        CHECK( first.digest == second.digest );
+        CHECK( first.virtualEnd == second.virtualEnd );
+    }
+
+
+    void TestSaveAndLoad( const GitHubSample::EventRecording& recording, const std::string& path )
+    {
+        CHECK( recording.Save( path ) );
+
+        GitHubSample::EventRecording loaded;
+        CHECK( loaded.Load( path ) );
+        CHECK( SameEntries( recording, loaded ) );
+        CHECK( Replay( loaded, GitHubSample::EventReplay::kMaximumSpeed ).digest
+               == Replay( recording, GitHubSample::EventReplay::kMaximumSpeed ).digest );
+
+        const std::vector< uint8_t > good = ReadFile( path );
+        CHECK( good.size() == 16 + 32 * recording.Count() );
+
+        // the last event cut short, and the last one missing
+        std::vector< uint8_t > bytes( good.begin(), good.end() - 5 );
+        CheckRejected( path, bytes );
+        bytes.assign( good.begin(), good.end() - 32 );
+        CheckRejected( path, bytes );
+
+        // a header cut short
+        bytes.assign( good.begin(), good.begin() + 10 );
+        CheckRejected( path, bytes );
+
+        bytes = good;
+        bytes[0] = 'X';
+        CheckRejected( path, bytes );
+
+        bytes = good;
+        bytes[4] = 2;
+        CheckRejected( path, bytes );
+
+        g_errorCount = 0;
+        CHECK( ! loaded.Load( path + ".missing", boost::bind( &CountError, _1 ) ) );
+        CHECK( g_errorCount == 1 );
+    }
+
+
+    /**
+       Paced replays digest the same as the unpaced one, and take as long
+       on the real clock as their share of the virtual time: a tenth of it
+       at 10x, a twentieth at 20x, and next to nothing at maximum speed.
+       Sleeps only ever run late, so the bounds are loose above and tight
+       below.
+     */
+    void TestSpeeds( const GitHubSample::EventRecording& recording )
+    {
+        const Run fastest = Replay( recording, GitHubSample::EventReplay::kMaximumSpeed );
+        const Run tenTimes = Replay( recording, 10 );
+        const Run twentyTimes = Replay( recording, 20 );
+
+        CHECK( tenTimes.digest == fastest.digest );
+        CHECK( twentyTimes.digest == fastest.digest );
+
+        const double session = static_cast<double>( fastest.virtualEnd - SESSION_START );
+        printf( "%.0f ms of typing, %lu events: %.1f ms at maximum speed, %.1f ms at 10x, %.1f ms at 20x\n",
+                session / 1e6, static_cast<unsigned long>( recording.Count() ), fastest.wallNanoseconds / 1e6,
+                tenTimes.wallNanoseconds / 1e6, twentyTimes.wallNanoseconds / 1e6 );
+
+        CHECK( tenTimes.wallNanoseconds >= session / 10 * 0.99 );
+        CHECK( tenTimes.wallNanoseconds < session / 10 * 1.5 + 20 * MILLISECOND );
+        CHECK( twentyTimes.wallNanoseconds >= session / 20 * 0.99 );
+        CHECK( twentyTimes.wallNanoseconds < session / 20 * 1.5 + 20 * MILLISECOND );
+
+        const double ratio = static_cast<double>( tenTimes.wallNanoseconds ) / twentyTimes.wallNanoseconds;
+        CHECK( ratio > 1.5 && ratio < 2.5 );
+        CHECK( fastest.wallNanoseconds < twentyTimes.wallNanoseconds / 4 );
+    }
+}
+
+
+
+int main( int, char** argv )
+{
+    // next to the test program, so that nothing outside the build directory is touched
+    const std::string path = std::string( argv[0] ) + ".kevr";
+
+    GitHubSample::EventRecording recording;
+    MakeRecording( recording );
+
+    TestSameDigestEveryRun( recording );
+    TestSaveAndLoad( recording, path );
+    TestSpeeds( recording );
+
+    remove( path.c_str() );
+
+    return GitHubSample::Test::Finish( "EventReplayTest" );
+}
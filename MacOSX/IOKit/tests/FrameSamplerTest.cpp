@@ -0,0 +1,420 @@
+
+
+#include "TestCheck.h"
+
+#include "AtomicOps.h"
+#include "FrameSampler.h"
+
+#include <boost/bind.hpp>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <vector>
+
+
+
+namespace
+{
+    const uint16_t USAGE_PAGE_KEYBOARD_OR_KEYPAD = 0x07;
+    const uint16_t USAGE_PAGE_CONSUMER = 0x0C;
+    const uint16_t USAGE_A = 0x04;
+
+    const uint64_t NO_DEADLINE = ~static_cast<uint64_t>( 0 );
+
+    /// the threaded test: a small ring, so that it fills and wraps all the time
+    const size_t STREAM_EVENTS = 200000;
+    const size_t RING_CAPACITY = 256;
+    const unsigned int LARGEST_CHUNK = 64;
+    const unsigned int LARGEST_FRAME_STEP = 200;
+
+    unsigned int Random( uint32_t& seed, const unsigned int range )
+    {
+        seed = seed * 1103515245u + 12345u;
+        return ( seed >> 16 ) % range;
+    }
+
+
+    GitHubSample::KeyEvent Key( const uint16_t usage, const bool pressed, const uint64_t timestamp )
+    {
+        GitHubSample::KeyEvent event;
+        memset( &event, 0, sizeof(event) );
+        event.timestamp = timestamp;
+        event.usagePage = USAGE_PAGE_KEYBOARD_OR_KEYPAD;
+        event.usage = usage;
+        event.value = pressed ? 1 : 0;
+        return event;
+    }
+
+
+    bool SameBitmap( const GitHubSample::KeyStateBitmap& a, const GitHubSample::KeyStateBitmap& b )
+    {
+        return memcmp( a.words, b.words, sizeof(a.words) ) == 0;
+    }
+
+
+    /// the sample's events in order: spans[0], then spans[1]
+    const GitHubSample::KeyEvent& SampleEvent( const GitHubSample::FrameSample& sample, const size_t i )
+    {
+        return ( i < sample.spans[0].count ) ? sample.spans[0].events[ i ] : sample.spans[1].events[ i - sample.spans[0].count ];
+    }
+
+
+    /// A source for Produce: hands out the next events of 'stream', at most 'limit' of them per call.
+    struct StreamSource
+    {
+        const std::vector< GitHubSample::KeyEvent >* stream;
+        size_t next;
+        size_t limit;
+
+        size_t Read( GitHubSample::KeyEvent* events, const size_t capacity )
+        {
+            size_t count = ( capacity < limit ) ? capacity : limit;
+            count = ( count < stream->size() - next ) ? count : stream->size() - next;
+            memcpy( events, &( *stream )[ next ], count * sizeof(GitHubSample::KeyEvent) );
+            next += count;
+            return count;
+        }
+    };
+
+
+    void TestWraparound()
+    {
+        GitHubSample::FrameSampler sampler( 8 );
+        CHECK( sampler.Capacity() == 8 );
+
+        GitHubSample::KeyEvent events[ 8 ];
+        for ( size_t i = 0; i < 8; i++ )
+        {
+            events[i] = Key( static_cast<uint16_t>( USAGE_A + i ), true, 100 + i );
+        }
+
+        CHECK( sampler.Publish( events, 6 ) == 6 );
+        const GitHubSample::FrameSample& first = sampler.SampleFrame( NO_DEADLINE );
+        CHECK( first.eventCount == 6 && first.spans[0].count == 6 && first.spans[1].count == 0 );
+
+        // the six stay the frame's until the next one, which releases them
+        CHECK( sampler.SampleFrame( NO_DEADLINE ).eventCount == 0 );
+
+        // slots 6 and 7, then 0 .. 2
+        CHECK( sampler.Publish( events + 1, 5 ) == 5 );
+        const GitHubSample::FrameSample& second = sampler.SampleFrame( NO_DEADLINE );
+        CHECK( second.eventCount == 5 );
+        CHECK( second.spans[0].count == 2 && second.spans[1].count == 3 );
+        for ( size_t i = 0; i < 5; i++ )
+        {
+            CHECK( SampleEvent( second, i ).usage == USAGE_A + 1 + i );
+        }
+        CHECK( second.spans[1].events + 3 <= second.spans[0].events );
+    }
+
+
+    void TestFullRing()
+    {
+        GitHubSample::FrameSampler sampler( 8 );
+        GitHubSample::KeyEvent events[ 10 ];
+        for ( size_t i = 0; i < 10; i++ )
+        {
+            events[i] = Key( USAGE_A, ( i % 2 ) == 0, i );
+        }
+
+        CHECK( sampler.Publish( events, 10 ) == 8 );
+        const GitHubSample::FrameSample& full = sampler.SampleFrame( NO_DEADLINE );
+        CHECK( full.eventCount == 8 );
+        CHECK( full.droppedEvents == 2 );
+
+        // the frame's events are still in use: no room until the next SampleFrame
+        CHECK( sampler.Publish( events, 1 ) == 0 );
+        const std::vector< GitHubSample::KeyEvent > none;
+        StreamSource nothing = { &none, 0, 100 };
+        CHECK( sampler.Produce( boost::bind( &StreamSource::Read, &nothing, _1, _2 ) ) == 0 );
+
+        const GitHubSample::FrameSample& empty = sampler.SampleFrame( NO_DEADLINE );
+        CHECK( empty.eventCount == 0 );
+        CHECK( empty.droppedEvents == 1 );
+        CHECK( sampler.Publish( events, 8 ) == 8 );
+        CHECK( sampler.SampleFrame( NO_DEADLINE ).droppedEvents == 0 );
+
+        // Produce never drops: what does not fit stays in the source, for after the next frame
+        std::vector< GitHubSample::KeyEvent > stream( events, events + 10 );
+        StreamSource source = { &stream, 0, 100 };
+        const GitHubSample::EventSourceFunctor functor = boost::bind( &StreamSource::Read, &source, _1, _2 );
+        CHECK( sampler.Produce( functor ) == 0 );
+        CHECK( sampler.SampleFrame( NO_DEADLINE ).eventCount == 0 );
+        CHECK( sampler.Produce( functor ) == 8 );
+        CHECK( source.next == 8 );
+        const GitHubSample::FrameSample& produced = sampler.SampleFrame( NO_DEADLINE );
+        CHECK( produced.eventCount == 8 && produced.droppedEvents == 0 );
+        CHECK( sampler.SampleFrame( NO_DEADLINE ).eventCount == 0 );
+        CHECK( sampler.Produce( functor ) == 2 );
+        CHECK( source.next == 10 );
+    }
+
+
+    void TestDeadline()
+    {
+        GitHubSample::FrameSampler sampler( 16 );
+        GitHubSample::KeyEvent events[ 3 ];
+        events[0] = Key( USAGE_A, true, 10 );
+        events[1] = Key( USAGE_A, false, 20 );
+        events[2] = Key( USAGE_A + 1, true, 30 );
+        sampler.Publish( events, 3 );
+
+        // the event AT the deadline is the next frame's
+        const GitHubSample::FrameSample& first = sampler.SampleFrame( 20 );
+        CHECK( first.eventCount == 1 );
+        CHECK( first.end.IsPressed( USAGE_A ) );
+        CHECK( sampler.PendingCount() == 2 );
+
+        const GitHubSample::FrameSample& second = sampler.SampleFrame( 31 );
+        CHECK( second.eventCount == 2 );
+        CHECK( SampleEvent( second, 0 ).timestamp == 20 );
+        CHECK( second.begin.IsPressed( USAGE_A ) );
+        CHECK( ! second.end.IsPressed( USAGE_A ) && second.end.IsPressed( USAGE_A + 1 ) );
+        CHECK( second.released.IsPressed( USAGE_A ) && second.pressed.IsPressed( USAGE_A + 1 ) );
+        CHECK( sampler.PendingCount() == 0 );
+    }
+
+
+    struct Shared
+    {
+        GitHubSample::FrameSampler* sampler;
+        const std::vector< GitHubSample::KeyEvent >* stream;
+        volatile uint32_t producerDone;
+    };
+
+
+    /**
+       Takes the stream in pieces, now through Produce (which never
+       drops) and now through Publish (which drops what does not fit, and
+       the producer moves on past it).  Gives way when the ring is full.
+     */
+    void* RunProducer( void* argument )
+    {
+        Shared& shared = *static_cast< Shared* >( argument );
+        const std::vector< GitHubSample::KeyEvent >& stream = *shared.stream;
+        uint32_t seed = 41;
+
+        StreamSource source = { &stream, 0, 0 };
+        const GitHubSample::EventSourceFunctor functor = boost::bind( &StreamSource::Read, &source, _1, _2 );
+
+        while ( source.next < stream.size() )
+        {
+            const size_t chunk = 1 + Random( seed, LARGEST_CHUNK );
+            bool full = false;
+            if ( Random( seed, 2 ) == 0 )
+            {
+                source.limit = chunk;
+                full = ( shared.sampler->Produce( functor ) == 0 );
+            }
+            else
+            {
+                const size_t count = ( chunk < stream.size() - source.next ) ? chunk : stream.size() - source.next;
+                full = ( shared.sampler->Publish( &stream[ source.next ], count ) < count );
+                source.next += count;
+            }
+
+            if ( full )
+            {
+                sched_yield();
+            }
+        }
+
+        GitHubSample::StoreRelease( &shared.producerDone, 1u );
+        return 0;
+    }
+
+
+    struct Frame
+    {
+        uint64_t deadline;
+        size_t firstEvent;
+        size_t eventCount;
+        uint32_t droppedEvents;
+        GitHubSample::KeyStateBitmap begin;
+        GitHubSample::KeyStateBitmap end;
+        GitHubSample::KeyStateBitmap pressed;
+        GitHubSample::KeyStateBitmap released;
+    };
+
+
+    /**
+       The render thread: a frame's deadline is a random step past the
+       last event it was given, so that the newest events are often held
+       back, and frames start anywhere in the ring.  Now and then it pauses
+       before it reads the events (the producer must not touch them).
+       Everything is written down, and checked once both threads are done.
+     */
+    void Consume( Shared& shared, std::vector< Frame >& frames, std::vector< GitHubSample::KeyEvent >& delivered, size_t& wrappedFrames )
+    {
+        uint32_t seed = 43;
+
+        for ( ;; )
+        {
+            const bool producerDone = GitHubSample::LoadAcquire( &shared.producerDone ) != 0;
+            const uint64_t next = delivered.empty() ? 0 : delivered.back().timestamp + 1;
+
+            const GitHubSample::FrameSample& sample = shared.sampler->SampleFrame( next + Random( seed, LARGEST_FRAME_STEP ) );
+            if ( Random( seed, 8 ) == 0 )
+            {
+                sched_yield();
+            }
+
+            Frame frame;
+            frame.deadline = sample.deadline;
+            frame.firstEvent = delivered.size();
+            frame.eventCount = sample.eventCount;
+            frame.droppedEvents = sample.droppedEvents;
+            frame.begin = sample.begin;
+            frame.end = sample.end;
+            frame.pressed = sample.pressed;
+            frame.released = sample.released;
+            frames.push_back( frame );
+
+            CHECK( sample.spans[0].count + sample.spans[1].count == sample.eventCount );
+            wrappedFrames += ( sample.spans[1].count != 0 ) ? 1 : 0;
+            for ( size_t i = 0; i < sample.eventCount; i++ )
+            {
+                delivered.push_back( SampleEvent( sample, i ) );
+            }
+
+            // everything was published before this frame, and no frame has to take any of it
+            if ( producerDone && shared.sampler->PendingCount() == 0 )
+            {
+                break;
+            }
+        }
+    }
+
+
+    /**
+       The stream's timestamps are its indices, so a gap in what was
+       delivered is exactly what Publish dropped.  The bitmaps are
+       replayed with a plain array of 256 flags.
+     */
+    void CheckFrames( const std::vector< Frame >& frames, const std::vector< GitHubSample::KeyEvent >& delivered )
+    {
+        size_t dropped = 0;
+        for ( size_t i = 0; i < frames.size(); i++ )
+        {
+            dropped += frames[i].droppedEvents;
+        }
+
+        size_t gaps = delivered.empty() ? 0 : static_cast<size_t>( delivered[0].timestamp );
+        bool ordered = true;
+        for ( size_t i = 1; i < delivered.size(); i++ )
+        {
+            ordered = ordered && delivered[i].timestamp > delivered[ i - 1 ].timestamp;
+            gaps += static_cast<size_t>( delivered[i].timestamp - delivered[ i - 1 ].timestamp - 1 );
+        }
+        if ( ! delivered.empty() )
+        {
+            gaps += STREAM_EVENTS - 1 - static_cast<size_t>( delivered.back().timestamp );
+        }
+        CHECK( ordered );
+        CHECK( delivered.size() + dropped == STREAM_EVENTS );
+        CHECK( gaps == dropped );
+
+        bool down[ 256 ];
+        memset( down, 0, sizeof(down) );
+        bool bitmapsAgree = true;
+        bool beforeDeadline = true;
+
+        for ( size_t f = 0; f < frames.size(); f++ )
+        {
+            const Frame& frame = frames[f];
+            GitHubSample::KeyStateBitmap begin, end, pressed, released;
+            memset( &begin, 0, sizeof(begin) );
+            memset( &end, 0, sizeof(end) );
+            memset( &pressed, 0, sizeof(pressed) );
+            memset( &released, 0, sizeof(released) );
+            for ( unsigned int usage = 0; usage < 256; usage++ )
+            {
+                begin.Set( usage, down[ usage ] );
+            }
+
+            for ( size_t i = frame.firstEvent; i < frame.firstEvent + frame.eventCount; i++ )
+            {
+                const GitHubSample::KeyEvent& event = delivered[i];
+                beforeDeadline = beforeDeadline && event.timestamp < frame.deadline;
+                if ( event.usagePage == USAGE_PAGE_KEYBOARD_OR_KEYPAD && event.usage < 256 )
+                {
+                    down[ event.usage ] = ( event.value != 0 );
+                    ( event.value != 0 ? pressed : released ).Set( event.usage, true );
+                }
+            }
+
+            for ( unsigned int usage = 0; usage < 256; usage++ )
+            {
+                end.Set( usage, down[ usage ] );
+            }
+
+            bitmapsAgree = bitmapsAgree && SameBitmap( begin, frame.begin ) && SameBitmap( end, frame.end )
+                && SameBitmap( pressed, frame.pressed ) && SameBitmap( released, frame.released );
+        }
+
+        CHECK( beforeDeadline );
+        CHECK( bitmapsAgree );
+    }
+
+
+    void TestProducerAgainstConsumer()
+    {
+        // keys, mostly; a consumer-page event and a keyboard usage above 0xFF now and then, which no bitmap shows
+        std::vector< GitHubSample::KeyEvent > stream( STREAM_EVENTS );
+        uint32_t seed = 47;
+        for ( size_t i = 0; i < STREAM_EVENTS; i++ )
+        {
+            stream[i] = Key( static_cast<uint16_t>( USAGE_A + Random( seed, 40 ) ), Random( seed, 2 ) == 0, i );
+            const unsigned int odd = Random( seed, 50 );
+            if ( odd == 0 )
+            {
+                stream[i].usagePage = USAGE_PAGE_CONSUMER;
+            }
+            else if ( odd == 1 )
+            {
+                stream[i].usage = static_cast<uint16_t>( 0x100 + stream[i].usage );
+            }
+        }
+
+        GitHubSample::FrameSampler sampler( RING_CAPACITY );
+        Shared shared = { &sampler, &stream, 0 };
+
+        std::vector< Frame > frames;
+        std::vector< GitHubSample::KeyEvent > delivered;
+        delivered.reserve( STREAM_EVENTS );
+        size_t wrappedFrames = 0;
+
+        pthread_t producer;
+        CHECK( pthread_create( &producer, 0, &RunProducer, &shared ) == 0 );
+        Consume( shared, frames, delivered, wrappedFrames );
+        pthread_join( producer, 0 );
+
+        size_t dropped = 0;
+        size_t droppingFrames = 0;
+        for ( size_t i = 0; i < frames.size(); i++ )
+        {
+            dropped += frames[i].droppedEvents;
+            droppingFrames += ( frames[i].droppedEvents != 0 ) ? 1 : 0;
+        }
+        printf( "%lu frames, %lu of them wrapped, %lu events delivered, %lu dropped (reported in %lu frames)\n",
+                static_cast<unsigned long>( frames.size() ), static_cast<unsigned long>( wrappedFrames ),
+                static_cast<unsigned long>( delivered.size() ), static_cast<unsigned long>( dropped ),
+                static_cast<unsigned long>( droppingFrames ) );
+
+        CheckFrames( frames, delivered );
+        CHECK( wrappedFrames > 0 );
+        CHECK( ! delivered.empty() );
+    }
+}
+
+
+
+int main()
+{
+    TestWraparound();
+    TestFullRing();
+    TestDeadline();
+    TestProducerAgainstConsumer();
+
+    return GitHubSample::Test::Finish( "FrameSamplerTest" );
+}
@@ -0,0 +1,123 @@
+
+
+#include "TestCheck.h"
+
+#include "InputProfile.h"
+
+#include <string.h>
+#include <vector>
+
+
+
+namespace
+{
+    const uint16_t USAGE_PAGE_KEYBOARD_OR_KEYPAD = 0x07;
+    const uint16_t USAGE_PAGE_CONSUMER = 0x0C;
+    const uint16_t USAGE_A = 0x04;
+    const uint16_t USAGE_B = 0x05;
+    const uint16_t USAGE_C = 0x06;
+    const uint16_t USAGE_CAPS_LOCK = 0x39;
+    const uint16_t USAGE_LEFT_CONTROL = 0xE0;
+
+
+    GitHubSample::KeyEvent Key( const uint16_t usage, const bool pressed, const uint16_t usagePage = USAGE_PAGE_KEYBOARD_OR_KEYPAD )
+    {
+        GitHubSample::KeyEvent event;
+        memset( &event, 0, sizeof(event) );
+        event.usagePage = usagePage;
+        event.usage = usage;
+        event.value = pressed ? 1 : 0;
+        return event;
+    }
+
+    /// one event through 'profile'.  returns the usage it went out as, or zero when it was dropped.
+    uint16_t ApplyOne( const GitHubSample::InputProfile& profile, GitHubSample::InputProfile::PressedKeys& pressedKeys,
+                       const uint16_t usage, const bool pressed )
+    {
+        GitHubSample::KeyEvent event = Key( usage, pressed );
+        return ( profile.Apply( &event, 1, pressedKeys ) == 1 ) ? event.usage : 0;
+    }
+
+
+    /// "ctrl:nocaps": caps lock is a second left control, and C is not delivered at all
+    GitHubSample::InputProfile MakeEditorProfile()
+    {
+        GitHubSample::InputProfile::Definition definition;
+        definition.name = "editor";
+
+        GitHubSample::InputProfile::Remap remap = { USAGE_CAPS_LOCK, USAGE_LEFT_CONTROL };
+        definition.remaps.push_back( remap );
+        GitHubSample::InputProfile::Remap swap = { USAGE_A, USAGE_B };
+        definition.remaps.push_back( swap );
+        definition.masks.delivered.Set( USAGE_C, false );
+
+        GitHubSample::InputProfile profile;
+        CHECK( profile.Compile( definition ) );
+        return profile;
+    }
+
+
+    void TestRemapAndMask()
+    {
+        const GitHubSample::InputProfile editor = MakeEditorProfile();
+        GitHubSample::InputProfile::PressedKeys pressedKeys;
+
+        std::vector< GitHubSample::KeyEvent > events;
+        events.push_back( Key( USAGE_CAPS_LOCK, true ) );
+        events.push_back( Key( USAGE_C, true ) );
+        events.push_back( Key( 0xE9, true, USAGE_PAGE_CONSUMER ) );
+        events.push_back( Key( USAGE_C, false ) );
+        events.push_back( Key( USAGE_CAPS_LOCK, false ) );
+
+        const size_t kept = editor.Apply( &events[0], events.size(), pressedKeys );
+
+        CHECK( kept == 3 );
+        CHECK( events[0].usage == USAGE_LEFT_CONTROL && events[0].value == 1 );
+        CHECK( events[1].usagePage == USAGE_PAGE_CONSUMER && events[1].usage == 0xE9 );
+        CHECK( events[2].usage == USAGE_LEFT_CONTROL && events[2].value == 0 );
+    }
+
+
+    /// the profile switches while keys are down: every release must match its press
+    void TestSwitchWhileDown()
+    {
+        const GitHubSample::InputProfile editor = MakeEditorProfile();
+        const GitHubSample::InputProfile plain;
+        GitHubSample::InputProfile::PressedKeys pressedKeys;
+
+        // pressed as B under the editor profile, released under the plain one: the release is B, not A
+        CHECK( ApplyOne( editor, pressedKeys, USAGE_A, true ) == USAGE_B );
+        CHECK( ApplyOne( plain, pressedKeys, USAGE_A, false ) == USAGE_B );
+
+        // and after that A is A again
+        CHECK( ApplyOne( plain, pressedKeys, USAGE_A, true ) == USAGE_A );
+        CHECK( ApplyOne( editor, pressedKeys, USAGE_A, false ) == USAGE_A );
+
+        // a press that was dropped has its release dropped too, though the new profile delivers C
+        CHECK( ApplyOne( editor, pressedKeys, USAGE_C, true ) == 0 );
+        CHECK( ApplyOne( plain, pressedKeys, USAGE_C, false ) == 0 );
+
+        // a press that was delivered has its release delivered, though the new profile drops C
+        CHECK( ApplyOne( plain, pressedKeys, USAGE_C, true ) == USAGE_C );
+        CHECK( ApplyOne( editor, pressedKeys, USAGE_C, false ) == USAGE_C );
+
+        // a key that was down before the stream started: its release follows the profile
+        CHECK( ApplyOne( editor, pressedKeys, USAGE_CAPS_LOCK, false ) == USAGE_LEFT_CONTROL );
+        CHECK( ApplyOne( editor, pressedKeys, USAGE_C, false ) == 0 );
+
+        for ( size_t usage = 0; usage < GitHubSample::InputProfile::kUsageCount; usage++ )
+        {
+            CHECK( pressedKeys.deliveredAs[ usage ] == GitHubSample::InputProfile::PressedKeys::kNotPressed );
+        }
+    }
+}
+
+
+
+int main()
+{
+    TestRemapAndMask();
+    TestSwitchWhileDown();
+
+    return GitHubSample::Test::Finish( "InputProfileTest" );
+}
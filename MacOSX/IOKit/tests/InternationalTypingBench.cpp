@@ -0,0 +1,313 @@
+
+
+#include "TestCheck.h"
+
+#include "ComposeTable.h"
+#include "EventReplay.h"
+#include "KeyboardLayout.h"
+#include "LittleEndian.h"
+#include "TextReconstructionStage.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+
+
+namespace
+{
+    const uint16_t USAGE_PAGE_KEYBOARD_OR_KEYPAD = 0x07;
+
+    const uint16_t USAGE_A          = 0x04;
+    const uint16_t USAGE_6          = 0x23;
+    const uint16_t USAGE_RETURN     = 0x28;
+    const uint16_t USAGE_BACKSPACE  = 0x2A;
+    const uint16_t USAGE_SPACE      = 0x2C;
+    const uint16_t USAGE_QUOTE      = 0x34;
+    const uint16_t USAGE_GRAVE      = 0x35;
+    const uint16_t USAGE_COMPOSE    = 0x65; // the Application (menu) key
+    const uint16_t USAGE_LEFT_SHIFT = 0xE1;
+
+    const uint32_t DEAD_ACUTE      = GitHubSample::KeyboardLayout::kDeadKeyFlag | 0xB4;
+    const uint32_t DEAD_GRAVE      = GitHubSample::KeyboardLayout::kDeadKeyFlag | 0x60;
+    const uint32_t DEAD_CIRCUMFLEX = GitHubSample::KeyboardLayout::kDeadKeyFlag | 0x5E;
+    const uint32_t DEAD_DIAERESIS  = GitHubSample::KeyboardLayout::kDeadKeyFlag | 0xA8;
+
+    const char VOWELS[] = "aeiou";
+    /// the lower case precomposed vowels (Latin-1), per accent.  upper case is 0x20 below.
+    const uint32_t ACCENTED_VOWELS[ 4 ][ 5 ] =
+    {
+        { 0xE1, 0xE9, 0xED, 0xF3, 0xFA }, // acute
+        { 0xE0, 0xE8, 0xEC, 0xF2, 0xF9 }, // grave
+        { 0xE2, 0xEA, 0xEE, 0xF4, 0xFB }, // circumflex
+        { 0xE4, 0xEB, 0xEF, 0xF6, 0xFC }  // diaeresis
+    };
+    const uint32_t DEAD_KEYS[ 4 ] = { DEAD_ACUTE, DEAD_GRAVE, DEAD_CIRCUMFLEX, DEAD_DIAERESIS };
+
+    const uint64_t MILLISECOND = 1000000;
+    const size_t KEYSTROKES = 400000;
+
+
+    /// the built-in US layout with the dead keys of "US international" and a compose key
+    bool LoadInternationalLayout( GitHubSample::KeyboardLayout& layout )
+    {
+        layout.LoadBuiltInUSLayout();
+        std::vector< uint8_t > image = layout.SaveToMemory();
+
+        // see the byte layout above KeyboardLayout::ParseHeader
+        const size_t codePointsOffset = 288;
+        struct { unsigned int level; uint16_t usage; uint32_t symbol; } keys[] =
+        {
+            { GitHubSample::KeyboardLayout::kLevelBase,  USAGE_QUOTE,   DEAD_ACUTE },
+            { GitHubSample::KeyboardLayout::kLevelShift, USAGE_QUOTE,   DEAD_DIAERESIS },
+            { GitHubSample::KeyboardLayout::kLevelBase,  USAGE_GRAVE,   DEAD_GRAVE },
+            { GitHubSample::KeyboardLayout::kLevelShift, USAGE_6,       DEAD_CIRCUMFLEX },
+            { GitHubSample::KeyboardLayout::kLevelBase,  USAGE_COMPOSE, GitHubSample::KeyboardLayout::kMultiKey }
+        };
+
+        for ( size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++ )
+        {
+            const size_t index = keys[i].level * GitHubSample::KeyboardLayout::kUsageCount + keys[i].usage;
+            GitHubSample::WriteLittleEndian32( &image[ codePointsOffset + index * 4 ], keys[i].symbol );
+        }
+
+        return layout.LoadFromMemory( &image[0], image.size() );
+    }
+
+
+    /// Every accent on every vowel (and on space), plus 676 Multi_key pairs: about the size of a national Compose file.
+    bool CompileComposeTable( GitHubSample::ComposeTable& table )
+    {
+        std::vector< GitHubSample::ComposeTable::Sequence > sequences;
+        GitHubSample::ComposeTable::Sequence sequence;
+
+        for ( size_t accent = 0; accent < 4; accent++ )
+        {
+            for ( size_t vowel = 0; vowel < 5; vowel++ )
+            {
+                sequence.symbols.assign( 1, DEAD_KEYS[ accent ] );
+                sequence.symbols.push_back( static_cast<uint32_t>( VOWELS[ vowel ] ) );
+                sequence.result = ACCENTED_VOWELS[ accent ][ vowel ];
+                sequences.push_back( sequence );
+
+                sequence.symbols[1] -= 0x20;
+                sequence.result -= 0x20;
+                sequences.push_back( sequence );
+            }
+
+            sequence.symbols.assign( 1, DEAD_KEYS[ accent ] );
+            sequence.symbols.push_back( ' ' );
+            sequence.result = DEAD_KEYS[ accent ] & GitHubSample::KeyboardLayout::kCodePointMask;
+            sequences.push_back( sequence );
+        }
+
+        for ( uint32_t first = 0; first < 26; first++ )
+        {
+            for ( uint32_t second = 0; second < 26; second++ )
+            {
+                sequence.symbols.assign( 1, GitHubSample::KeyboardLayout::kMultiKey );
+                sequence.symbols.push_back( 'a' + first );
+                sequence.symbols.push_back( 'a' + second );
+                sequence.result = 0x0100 + first * 26 + second; // Latin Extended and on
+                sequences.push_back( sequence );
+            }
+        }
+
+        return table.Compile( sequences );
+    }
+
+
+    /// Types like a person: one key at a time, 60 ms down, 120 ms apart.
+    class Typist
+    {
+    public:
+
+        explicit Typist( GitHubSample::EventRecording& recording ) : m_recording( recording ), m_now( 0 ), m_seed( 12345 ) {}
+
+        unsigned int Random( const unsigned int range )
+        {
+            m_seed = m_seed * 1103515245u + 12345u;
+            return ( m_seed >> 16 ) % range;
+        }
+
+        void Tap( const uint16_t usage, const bool shifted = false )
+        {
+            if ( shifted )
+            {
+                Edge( USAGE_LEFT_SHIFT, 1 );
+            }
+            Edge( usage, 1 );
+            m_now += 60 * MILLISECOND;
+            Edge( usage, 0 );
+            if ( shifted )
+            {
+                Edge( USAGE_LEFT_SHIFT, 0 );
+            }
+            m_now += 60 * MILLISECOND;
+        }
+
+        void TapLetter( const char letter, const bool shifted = false )
+        {
+            Tap( static_cast<uint16_t>( USAGE_A + ( letter - 'a' ) ), shifted );
+        }
+
+        /// a French/German/Portuguese-ish mix: mostly letters, one accent every eight or so
+        void TypeSomething()
+        {
+            const unsigned int roll = Random( 100 );
+            if ( roll < 60 )
+            {
+                TapLetter( static_cast<char>( 'a' + Random( 26 ) ) );
+            }
+            else if ( roll < 75 )
+            {
+                Tap( USAGE_SPACE );
+            }
+            else if ( roll < 88 )
+            {
+                TapDeadKey( Random( 4 ) );
+                TapLetter( VOWELS[ Random( 5 ) ], Random( 8 ) == 0 );
+            }
+            else if ( roll < 92 )
+            {
+                TapLetter( static_cast<char>( 'a' + Random( 26 ) ), true );
+            }
+            else if ( roll < 95 )
+            {
+                Tap( USAGE_COMPOSE );
+                TapLetter( static_cast<char>( 'a' + Random( 26 ) ) );
+                TapLetter( static_cast<char>( 'a' + Random( 26 ) ) );
+            }
+            else if ( roll < 97 )
+            {
+                TapDeadKey( Random( 4 ) );
+                TapLetter( 'x' ); // does not combine: both come out
+            }
+            else
+            {
+                Tap( Random( 2 ) ? USAGE_RETURN : USAGE_BACKSPACE );
+            }
+        }
+
+        void TapDeadKey( const unsigned int accent )
+        {
+            switch ( accent )
+            {
+            case 0:  Tap( USAGE_QUOTE );        break;
+            case 1:  Tap( USAGE_GRAVE );        break;
+            case 2:  Tap( USAGE_6, true );      break;
+            default: Tap( USAGE_QUOTE, true );  break;
+            }
+        }
+
+    private:
+
+        GitHubSample::EventRecording& m_recording;
+        uint64_t m_now;
+        uint32_t m_seed;
+
+        void Edge( const uint16_t usage, const int32_t value )
+        {
+            GitHubSample::KeyEvent event;
+            memset( &event, 0, sizeof(event) );
+            event.timestamp = m_now;
+            event.usagePage = USAGE_PAGE_KEYBOARD_OR_KEYPAD;
+            event.usage = usage;
+            event.value = value;
+            m_recording.Append( &event, 1, m_now );
+        }
+    };
+
+
+    /// Feeds 'count' events to the stage, appending to 'text'.
+    void Reconstruct( GitHubSample::TextReconstructionStage& stage, const GitHubSample::KeyEvent* events, size_t count, std::string& text )
+    {
+        char buffer[ 4096 ];
+        while ( count > 0 )
+        {
+            size_t bytes = 0;
+            const size_t consumed = stage.Process( events, count, buffer, sizeof(buffer), &bytes );
+            text.append( buffer, bytes );
+            events += consumed;
+            count -= consumed;
+        }
+    }
+}
+
+
+
+int main()
+{
+    GitHubSample::KeyboardLayout layout;
+    GitHubSample::ComposeTable compose;
+    if ( ! CHECK( LoadInternationalLayout( layout ) ) || ! CHECK( CompileComposeTable( compose ) ) )
+    {
+        return GitHubSample::Test::Finish( "InternationalTypingBench" );
+    }
+
+    GitHubSample::EventRecording recording;
+    Typist typist( recording );
+    typist.TapDeadKey( 0 );
+    typist.TapLetter( 'e' );
+    for ( size_t i = 0; i < KEYSTROKES; i++ )
+    {
+        typist.TypeSomething();
+    }
+
+    std::vector< GitHubSample::KeyEvent > events( recording.Count() );
+    for ( size_t i = 0; i < recording.Count(); i++ )
+    {
+        events[i] = recording.At( i ).event;
+    }
+
+    // straight from memory: the stage alone
+    GitHubSample::TextReconstructionStage direct( layout );
+    direct.SetComposeTable( &compose );
+    std::string directText;
+    directText.reserve( events.size() );
+
+    const uint64_t directStart = GitHubSample::Test::Nanoseconds();
+    Reconstruct( direct, &events[0], events.size(), directText );
+    const uint64_t directNanoseconds = GitHubSample::Test::Nanoseconds() - directStart;
+
+    // replayed as it was typed (at maximum speed), one reader-sized read at a time
+    GitHubSample::TextReconstructionStage replayed( layout );
+    replayed.SetComposeTable( &compose );
+    std::string replayText;
+    replayText.reserve( events.size() );
+
+    GitHubSample::VirtualClock clock;
+    GitHubSample::EventReplay replay( recording, clock );
+    GitHubSample::KeyEvent batch[ 64 ];
+
+    const uint64_t replayStart = GitHubSample::Test::Nanoseconds();
+    while ( replay.Advance() )
+    {
+        Reconstruct( replayed, batch, replay.ReadEvents( batch, 64 ), replayText );
+    }
+    const uint64_t replayNanoseconds = GitHubSample::Test::Nanoseconds() - replayStart;
+
+    CHECK( directText == replayText );
+    CHECK( directText.compare( 0, 2, "\xC3\xA9" ) == 0 ); // the first thing typed was an e acute
+    CHECK( ! direct.ComposePending() );
+
+    size_t characters = 0;
+    size_t nonAscii = 0;
+    for ( size_t i = 0; i < directText.size(); i++ )
+    {
+        const uint8_t byte = static_cast<uint8_t>( directText[i] );
+        characters += ( ( byte & 0xC0 ) != 0x80 );
+        nonAscii += ( byte >= 0xC0 );
+    }
+
+    printf( "%lu keystrokes, %lu events, %lu characters (%lu not ASCII), %lu bytes of UTF-8\n",
+            static_cast<unsigned long>( KEYSTROKES ), static_cast<unsigned long>( events.size() ),
+            static_cast<unsigned long>( characters ), static_cast<unsigned long>( nonAscii ),
+            static_cast<unsigned long>( directText.size() ) );
+    printf( "stage alone:     %7.1f M events/s  (%.1f ns per event)\n",
+            events.size() * 1e3 / directNanoseconds, static_cast<double>( directNanoseconds ) / events.size() );
+    printf( "through replay:  %7.1f M events/s  (%.1f ns per event)\n",
+            events.size() * 1e3 / replayNanoseconds, static_cast<double>( replayNanoseconds ) / events.size() );
+
+    return GitHubSample::Test::Finish( "InternationalTypingBench" );
+}
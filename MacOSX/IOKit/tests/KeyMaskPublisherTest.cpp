@@ -0,0 +1,225 @@
+
+
+#include "TestCheck.h"
+
+#include "AtomicOps.h"
+#include "KeyMaskPublisher.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+
+
+namespace
+{
+    const uint64_t PUBLISHES = 1 << 21;
+    const size_t READERS = 4;
+
+    /// KeyMaskPublisher's kSlotCount: a reader away for this many publishes has seen every slot rewritten
+    const uint64_t SLOT_COUNT = 8;
+
+    /// the sleepy reader naps this often (in reads) for this long, while the publisher laps the slots
+    const uint64_t READS_BETWEEN_NAPS = 1024;
+    const useconds_t NAP_MICROSECONDS = 100;
+
+
+    /// every word different, and different in every generation, so a mask made of two publishes cannot pass for one
+    uint32_t PatternWord( const uint64_t generation, const unsigned int word )
+    {
+        uint32_t hash = static_cast<uint32_t>( generation ) * 2654435761u + word * 0x9E3779B9u;
+        hash ^= hash >> 15;
+        hash *= 0x85EBCA6Bu;
+        return hash ^ ( hash >> 13 ) ^ static_cast<uint32_t>( generation >> 32 );
+    }
+
+
+    void MakeMasks( const uint64_t generation, GitHubSample::KeyInterestMasks& masks )
+    {
+        for ( unsigned int word = 0; word < GitHubSample::KeyStateBitmap::kWordCount; word++ )
+        {
+            masks.delivered.words[ word ] = PatternWord( generation, word );
+            masks.counted.words[ word ] = PatternWord( generation, word + GitHubSample::KeyStateBitmap::kWordCount );
+        }
+    }
+
+
+    bool MatchesGeneration( const GitHubSample::KeyInterestMasks& masks, const uint64_t generation )
+    {
+        GitHubSample::KeyInterestMasks expected;
+        MakeMasks( generation, expected );
+        for ( unsigned int word = 0; word < GitHubSample::KeyStateBitmap::kWordCount; word++ )
+        {
+            if ( masks.delivered.words[ word ] != expected.delivered.words[ word ]
+                 || masks.counted.words[ word ] != expected.counted.words[ word ] )
+            {
+                return false; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+            }
+        }
+        return true;
+    }
+
+
+    struct Shared
+    {
+        GitHubSample::KeyMaskPublisher* publisher;
+        volatile uint32_t done;
+    };
+
+
+    /// What one reader saw.  The readers do not CHECK themselves: the failure count is not thread-safe.
+    struct ReaderResult
+    {
+        Shared* shared;
+        bool sleepy;
+
+        uint64_t reads;
+        uint64_t tornMasks;
+        uint64_t generationsBackwards;
+        uint64_t largestJump;
+        uint64_t lastGeneration;
+    };
+
+
+    void* RunPublisher( void* argument )
+    {
+        Shared& shared = *static_cast< Shared* >( argument );
+
+        GitHubSample::KeyInterestMasks masks;
+        for ( uint64_t generation = 1; generation <= PUBLISHES; generation++ )
+        {
+            MakeMasks( generation, masks );
+            shared.publisher->Publish( masks );
+        }
+
+        GitHubSample::StoreRelease( &shared.done, 1u );
+        return 0;
+    }
+
+
+    void* RunReader( void* argument )
+    {
+        ReaderResult& result = *static_cast< ReaderResult* >( argument );
+
+        GitHubSample::KeyInterestMasks masks;
+        uint64_t generation = 0;
+        bool finished = false;
+
+        // one more read after the publisher is done, so every reader ends on the last generation
+        while ( ! finished )
+        {
+            finished = GitHubSample::LoadAcquire( &result.shared->done ) != 0;
+
+            result.shared->publisher->Read( masks, &generation );
+            result.reads++;
+
+            result.tornMasks += MatchesGeneration( masks, generation ) ? 0 : 1;
+            if ( generation < result.lastGeneration )
+            {
+                result.generationsBackwards++;
+            }
+            else if ( generation - result.lastGeneration > result.largestJump )
+            {
+                result.largestJump = generation - result.lastGeneration;
+            }
+            result.lastGeneration = generation;
+
+            if ( result.sleepy && result.reads % READS_BETWEEN_NAPS == 0 )
+            {
+                usleep( NAP_MICROSECONDS );
+            }
+        }
+
+        return 0;
+    }
+
+
+    void TestSingleThread()
+    {
+        GitHubSample::KeyInterestMasks masks;
+        MakeMasks( 0, masks );
+        GitHubSample::KeyMaskPublisher publisher( masks );
+
+        uint64_t generation = 99;
+        GitHubSample::KeyInterestMasks read;
+        publisher.Read( read, &generation );
+        CHECK( generation == 0 );
+        CHECK( MatchesGeneration( read, 0 ) );
+
+        // round the ring twice and a bit: every slot reused
+        for ( uint64_t published = 1; published <= 2 * SLOT_COUNT + 3; published++ )
+        {
+            MakeMasks( published, masks );
+            publisher.Publish( masks );
+            publisher.Read( read, &generation );
+            CHECK( generation == published );
+            CHECK( MatchesGeneration( read, published ) );
+            CHECK( publisher.Generation() == published );
+        }
+    }
+
+
+    /**
+       One publisher and READERS readers.  Wherever there are fewer cores
+       than threads, readers are preempted in the middle of a copy while
+       the publisher runs on.  Every mask must be whole (the pattern of the
+       generation it came with), and no reader may see a generation go
+       back.  The sleepy reader is away for thousands of publishes at a
+       time, so it must see jumps of more than SLOT_COUNT: the whole ring
+       rewritten between two of its reads.
+     */
+    void TestConcurrentReaders()
+    {
+        GitHubSample::KeyInterestMasks masks;
+        MakeMasks( 0, masks );
+        GitHubSample::KeyMaskPublisher publisher( masks );
+
+        Shared shared = { &publisher, 0 };
+
+        ReaderResult results[ READERS ];
+        pthread_t readers[ READERS ];
+        for ( size_t i = 0; i < READERS; i++ )
+        {
+            ReaderResult result = { &shared, i == 0, 0, 0, 0, 0, 0 };
+            results[i] = result;
+            CHECK( pthread_create( &readers[i], 0, &RunReader, &results[i] ) == 0 );
+        }
+
+        pthread_t writer;
+        CHECK( pthread_create( &writer, 0, &RunPublisher, &shared ) == 0 );
+
+        pthread_join( writer, 0 );
+        for ( size_t i = 0; i < READERS; i++ )
+        {
+            pthread_join( readers[i], 0 );
+        }
+
+        for ( size_t i = 0; i < READERS; i++ )
+        {
+            printf( "%s reader: %9lu reads, largest jump %7lu generations\n", results[i].sleepy ? "sleepy" : "busy  ",
+                    static_cast<unsigned long>( results[i].reads ), static_cast<unsigned long>( results[i].largestJump ) );
+
+            CHECK( results[i].tornMasks == 0 );
+            CHECK( results[i].generationsBackwards == 0 );
+            CHECK( results[i].lastGeneration == PUBLISHES );
+            CHECK( results[i].reads > 1 );
+        }
+
+        CHECK( results[0].largestJump > SLOT_COUNT );
+
+        GitHubSample::KeyInterestMasks last;
+        uint64_t generation = 0;
+        publisher.Read( last, &generation );
+        CHECK( generation == PUBLISHES );
+        CHECK( MatchesGeneration( last, PUBLISHES ) );
+    }
+}
+
+
+
+int main()
+{
+    TestSingleThread();
+    TestConcurrentReaders();
+
+    return GitHubSample::Test::Finish( "KeyMaskPublisherTest" );
+}
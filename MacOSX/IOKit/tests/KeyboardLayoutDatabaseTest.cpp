@@ -0,0 +1,254 @@
+
+
+#include "TestCheck.h"
+
+#include "KeyboardLayoutDatabase.h"
+#include "LittleEndian.h"
+
+#include <boost/bind.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+
+
+namespace
+{
+    const uint16_t ANY = GitHubSample::KeyboardLayoutDatabase::kMatchAny;
+
+    const uint16_t COUNTRY_GERMAN = 9;
+    const uint16_t COUNTRY_US = 33;
+    const uint16_t VENDOR_APPLE = 0x05AC;
+    const uint16_t VENDOR_LOGITECH = 0x046D;
+    const uint16_t PRODUCT_ALUMINIUM = 0x0221;
+
+    const unsigned int USAGE_Y = 0x1C;
+    const unsigned int USAGE_Z = 0x1D;
+
+    /// where the layout image (see KeyboardLayout.cpp) keeps the name and the level 0 code points
+    const size_t LAYOUT_NAME_OFFSET = 16;
+    const size_t LAYOUT_CODE_POINT_OFFSET = 288;
+
+    size_t g_errorCount = 0;
+
+    void CountError( const std::string )
+    {
+        g_errorCount++;
+    }
+
+
+    /// the US layout with Y and Z swapped, under another name
+    void MakeGermanLayout( GitHubSample::KeyboardLayout& german )
+    {
+        GitHubSample::KeyboardLayout us;
+        us.LoadBuiltInUSLayout();
+        std::vector< uint8_t > image = us.SaveToMemory();
+
+        memset( &image[ LAYOUT_NAME_OFFSET ], 0, 16 );
+        memcpy( &image[ LAYOUT_NAME_OFFSET ], "German", 6 );
+        GitHubSample::WriteLittleEndian32( &image[ LAYOUT_CODE_POINT_OFFSET + 4 * USAGE_Y ], 'z' );
+        GitHubSample::WriteLittleEndian32( &image[ LAYOUT_CODE_POINT_OFFSET + 4 * USAGE_Z ], 'y' );
+
+        CHECK( german.LoadFromMemory( &image[0], image.size() ) );
+    }
+
+
+    GitHubSample::KeyboardLayoutDatabase::SelectionRule Rule( const uint16_t countryCode, const uint16_t vendorId,
+                                                              const uint16_t productId, const uint16_t layoutIndex )
+    {
+        GitHubSample::KeyboardLayoutDatabase::SelectionRule rule = { countryCode, vendorId, productId, layoutIndex };
+        return rule;
+    }
+
+
+    std::vector< uint8_t > ReadFile( const std::string& path )
+    {
+        std::vector< uint8_t > bytes;
+        FILE* file = fopen( path.c_str(), "rb" );
+        if ( file )
+        {
+            uint8_t buffer[ 4096 ];
+            size_t count = 0;
+            while ( ( count = fread( buffer, 1, sizeof(buffer), file ) ) > 0 )
+            {
+                bytes.insert( bytes.end(), buffer, buffer + count );
+            }
+            fclose( file );
+        }
+        return bytes;
+    }
+
+
+    void WriteFile( const std::string& path, const std::vector< uint8_t >& bytes )
+    {
+        FILE* file = fopen( path.c_str(), "wb" );
+        CHECK( file && fwrite( &bytes[0], 1, bytes.size(), file ) == bytes.size() );
+        if ( file )
+        {
+            fclose( file );
+        }
+    }
+
+
+    /**
+       Three layouts: US (the default), German, and US again for one Apple
+       keyboard that reports German but is not.  The rules are in the
+       reverse order of how specific they are, so the order in the file
+       cannot be what picks the winner.
+     */
+    void SaveDatabase( const std::string& path, const GitHubSample::KeyboardLayout& us, const GitHubSample::KeyboardLayout& german )
+    {
+        std::vector< const GitHubSample::KeyboardLayout* > layouts;
+        layouts.push_back( &us );
+        layouts.push_back( &german );
+        layouts.push_back( &us );
+
+        std::vector< GitHubSample::KeyboardLayoutDatabase::SelectionRule > rules;
+        rules.push_back( Rule( COUNTRY_GERMAN, ANY, ANY, 1 ) );
+        rules.push_back( Rule( ANY, VENDOR_LOGITECH, ANY, 1 ) );
+        rules.push_back( Rule( ANY, VENDOR_APPLE, PRODUCT_ALUMINIUM, 2 ) );
+        // names a layout that is not there: skipped (and logged) by Open
+        rules.push_back( Rule( COUNTRY_US, ANY, ANY, 7 ) );
+
+        CHECK( GitHubSample::KeyboardLayoutDatabase::Save( path, layouts, rules ) );
+    }
+
+
+    void TestRoundTripAndSelection( const std::string& path )
+    {
+        GitHubSample::KeyboardLayout us;
+        us.LoadBuiltInUSLayout();
+        GitHubSample::KeyboardLayout german;
+        MakeGermanLayout( german );
+        SaveDatabase( path, us, german );
+
+        GitHubSample::KeyboardLayoutDatabase database;
+        g_errorCount = 0;
+        CHECK( database.Open( path, boost::bind( &CountError, _1 ) ) );
+        CHECK( g_errorCount == 1 );
+        CHECK( database.LayoutCount() == 3 );
+
+        // every layout comes back byte for byte, attached to the mapping
+        CHECK( database.LayoutAt( 0 ).SaveToMemory() == us.SaveToMemory() );
+        CHECK( database.LayoutAt( 1 ).SaveToMemory() == german.SaveToMemory() );
+        CHECK( database.LayoutAt( 1 ).Name() == "German" );
+        CHECK( database.LayoutAt( 1 ).CodePoint( 0, USAGE_Y ) == 'z' );
+        CHECK( database.LayoutAt( 2 ).IsAttached() );
+
+        const GitHubSample::KeyboardLayout* const usLayout = &database.LayoutAt( 0 );
+        const GitHubSample::KeyboardLayout* const germanLayout = &database.LayoutAt( 1 );
+        const GitHubSample::KeyboardLayout* const appleLayout = &database.LayoutAt( 2 );
+
+        // nothing matches (the US rule was dropped): the first layout
+        CHECK( database.SelectLayout( COUNTRY_US, ANY, ANY ) == usLayout );
+        CHECK( database.SelectLayout( ANY, ANY, ANY ) == usLayout );
+
+        // country alone
+        CHECK( database.SelectLayout( COUNTRY_GERMAN, 0x1234, 0x0001 ) == germanLayout );
+
+        // vendor beats country
+        CHECK( database.SelectLayout( COUNTRY_US, VENDOR_LOGITECH, 0x0001 ) == germanLayout );
+
+        // product beats vendor and country: this Apple keyboard says German and gets US
+        CHECK( database.SelectLayout( COUNTRY_GERMAN, VENDOR_APPLE, PRODUCT_ALUMINIUM ) == appleLayout );
+        // another Apple product is only a German keyboard
+        CHECK( database.SelectLayout( COUNTRY_GERMAN, VENDOR_APPLE, 0x0222 ) == germanLayout );
+        // the product id means nothing under another vendor
+        CHECK( database.SelectLayout( COUNTRY_US, VENDOR_LOGITECH, PRODUCT_ALUMINIUM ) == germanLayout );
+    }
+
+
+    /// Open must refuse 'bytes' and leave the database empty
+    void CheckRejected( const std::string& path, const std::vector< uint8_t >& bytes )
+    {
+        WriteFile( path, bytes );
+
+        GitHubSample::KeyboardLayoutDatabase database;
+        g_errorCount = 0;
+        CHECK( ! database.Open( path, boost::bind( &CountError, _1 ) ) );
+        CHECK( g_errorCount == 1 );
+        CHECK( database.LayoutCount() == 0 );
+        CHECK( database.SelectLayout( ANY, ANY, ANY ) == NULL );
+    }
+
+
+    void TestDamagedHeaders( const std::string& path )
+    {
+        GitHubSample::KeyboardLayout us;
+        us.LoadBuiltInUSLayout();
+        GitHubSample::KeyboardLayout german;
+        MakeGermanLayout( german );
+        SaveDatabase( path, us, german );
+        const std::vector< uint8_t > good = ReadFile( path );
+        CHECK( good.size() > 64 );
+
+        std::vector< uint8_t > bytes = good;
+        bytes[0] = 'X';
+        CheckRejected( path, bytes );
+
+        bytes = good;
+        GitHubSample::WriteLittleEndian16( &bytes[4], 2 );
+        CheckRejected( path, bytes );
+
+        // the last layout is one byte short
+        bytes = good;
+        bytes.pop_back();
+        CheckRejected( path, bytes );
+
+        // the first layout would overlap the rules
+        bytes = good;
+        GitHubSample::WriteLittleEndian32( &bytes[12], 32 );
+        CheckRejected( path, bytes );
+
+        // an offset near 4 GB: with a 32-bit size_t, adding the layouts to it wraps around to a small number
+        bytes = good;
+        GitHubSample::WriteLittleEndian32( &bytes[12], 0xFFFFFFE0u );
+        GitHubSample::WriteLittleEndian16( &bytes[6], 1 );
+        CheckRejected( path, bytes );
+
+        // too many layouts for the file
+        bytes = good;
+        GitHubSample::WriteLittleEndian16( &bytes[6], 0xFFFF );
+        CheckRejected( path, bytes );
+
+        // shorter than a header
+        bytes.assign( good.begin(), good.begin() + 16 );
+        CheckRejected( path, bytes );
+    }
+
+
+    void TestSaveRefusesTooMany( const std::string& path )
+    {
+        GitHubSample::KeyboardLayout us;
+        us.LoadBuiltInUSLayout();
+        std::vector< const GitHubSample::KeyboardLayout* > layouts( 1, &us );
+        std::vector< GitHubSample::KeyboardLayoutDatabase::SelectionRule > rules( 0x10000, Rule( ANY, ANY, ANY, 0 ) );
+
+        g_errorCount = 0;
+        CHECK( ! GitHubSample::KeyboardLayoutDatabase::Save( path, layouts, rules, boost::bind( &CountError, _1 ) ) );
+        CHECK( g_errorCount == 1 );
+
+        rules.pop_back();
+        CHECK( GitHubSample::KeyboardLayoutDatabase::Save( path, layouts, rules ) );
+        GitHubSample::KeyboardLayoutDatabase database;
+        CHECK( database.Open( path ) );
+        CHECK( database.LayoutCount() == 1 );
+    }
+}
+
+
+
+int main( int, char** argv )
+{
+    // next to the test program, so that nothing outside the build directory is touched
+    const std::string path = std::string( argv[0] ) + ".kbdb";
+
+    TestRoundTripAndSelection( path );
+    TestDamagedHeaders( path );
+    TestSaveRefusesTooMany( path );
+
+    remove( path.c_str() );
+
+    return GitHubSample::Test::Finish( "KeyboardLayoutDatabaseTest" );
+}
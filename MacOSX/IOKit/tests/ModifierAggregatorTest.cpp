@@ -0,0 +1,175 @@
+
+
+#include "TestCheck.h"
+
+#include "ModifierAggregator.h"
+
+#include <string.h>
+
+
+
+namespace
+{
+    const uint16_t USAGE_PAGE_KEYBOARD_OR_KEYPAD = 0x07;
+    const uint16_t USAGE_A = 0x04;
+    const uint16_t USAGE_LEFT_CONTROL = 0xE0;
+    const uint16_t USAGE_LEFT_SHIFT = 0xE1;
+    const uint16_t USAGE_RIGHT_GUI = 0xE7;
+
+    const uint8_t LEFT_CONTROL = 0x01;
+    const uint8_t LEFT_SHIFT = 0x02;
+    const uint8_t RIGHT_GUI = 0x80;
+
+    uint32_t g_seed = 11;
+
+    unsigned int Random( const unsigned int range )
+    {
+        g_seed = g_seed * 1103515245u + 12345u;
+        return ( g_seed >> 16 ) % range;
+    }
+
+
+    GitHubSample::KeyEvent Key( const uint16_t deviceIndex, const uint16_t usage, const bool pressed )
+    {
+        GitHubSample::KeyEvent event;
+        memset( &event, 0, sizeof(event) );
+        event.usagePage = USAGE_PAGE_KEYBOARD_OR_KEYPAD;
+        event.usage = usage;
+        event.value = pressed ? 1 : 0;
+        event.deviceIndex = deviceIndex;
+        return event;
+    }
+
+
+    /// the bug in the VirtualBox sample: shift held on one keyboard, pressed and released on another
+    void TestTwoKeyboardsHoldShift()
+    {
+        GitHubSample::ModifierAggregator aggregator;
+
+        CHECK( aggregator.OnEvent( Key( 0, USAGE_LEFT_SHIFT, true ) ) );
+        CHECK( ! aggregator.OnEvent( Key( 1, USAGE_LEFT_SHIFT, true ) ) );
+        CHECK( aggregator.HoldCount( 1 ) == 2 );
+
+        CHECK( ! aggregator.OnEvent( Key( 0, USAGE_LEFT_SHIFT, false ) ) );
+        CHECK( aggregator.MergedModifiers() == LEFT_SHIFT );
+        CHECK( aggregator.HoldCount( 1 ) == 1 );
+
+        CHECK( aggregator.OnEvent( Key( 1, USAGE_LEFT_SHIFT, false ) ) );
+        CHECK( aggregator.MergedModifiers() == 0 );
+    }
+
+
+    void TestDeviceMasks()
+    {
+        GitHubSample::ModifierAggregator aggregator;
+
+        aggregator.OnEvent( Key( 0, USAGE_LEFT_CONTROL, true ) );
+        aggregator.OnEvent( Key( 3, USAGE_RIGHT_GUI, true ) );
+        aggregator.OnEvent( Key( 3, USAGE_LEFT_SHIFT, true ) );
+        // not a modifier
+        CHECK( ! aggregator.OnEvent( Key( 3, USAGE_A, true ) ) );
+
+        CHECK( aggregator.DeviceModifiers( 0 ) == LEFT_CONTROL );
+        CHECK( aggregator.DeviceModifiers( 1 ) == 0 );
+        CHECK( aggregator.DeviceModifiers( 3 ) == ( RIGHT_GUI | LEFT_SHIFT ) );
+        CHECK( aggregator.DeviceModifiers( 1000 ) == 0 );
+        CHECK( aggregator.MergedModifiers() == ( LEFT_CONTROL | LEFT_SHIFT | RIGHT_GUI ) );
+
+        // idempotent: a repeated press, and a release of what was never pressed, change nothing
+        CHECK( ! aggregator.OnEvent( Key( 0, USAGE_LEFT_CONTROL, true ) ) );
+        CHECK( ! aggregator.OnEvent( Key( 1, USAGE_LEFT_CONTROL, false ) ) );
+        CHECK( aggregator.HoldCount( 0 ) == 1 );
+
+        // a poll replaces the whole mask of one device
+        CHECK( aggregator.SetDeviceModifiers( 3, LEFT_CONTROL ) );
+        CHECK( aggregator.HoldCount( 0 ) == 2 );
+        CHECK( aggregator.MergedModifiers() == LEFT_CONTROL );
+
+        CHECK( ! aggregator.RemoveDevice( 0 ) );
+        CHECK( aggregator.RemoveDevice( 3 ) );
+        CHECK( aggregator.MergedModifiers() == 0 );
+    }
+
+
+    void TestSaturation()
+    {
+        GitHubSample::ModifierAggregator aggregator;
+
+        for ( uint16_t device = 0; device < 300; device++ )
+        {
+            aggregator.SetDeviceModifiers( device, LEFT_SHIFT );
+        }
+        CHECK( aggregator.HoldCount( 1 ) == 255 );
+        // the neighbouring counters are untouched: no carry out of a full byte
+        CHECK( aggregator.HoldCount( 0 ) == 0 );
+        CHECK( aggregator.HoldCount( 2 ) == 0 );
+        CHECK( aggregator.MergedModifiers() == LEFT_SHIFT );
+
+        for ( uint16_t device = 0; device < 300; device++ )
+        {
+            aggregator.RemoveDevice( device );
+        }
+        // and no borrow out of an empty one
+        CHECK( aggregator.HoldCount( 1 ) == 0 );
+        CHECK( aggregator.HoldCount( 2 ) == 0 );
+        CHECK( aggregator.MergedModifiers() == 0 );
+    }
+
+
+    /**
+       The merged mask against the counters it comes from, for counters of
+       0, 1, 127, 128 and 255: the byte values where a SWAR compare goes
+       wrong if it is going to.
+     */
+    void TestNonZeroCounters()
+    {
+        const unsigned int interesting[] = { 0, 1, 127, 128, 255 };
+
+        for ( size_t round = 0; round < 2000; round++ )
+        {
+            unsigned int counts[ GitHubSample::ModifierAggregator::kModifierCount ];
+            uint8_t expected = 0;
+            for ( unsigned int modifier = 0; modifier < GitHubSample::ModifierAggregator::kModifierCount; modifier++ )
+            {
+                counts[ modifier ] = interesting[ Random( 5 ) ];
+                expected |= ( counts[ modifier ] != 0 ) ? static_cast<uint8_t>( 1 << modifier ) : 0;
+            }
+
+            // device d holds every modifier whose count is above d
+            GitHubSample::ModifierAggregator aggregator;
+            for ( uint16_t device = 0; device < 255; device++ )
+            {
+                uint8_t held = 0;
+                for ( unsigned int modifier = 0; modifier < GitHubSample::ModifierAggregator::kModifierCount; modifier++ )
+                {
+                    held |= ( counts[ modifier ] > device ) ? static_cast<uint8_t>( 1 << modifier ) : 0;
+                }
+                aggregator.SetDeviceModifiers( device, held );
+            }
+
+            CHECK( aggregator.MergedModifiers() == expected );
+            for ( unsigned int modifier = 0; modifier < GitHubSample::ModifierAggregator::kModifierCount; modifier++ )
+            {
+                CHECK( aggregator.HoldCount( modifier ) == counts[ modifier ] );
+            }
+        }
+    }
+}
+
+
+
+int main()
+{
+#ifdef __SSE2__
+    printf( "merging with SSE2\n" );
+#else
+    printf( "merging with the SWAR fallback\n" );
+#endif
+
+    TestTwoKeyboardsHoldShift();
+    TestDeviceMasks();
+    TestSaturation();
+    TestNonZeroCounters();
+
+    return GitHubSample::Test::Finish( "ModifierAggregatorTest" );
+}
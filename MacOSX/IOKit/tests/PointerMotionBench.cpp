@@ -0,0 +1,230 @@
+
+
+#include "TestCheck.h"
+
+#include "PointerMotionCoalescer.h"
+
+#include <string.h>
+#include <vector>
+
+
+
+namespace
+{
+    const uint16_t USAGE_PAGE_GENERIC_DESKTOP = 0x01;
+    const uint16_t USAGE_PAGE_BUTTON = 0x09;
+    const uint16_t USAGE_GD_X = 0x30;
+    const uint16_t USAGE_GD_Y = 0x31;
+    const uint16_t USAGE_GD_WHEEL = 0x38;
+
+    /// a gaming mouse: one report every 125 us
+    const size_t REPORTS_PER_SECOND = 8000;
+    const uint64_t REPORT_NANOSECONDS = 1000000000 / REPORTS_PER_SECOND;
+    const size_t SECONDS = 10;
+    /// a button edge five times a second, a wheel step twenty times a second
+    const size_t REPORTS_PER_EDGE = 1600;
+    const size_t REPORTS_PER_WHEEL_STEP = 400;
+
+    uint32_t g_seed = 5;
+
+    unsigned int Random( const unsigned int range )
+    {
+        g_seed = g_seed * 1103515245u + 12345u;
+        return ( g_seed >> 16 ) % range;
+    }
+
+
+    GitHubSample::KeyEvent Event( const uint64_t timestamp, const uint16_t usagePage, const uint16_t usage, const int32_t value )
+    {
+        GitHubSample::KeyEvent event;
+        memset( &event, 0, sizeof(event) );
+        event.timestamp = timestamp;
+        event.usagePage = usagePage;
+        event.usage = usage;
+        event.value = value;
+        return event;
+    }
+
+
+    /**
+       What ReadEventsFromQueue hands out for SECONDS of an 8 kHz mouse that
+       never stops moving: per report an X and a Y delta (either may be
+       zero, and is then not reported), now and then a wheel step, and a
+       button edge.  'reportStarts' has where each report begins, plus one
+       past the end; 'motionBeforeEdge' the X and Y moved since the
+       previous edge, for each edge.
+     */
+    void MakeReports( std::vector< GitHubSample::KeyEvent >& events, std::vector< size_t >& reportStarts,
+                      std::vector< int64_t >& motionBeforeEdge )
+    {
+        int64_t sinceEdge = 0;
+        bool down = false;
+
+        for ( size_t report = 0; report < SECONDS * REPORTS_PER_SECOND; report++ )
+        {
+            const uint64_t timestamp = report * REPORT_NANOSECONDS;
+            const int32_t dx = static_cast<int32_t>( Random( 21 ) ) - 10;
+            const int32_t dy = static_cast<int32_t>( Random( 21 ) ) - 10;
+
+            reportStarts.push_back( events.size() );
+            if ( dx != 0 )
+            {
+                events.push_back( Event( timestamp, USAGE_PAGE_GENERIC_DESKTOP, USAGE_GD_X, dx ) );
+            }
+            if ( dy != 0 )
+            {
+                events.push_back( Event( timestamp, USAGE_PAGE_GENERIC_DESKTOP, USAGE_GD_Y, dy ) );
+            }
+            if ( report % REPORTS_PER_WHEEL_STEP == 0 )
+            {
+                events.push_back( Event( timestamp, USAGE_PAGE_GENERIC_DESKTOP, USAGE_GD_WHEEL, -1 ) );
+            }
+            sinceEdge += dx + dy;
+
+            if ( report % REPORTS_PER_EDGE == REPORTS_PER_EDGE / 2 )
+            {
+                down = ! down;
+                events.push_back( Event( timestamp, USAGE_PAGE_BUTTON, 1, down ? 1 : 0 ) );
+                motionBeforeEdge.push_back( sinceEdge );
+                sinceEdge = 0;
+            }
+        }
+        reportStarts.push_back( events.size() );
+    }
+
+
+    struct Totals
+    {
+        int64_t sums[ GitHubSample::PointerMotionCoalescer::kAxisCount ];
+        size_t edges;
+        size_t eventsOut;
+        size_t reads;
+        /// edges whose motion before them did not add up
+        size_t misplacedEdges;
+        /// no motion stamped after the edge that follows it, or before the edge that precedes it
+        bool ordered;
+    };
+
+
+    void Count( const GitHubSample::KeyEvent* events, const size_t count, const std::vector< int64_t >& motionBeforeEdge,
+                int64_t& sinceEdge, uint64_t& lastEdge, uint64_t& latest, Totals& totals )
+    {
+        for ( size_t i = 0; i < count; i++ )
+        {
+            const GitHubSample::PointerMotionCoalescer::Axis axis = GitHubSample::PointerMotionCoalescer::AxisOf( events[i] );
+            if ( axis != GitHubSample::PointerMotionCoalescer::kAxisCount )
+            {
+                totals.sums[ axis ] += events[i].value;
+                if ( axis == GitHubSample::PointerMotionCoalescer::kAxisX || axis == GitHubSample::PointerMotionCoalescer::kAxisY )
+                {
+                    sinceEdge += events[i].value;
+                }
+                // each axis carries the time of the last report that moved it, so the axes need not be in order among themselves
+                totals.ordered = totals.ordered && ( events[i].timestamp >= lastEdge );
+            }
+            else
+            {
+                totals.ordered = totals.ordered && ( events[i].timestamp >= latest );
+                lastEdge = events[i].timestamp;
+                if ( totals.edges >= motionBeforeEdge.size() || motionBeforeEdge[ totals.edges ] != sinceEdge )
+                {
+                    totals.misplacedEdges++;
+                }
+                sinceEdge = 0;
+                totals.edges++;
+            }
+
+            latest = ( events[i].timestamp > latest ) ? events[i].timestamp : latest;
+        }
+        totals.eventsOut += count;
+    }
+
+
+    /// Feeds every report, draining 'readsPerSecond' times a second.  Returns nanoseconds per report.
+    double Run( const std::vector< GitHubSample::KeyEvent >& events, const std::vector< size_t >& reportStarts,
+                const std::vector< int64_t >& motionBeforeEdge, const size_t readsPerSecond,
+                GitHubSample::PointerMotionCoalescer& coalescer, Totals& totals )
+    {
+        memset( &totals, 0, sizeof(totals) );
+        totals.ordered = true;
+
+        GitHubSample::KeyEvent drained[ 256 ];
+        const size_t reportsPerRead = REPORTS_PER_SECOND / readsPerSecond;
+        int64_t sinceEdge = 0;
+        uint64_t lastEdge = 0;
+        uint64_t latest = 0;
+
+        const uint64_t start = GitHubSample::Test::Nanoseconds();
+        for ( size_t report = 0; report + 1 < reportStarts.size(); report++ )
+        {
+            coalescer.Offer( &events[ reportStarts[ report ] ], reportStarts[ report + 1 ] - reportStarts[ report ] );
+
+            if ( ( report + 1 ) % reportsPerRead == 0 || report + 2 == reportStarts.size() )
+            {
+                size_t count = 0;
+                while ( ( count = coalescer.Drain( drained, 256 ) ) > 0 )
+                {
+                    Count( drained, count, motionBeforeEdge, sinceEdge, lastEdge, latest, totals );
+                }
+                totals.reads++;
+            }
+        }
+        const uint64_t elapsed = GitHubSample::Test::Nanoseconds() - start;
+
+        return static_cast<double>( elapsed ) / ( reportStarts.size() - 1 );
+    }
+}
+
+
+
+int main()
+{
+    std::vector< GitHubSample::KeyEvent > events;
+    std::vector< size_t > reportStarts;
+    std::vector< int64_t > motionBeforeEdge;
+    MakeReports( events, reportStarts, motionBeforeEdge );
+
+    int64_t sumsIn[ GitHubSample::PointerMotionCoalescer::kAxisCount ] = { 0 };
+    for ( size_t i = 0; i < events.size(); i++ )
+    {
+        const GitHubSample::PointerMotionCoalescer::Axis axis = GitHubSample::PointerMotionCoalescer::AxisOf( events[i] );
+        if ( axis != GitHubSample::PointerMotionCoalescer::kAxisCount )
+        {
+            sumsIn[ axis ] += events[i].value;
+        }
+    }
+
+    printf( "%lu reports at %lu Hz: %lu events in, %lu button edges\n\n",
+            static_cast<unsigned long>( reportStarts.size() - 1 ), static_cast<unsigned long>( REPORTS_PER_SECOND ),
+            static_cast<unsigned long>( events.size() ), static_cast<unsigned long>( motionBeforeEdge.size() ) );
+    printf( "reads/s   ns/report   events out   events per read\n" );
+
+    const size_t readRates[] = { 1000, 250, 125, 60 };
+    for ( size_t rate = 0; rate < sizeof(readRates) / sizeof(readRates[0]); rate++ )
+    {
+        GitHubSample::PointerMotionCoalescer coalescer;
+        Totals totals;
+        const double nanoseconds = Run( events, reportStarts, motionBeforeEdge, readRates[ rate ], coalescer, totals );
+
+        printf( "%7lu   %9.1f   %10lu   %15.1f\n", static_cast<unsigned long>( readRates[ rate ] ), nanoseconds,
+                static_cast<unsigned long>( totals.eventsOut ), static_cast<double>( totals.eventsOut ) / totals.reads );
+
+        // not one count of motion lost, every click out, in order, in its place relative to the motion
+        for ( size_t axis = 0; axis < GitHubSample::PointerMotionCoalescer::kAxisCount; axis++ )
+        {
+            CHECK( totals.sums[ axis ] == sumsIn[ axis ] );
+        }
+        CHECK( totals.edges == motionBeforeEdge.size() );
+        CHECK( totals.misplacedEdges == 0 );
+        CHECK( totals.ordered );
+        CHECK( coalescer.Stats().droppedExactEvents == 0 );
+        CHECK( coalescer.Stats().droppedMotion == 0 );
+        CHECK( ! coalescer.HasPending() );
+
+        // at most one event per axis per read, and per edge, however many reports came in
+        const size_t axisCount = GitHubSample::PointerMotionCoalescer::kAxisCount;
+        CHECK( totals.eventsOut <= totals.reads * axisCount + totals.edges * ( axisCount + 1 ) );
+    }
+
+    return GitHubSample::Test::Finish( "PointerMotionBench" );
+}
@@ -0,0 +1,76 @@
+
+
+#include "TestCheck.h"
+#include "CountingAllocator.h"
+
+#include "HelperForKeyboardReaderIOKit.h"
+
+
+
+namespace
+{
+    const size_t CYCLES = 50;
+
+    /**
+       Every operator new a reader that opened makes, IOKit and
+       CoreFoundation aside (they use malloc):
+
+         1   PrivateImpl and its shared_ptr control block (one make_shared)
+         2   the registry's block hash table, keys and block numbers
+         10  UsageRegistry::Reserve, from the element count: the eight dense
+             arrays, the cookie map and the sparse blocks
+
+       that is 13.  The other 3 are for a device with more than 16 blocks
+       of usages, whose hash table and sparse array grow once more.  The
+       error functor and the layout database are empty here, and the
+       property strings are interned by the warm-up reader.  Before the
+       arena it was hundreds: a shared_ptr, a name string and a control
+       block per key.
+     */
+    const size_t MAXIMUM_ALLOCATIONS_PER_READER = 16;
+
+
+    /// hotplug churn: open and close the same device over and over
+    void TestCreateAndDestroy( const GitHubSample::HelperForKeyboardReaderIOKit::DeviceKind kind, const char* name )
+    {
+        {
+            // a device that is not there only measures how the failure is logged
+            GitHubSample::HelperForKeyboardReaderIOKit probe( true, 0, boost::shared_ptr< const GitHubSample::KeyboardLayoutDatabase >(), kind );
+            if ( probe.Elements().Count() == 0 )
+            {
+                printf( "%s reader: no such device attached, skipped\n", name );
+                return; // BAILING OUT EARLY!!  BAILING OUT EARLY!!  BAILING OUT EARLY!!
+            }
+        }
+
+        size_t elementCount = 0;
+        const GitHubSample::Test::AllocationCount allocations;
+
+        for ( size_t cycle = 0; cycle < CYCLES; cycle++ )
+        {
+            GitHubSample::HelperForKeyboardReaderIOKit reader( true, 0, boost::shared_ptr< const GitHubSample::KeyboardLayoutDatabase >(), kind );
+            elementCount = reader.Elements().Count();
+        }
+
+        const double perReader = static_cast<double>( allocations.Count() ) / CYCLES;
+        printf( "%s reader (%lu elements): %.1f allocations per create and destroy\n",
+                name, static_cast<unsigned long>( elementCount ), perReader );
+
+        CHECK( allocations.Count() <= CYCLES * MAXIMUM_ALLOCATIONS_PER_READER );
+    }
+}
+
+
+
+int main()
+{
+    // the first reader pays for the statics (the usage tables, the IOKit plugin), which are not churn
+    {
+        GitHubSample::HelperForKeyboardReaderIOKit warmUp( true );
+    }
+
+    TestCreateAndDestroy( GitHubSample::HelperForKeyboardReaderIOKit::kKeyboardDevice, "keyboard" );
+    TestCreateAndDestroy( GitHubSample::HelperForKeyboardReaderIOKit::kPointerDevice, "pointer" );
+
+    return GitHubSample::Test::Finish( "ReaderAllocationTest" );
+}
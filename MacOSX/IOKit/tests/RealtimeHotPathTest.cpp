@@ -0,0 +1,255 @@
+
+
+#include "TestCheck.h"
+#include "CountingAllocator.h"
+
+#include "AdaptivePoller.h"
+#include "EventCoalescer.h"
+#include "FrameSampler.h"
+#include "KeyboardLayout.h"
+#include "ModifierAggregator.h"
+#include "PointerMotionCoalescer.h"
+#include "RealtimeThreadConfig.h"
+#include "ScancodeEncoder.h"
+#include "TextReconstructionStage.h"
+
+#include <boost/bind.hpp>
+#include <string.h>
+#include <vector>
+
+
+
+namespace
+{
+    const uint16_t FIRST_LETTER = 0x04;
+    const uint16_t USAGE_LEFT_SHIFT = 0xE1;
+    const uint16_t USAGE_PAGE_GENERIC_DESKTOP = 0x01;
+    const uint16_t USAGE_GD_X = 0x30;
+
+    /// a 60 Hz render loop samples the frame sampler, and the mouse is drained at 1 kHz
+    const uint64_t FRAME_NANOSECONDS = 16666667;
+    const uint64_t POINTER_DRAIN_NANOSECONDS = 1000000;
+
+    /// the virtual time the poller runs before anything is counted, so every lazily grown table has grown
+    const uint64_t WARM_UP_NANOSECONDS = 2000000000ULL;
+    const uint64_t SESSION_NANOSECONDS = 60000000000ULL;
+
+    const size_t EVENT_CAPACITY = 64;
+
+    uint32_t g_seed = 17;
+
+    unsigned int Random( const unsigned int range )
+    {
+        g_seed = g_seed * 1103515245u + 12345u;
+        return ( g_seed >> 16 ) % range;
+    }
+
+
+    struct Keystroke
+    {
+        uint64_t down;
+        uint64_t up;
+        uint16_t usage;
+        bool shifted;
+    };
+
+
+    /// a keyboard typing letters, some shifted, 150 ms apart.  made up front, so the snapshot does not allocate either.
+    class SimulatedKeyboard
+    {
+    public:
+
+        explicit SimulatedKeyboard( const GitHubSample::EventClock& clock )
+            : m_clock( clock ),
+              m_next( 0 )
+        {
+            for ( uint64_t time = 100000000; time < SESSION_NANOSECONDS; time += 150000000 )
+            {
+                Keystroke keystroke;
+                keystroke.down = time;
+                keystroke.up = time + 60000000 + Random( 40 ) * 1000000ULL;
+                keystroke.usage = static_cast<uint16_t>( FIRST_LETTER + Random( 26 ) );
+                keystroke.shifted = ( Random( 8 ) == 0 );
+                m_typing.push_back( keystroke );
+            }
+        }
+
+        std::vector< Keystroke >& Typing() { return m_typing; }
+
+        bool Snapshot( GitHubSample::KeyStateBitmap& pressed )
+        {
+            const uint64_t now = m_clock.NowNanoseconds();
+            memset( pressed.words, 0, sizeof(pressed.words) );
+
+            while ( m_next < m_typing.size() && m_typing[ m_next ].up <= now )
+            {
+                m_next++;
+            }
+            if ( m_next < m_typing.size() && m_typing[ m_next ].down <= now )
+            {
+                const Keystroke& keystroke = m_typing[ m_next ];
+                pressed.words[ keystroke.usage >> 5 ] |= 1u << ( keystroke.usage & 31 );
+                if ( keystroke.shifted )
+                {
+                    pressed.words[ USAGE_LEFT_SHIFT >> 5 ] |= 1u << ( USAGE_LEFT_SHIFT & 31 );
+                }
+            }
+            return true;
+        }
+
+    private:
+
+        const GitHubSample::EventClock& m_clock;
+        std::vector< Keystroke > m_typing;
+        size_t m_next;
+    };
+
+
+    /// the hooks above do see allocations
+    void TestCountingWorks()
+    {
+        const GitHubSample::Test::AllocationCount allocations;
+        std::vector< int >* numbers = new std::vector< int >( 10 );
+        delete numbers;
+
+        CHECK( allocations.Count() == 2 );
+    }
+
+
+    /**
+       The reader thread's loop, as RealtimeThreadConfig describes it: poll,
+       hold the edges back in the coalescer, then the modifier aggregate,
+       the scancodes and the text.  The edges also go to a frame sampler
+       (sampled here, at 60 Hz, instead of on a render thread), and a mouse
+       moves all the while.  Once warmed up and every stage's buffers are
+       locked, a minute of typing must take no allocation and no page fault.
+     */
+    void TestHotPath()
+    {
+        GitHubSample::VirtualClock clock;
+        SimulatedKeyboard keyboard( clock );
+        GitHubSample::AdaptivePoller poller( boost::bind( &SimulatedKeyboard::Snapshot, &keyboard, _1 ),
+                                             1000000, 16000000, 250000000, clock );
+
+        GitHubSample::KeyboardLayout layout;
+        layout.LoadBuiltInUSLayout();
+        GitHubSample::TextReconstructionStage text( layout );
+        GitHubSample::ModifierAggregator aggregator;
+        const GitHubSample::ScancodeEncoder encoder( GitHubSample::ScancodeEncoder::kSet1 );
+        GitHubSample::EventCoalescer coalescer;
+        GitHubSample::FrameSampler sampler;
+        GitHubSample::PointerMotionCoalescer pointer;
+
+        std::vector< GitHubSample::KeyEvent > events( EVENT_CAPACITY );
+        std::vector< GitHubSample::KeyEvent > delivered( EVENT_CAPACITY );
+        std::vector< GitHubSample::KeyEvent > motion( EVENT_CAPACITY );
+        std::vector< uint8_t > scancodes( EVENT_CAPACITY * GitHubSample::ScancodeEncoder::kMaxBytesPerEvent );
+        std::vector< char > utf8( EVENT_CAPACITY * GitHubSample::TextReconstructionStage::kMaxBytesPerEvent );
+
+        size_t edgeCount = 0;
+        size_t deliveredCount = 0;
+        size_t sampledCount = 0;
+        int64_t motionOut = 0;
+        uint64_t nextFrame = FRAME_NANOSECONDS;
+        uint64_t nextPointerDrain = POINTER_DRAIN_NANOSECONDS;
+        size_t scancodeBytes = 0;
+        size_t textBytes = 0;
+        bool counting = false;
+
+        GitHubSample::RealtimeThreadConfig realtime;
+        GitHubSample::PageFaultCounter faults;
+        GitHubSample::Test::AllocationCount allocations;
+
+        while ( clock.NowNanoseconds() < SESSION_NANOSECONDS )
+        {
+            if ( ! counting && clock.NowNanoseconds() >= WARM_UP_NANOSECONDS )
+            {
+                // mlock may be refused here (RLIMIT_MEMLOCK); the pages are touched all the same
+                realtime.LockVector( keyboard.Typing() );
+                realtime.LockVector( events );
+                realtime.LockVector( delivered );
+                realtime.LockVector( motion );
+                realtime.LockVector( scancodes );
+                realtime.LockVector( utf8 );
+                coalescer.LockBuffers( realtime );
+                sampler.LockBuffers( realtime );
+                pointer.LockBuffers( realtime );
+                realtime.ApplyToCurrentThread();
+
+                counting = true;
+                allocations.Restart();
+                faults.Restart();
+            }
+
+            const size_t count = poller.WaitAndPoll( &events[0], events.size() );
+            const uint64_t now = clock.NowNanoseconds();
+            edgeCount += count;
+
+            sampler.Publish( &events[0], count );
+            if ( now >= nextFrame )
+            {
+                sampledCount += sampler.SampleFrame( now + 1 ).eventCount;
+                nextFrame += FRAME_NANOSECONDS;
+            }
+
+            GitHubSample::KeyEvent step;
+            memset( &step, 0, sizeof(step) );
+            step.timestamp = now;
+            step.usagePage = USAGE_PAGE_GENERIC_DESKTOP;
+            step.usage = USAGE_GD_X;
+            step.value = 1;
+            pointer.Offer( &step, 1 );
+            if ( now >= nextPointerDrain )
+            {
+                const size_t moved = pointer.Drain( &motion[0], motion.size() );
+                for ( size_t i = 0; i < moved; i++ )
+                {
+                    motionOut += motion[i].value;
+                }
+                nextPointerDrain += POINTER_DRAIN_NANOSECONDS;
+            }
+
+            coalescer.Offer( &events[0], count, now );
+            const size_t due = coalescer.Deliver( &delivered[0], delivered.size(), now );
+            deliveredCount += due;
+
+            aggregator.OnEvents( &delivered[0], due );
+
+            size_t bytes = 0;
+            encoder.Encode( &delivered[0], due, &scancodes[0], scancodes.size(), &bytes );
+            scancodeBytes += bytes;
+
+            text.Process( &delivered[0], due, &utf8[0], utf8.size(), &bytes );
+            textBytes += bytes;
+        }
+
+        const size_t allocationCount = allocations.Count();
+        const long minorFaults = faults.MinorFaults();
+        const long majorFaults = faults.MajorFaults();
+
+        printf( "%lu edges, %lu scancode bytes, %lu text bytes, %lu polls: %lu allocations, %ld minor and %ld major faults\n",
+                static_cast<unsigned long>( edgeCount ), static_cast<unsigned long>( scancodeBytes ), static_cast<unsigned long>( textBytes ),
+                static_cast<unsigned long>( poller.PollCount() ), static_cast<unsigned long>( allocationCount ), minorFaults, majorFaults );
+
+        CHECK( counting );
+        CHECK( edgeCount >= 2 * keyboard.Typing().size() );
+        // all but the last batch and the last frame made it through
+        CHECK( deliveredCount + 8 >= edgeCount );
+        CHECK( sampledCount + 8 >= edgeCount );
+        CHECK( motionOut + 64 >= static_cast<int64_t>( poller.PollCount() ) );
+        CHECK( textBytes >= keyboard.Typing().size() - 20 );
+        CHECK( allocationCount == 0 );
+        CHECK( minorFaults == 0 );
+        CHECK( majorFaults == 0 );
+    }
+}
+
+
+
+int main()
+{
+    TestCountingWorks();
+    TestHotPath();
+
+    return GitHubSample::Test::Finish( "RealtimeHotPathTest" );
+}
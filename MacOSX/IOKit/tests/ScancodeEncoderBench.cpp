@@ -0,0 +1,182 @@
+
+
+#include "TestCheck.h"
+
+#include "ScancodeEncoder.h"
+#include "ScancodeTranslation.h"
+
+#include <string.h>
+#include <vector>
+
+
+
+namespace
+{
+    const uint16_t USAGE_PAGE_KEYBOARD_OR_KEYPAD = 0x07;
+    const uint16_t USAGE_PRINT_SCREEN = 0x46;
+    const uint16_t USAGE_PAUSE = 0x48;
+
+    const size_t EVENT_COUNT = 1 << 20;
+    const size_t PASSES = 20;
+
+
+    /**
+       What every caller of DarwinKeycodeToSet1Scancode ends up writing: look
+       the key up, then decide per event about the prefix, the break form and
+       the keys that send whole sequences.
+     */
+    size_t NaiveEncode( const size_t set, const GitHubSample::KeyEvent* events, const size_t count, uint8_t* buffer )
+    {
+        size_t written = 0;
+
+        for ( size_t i = 0; i < count; i++ )
+        {
+            const GitHubSample::KeyEvent& event = events[i];
+            if ( event.usagePage != USAGE_PAGE_KEYBOARD_OR_KEYPAD )
+            {
+                continue;
+            }
+
+            const bool pressed = ( event.value != 0 );
+
+            if ( event.usage == USAGE_PAUSE )
+            {
+                if ( pressed )
+                {
+                    static const uint8_t set1[] = { 0xE1, 0x1D, 0x45, 0xE1, 0x9D, 0xC5 };
+                    static const uint8_t set2[] = { 0xE1, 0x14, 0x77, 0xE1, 0xF0, 0x14, 0xF0, 0x77 };
+                    memcpy( buffer + written, ( set == 1 ) ? set1 : set2, ( set == 1 ) ? sizeof(set1) : sizeof(set2) );
+                    written += ( set == 1 ) ? sizeof(set1) : sizeof(set2);
+                }
+                continue;
+            }
+
+            if ( event.usage == USAGE_PRINT_SCREEN )
+            {
+                static const uint8_t set1Make[]  = { 0xE0, 0x2A, 0xE0, 0x37 };
+                static const uint8_t set1Break[] = { 0xE0, 0xB7, 0xE0, 0xAA };
+                static const uint8_t set2Make[]  = { 0xE0, 0x12, 0xE0, 0x7C };
+                static const uint8_t set2Break[] = { 0xE0, 0xF0, 0x7C, 0xE0, 0xF0, 0x12 };
+                const uint8_t* bytes = ( set == 1 ) ? ( pressed ? set1Make : set1Break ) : ( pressed ? set2Make : set2Break );
+                const size_t length = ( set == 2 && ! pressed ) ? sizeof(set2Break) : 4;
+                memcpy( buffer + written, bytes, length );
+                written += length;
+                continue;
+            }
+
+            const uint16_t code = GitHubSample::TranslateKeyCode( GitHubSample::kHidUsage,
+                                                                  ( set == 1 ) ? GitHubSample::kSet1Scancode : GitHubSample::kSet2Scancode,
+                                                                  event.usage );
+            if ( code == GitHubSample::kNoKeyCode )
+            {
+                continue;
+            }
+
+            if ( code & GitHubSample::kScancodeExtended )
+            {
+                buffer[ written++ ] = 0xE0;
+            }
+
+            if ( set == 1 )
+            {
+                buffer[ written++ ] = static_cast<uint8_t>( ( code & GitHubSample::kScancodeCodeMask ) | ( pressed ? 0 : 0x80 ) );
+            }
+            else
+            {
+                if ( ! pressed )
+                {
+                    buffer[ written++ ] = 0xF0;
+                }
+                buffer[ written++ ] = static_cast<uint8_t>( code & GitHubSample::kScancodeCodeMask );
+            }
+        }
+
+        return written;
+    }
+
+
+    uint32_t g_seed = 7;
+
+    unsigned int Random( const unsigned int range )
+    {
+        g_seed = g_seed * 1103515245u + 12345u;
+        return ( g_seed >> 16 ) % range;
+    }
+
+    /// typing with shortcuts: letters and digits, modifiers, navigation keys (extended), and the odd Print Screen or Pause
+    uint16_t RandomUsage()
+    {
+        const unsigned int roll = Random( 1000 );
+        if ( roll < 600 )
+        {
+            return static_cast<uint16_t>( 0x04 + Random( 0x2D - 0x04 ) ); // a .. -
+        }
+        if ( roll < 800 )
+        {
+            return static_cast<uint16_t>( 0xE0 + Random( 8 ) );           // modifiers, half of them extended
+        }
+        if ( roll < 950 )
+        {
+            return static_cast<uint16_t>( 0x49 + Random( 10 ) );          // insert .. up
+        }
+        if ( roll < 990 )
+        {
+            return static_cast<uint16_t>( 0x3A + Random( 12 ) );          // F1 .. F12
+        }
+        return ( roll < 995 ) ? USAGE_PRINT_SCREEN : USAGE_PAUSE;
+    }
+
+    volatile size_t g_sink = 0;
+}
+
+
+
+int main()
+{
+    std::vector< GitHubSample::KeyEvent > events( EVENT_COUNT );
+    memset( &events[0], 0, events.size() * sizeof(events[0]) );
+    for ( size_t i = 0; i + 1 < EVENT_COUNT; i += 2 )
+    {
+        events[i].usagePage = events[ i + 1 ].usagePage = USAGE_PAGE_KEYBOARD_OR_KEYPAD;
+        events[i].usage = events[ i + 1 ].usage = RandomUsage();
+        events[i].value = 1;
+    }
+
+    std::vector< uint8_t > naive( EVENT_COUNT * GitHubSample::ScancodeEncoder::kMaxBytesPerEvent );
+    std::vector< uint8_t > encoded( naive.size() );
+
+    for ( int set = 1; set <= 2; set++ )
+    {
+        const GitHubSample::ScancodeEncoder encoder( static_cast<GitHubSample::ScancodeEncoder::ScancodeSet>( set ) );
+
+        size_t naiveBytes = 0;
+        const uint64_t naiveStart = GitHubSample::Test::Nanoseconds();
+        for ( size_t pass = 0; pass < PASSES; pass++ )
+        {
+            naiveBytes = NaiveEncode( set, &events[0], events.size(), &naive[0] );
+            g_sink = naive[ pass ];
+        }
+        const uint64_t naiveNanoseconds = GitHubSample::Test::Nanoseconds() - naiveStart;
+
+        size_t encodedBytes = 0;
+        size_t consumed = 0;
+        const uint64_t encoderStart = GitHubSample::Test::Nanoseconds();
+        for ( size_t pass = 0; pass < PASSES; pass++ )
+        {
+            consumed = encoder.Encode( &events[0], events.size(), &encoded[0], encoded.size(), &encodedBytes );
+            g_sink = encoded[ pass ];
+        }
+        const uint64_t encoderNanoseconds = GitHubSample::Test::Nanoseconds() - encoderStart;
+
+        CHECK( consumed == events.size() );
+        CHECK( encodedBytes == naiveBytes );
+        CHECK( 0 == memcmp( &encoded[0], &naive[0], naiveBytes ) );
+
+        printf( "set %d: %lu events, %lu bytes.  naive %.2f ns per event, templates %.2f ns per event\n",
+                set, static_cast<unsigned long>( events.size() ), static_cast<unsigned long>( encodedBytes ),
+                static_cast<double>( naiveNanoseconds ) / ( EVENT_COUNT * PASSES ),
+                static_cast<double>( encoderNanoseconds ) / ( EVENT_COUNT * PASSES ) );
+    }
+
+    return GitHubSample::Test::Finish( "ScancodeEncoderBench" );
+}
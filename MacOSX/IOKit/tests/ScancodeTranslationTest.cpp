@@ -0,0 +1,209 @@
+
+
+#include "TestCheck.h"
+
+#include "DarwinKeycodeTables.h"
+#include "ScancodeTranslation.h"
+
+#include <vector>
+
+
+
+namespace
+{
+    const size_t SPACE_COUNT = GitHubSample::kKeyCodeSpaceCount;
+    const size_t ALL_CODES = 0x10000;
+
+    /// what identifies a code: its low byte and the extended bit (the other flags are ignored on input)
+    const uint16_t IDENTITY_BITS = GitHubSample::kScancodeCodeMask | GitHubSample::kScancodeExtended;
+
+    uint16_t Translate( const size_t from, const size_t to, const size_t code )
+    {
+        return GitHubSample::TranslateKeyCode( static_cast<GitHubSample::KeyCodeSpace>( from ),
+                                               static_cast<GitHubSample::KeyCodeSpace>( to ),
+                                               static_cast<uint16_t>( code ) );
+    }
+
+
+    void TestKnownKeys()
+    {
+        // 'a' is mac keycode ZERO, and must work both ways
+        CHECK( Translate( GitHubSample::kHidUsage, GitHubSample::kDarwinKeycode, 0x04 ) == 0x00 );
+        CHECK( Translate( GitHubSample::kDarwinKeycode, GitHubSample::kHidUsage, 0x00 ) == 0x04 );
+        CHECK( Translate( GitHubSample::kDarwinKeycode, GitHubSample::kSet1Scancode, 0x00 ) == 0x1E );
+        CHECK( Translate( GitHubSample::kSet2Scancode, GitHubSample::kDarwinKeycode, 0x1C ) == 0x00 );
+
+        CHECK( Translate( GitHubSample::kHidUsage, GitHubSample::kSet1Scancode, 0x04 ) == 0x1E );
+        CHECK( Translate( GitHubSample::kHidUsage, GitHubSample::kSet2Scancode, 0x04 ) == 0x1C );
+        CHECK( Translate( GitHubSample::kHidUsage, GitHubSample::kLinuxEvdev, 0x04 ) == 30 );
+
+        // up arrow is extended in both scancode sets
+        CHECK( Translate( GitHubSample::kSet1Scancode, GitHubSample::kDarwinKeycode, 0x48 | GitHubSample::kScancodeExtended ) == 0x7E );
+        CHECK( Translate( GitHubSample::kSet1Scancode, GitHubSample::kDarwinKeycode, 0x48 ) == 0x5B ); // keypad 8
+
+        // Pause has a set-1 code, but no way back from it
+        CHECK( Translate( GitHubSample::kHidUsage, GitHubSample::kSet1Scancode, 0x48 ) == ( 0x45 | GitHubSample::kScancodeSpecial ) );
+        CHECK( Translate( GitHubSample::kSet1Scancode, GitHubSample::kHidUsage, 0x45 ) == 0x53 ); // num lock
+
+        // keys the mac does not have
+        CHECK( Translate( GitHubSample::kHidUsage, GitHubSample::kDarwinKeycode, 0x88 ) == GitHubSample::kNoKeyCode );
+        CHECK( Translate( GitHubSample::kSet1Scancode, GitHubSample::kDarwinKeycode, 0x70 ) == GitHubSample::kNoKeyCode );
+
+        for ( size_t to = 0; to < SPACE_COUNT; to++ )
+        {
+            // HID usage zero is no key, and "no key" stays "no key" in every direction
+            CHECK( Translate( GitHubSample::kHidUsage, to, 0 ) == GitHubSample::kNoKeyCode );
+            for ( size_t from = 0; from < SPACE_COUNT; from++ )
+            {
+                CHECK( Translate( from, to, GitHubSample::kNoKeyCode ) == GitHubSample::kNoKeyCode );
+            }
+        }
+    }
+
+
+    /// Every 16 bit input of every space: it either means nothing anywhere,
+    /// or it means one HID usage, and every translation goes through that usage.
+    void TestEveryCodeRoundTrips()
+    {
+        size_t keys[ SPACE_COUNT ] = { 0 };
+
+        for ( size_t from = 0; from < SPACE_COUNT; from++ )
+        {
+            for ( size_t code = 0; code < ALL_CODES; code++ )
+            {
+                const uint16_t hid = Translate( from, GitHubSample::kHidUsage, code );
+
+                for ( size_t to = 0; to < SPACE_COUNT; to++ )
+                {
+                    const uint16_t direct = Translate( from, to, code );
+                    CHECK( direct == ( ( hid == GitHubSample::kNoKeyCode ) ? hid : Translate( GitHubSample::kHidUsage, to, hid ) ) );
+                }
+
+                if ( hid == GitHubSample::kNoKeyCode )
+                {
+                    continue;
+                }
+
+                const uint16_t back = Translate( GitHubSample::kHidUsage, from, hid );
+                CHECK( back != GitHubSample::kNoKeyCode );
+                CHECK( ( back & IDENTITY_BITS ) == ( code & IDENTITY_BITS ) );
+
+                if ( ( code & ~IDENTITY_BITS ) == 0 )
+                {
+                    keys[ from ]++;
+                }
+            }
+        }
+
+        // one usage per row of the table.  the mac lacks three of the keys, and has one code for backslash and non-US #.
+        CHECK( keys[ GitHubSample::kHidUsage ] == 115 );
+        CHECK( keys[ GitHubSample::kDarwinKeycode ] == 111 );
+    }
+
+
+    /// Every HID usage that has a code translates back to a usage with the SAME code.
+    void TestEveryUsageRoundTrips()
+    {
+        for ( size_t space = 0; space < SPACE_COUNT; space++ )
+        {
+            for ( size_t hid = 0; hid < ALL_CODES; hid++ )
+            {
+                const uint16_t code = Translate( GitHubSample::kHidUsage, space, hid );
+                CHECK( hid != 0 || code == GitHubSample::kNoKeyCode );
+                CHECK( hid <= 0xFF || code == GitHubSample::kNoKeyCode );
+
+                if ( code == GitHubSample::kNoKeyCode || ( code & GitHubSample::kScancodeSpecial ) )
+                {
+                    continue;
+                }
+
+                const uint16_t backHid = Translate( space, GitHubSample::kHidUsage, code );
+                CHECK( backHid != GitHubSample::kNoKeyCode );
+                CHECK( Translate( GitHubSample::kHidUsage, space, backHid ) == code );
+            }
+        }
+    }
+
+
+    /// The batch version (with AVX2, the gather path) against the single one, and in place.
+    void TestBatchMatchesSingle()
+    {
+        std::vector< uint16_t > input( ALL_CODES );
+        std::vector< uint16_t > output( ALL_CODES );
+        for ( size_t code = 0; code < ALL_CODES; code++ )
+        {
+            input[ code ] = static_cast<uint16_t>( code );
+        }
+
+        for ( size_t from = 0; from < SPACE_COUNT; from++ )
+        {
+            for ( size_t to = 0; to < SPACE_COUNT; to++ )
+            {
+                // an odd count leaves a scalar tail
+                GitHubSample::TranslateKeyCodes( static_cast<GitHubSample::KeyCodeSpace>( from ),
+                                                 static_cast<GitHubSample::KeyCodeSpace>( to ),
+                                                 &input[0], &output[0], ALL_CODES - 3 );
+
+                std::vector< uint16_t > inPlace( input );
+                GitHubSample::TranslateKeyCodes( static_cast<GitHubSample::KeyCodeSpace>( from ),
+                                                 static_cast<GitHubSample::KeyCodeSpace>( to ),
+                                                 &inPlace[0], &inPlace[0], ALL_CODES );
+
+                for ( size_t code = 0; code < ALL_CODES; code++ )
+                {
+                    const uint16_t expected = Translate( from, to, code );
+                    CHECK( code >= ALL_CODES - 3 || output[ code ] == expected );
+                    CHECK( inPlace[ code ] == expected );
+                }
+            }
+        }
+    }
+
+
+    /// DarwinKeycodeToSet1Scancode comes from the same table, so it must agree with it everywhere.
+    void TestDarwinTableAgrees()
+    {
+        std::vector< uint16_t > keycodes( 0x100 );
+        std::vector< uint16_t > scancodes( 0x100 );
+        for ( size_t keycode = 0; keycode < keycodes.size(); keycode++ )
+        {
+            keycodes[ keycode ] = static_cast<uint16_t>( keycode );
+        }
+        GitHubSample::DarwinKeycodesToSet1Scancodes( &keycodes[0], &scancodes[0], keycodes.size() );
+
+        for ( size_t keycode = 0; keycode < keycodes.size(); keycode++ )
+        {
+            uint16_t expected = 0;
+            if ( keycode < GitHubSample::kDarwinKeycodeCount )
+            {
+                const uint16_t code = Translate( GitHubSample::kDarwinKeycode, GitHubSample::kSet1Scancode, keycode );
+                if ( code != GitHubSample::kNoKeyCode && ! ( code & GitHubSample::kScancodeSpecial ) )
+                {
+                    expected = code;
+                }
+            }
+
+            CHECK( GitHubSample::DarwinKeycodeToSet1Scancode( static_cast<unsigned>( keycode ) ) == expected );
+            CHECK( scancodes[ keycode ] == expected );
+        }
+
+        CHECK( GitHubSample::DarwinKeycodeToSet1Scancode( 0x00 ) == 0x1E ); // a
+        CHECK( GitHubSample::DarwinKeycodeToSet1Scancode( 0x51 ) == 0x59 ); // keypad =
+        CHECK( GitHubSample::DarwinKeycodeToSet1Scancode( 0x71 ) == 0 );    // pause
+        CHECK( GitHubSample::DarwinKeycodeToSet1Scancode( 0x36 ) == ( 0x5C | GitHubSample::kSet1Extended | GitHubSample::kSet1Modifier ) );
+        CHECK( GitHubSample::DarwinModifierMaskToSet1Scancode( GitHubSample::kDarwinShiftKey ) == ( 0x2A | GitHubSample::kSet1Modifier ) );
+    }
+}
+
+
+
+int main()
+{
+    TestKnownKeys();
+    TestEveryCodeRoundTrips();
+    TestEveryUsageRoundTrips();
+    TestBatchMatchesSingle();
+    TestDarwinTableAgrees();
+
+    return GitHubSample::Test::Finish( "ScancodeTranslationTest" );
+}
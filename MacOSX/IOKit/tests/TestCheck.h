@@ -0,0 +1,61 @@
+
+#ifndef GITHUBSAMPLE_TEST_CHECK_H
+#define GITHUBSAMPLE_TEST_CHECK_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "EventClock.h"
+
+
+/// Counts a failure (and says where) when 'condition' is false.  Carries on either way.
+#define CHECK( condition ) GitHubSample::Test::Check( ( condition ), #condition, __FILE__, __LINE__ )
+
+
+namespace GitHubSample
+{
+namespace Test
+{
+
+    inline unsigned int& FailureCount()
+    {
+        static unsigned int failures = 0;
+        return failures;
+    }
+
+    inline bool Check( const bool condition, const char* text, const char* file, const int line )
+    {
+        if ( ! condition )
+        {
+            // an exhaustive test that is wrong is wrong thousands of times.  the first few say enough.
+            if ( FailureCount()++ < 20 )
+            {
+                fprintf( stderr, "%s:%d: FAILED: %s\n", file, line, text );
+            }
+        }
+        return condition;
+    }
+
+    /// What main returns.
+    inline int Finish( const char* name )
+    {
+        if ( FailureCount() != 0 )
+        {
+            fprintf( stderr, "%s: %u checks FAILED\n", name, FailureCount() );
+            return 1;
+        }
+
+        printf( "%s: passed\n", name );
+        return 0;
+    }
+
+    /// Nanoseconds on the clock the readers stamp their events with.
+    inline uint64_t Nanoseconds()
+    {
+        return EventClock::System().NowNanoseconds();
+    }
+
+} // end namespace Test
+} // end namespace GitHubSample
+
+#endif // GITHUBSAMPLE_TEST_CHECK_H
@@ -0,0 +1,108 @@
+
+
+#include "TestCheck.h"
+
+#include "TimestampMerger.h"
+
+#include <string.h>
+#include <vector>
+
+
+
+namespace
+{
+    const uint16_t USAGE_PAGE_KEYBOARD_OR_KEYPAD = 0x07;
+
+    /// the same number of events at every device count, so the times compare
+    const size_t TOTAL_EVENTS = 1 << 21;
+    /// what one read of one device returns
+    const size_t EVENTS_PER_READ = 16;
+    /// every device is read once per round, and its events of the round span this much time
+    const uint64_t ROUND_NANOSECONDS = 8000000;
+
+    uint32_t g_seed = 3;
+
+    unsigned int Random( const unsigned int range )
+    {
+        g_seed = g_seed * 1103515245u + 12345u;
+        return ( g_seed >> 16 ) % range;
+    }
+
+
+    /// Returns nanoseconds per event.  Checks the order on the way.
+    double MergeOnce( const size_t deviceCount, size_t& memoryBytes )
+    {
+        GitHubSample::TimestampMerger merger( deviceCount, 2 * ROUND_NANOSECONDS );
+        const size_t rounds = TOTAL_EVENTS / ( deviceCount * EVENTS_PER_READ );
+
+        // made up front, so only the merging is timed: each device's events are in order, the devices interleave
+        std::vector< GitHubSample::KeyEvent > events( rounds * deviceCount * EVENTS_PER_READ );
+        memset( &events[0], 0, events.size() * sizeof(events[0]) );
+        size_t next = 0;
+        for ( size_t round = 0; round < rounds; round++ )
+        {
+            for ( size_t device = 0; device < deviceCount; device++ )
+            {
+                uint64_t timestamp = round * ROUND_NANOSECONDS + Random( 1000 );
+                for ( size_t i = 0; i < EVENTS_PER_READ; i++, next++ )
+                {
+                    timestamp += Random( ROUND_NANOSECONDS / EVENTS_PER_READ - 1000 );
+                    events[ next ].timestamp = timestamp;
+                    events[ next ].usagePage = USAGE_PAGE_KEYBOARD_OR_KEYPAD;
+                    events[ next ].usage = static_cast<uint16_t>( 0x04 + i );
+                    events[ next ].value = static_cast<int32_t>( i & 1 );
+                    events[ next ].deviceIndex = static_cast<uint16_t>( device );
+                }
+            }
+        }
+
+        std::vector< GitHubSample::KeyEvent > merged( 4096 );
+        size_t mergedCount = 0;
+        uint64_t previous = 0;
+        bool ordered = true;
+
+        const uint64_t start = GitHubSample::Test::Nanoseconds();
+        for ( size_t offset = 0; offset < events.size(); offset += EVENTS_PER_READ )
+        {
+            merger.Push( &events[ offset ], EVENTS_PER_READ );
+
+            size_t count = 0;
+            while ( ( count = merger.Pop( &merged[0], merged.size() ) ) > 0 )
+            {
+                for ( size_t i = 0; i < count; i++ )
+                {
+                    ordered = ordered && ( merged[i].timestamp >= previous );
+                    previous = merged[i].timestamp;
+                }
+                mergedCount += count;
+            }
+        }
+        mergedCount += merger.Flush( &merged[0], merged.size() );
+        const uint64_t nanoseconds = GitHubSample::Test::Nanoseconds() - start;
+
+        memoryBytes = merger.MemoryUsage().ReservedBytes();
+
+        CHECK( ordered );
+        CHECK( mergedCount == events.size() );
+        CHECK( merger.LateCount() == 0 );
+        CHECK( merger.PendingCount() == 0 );
+
+        return static_cast<double>( nanoseconds ) / events.size();
+    }
+}
+
+
+
+int main()
+{
+    printf( "devices   ns per event   merger bytes\n" );
+
+    for ( size_t deviceCount = 1; deviceCount <= 256; deviceCount *= 2 )
+    {
+        size_t memoryBytes = 0;
+        const double nanoseconds = MergeOnce( deviceCount, memoryBytes );
+        printf( "%7lu   %12.1f   %12lu\n", static_cast<unsigned long>( deviceCount ), nanoseconds, static_cast<unsigned long>( memoryBytes ) );
+    }
+
+    return GitHubSample::Test::Finish( "TimestampMergerBench" );
+}
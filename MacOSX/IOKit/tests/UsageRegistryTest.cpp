@@ -0,0 +1,275 @@
+
+
+#include "TestCheck.h"
+
+#include "UsageRegistry.h"
+
+#include <map>
+#include <vector>
+
+
+
+namespace
+{
+    const unsigned int NO_INDEX = GitHubSample::UsageRegistry::kNoIndex;
+
+    /// the keyboard, the desktop, buttons, consumer, digitizer, and a vendor page at the top of the range
+    const uint16_t PAGES[] = { 0x07, 0x01, 0x09, 0x0C, 0x0D, 0xFF00 };
+    const size_t PAGE_COUNT = sizeof(PAGES) / sizeof(PAGES[0]);
+
+    const size_t ELEMENTS = 6000;
+    const unsigned int REPORT_IDS = 4;
+
+    uint32_t g_seed = 23;
+
+    unsigned int Random( const unsigned int range )
+    {
+        g_seed = g_seed * 1103515245u + 12345u;
+        return ( g_seed >> 16 ) % range;
+    }
+
+
+    struct Element
+    {
+        uint16_t usagePage;
+        uint16_t usage;
+        uint8_t reportId;
+        uint32_t cookie;
+    };
+
+
+    /// What the registry should hold: the elements in dense order, and where each (page, usage, report) went.
+    struct Model
+    {
+        std::vector< Element > elements;
+        std::map< uint64_t, unsigned int > indexByKey;
+        std::map< uint32_t, unsigned int > indexByUsage;
+
+        static uint64_t Key( const uint16_t usagePage, const uint16_t usage, const uint8_t reportId )
+        {
+            return ( static_cast<uint64_t>( usagePage ) << 24 ) | ( static_cast<uint64_t>( usage ) << 8 ) | reportId;
+        }
+
+        static uint32_t UsageKey( const uint16_t usagePage, const uint16_t usage )
+        {
+            return ( static_cast<uint32_t>( usagePage ) << 16 ) | usage;
+        }
+    };
+
+
+    /**
+       Mostly scattered usages (a block each), and now and then a run of
+       neighbours in one block, or a usage that is already there in
+       another report.  Cookies are all different, and not in order.
+     */
+    Element MakeElement( const Model& model, const size_t i )
+    {
+        Element element;
+        element.cookie = static_cast<uint32_t>( 1 + ( i * 7919 ) % 60000 );
+        element.reportId = static_cast<uint8_t>( Random( REPORT_IDS ) );
+
+        const unsigned int kind = Random( 4 );
+        if ( kind == 0 && ! model.elements.empty() )
+        {
+            const Element& earlier = model.elements[ Random( static_cast<unsigned int>( model.elements.size() ) ) ];
+            element.usagePage = earlier.usagePage;
+            element.usage = earlier.usage;
+        }
+        else if ( kind == 1 && ! model.elements.empty() )
+        {
+            const Element& earlier = model.elements.back();
+            element.usagePage = earlier.usagePage;
+            element.usage = static_cast<uint16_t>( earlier.usage + 1 );
+        }
+        else
+        {
+            element.usagePage = PAGES[ Random( PAGE_COUNT ) ];
+            element.usage = static_cast<uint16_t>( Random( 65536 ) );
+        }
+        return element;
+    }
+
+
+    void Fill( GitHubSample::UsageRegistry& registry, Model& model )
+    {
+        for ( size_t i = 0; i < ELEMENTS; i++ )
+        {
+            const Element element = MakeElement( model, i );
+            const unsigned int index = registry.Add( element.usagePage, element.usage, element.cookie, element.reportId );
+
+            const uint64_t key = Model::Key( element.usagePage, element.usage, element.reportId );
+            const std::map< uint64_t, unsigned int >::const_iterator existing = model.indexByKey.find( key );
+            if ( existing != model.indexByKey.end() )
+            {
+                // the same element again: its index, and the new cookie is not taken
+                CHECK( index == existing->second );
+                CHECK( registry.IndexOfCookie( element.cookie ) == NO_INDEX );
+                continue;
+            }
+
+            CHECK( index == model.elements.size() );
+            model.indexByKey[ key ] = index;
+            model.indexByUsage.insert( std::make_pair( Model::UsageKey( element.usagePage, element.usage ), index ) );
+            model.elements.push_back( element );
+        }
+    }
+
+
+    void CheckAgainstModel( const GitHubSample::UsageRegistry& registry, const Model& model )
+    {
+        CHECK( registry.Count() == model.elements.size() );
+
+        // dense order is the order of Add, however the usages are scattered
+        for ( unsigned int index = 0; index < model.elements.size(); index++ )
+        {
+            const Element& element = model.elements[ index ];
+            CHECK( registry.UsagePage( index ) == element.usagePage );
+            CHECK( registry.Usage( index ) == element.usage );
+            CHECK( registry.ReportId( index ) == element.reportId );
+            CHECK( registry.Cookie( index ) == element.cookie );
+            CHECK( registry.IndexOfCookie( element.cookie ) == index );
+            CHECK( registry.IndexOf( element.usagePage, element.usage, element.reportId ) == index );
+
+            // the first of the usage, whichever report it is in
+            const uint32_t usageKey = Model::UsageKey( element.usagePage, element.usage );
+            CHECK( registry.IndexOf( element.usagePage, element.usage ) == model.indexByUsage.find( usageKey )->second );
+        }
+
+        // each chain: every element of the usage, in dense order, and nothing else
+        size_t chained = 0;
+        for ( std::map< uint32_t, unsigned int >::const_iterator it = model.indexByUsage.begin(); it != model.indexByUsage.end(); ++it )
+        {
+            unsigned int previous = it->second;
+            chained++;
+            for ( unsigned int next = registry.NextWithSameUsage( previous ); next != NO_INDEX; next = registry.NextWithSameUsage( next ) )
+            {
+                CHECK( next > previous );
+                CHECK( Model::UsageKey( registry.UsagePage( next ), registry.Usage( next ) ) == it->first );
+                previous = next;
+                chained++;
+            }
+        }
+        CHECK( chained == model.elements.size() );
+    }
+
+
+    /// usages next to ones that are there, in the same block, on another page, or in another report
+    void CheckAbsent( const GitHubSample::UsageRegistry& registry, const Model& model )
+    {
+        size_t absent = 0;
+        for ( size_t i = 0; i < model.elements.size(); i++ )
+        {
+            const Element& element = model.elements[i];
+
+            const uint16_t neighbour = static_cast<uint16_t>( element.usage ^ 1 );
+            if ( model.indexByUsage.find( Model::UsageKey( element.usagePage, neighbour ) ) == model.indexByUsage.end() )
+            {
+                CHECK( registry.IndexOf( element.usagePage, neighbour ) == NO_INDEX );
+                absent++;
+            }
+
+            // a page we never add to, with the very same usage
+            CHECK( registry.IndexOf( 0x0B, element.usage ) == NO_INDEX );
+
+            const uint8_t otherReport = static_cast<uint8_t>( REPORT_IDS + element.reportId );
+            CHECK( registry.IndexOf( element.usagePage, element.usage, otherReport ) == NO_INDEX );
+        }
+        CHECK( absent > model.elements.size() / 2 );
+
+        CHECK( registry.IndexOfCookie( 0 ) == NO_INDEX );
+        CHECK( registry.IndexOfCookie( 60001 ) == NO_INDEX );
+        CHECK( registry.IndexOfCookie( 0xFFFFFFFF ) == NO_INDEX );
+    }
+
+
+    void TestThousandsOfElements()
+    {
+        GitHubSample::UsageRegistry registry;
+        Model model;
+
+        const size_t emptyBytes = registry.TableBytes();
+        Fill( registry, model );
+        printf( "%lu elements in %lu usages: %lu bytes of tables\n", static_cast<unsigned long>( model.elements.size() ),
+                static_cast<unsigned long>( model.indexByUsage.size() ), static_cast<unsigned long>( registry.TableBytes() ) );
+
+        // thousands of blocks: the hash table has grown many times over its first 32 places
+        CHECK( model.indexByUsage.size() > 1000 );
+        CHECK( registry.TableBytes() > emptyBytes + model.indexByUsage.size() / 2 * 64 * sizeof(uint16_t) );
+
+        CheckAgainstModel( registry, model );
+        CheckAbsent( registry, model );
+
+        // values are per element, and Values() is all of them in dense order
+        for ( unsigned int index = 0; index < registry.Count(); index++ )
+        {
+            registry.SetValue( index, static_cast<int32_t>( index ) - 1000 );
+        }
+        const int32_t* values = registry.Values();
+        for ( unsigned int index = 0; index < registry.Count(); index++ )
+        {
+            CHECK( values[ index ] == static_cast<int32_t>( index ) - 1000 );
+        }
+    }
+
+
+    void TestClear()
+    {
+        GitHubSample::UsageRegistry registry;
+        Model model;
+        Fill( registry, model );
+
+        registry.Clear();
+        CHECK( registry.Count() == 0 );
+        for ( size_t i = 0; i < model.elements.size(); i++ )
+        {
+            const Element& element = model.elements[i];
+            CHECK( registry.IndexOf( element.usagePage, element.usage ) == NO_INDEX );
+            CHECK( registry.IndexOf( element.usagePage, element.usage, element.reportId ) == NO_INDEX );
+            CHECK( registry.IndexOfCookie( element.cookie ) == NO_INDEX );
+        }
+
+        // filled again with other elements: as good as new, and in the tables it already has
+        Model again;
+        g_seed += 1000;
+        Fill( registry, again );
+        CheckAgainstModel( registry, again );
+        CheckAbsent( registry, again );
+    }
+
+
+    void TestLimits()
+    {
+        GitHubSample::UsageRegistry registry;
+
+        // cookies are 16 bits
+        CHECK( registry.Add( 0x0C, 0xE9, 0x10000 ) == NO_INDEX );
+        CHECK( registry.Add( 0x0C, 0xE9, 0xFFFF ) == 0 );
+        CHECK( registry.IndexOfCookie( 0xFFFF ) == 0 );
+
+        // up to kNoIndex - 1 elements: every usage of the vendor page, then no more
+        registry.Clear();
+        registry.Reserve( NO_INDEX );
+        for ( uint32_t usage = 0; usage < NO_INDEX - 1; usage++ )
+        {
+            CHECK( registry.Add( 0xFF00, static_cast<uint16_t>( usage ), usage ) == usage );
+        }
+        CHECK( registry.Count() == NO_INDEX - 1 );
+        CHECK( registry.Add( 0xFF00, 0xFFFE, 0xFFFE ) == NO_INDEX );
+        CHECK( registry.Add( 0xFF01, 0, 0xFFFE ) == NO_INDEX );
+        // what is there is still found, and still added again
+        CHECK( registry.Add( 0xFF00, 0x1234, 0x1234 ) == 0x1234 );
+        CHECK( registry.IndexOf( 0xFF00, 0xFFFD ) == 0xFFFD );
+        CHECK( registry.IndexOfCookie( 0xFFFD ) == 0xFFFD );
+    }
+}
+
+
+
+int main()
+{
+    TestThousandsOfElements();
+    TestClear();
+    TestLimits();
+
+    return GitHubSample::Test::Finish( "UsageRegistryTest" );
+}